@@ -355,6 +355,15 @@ if port:
     fi
 }
 
+# サーバー本体を実行（Webサーバーが無い場合はネイティブの常駐サーバーを使用）
+run_server_binary() {
+    if [ -x "$WEB_DIR/gllm_rest_server" ]; then
+        cd "$WEB_DIR" && exec ./gllm_rest_server --port "$PORT" $([ "$DEBUG" = "true" ] && echo "--debug")
+    else
+        cd "$WORKSPACE_DIR" && exec "$BIN_DIR/main" $([ "$DEBUG" = "true" ] && echo "-d") -s --port "$PORT"
+    fi
+}
+
 # サーバーを起動
 start_server() {
     local foreground="$1"
@@ -393,10 +402,10 @@ start_server() {
     
     if [ "$foreground" = "true" ]; then
         # フォアグラウンドで実行
-        cd "$WEB_DIR" && ./gllm_rest_server --port "$PORT" $([ "$DEBUG" = "true" ] && echo "--debug")
+        ( run_server_binary )
     else
         # バックグラウンドで実行
-        cd "$WEB_DIR" && ./gllm_rest_server --port "$PORT" $([ "$DEBUG" = "true" ] && echo "--debug") > "$LOG_DIR/server.log" 2>&1 &
+        ( run_server_binary ) > "$LOG_DIR/server.log" 2>&1 &
         local server_pid=$!
         echo "$server_pid" > "$PID_FILE"
         
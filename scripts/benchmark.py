@@ -39,19 +39,61 @@ EXPECTED_KEYWORDS = {
     "旅行の計画を立てるコツはありますか？": ["予約", "スケジュール", "予算", "情報", "準備"]
 }
 
-def run_router_model(question: str, debug: bool = False) -> Tuple[str, float]:
+class ResidentServer:
+    """
+    常駐サーバーモード（./main -s）に行プロトコルで質問を送るクライアント。
+    初期化は起動時の一度だけなので、質問ごとの時間はルーティング処理のみになります。
+    """
+    
+    def __init__(self, debug: bool = False):
+        cmd = ["./main"]
+        if debug:
+            cmd.append("-d")
+        cmd.append("-s")
+        self.proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                     stderr=subprocess.DEVNULL)
+    
+    def ask(self, question: str) -> str:
+        """質問を1行で送り、"." だけの行までを応答として読み込みます"""
+        self.proc.stdin.write((question.replace("\n", " ") + "\n").encode('utf-8'))
+        self.proc.stdin.flush()
+        
+        lines = []
+        while True:
+            line = self.proc.stdout.readline()
+            if not line:
+                break
+            line = line.decode('utf-8', errors='replace').rstrip("\n")
+            if line == ".":
+                break
+            if line.startswith(".."):
+                line = line[1:]
+            lines.append(line)
+        return "\n".join(lines)
+    
+    def close(self):
+        if self.proc.poll() is None:
+            self.proc.stdin.close()
+            self.proc.wait(timeout=10)
+
+def run_router_model(question: str, debug: bool = False, server: ResidentServer = None) -> Tuple[str, float]:
     """
     ルーターモデルを実行して応答と実行時間を取得します。
     
     Args:
         question: 質問文
         debug: デバッグモードを有効にするかどうか
+        server: 常駐サーバー（Noneの場合は質問ごとにプロセスを起動）
     
     Returns:
         応答文と実行時間（秒）のタプル
     """
     start_time = time.time()
     
+    if server is not None:
+        response = server.ask(question)
+        return response, time.time() - start_time
+    
     cmd = ["./main", "router"]
     if debug:
         cmd.append("-d")
@@ -119,7 +161,8 @@ def evaluate_response(response: str, expected_keywords: List[str]) -> float:
     
     return matched_keywords / len(expected_keywords)
 
-def run_benchmark(questions: List[str] = None, debug: bool = False, output_file: str = None) -> Dict[str, Any]:
+def run_benchmark(questions: List[str] = None, debug: bool = False, output_file: str = None,
+                  use_server: bool = False) -> Dict[str, Any]:
     """
     ベンチマークを実行します。
     
@@ -127,6 +170,7 @@ def run_benchmark(questions: List[str] = None, debug: bool = False, output_file:
         questions: 質問のリスト（Noneの場合はデフォルトの質問を使用）
         debug: デバッグモードを有効にするかどうか
         output_file: 結果を保存するJSONファイルのパス
+        use_server: 常駐サーバーモードで実行するかどうか
     
     Returns:
         ベンチマーク結果の辞書
@@ -138,6 +182,7 @@ def run_benchmark(questions: List[str] = None, debug: bool = False, output_file:
         "timestamp": time.strftime("%Y-%m-%d %H:%M:%S"),
         "total_questions": len(questions),
         "debug_mode": debug,
+        "server_mode": use_server,
         "questions": []
     }
     
@@ -146,10 +191,12 @@ def run_benchmark(questions: List[str] = None, debug: bool = False, output_file:
     
     print(f"ベンチマークを開始します（質問数: {len(questions)}）...")
     
+    server = ResidentServer(debug) if use_server else None
+    
     for i, question in enumerate(questions, 1):
         print(f"\n[{i}/{len(questions)}] 質問: {question}")
         
-        response, exec_time = run_router_model(question, debug)
+        response, exec_time = run_router_model(question, debug, server)
         total_time += exec_time
         
         # 応答の評価
@@ -176,6 +223,9 @@ def run_benchmark(questions: List[str] = None, debug: bool = False, output_file:
             "expected_keywords": expected_kw
         })
     
+    if server is not None:
+        server.close()
+    
     # 集計結果
     results["total_execution_time"] = total_time
     results["average_execution_time"] = total_time / len(questions)
@@ -199,6 +249,7 @@ def main():
     parser.add_argument('-d', '--debug', action='store_true', help='デバッグモードを有効にする')
     parser.add_argument('-o', '--output', type=str, default='benchmark_results.json', help='結果を保存するJSONファイル')
     parser.add_argument('-q', '--questions', type=str, help='質問リストを含むJSONファイル')
+    parser.add_argument('-s', '--server', action='store_true', help='常駐サーバーモードで実行する（初期化は一度だけ）')
     
     args = parser.parse_args()
     
@@ -216,7 +267,7 @@ def main():
             print(f"質問ファイルの読み込みエラー: {e}")
             print("デフォルトの質問リストを使用します。")
     
-    run_benchmark(questions, args.debug, args.output)
+    run_benchmark(questions, args.debug, args.output, args.server)
 
 if __name__ == "__main__":
     main()
\ No newline at end of file
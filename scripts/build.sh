@@ -64,8 +64,8 @@ if [ -f "src/main_improved.c" ]; then
 else
     # 従来のソースコードを使用
     echo "従来のソースコードを使用してビルドします..."
-    echo "コンパイルコマンド: $COMPILER $CFLAGS -Wall -Wextra -std=c99 -o gllm src/main.c src/vector_search/vector_search.c src/vector_search/vector_search_global.c src/include/word_loader/word_loader.c $LDFLAGS -lmecab -lm -lcurl"
-    $COMPILER $CFLAGS -Wall -Wextra -std=c99 -o gllm src/main.c src/vector_search/vector_search.c src/vector_search/vector_search_global.c src/include/word_loader/word_loader.c $LDFLAGS -lmecab -lm -lcurl
+    echo "コンパイルコマンド: $COMPILER $CFLAGS -Wall -Wextra -std=c99 -o gllm src/main.c src/vector_search/vector_search.c src/vector_search/vector_distance.c src/vector_search/vector_scan.c src/vector_search/vector_search_global.c src/include/word_loader/word_loader.c $LDFLAGS -lmecab -lm -lcurl -lpthread"
+    $COMPILER $CFLAGS -Wall -Wextra -std=c99 -o gllm src/main.c src/vector_search/vector_search.c src/vector_search/vector_distance.c src/vector_search/vector_scan.c src/vector_search/vector_search_global.c src/include/word_loader/word_loader.c $LDFLAGS -lmecab -lm -lcurl -lpthread
 fi
 
 # 実行ファイルをbinディレクトリにコピー
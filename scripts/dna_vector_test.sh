@@ -41,7 +41,7 @@ int main() {
     printf("----------------------------------------\n");
     
     // DNAベクトルデータベースを初期化
-    DNAVectorDB db;
+    static DNAVectorDB db;  // エントリの配列が大きいのでスタックに置かない
     init_dna_vector_db(&db);
     
     // テスト用のDNAコードを読み込む
@@ -102,7 +102,8 @@ int main() {
     
     // DNAベクトルデータベースをファイルから読み込む
     printf("\nDNAベクトルデータベースをファイルから読み込んでいます...\n");
-    DNAVectorDB loaded_db;
+    static DNAVectorDB loaded_db;
+    init_dna_vector_db(&loaded_db);
     int loaded_count = load_dna_vector_db(&loaded_db, "$DNA_VECTOR_DB_FILE");
     if (loaded_count > 0) {
         printf("  読み込み成功: %d エントリ\n", loaded_count);
@@ -116,22 +117,28 @@ int main() {
     
     printf("  クエリ: %s\n", query_dna_code);
     
+    char nearest_code[64];
     int nearest_euclidean = search_nearest_dna_euclidean(&loaded_db, query_dna_code);
     if (nearest_euclidean >= 0) {
+        dna_code_format(&loaded_db.entries[nearest_euclidean].code, nearest_code, sizeof(nearest_code));
         printf("  ユークリッド距離で最も近いDNAコード: %s (ID: %d)\n", 
-               loaded_db.entries[nearest_euclidean].dna_code, nearest_euclidean);
+               nearest_code, nearest_euclidean);
     } else {
         printf("  ユークリッド距離での検索に失敗しました\n");
     }
     
     int nearest_cosine = search_nearest_dna_cosine(&loaded_db, query_dna_code);
     if (nearest_cosine >= 0) {
+        dna_code_format(&loaded_db.entries[nearest_cosine].code, nearest_code, sizeof(nearest_code));
         printf("  コサイン類似度で最も近いDNAコード: %s (ID: %d)\n", 
-               loaded_db.entries[nearest_cosine].dna_code, nearest_cosine);
+               nearest_code, nearest_cosine);
     } else {
         printf("  コサイン類似度での検索に失敗しました\n");
     }
     
+    free_dna_vector_db(&db);
+    free_dna_vector_db(&loaded_db);
+    
     printf("\nテスト完了\n");
     return 0;
 }
@@ -139,7 +146,7 @@ EOF
 
 # テストプログラムをコンパイル
 echo "テストプログラムをコンパイルしています..."
-gcc -o "$TEMP_DIR/dna_vector_test" "$TEMP_DIR/dna_vector_test.c" "$WORKSPACE_DIR/src/include/dna_vector_db.c" -lm
+gcc -o "$TEMP_DIR/dna_vector_test" "$TEMP_DIR/dna_vector_test.c" "$WORKSPACE_DIR/src/include/dna_vector_db.c" "$WORKSPACE_DIR/src/include/dna_packed_code.c" "$WORKSPACE_DIR/src/vector_search/vector_distance.c" -lm
 
 # テストプログラムを実行
 echo "テストプログラムを実行しています..."
@@ -0,0 +1,460 @@
+#define _POSIX_C_SOURCE 200809L
+#include "dna_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DNA_INDEX_INITIAL_ENTRIES 1024
+#define DNA_INDEX_INITIAL_DESCRIPTION_BYTES 65536
+
+// 作成中のインデックス
+typedef struct {
+    DnaPackedCode* codes;
+    uint32_t* description_offsets;      // count + 1 件
+    uint32_t count;
+    uint32_t capacity;
+    char* descriptions;
+    size_t description_bytes;
+    size_t description_capacity;
+} DnaIndexBuilder;
+
+// 作成中のインデックスを解放
+static void dna_index_builder_free(DnaIndexBuilder* builder) {
+    free(builder->codes);
+    free(builder->description_offsets);
+    free(builder->descriptions);
+    memset(builder, 0, sizeof(*builder));
+}
+
+// エントリを加える
+static bool dna_index_builder_add(DnaIndexBuilder* builder, const DnaPackedCode* code, const char* description, size_t length) {
+    if (builder->count + 1 >= builder->capacity) {
+        uint32_t capacity = builder->capacity > 0 ? builder->capacity * 2 : DNA_INDEX_INITIAL_ENTRIES;
+        DnaPackedCode* codes = (DnaPackedCode*)realloc(builder->codes, sizeof(DnaPackedCode) * capacity);
+        if (!codes) {
+            return false;
+        }
+        builder->codes = codes;
+        uint32_t* offsets = (uint32_t*)realloc(builder->description_offsets, sizeof(uint32_t) * (capacity + 1));
+        if (!offsets) {
+            return false;
+        }
+        builder->description_offsets = offsets;
+        builder->capacity = capacity;
+    }
+
+    if (builder->description_bytes + length + 1 > UINT32_MAX) {
+        return false;
+    }
+    if (builder->description_bytes + length + 1 > builder->description_capacity) {
+        size_t capacity = builder->description_capacity > 0 ? builder->description_capacity : DNA_INDEX_INITIAL_DESCRIPTION_BYTES;
+        while (capacity < builder->description_bytes + length + 1) {
+            capacity *= 2;
+        }
+        char* descriptions = (char*)realloc(builder->descriptions, capacity);
+        if (!descriptions) {
+            return false;
+        }
+        builder->descriptions = descriptions;
+        builder->description_capacity = capacity;
+    }
+
+    builder->codes[builder->count] = *code;
+    builder->description_offsets[builder->count] = (uint32_t)builder->description_bytes;
+    memcpy(builder->descriptions + builder->description_bytes, description, length);
+    builder->descriptions[builder->description_bytes + length] = '\0';
+    builder->description_bytes += length + 1;
+    builder->count++;
+    return true;
+}
+
+// DNAコンビネーションファイルを読み込む
+static bool dna_index_builder_read(DnaIndexBuilder* builder, FILE* file) {
+    char* line = NULL;
+    size_t line_capacity = 0;
+    ssize_t length;
+    bool ok = true;
+
+    while ((length = getline(&line, &line_capacity, file)) >= 0) {
+        // 改行を削除
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+
+        // DNAコードと説明を分離
+        char* separator = strchr(line, '|');
+        if (!separator) {
+            continue;
+        }
+        *separator = '\0';
+
+        DnaPackedCode code;
+        if (!dna_code_pack(line, &code)) {
+            fprintf(stderr, "DNAコードのIDが大きすぎるため読み飛ばします: %s\n", line);
+            continue;
+        }
+        const char* description = separator + 1;
+        if (!dna_index_builder_add(builder, &code, description, (size_t)(line + length - description))) {
+            fprintf(stderr, "メモリ割り当てエラー: DNAインデックスを作成できませんでした\n");
+            ok = false;
+            break;
+        }
+    }
+
+    free(line);
+    return ok;
+}
+
+// 配列をファイルに書き出す
+static bool dna_index_write(FILE* file, const void* data, size_t size, size_t count) {
+    return count == 0 || fwrite(data, size, count, file) == count;
+}
+
+// DNAコンビネーションファイルからインデックスファイルを作る
+bool dna_index_build(const char* source_path, const char* index_path) {
+    FILE* source = fopen(source_path, "r");
+    if (!source) {
+        fprintf(stderr, "DNAコンビネーションファイルを開けません: %s\n", source_path);
+        return false;
+    }
+    struct stat source_stat;
+    if (fstat(fileno(source), &source_stat) != 0) {
+        fclose(source);
+        return false;
+    }
+
+    DnaIndexBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+    bool ok = dna_index_builder_read(&builder, source);
+    fclose(source);
+    if (!ok) {
+        dna_index_builder_free(&builder);
+        return false;
+    }
+
+    DnaIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DNA_INDEX_MAGIC, sizeof(header.magic));
+    header.version = DNA_INDEX_VERSION;
+    header.count = builder.count;
+    header.description_bytes = (uint32_t)builder.description_bytes;
+    header.source_size = (uint64_t)source_stat.st_size;
+    header.source_mtime = (int64_t)source_stat.st_mtime;
+    if (builder.description_offsets) {
+        builder.description_offsets[builder.count] = (uint32_t)builder.description_bytes;
+    }
+
+    // 要素ごとに、IDの出現数を数えてから開始位置を決め、エントリ番号の順に並べる
+    uint32_t* starts[DNA_PACKED_SLOT_COUNT] = {0};
+    uint32_t* postings[DNA_PACKED_SLOT_COUNT] = {0};
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT && ok; slot++) {
+        for (uint32_t i = 0; i < builder.count; i++) {
+            int id = dna_code_id(&builder.codes[i], slot);
+            if (id >= 0 && (uint32_t)id >= header.id_counts[slot]) {
+                header.id_counts[slot] = (uint32_t)id + 1;
+            }
+        }
+
+        uint32_t id_count = header.id_counts[slot];
+        starts[slot] = (uint32_t*)calloc(id_count + 1, sizeof(uint32_t));
+        uint32_t* cursor = (uint32_t*)malloc(sizeof(uint32_t) * (id_count + 1));
+        if (!starts[slot] || !cursor) {
+            free(cursor);
+            ok = false;
+            break;
+        }
+        for (uint32_t i = 0; i < builder.count; i++) {
+            int id = dna_code_id(&builder.codes[i], slot);
+            if (id >= 0) {
+                starts[slot][id + 1]++;
+            }
+        }
+        for (uint32_t id = 0; id < id_count; id++) {
+            starts[slot][id + 1] += starts[slot][id];
+        }
+
+        postings[slot] = (uint32_t*)malloc(sizeof(uint32_t) * (starts[slot][id_count] + 1));
+        if (!postings[slot]) {
+            free(cursor);
+            ok = false;
+            break;
+        }
+        memcpy(cursor, starts[slot], sizeof(uint32_t) * (id_count + 1));
+        for (uint32_t i = 0; i < builder.count; i++) {
+            int id = dna_code_id(&builder.codes[i], slot);
+            if (id >= 0) {
+                postings[slot][cursor[id]++] = i;
+            }
+        }
+        free(cursor);
+    }
+
+    // 一時ファイルに書いてから置き換える
+    char temp_path[4096];
+    FILE* file = NULL;
+    if (ok) {
+        snprintf(temp_path, sizeof(temp_path), "%s.tmp", index_path);
+        file = fopen(temp_path, "wb");
+        if (!file) {
+            fprintf(stderr, "DNAインデックスファイルを作成できません: %s\n", temp_path);
+            ok = false;
+        }
+    } else {
+        fprintf(stderr, "メモリ割り当てエラー: DNAインデックスを作成できませんでした\n");
+    }
+
+    if (ok) {
+        ok = dna_index_write(file, &header, sizeof(header), 1) &&
+             dna_index_write(file, builder.codes, sizeof(DnaPackedCode), builder.count) &&
+             dna_index_write(file, builder.description_offsets, sizeof(uint32_t), builder.count > 0 ? builder.count + 1 : 0);
+        if (ok && builder.count == 0) {
+            uint32_t zero = 0;
+            ok = dna_index_write(file, &zero, sizeof(zero), 1);
+        }
+        for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT && ok; slot++) {
+            ok = dna_index_write(file, starts[slot], sizeof(uint32_t), header.id_counts[slot] + 1);
+        }
+        for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT && ok; slot++) {
+            ok = dna_index_write(file, postings[slot], sizeof(uint32_t), starts[slot][header.id_counts[slot]]);
+        }
+        ok = ok && dna_index_write(file, builder.descriptions, 1, builder.description_bytes);
+        if (fclose(file) != 0) {
+            ok = false;
+        }
+        if (ok && rename(temp_path, index_path) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "DNAインデックスファイルの書き込みに失敗しました: %s\n", index_path);
+            remove(temp_path);
+        }
+    }
+
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        free(starts[slot]);
+        free(postings[slot]);
+    }
+    dna_index_builder_free(&builder);
+    return ok;
+}
+
+// インデックスファイルを開く
+bool dna_index_open(DnaIndex* index, const char* index_path, const char* source_path) {
+    memset(index, 0, sizeof(*index));
+
+    int fd = open(index_path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(DnaIndexHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    index->mapping = mapping;
+    index->mapping_size = size;
+
+    const DnaIndexHeader* header = (const DnaIndexHeader*)mapping;
+    if (memcmp(header->magic, DNA_INDEX_MAGIC, sizeof(header->magic)) != 0 || header->version != DNA_INDEX_VERSION) {
+        fprintf(stderr, "DNAインデックスファイルの形式が違います: %s\n", index_path);
+        dna_index_close(index);
+        return false;
+    }
+
+    // 作成元が更新されていれば作り直してもらう（作成元がなければインデックスだけで使う）
+    struct stat source_stat;
+    if (source_path && stat(source_path, &source_stat) == 0 &&
+        ((uint64_t)source_stat.st_size != header->source_size || (int64_t)source_stat.st_mtime != header->source_mtime)) {
+        dna_index_close(index);
+        return false;
+    }
+
+    // 各部分の位置を求めながら、ファイルの大きさを超えないか確かめる
+    const char* base = (const char*)mapping;
+    size_t offset = sizeof(DnaIndexHeader);
+    size_t count = header->count;
+    bool ok = (size - offset) / sizeof(DnaPackedCode) >= count;
+    if (ok) {
+        index->codes = (const DnaPackedCode*)(base + offset);
+        offset += count * sizeof(DnaPackedCode);
+        ok = (size - offset) / sizeof(uint32_t) >= count + 1;
+    }
+    if (ok) {
+        index->description_offsets = (const uint32_t*)(base + offset);
+        offset += (count + 1) * sizeof(uint32_t);
+    }
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT && ok; slot++) {
+        size_t id_count = header->id_counts[slot];
+        ok = (size - offset) / sizeof(uint32_t) >= id_count + 1;
+        if (ok) {
+            index->id_counts[slot] = header->id_counts[slot];
+            index->starts[slot] = (const uint32_t*)(base + offset);
+            offset += (id_count + 1) * sizeof(uint32_t);
+        }
+        // 転置リストの開始位置は 0 から始まって減らない（でなければリストの範囲が転置リストの外に出る）
+        if (ok) {
+            const uint32_t* starts = index->starts[slot];
+            ok = starts[0] == 0;
+            for (size_t i = 0; i < id_count && ok; i++) {
+                ok = starts[i] <= starts[i + 1];
+            }
+        }
+    }
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT && ok; slot++) {
+        size_t posting_count = index->starts[slot][index->id_counts[slot]];
+        ok = (size - offset) / sizeof(uint32_t) >= posting_count;
+        if (ok) {
+            index->postings[slot] = (const uint32_t*)(base + offset);
+            offset += posting_count * sizeof(uint32_t);
+        }
+    }
+    if (ok) {
+        ok = size - offset == header->description_bytes &&
+             index->description_offsets[count] == header->description_bytes &&
+             (header->description_bytes == 0 || base[size - 1] == '\0');
+    }
+    if (!ok) {
+        fprintf(stderr, "DNAインデックスファイルが壊れています: %s\n", index_path);
+        dna_index_close(index);
+        return false;
+    }
+
+    index->descriptions = base + offset;
+    index->count = header->count;
+    return true;
+}
+
+// インデックスファイルを閉じる
+void dna_index_close(DnaIndex* index) {
+    if (index->mapping) {
+        munmap(index->mapping, index->mapping_size);
+    }
+    memset(index, 0, sizeof(*index));
+}
+
+// エントリの説明
+const char* dna_index_description(const DnaIndex* index, uint32_t entry) {
+    if (entry >= index->count || index->description_offsets[entry] >= index->description_offsets[index->count]) {
+        return "";
+    }
+    return index->descriptions + index->description_offsets[entry];
+}
+
+// 要素のビットの重みの合計
+static double dna_index_weight_sum(unsigned int mask, const double weights[DNA_PACKED_SLOT_COUNT]) {
+    double sum = 0.0;
+    for (int i = 0; i < DNA_PACKED_SLOT_COUNT; i++) {
+        sum += weights[i] * ((mask >> i) & 1);
+    }
+    return sum;
+}
+
+// 重み付きの類似度
+double dna_index_similarity(const DnaPackedCode* a, const DnaPackedCode* b, const double weights[DNA_PACKED_SLOT_COUNT]) {
+    unsigned int shared = 0;
+    unsigned int matched = 0;
+    dna_code_compare(a, b, &shared, &matched);
+
+    double weight_sum = dna_index_weight_sum(shared, weights);
+    if (weight_sum == 0.0) {
+        return 0.0;
+    }
+    return dna_index_weight_sum(matched, weights) / weight_sum;
+}
+
+// 類似度の高い順（同じならエントリ番号の順）に保った上位の結果に加える
+static void dna_index_push(DnaIndexResult* results, int* count, int max_results, uint32_t entry, double similarity) {
+    int position = *count;
+    if (position == max_results) {
+        const DnaIndexResult* last = &results[position - 1];
+        if (similarity < last->similarity || (similarity == last->similarity && entry > last->entry)) {
+            return;
+        }
+        position--;
+    } else {
+        (*count)++;
+    }
+
+    while (position > 0 &&
+           (similarity > results[position - 1].similarity ||
+            (similarity == results[position - 1].similarity && entry < results[position - 1].entry))) {
+        results[position] = results[position - 1];
+        position--;
+    }
+    results[position].entry = entry;
+    results[position].similarity = similarity;
+}
+
+// 類似度の上位を検索
+int dna_index_search(const DnaIndex* index, const DnaPackedCode* query, const double weights[DNA_PACKED_SLOT_COUNT],
+                     DnaIndexResult* results, int max_results, uint32_t* candidates) {
+    if (candidates) {
+        *candidates = 0;
+    }
+    if (!index || !query || !results || max_results <= 0 || index->count == 0) {
+        return 0;
+    }
+
+    // エントリごとに、クエリとIDが一致した（重みのある）要素のビットを集める
+    uint8_t* matched = (uint8_t*)calloc(index->count, 1);
+    uint32_t* touched = (uint32_t*)malloc(sizeof(uint32_t) * index->count);
+    if (!matched || !touched) {
+        fprintf(stderr, "メモリ割り当てエラー: DNAインデックスの検索に失敗しました\n");
+        free(matched);
+        free(touched);
+        return 0;
+    }
+
+    uint32_t touched_count = 0;
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        int id = dna_code_id(query, slot);
+        if (id < 0 || (uint32_t)id >= index->id_counts[slot] || weights[slot] <= 0.0) {
+            continue;
+        }
+        const uint32_t* posting = index->postings[slot];
+        for (uint32_t p = index->starts[slot][id]; p < index->starts[slot][id + 1]; p++) {
+            uint32_t entry = posting[p];
+            if (entry >= index->count) {
+                continue;
+            }
+            if (matched[entry] == 0) {
+                touched[touched_count++] = entry;
+            }
+            matched[entry] |= (uint8_t)(1u << slot);
+        }
+    }
+
+    // 集めたエントリだけ類似度を計算する（それ以外は一致する要素がないので 0）
+    int count = 0;
+    for (uint32_t i = 0; i < touched_count; i++) {
+        uint32_t entry = touched[i];
+        double similarity = dna_index_similarity(query, &index->codes[entry], weights);
+        dna_index_push(results, &count, max_results, entry, similarity);
+    }
+
+    // 足りない分は類似度 0 のエントリを番号の順に補う
+    for (uint32_t entry = 0; entry < index->count && count < max_results; entry++) {
+        if (matched[entry] == 0) {
+            results[count].entry = entry;
+            results[count].similarity = 0.0;
+            count++;
+        }
+    }
+
+    if (candidates) {
+        *candidates = touched_count;
+    }
+    free(matched);
+    free(touched);
+    return count;
+}
@@ -0,0 +1,71 @@
+#ifndef DNA_INDEX_H
+#define DNA_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/dna_packed_code.h"
+
+#define DNA_INDEX_MAGIC "DNAI"
+#define DNA_INDEX_VERSION 1
+
+// DNAコンビネーションのインデックスファイルの形式（数値は実行環境のバイト順）
+//   ヘッダー: DnaIndexHeader
+//   DNAコード: DnaPackedCode × count
+//   説明の位置: uint32 × (count + 1)（i 番目の説明は descriptions + offsets[i]、'\0' 終端）
+//   要素ごと（E, C, R, A, T, L, M, Q の順）の転置リストの開始位置: uint32 × (id_counts[s] + 1)
+//   要素ごとの転置リスト: エントリ番号（uint32、昇順）を要素のIDの順に並べる
+//   説明: char × description_bytes
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;                                 // エントリ数
+    uint32_t description_bytes;                     // 説明の合計バイト数（終端を含む）
+    uint64_t source_size;                           // 作成元のテキストファイルの大きさ
+    int64_t source_mtime;                           // 作成元のテキストファイルの更新時刻
+    uint32_t id_counts[DNA_PACKED_SLOT_COUNT];      // 要素ごとの（最大のID + 1）
+} DnaIndexHeader;
+
+// 読み込んだインデックス（ファイルを mmap して参照する）
+typedef struct {
+    void* mapping;
+    size_t mapping_size;
+    uint32_t count;
+    const DnaPackedCode* codes;
+    const uint32_t* description_offsets;
+    const char* descriptions;
+    uint32_t id_counts[DNA_PACKED_SLOT_COUNT];
+    const uint32_t* starts[DNA_PACKED_SLOT_COUNT];      // 要素のIDごとの転置リストの開始位置
+    const uint32_t* postings[DNA_PACKED_SLOT_COUNT];
+} DnaIndex;
+
+// 検索結果
+typedef struct {
+    uint32_t entry;             // エントリ番号
+    double similarity;
+} DnaIndexResult;
+
+// DNAコンビネーションファイル（"DNAコード|説明" の行）からインデックスファイルを作る
+// 区切りのない行とIDが大きすぎるコードの行は読み飛ばす
+bool dna_index_build(const char* source_path, const char* index_path);
+
+// インデックスファイルを開く（source_path を指定すると、作成後に更新されていれば false）
+bool dna_index_open(DnaIndex* index, const char* index_path, const char* source_path);
+
+// インデックスファイルを閉じる
+void dna_index_close(DnaIndex* index);
+
+// エントリの説明
+const char* dna_index_description(const DnaIndex* index, uint32_t entry);
+
+// 重み付きの類似度（両方にある要素の重みの合計に対する、IDが一致した要素の重みの割合）
+double dna_index_similarity(const DnaPackedCode* a, const DnaPackedCode* b, const double weights[DNA_PACKED_SLOT_COUNT]);
+
+// 類似度の上位 max_results 件を類似度の高い順（同じならエントリ番号の順）に results に入れる
+// 重みのある要素のIDが一致するエントリだけを転置リストから集めて計算し、
+// 残りは類似度 0 としてエントリ番号の順に補う（全件を調べた結果と同じになる）
+// candidates には計算したエントリ数を入れる（NULL 可）
+int dna_index_search(const DnaIndex* index, const DnaPackedCode* query, const double weights[DNA_PACKED_SLOT_COUNT],
+                     DnaIndexResult* results, int max_results, uint32_t* candidates);
+
+#endif // DNA_INDEX_H
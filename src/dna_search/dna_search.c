@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,37 +6,16 @@
 #include <ctype.h>
 #include <math.h>
 #include <time.h>
-#include <signal.h>
-#include <unistd.h>
+#include "../include/dna_packed_code.h"
+#include "dna_index.h"
 
-#define MAX_LINE_LENGTH 1024
 #define MAX_DNA_LENGTH 32
-#define MAX_DESC_LENGTH 256
 #define MAX_RESULTS 20
-#define MAX_COMBINATIONS 10000
-#define SAMPLE_SIZE 1000
-#define TIMEOUT_SECONDS 5
+#define DNA_COMBINATIONS_FILE "/workspace/data/dna_combinations.txt"
+#define DNA_INDEX_FILE "/workspace/data/dna_combinations.idx"
 
-// DNAコードの構造体
-typedef struct {
-    char code[MAX_DNA_LENGTH];
-    char description[MAX_DESC_LENGTH];
-    double similarity;
-} DNAEntry;
-
-// DNAコードの要素
-typedef struct {
-    char entity[8];      // 主語 (E0, E1, ...)
-    char concept[8];     // 動詞 (C0, C1, ...)
-    char result[8];      // 目的語 (R0, R1, ...)
-    char attribute[8];   // 属性 (A0, A1, ...)
-    char location[8];    // 場所 (L0, L1, ...)
-    char manner[8];      // 様態 (M0, M1, ...)
-} DNAComponents;
-
-// 結果配列
-DNAEntry results[MAX_COMBINATIONS];
-int result_count = 0;
+// 要素ごとの類似度の重み（E, C, R, A, T, L, M, Q の順、T と Q は比べない）
+static const double dna_slot_weights[DNA_PACKED_SLOT_COUNT] = {3.0, 2.0, 2.0, 1.0, 0.0, 1.0, 1.0, 0.0};
 
 // 文字列から部分文字列を抽出する関数
 void extract_substring(const char* src, char* dest, char start_char, char end_char) {
@@ -61,146 +41,6 @@ void extract_substring(const char* src, char* dest, char start_char, char end_ch
     }
 }
 
-// DNAコードを解析して構成要素に分解する関数
-void parse_dna_code(const char* dna_code, DNAComponents* components) {
-    // 初期化
-    components->entity[0] = '\0';
-    components->concept[0] = '\0';
-    components->result[0] = '\0';
-    components->attribute[0] = '\0';
-    components->location[0] = '\0';
-    components->manner[0] = '\0';
-    
-    // 主語（E）の抽出
-    if (dna_code[0] == 'E') {
-        int i = 0;
-        while (dna_code[i] != 'C' && dna_code[i] != '\0') {
-            i++;
-        }
-        strncpy(components->entity, dna_code, i);
-        components->entity[i] = '\0';
-    }
-    
-    // 動詞（C）の抽出
-    char* c_pos = strchr(dna_code, 'C');
-    if (c_pos) {
-        int i = 0;
-        c_pos++;
-        while (c_pos[i] != 'R' && c_pos[i] != '\0') {
-            i++;
-        }
-        strncpy(components->concept, c_pos - 1, i + 1);
-        components->concept[i + 1] = '\0';
-    }
-    
-    // 目的語（R）の抽出
-    char* r_pos = strchr(dna_code, 'R');
-    if (r_pos) {
-        int i = 0;
-        r_pos++;
-        while (r_pos[i] != 'A' && r_pos[i] != 'L' && r_pos[i] != 'M' && r_pos[i] != '\0') {
-            i++;
-        }
-        strncpy(components->result, r_pos - 1, i + 1);
-        components->result[i + 1] = '\0';
-    }
-    
-    // 属性（A）の抽出
-    char* a_pos = strchr(dna_code, 'A');
-    if (a_pos) {
-        int i = 0;
-        a_pos++;
-        while (a_pos[i] != 'L' && a_pos[i] != 'M' && a_pos[i] != '\0') {
-            i++;
-        }
-        strncpy(components->attribute, a_pos - 1, i + 1);
-        components->attribute[i + 1] = '\0';
-    }
-    
-    // 場所（L）の抽出
-    char* l_pos = strchr(dna_code, 'L');
-    if (l_pos) {
-        int i = 0;
-        l_pos++;
-        while (l_pos[i] != 'M' && l_pos[i] != '\0') {
-            i++;
-        }
-        strncpy(components->location, l_pos - 1, i + 1);
-        components->location[i + 1] = '\0';
-    }
-    
-    // 様態（M）の抽出
-    char* m_pos = strchr(dna_code, 'M');
-    if (m_pos) {
-        strcpy(components->manner, m_pos);
-    }
-}
-
-// 類似度を計算する関数
-double calculate_similarity(const char* dna1, const char* dna2) {
-    DNAComponents comp1, comp2;
-    parse_dna_code(dna1, &comp1);
-    parse_dna_code(dna2, &comp2);
-    
-    double similarity_score = 0.0;
-    double weight_sum = 0.0;
-    
-    // 主語（E）の比較（重み: 3.0）
-    if (comp1.entity[0] != '\0' && comp2.entity[0] != '\0') {
-        weight_sum += 3.0;
-        if (strcmp(comp1.entity, comp2.entity) == 0) {
-            similarity_score += 3.0;
-        }
-    }
-    
-    // 動詞（C）の比較（重み: 2.0）
-    if (comp1.concept[0] != '\0' && comp2.concept[0] != '\0') {
-        weight_sum += 2.0;
-        if (strcmp(comp1.concept, comp2.concept) == 0) {
-            similarity_score += 2.0;
-        }
-    }
-    
-    // 目的語（R）の比較（重み: 2.0）
-    if (comp1.result[0] != '\0' && comp2.result[0] != '\0') {
-        weight_sum += 2.0;
-        if (strcmp(comp1.result, comp2.result) == 0) {
-            similarity_score += 2.0;
-        }
-    }
-    
-    // 属性（A）の比較（重み: 1.0）
-    if (comp1.attribute[0] != '\0' && comp2.attribute[0] != '\0') {
-        weight_sum += 1.0;
-        if (strcmp(comp1.attribute, comp2.attribute) == 0) {
-            similarity_score += 1.0;
-        }
-    }
-    
-    // 場所（L）の比較（重み: 1.0）
-    if (comp1.location[0] != '\0' && comp2.location[0] != '\0') {
-        weight_sum += 1.0;
-        if (strcmp(comp1.location, comp2.location) == 0) {
-            similarity_score += 1.0;
-        }
-    }
-    
-    // 様態（M）の比較（重み: 1.0）
-    if (comp1.manner[0] != '\0' && comp2.manner[0] != '\0') {
-        weight_sum += 1.0;
-        if (strcmp(comp1.manner, comp2.manner) == 0) {
-            similarity_score += 1.0;
-        }
-    }
-    
-    // 最終的な類似度スコアを計算
-    if (weight_sum == 0.0) {
-        return 0.0;
-    } else {
-        return similarity_score / weight_sum;
-    }
-}
-
 // 質問からDNAコードを生成する関数
 void generate_dna_from_query(const char* query, char* dna_code) {
     // デフォルトのDNAコード
@@ -380,18 +220,8 @@ void generate_dna_from_query(const char* query, char* dna_code) {
     }
 }
 
-// 結果を比較する関数（qsort用）
-int compare_results(const void* a, const void* b) {
-    const DNAEntry* entry_a = (const DNAEntry*)a;
-    const DNAEntry* entry_b = (const DNAEntry*)b;
-    
-    if (entry_a->similarity > entry_b->similarity) return -1;
-    if (entry_a->similarity < entry_b->similarity) return 1;
-    return 0;
-}
-
 // DNAコードの意味を解析して回答を生成する関数
-void generate_answer_from_dna(const char* dna_code, char* answer, size_t answer_size) {
+void generate_answer_from_dna(const DnaPackedCode* dna_code, char* answer, size_t answer_size) {
     char entity[64] = "GeneLLM";
     char concept[64] = "解析する";
     char result[64] = "知識ベース";
@@ -399,61 +229,69 @@ void generate_answer_from_dna(const char* dna_code, char* answer, size_t answer_
     char location[64] = "";
     char manner[64] = "";
     
+    // 要素のID（ない要素は -1）
+    int entity_id = dna_code_id(dna_code, dna_packed_slot('E'));
+    int concept_id = dna_code_id(dna_code, dna_packed_slot('C'));
+    int result_id = dna_code_id(dna_code, dna_packed_slot('R'));
+    int attribute_id = dna_code_id(dna_code, dna_packed_slot('A'));
+    int location_id = dna_code_id(dna_code, dna_packed_slot('L'));
+    int manner_id = dna_code_id(dna_code, dna_packed_slot('M'));
+    
     // 主語（E）の解析
-    if (strncmp(dna_code, "E0", 2) == 0) {
+    if (entity_id == 0) {
         strcpy(entity, "GeneLLM");
-    } else if (strncmp(dna_code, "E5", 2) == 0) {
+    } else if (entity_id == 5) {
         strcpy(entity, "知識グラフ");
-    } else if (strncmp(dna_code, "E6", 2) == 0) {
+    } else if (entity_id == 6) {
         strcpy(entity, "自然言語処理");
-    } else if (strncmp(dna_code, "E7", 2) == 0) {
+    } else if (entity_id == 7) {
         strcpy(entity, "機械学習");
-    } else if (strncmp(dna_code, "E8", 2) == 0) {
+    } else if (entity_id == 8) {
         strcpy(entity, "深層学習");
     }
     
     // 動詞（C）の解析
-    if (strstr(dna_code, "C3")) {
+    if (concept_id == 3) {
         strcpy(concept, "解析する");
-    } else if (strstr(dna_code, "C4")) {
+    } else if (concept_id == 4) {
         strcpy(concept, "生成する");
-    } else if (strstr(dna_code, "C5")) {
+    } else if (concept_id == 5) {
         strcpy(concept, "最適化する");
-    } else if (strstr(dna_code, "C10")) {
+    } else if (concept_id == 10) {
         strcpy(concept, "学習する");
-    } else if (strstr(dna_code, "C11")) {
+    } else if (concept_id == 11) {
         strcpy(concept, "処理する");
     }
     
     // 目的語（R）の解析
-    if (strstr(dna_code, "R1")) {
+    if (result_id == 1) {
         strcpy(result, "知識ベース");
-    } else if (strstr(dna_code, "R3")) {
+    } else if (result_id == 3) {
         strcpy(result, "テキストデータ");
-    } else if (strstr(dna_code, "R5")) {
+    } else if (result_id == 5) {
         strcpy(result, "構造化データ");
-    } else if (strstr(dna_code, "R6")) {
+    } else if (result_id == 6) {
         strcpy(result, "非構造化データ");
     }
     
     // 属性（A）の解析
-    if (strstr(dna_code, "A0")) {
+    if (attribute_id == 0) {
         strcpy(attribute, "高速な");
-    } else if (strstr(dna_code, "A1")) {
+    } else if (attribute_id == 1) {
         strcpy(attribute, "効率的な");
     }
     
     // 場所（L）の解析
-    if (strstr(dna_code, "L2")) {
+    if (location_id == 2) {
         strcpy(location, "クラウド環境で");
-    } else if (strstr(dna_code, "L5")) {
+    } else if (location_id == 5) {
         strcpy(location, "データベース内で");
     }
     
     // 様態（M）の解析
-    if (strstr(dna_code, "M0")) {
+    if (manner_id == 0) {
         strcpy(manner, "効率的に");
-    } else if (strstr(dna_code, "M3")) {
+    } else if (manner_id == 3) {
         strcpy(manner, "迅速に");
     }
     
@@ -495,16 +333,21 @@ void generate_answer_from_dna(const char* dna_code, char* answer, size_t answer_
     }
 }
 
-// タイムアウト処理用のアラームハンドラ
-volatile sig_atomic_t timeout_flag = 0;
-
-void timeout_handler(int sig) {
-    timeout_flag = 1;
-}
-
 int main(int argc, char* argv[]) {
+    // インデックスだけを作る
+    if (argc >= 2 && strcmp(argv[1], "--build-index") == 0) {
+        const char* source_path = argc >= 3 ? argv[2] : DNA_COMBINATIONS_FILE;
+        const char* index_path = argc >= 4 ? argv[3] : DNA_INDEX_FILE;
+        if (!dna_index_build(source_path, index_path)) {
+            return 1;
+        }
+        printf("DNAインデックスを作成しました: %s\n", index_path);
+        return 0;
+    }
+    
     if (argc < 2) {
         printf("使用方法: %s \"質問\" [結果数]\n", argv[0]);
+        printf("          %s --build-index [DNAコンビネーションファイル] [インデックスファイル]\n", argv[0]);
         return 1;
     }
     
@@ -522,117 +365,55 @@ int main(int argc, char* argv[]) {
     printf("----------------------------------------\n");
     
     // 質問からDNAコードを生成
-    char query_dna_code[MAX_DNA_LENGTH];
-    generate_dna_from_query(query, query_dna_code);
-    printf("質問から生成したDNAコード: %s\n", query_dna_code);
-    
-    // DNAコンビネーションファイルを開く
-    FILE* file = fopen("/workspace/data/dna_combinations.txt", "r");
-    if (!file) {
-        printf("DNAコンビネーションファイルが見つかりません\n");
-        return 1;
-    }
-    
-    printf("類似したDNAコードを検索しています...\n");
-    
-    // サンプリング用の配列
-    DNAEntry samples[SAMPLE_SIZE];
-    int sample_count = 0;
-    
-    // ファイルからランダムにサンプリング
-    srand(time(NULL));
-    char line[MAX_LINE_LENGTH];
-    int line_count = 0;
-    
-    // まずファイルの行数をカウント
-    while (fgets(line, sizeof(line), file)) {
-        line_count++;
-    }
-    
-    // ファイルポインタを先頭に戻す
-    rewind(file);
-    
-    // サンプリング
-    printf("DNAコードデータベースからサンプリング中...\n");
-    for (int i = 0; i < SAMPLE_SIZE && i < line_count; i++) {
-        int random_line = rand() % line_count;
-        rewind(file);
-        
-        // ランダムな行まで移動
-        for (int j = 0; j < random_line; j++) {
-            if (!fgets(line, sizeof(line), file)) {
-                break;
-            }
-        }
-        
-        // サンプルを取得
-        if (fgets(line, sizeof(line), file)) {
-            // 改行を削除
-            line[strcspn(line, "\n")] = '\0';
-            
-            // DNAコードと説明を分離
-            char* separator = strchr(line, '|');
-            if (separator) {
-                *separator = '\0';
-                strncpy(samples[sample_count].code, line, MAX_DNA_LENGTH - 1);
-                samples[sample_count].code[MAX_DNA_LENGTH - 1] = '\0';
-                
-                strncpy(samples[sample_count].description, separator + 1, MAX_DESC_LENGTH - 1);
-                samples[sample_count].description[MAX_DESC_LENGTH - 1] = '\0';
-                
-                sample_count++;
-            }
+    char query_text[MAX_DNA_LENGTH];
+    generate_dna_from_query(query, query_text);
+    printf("質問から生成したDNAコード: %s\n", query_text);
+    
+    DnaPackedCode query_dna_code;
+    dna_code_pack(query_text, &query_dna_code);
+    
+    // インデックスを開く（ない場合や、DNAコンビネーションファイルが更新されていれば作り直す）
+    DnaIndex index;
+    if (!dna_index_open(&index, DNA_INDEX_FILE, DNA_COMBINATIONS_FILE)) {
+        printf("DNAインデックスを作成しています...\n");
+        if (!dna_index_build(DNA_COMBINATIONS_FILE, DNA_INDEX_FILE) ||
+            !dna_index_open(&index, DNA_INDEX_FILE, DNA_COMBINATIONS_FILE)) {
+            printf("DNAコンビネーションファイルが見つかりません\n");
+            return 1;
         }
     }
     
-    fclose(file);
-    
-    // 類似度計算
-    printf("類似度計算中（タイムアウト: %d秒）...\n", TIMEOUT_SECONDS);
-    
-    // タイムアウト処理の設定
-    signal(SIGALRM, timeout_handler);
-    alarm(TIMEOUT_SECONDS);
-    
-    for (int i = 0; i < sample_count && !timeout_flag; i++) {
-        double similarity = calculate_similarity(query_dna_code, samples[i].code);
-        samples[i].similarity = similarity;
-        
-        // 結果配列に追加
-        if (result_count < MAX_COMBINATIONS) {
-            results[result_count] = samples[i];
-            result_count++;
-        }
-    }
-    
-    // タイムアウトアラームを解除
-    alarm(0);
+    printf("類似したDNAコードを検索しています...\n");
     
-    // 結果を類似度でソート
-    qsort(results, result_count, sizeof(DNAEntry), compare_results);
+    // 要素のIDが一致するエントリを転置リストから集めて、全件の中の上位を求める
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    DnaIndexResult results[MAX_RESULTS];
+    uint32_t candidates = 0;
+    int result_count = dna_index_search(&index, &query_dna_code, dna_slot_weights, results, max_results, &candidates);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
     
     // 結果を表示
-    printf("検索結果:\n");
+    printf("検索結果（%u件中、要素の一致する%u件を比較、%.3fミリ秒）:\n", index.count, candidates, elapsed_ms);
     printf("----------------------------------------\n");
     
-    if (timeout_flag) {
-        printf("検索がタイムアウトしました。部分的な結果を表示します。\n");
-    }
-    
-    int display_count = (result_count < max_results) ? result_count : max_results;
-    for (int i = 0; i < display_count; i++) {
-        printf("[%.4f] %s: %s\n", results[i].similarity, results[i].code, results[i].description);
+    for (int i = 0; i < result_count; i++) {
+        char code[DNA_PACKED_TEXT_MAX];
+        dna_code_format(&index.codes[results[i].entry], code, sizeof(code));
+        printf("[%.4f] %s: %s\n", results[i].similarity, code, dna_index_description(&index, results[i].entry));
     }
     
     printf("検索完了\n");
+    dna_index_close(&index);
     
     // DNAコードから回答を生成
     char answer[4096];
-    generate_answer_from_dna(query_dna_code, answer, sizeof(answer));
+    generate_answer_from_dna(&query_dna_code, answer, sizeof(answer));
     
     printf("\n回答:\n");
     printf("----------------------------------------\n");
     printf("%s\n", answer);
     
     return 0;
-}
\ No newline at end of file
+}
@@ -234,11 +234,12 @@ int generate_large_word_vector_dataset(VectorDB* db, int target_size) {
             }
             
             // 単語からベクトルを生成（ここでは単語の文字コードを使用して決定論的に生成）
+            size_t word_len = strlen(word);
             float vector[VECTOR_DIM];
             for (int i = 0; i < VECTOR_DIM; i++) {
                 // 単語の各文字のコードを使用して決定論的にベクトル値を生成
                 float val = 0.0f;
-                for (size_t j = 0; j < strlen(word); j++) {
+                for (size_t j = 0; j < word_len; j++) {
                     val += (float)(word[j] * (j+1) * (i+1)) / 10000.0f;
                 }
                 // -1.0から1.0の範囲に正規化
@@ -283,10 +284,11 @@ int generate_large_word_vector_dataset(VectorDB* db, int target_size) {
                     }
                     
                     // 単語からベクトルを生成
+                    size_t word_len = strlen(word);
                     float vector[VECTOR_DIM];
                     for (int i = 0; i < VECTOR_DIM; i++) {
                         float val = 0.0f;
-                        for (size_t j = 0; j < strlen(word); j++) {
+                        for (size_t j = 0; j < word_len; j++) {
                             val += (float)(word[j] * (j+1) * (i+1)) / 10000.0f;
                         }
                         vector[i] = fmodf(val, 2.0f) - 1.0f;
@@ -15,8 +15,14 @@
 #include "include/learning_module.c"
 // 知識管理モジュールのインクルード
 #include "include/knowledge_manager.c"
+// 知識ドキュメントの文字列を置くストアのインクルード
+#include "include/knowledge_store.c"
+// 知識ドキュメントの転置インデックスのインクルード
+#include "include/knowledge_index.c"
 // DuckDuckGo検索モジュールのインクルード
 #include "include/duckduckgo_search.h"
+// 形態素解析モジュールのインクルード
+#include "include/mecab_tagger.c"
 
 #define MAX_WORD_LEN 64
 #define MAX_TOKENS 1000
@@ -164,18 +170,15 @@ char handle_fallback(const char* text, char* response, Topic* topics, int topic_
 
 // MeCabを使用してテキストをトークン化する
 void tokenize_text(const char* text) {
-    // MeCabの初期化
-    mecab_t* mecab = mecab_new2("");
-    if (!mecab) {
-        fprintf(stderr, "MeCabの初期化に失敗しました: %s\n", mecab_strerror(NULL));
+    // 起動時に生成したタガーとラティスを再利用する
+    MecabSession* session = mecab_tagger_default_session();
+    if (!session) {
         return;
     }
     
     // 形態素解析を実行
-    const mecab_node_t* node = mecab_sparse_tonode(mecab, text);
+    const mecab_node_t* node = mecab_session_parse(session, text);
     if (!node) {
-        fprintf(stderr, "形態素解析に失敗しました: %s\n", mecab_strerror(mecab));
-        mecab_destroy(mecab);
         return;
     }
     
@@ -272,9 +275,6 @@ void tokenize_text(const char* text) {
             token_count++;
         }
     }
-    
-    // MeCabを解放
-    mecab_destroy(mecab);
 }
 
 // エージェントを初期化
@@ -763,6 +763,13 @@ int route_text(const char* text, char* response) {
     // テキストをトークン化
     tokenize_text(text);
     
+    if (debug_mode) {
+        MecabTaggerStats mecab_stats;
+        mecab_tagger_get_stats(&mecab_stats);
+        printf("形態素解析: %d トークン (累計 %ld 回, 節約 %.1f ms)\n", 
+               token_count, mecab_stats.parse_count, mecab_stats.saved_ms);
+    }
+    
     // 各エージェントのスコアを計算
     float max_score = -1.0f;
     int best_agent = -1;
@@ -1681,6 +1688,9 @@ int main(int argc, char* argv[]) {
     // 乱数の初期化
     srand((unsigned int)time(NULL));
     
+    // 形態素解析器を初期化（辞書の読み込みは起動時の一度だけ）
+    mecab_tagger_init("");
+    
     // エージェントとトピックを初期化
     init_agents();
     init_topics();
@@ -1745,6 +1755,7 @@ int main(int argc, char* argv[]) {
             printf("%s\n", response);
         }
         
+        mecab_tagger_free();
         return 0;
     }
     
@@ -1837,5 +1848,7 @@ int main(int argc, char* argv[]) {
         knowledge_base_free(knowledge_base);
     }
     
+    mecab_tagger_free();
+    
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "dna_code_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DNA_CODE_TABLE_INITIAL_BUCKETS 64
+
+// 初期化
+void dna_code_table_init(DnaCodeTable* table, size_t entry_size, size_t code_offset,
+                         size_t word_offset, long type_offset) {
+    memset(table, 0, sizeof(*table));
+    table->entry_size = entry_size;
+    table->code_offset = code_offset;
+    table->word_offset = word_offset;
+    table->type_offset = type_offset;
+}
+
+// 解放
+void dna_code_table_free(DnaCodeTable* table) {
+    free(table->word_hashes);
+    free(table->code_hashes);
+    free(table->word_buckets);
+    free(table->code_buckets);
+    table->word_hashes = NULL;
+    table->code_hashes = NULL;
+    table->word_buckets = NULL;
+    table->code_buckets = NULL;
+    table->count = 0;
+    table->capacity = 0;
+    table->bucket_count = 0;
+    memset(table->next_ids, 0, sizeof(table->next_ids));
+}
+
+// 文字列のハッシュ値（単語は種類も混ぜる）
+static uint32_t dna_code_table_hash(int type, const char* text) {
+    uint32_t hash = 2166136261u ^ (uint32_t)type;
+    hash *= 16777619u;
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// エントリ内のフィールド
+static const char* dna_code_table_field(const DnaCodeTable* table, const void* entries, int index, size_t offset) {
+    return (const char*)entries + (size_t)index * table->entry_size + offset;
+}
+
+// エントリの種類（区別しない場合は DNA_CODE_TABLE_NO_TYPE）
+static int dna_code_table_type(const DnaCodeTable* table, const void* entries, int index) {
+    if (table->type_offset < 0) {
+        return DNA_CODE_TABLE_NO_TYPE;
+    }
+    int type;
+    memcpy(&type, dna_code_table_field(table, entries, index, (size_t)table->type_offset), sizeof(type));
+    return type;
+}
+
+// 空いているスロットにエントリ番号を置く
+static void dna_code_table_place(int* buckets, int bucket_count, uint32_t hash, int index) {
+    unsigned int mask = (unsigned int)bucket_count - 1;
+    unsigned int slot = hash & mask;
+    while (buckets[slot] >= 0) {
+        slot = (slot + 1) & mask;
+    }
+    buckets[slot] = index;
+}
+
+// ハッシュ表を2倍にして入れ直す（エントリ番号の順に入れるので、同じキーは先に加えたものが先に見つかる）
+static bool dna_code_table_grow_buckets(DnaCodeTable* table) {
+    int bucket_count = table->bucket_count > 0 ? table->bucket_count * 2 : DNA_CODE_TABLE_INITIAL_BUCKETS;
+    int* word_buckets = (int*)malloc(sizeof(int) * bucket_count);
+    int* code_buckets = (int*)malloc(sizeof(int) * bucket_count);
+    if (!word_buckets || !code_buckets) {
+        fprintf(stderr, "メモリ割り当てエラー: DNA辞書の索引の拡張に失敗しました\n");
+        free(word_buckets);
+        free(code_buckets);
+        return false;
+    }
+    memset(word_buckets, -1, sizeof(int) * bucket_count);
+    memset(code_buckets, -1, sizeof(int) * bucket_count);
+
+    for (int i = 0; i < table->count; i++) {
+        dna_code_table_place(word_buckets, bucket_count, table->word_hashes[i], i);
+        dna_code_table_place(code_buckets, bucket_count, table->code_hashes[i], i);
+    }
+
+    free(table->word_buckets);
+    free(table->code_buckets);
+    table->word_buckets = word_buckets;
+    table->code_buckets = code_buckets;
+    table->bucket_count = bucket_count;
+    return true;
+}
+
+// entries[index] を索引に加える
+bool dna_code_table_add(DnaCodeTable* table, const void* entries, int index) {
+    if (index != table->count) {
+        fprintf(stderr, "DNA辞書の索引の番号が一致しません: %d (索引済み %d)\n", index, table->count);
+        return false;
+    }
+
+    if (table->count >= table->capacity) {
+        int capacity = table->capacity > 0 ? table->capacity * 2 : DNA_CODE_TABLE_INITIAL_BUCKETS / 2;
+        uint32_t* word_hashes = (uint32_t*)realloc(table->word_hashes, sizeof(uint32_t) * capacity);
+        if (!word_hashes) {
+            fprintf(stderr, "メモリ割り当てエラー: DNA辞書の索引の拡張に失敗しました\n");
+            return false;
+        }
+        table->word_hashes = word_hashes;
+        uint32_t* code_hashes = (uint32_t*)realloc(table->code_hashes, sizeof(uint32_t) * capacity);
+        if (!code_hashes) {
+            fprintf(stderr, "メモリ割り当てエラー: DNA辞書の索引の拡張に失敗しました\n");
+            return false;
+        }
+        table->code_hashes = code_hashes;
+        table->capacity = capacity;
+    }
+
+    // 使用率を半分以下に保つ
+    if ((table->count + 1) * 2 > table->bucket_count && !dna_code_table_grow_buckets(table)) {
+        return false;
+    }
+
+    const char* word = dna_code_table_field(table, entries, index, table->word_offset);
+    const char* code = dna_code_table_field(table, entries, index, table->code_offset);
+    uint32_t word_hash = dna_code_table_hash(dna_code_table_type(table, entries, index), word);
+    uint32_t code_hash = dna_code_table_hash(DNA_CODE_TABLE_NO_TYPE, code);
+
+    table->word_hashes[index] = word_hash;
+    table->code_hashes[index] = code_hash;
+    dna_code_table_place(table->word_buckets, table->bucket_count, word_hash, index);
+    dna_code_table_place(table->code_buckets, table->bucket_count, code_hash, index);
+    table->count++;
+    return true;
+}
+
+// 種類と単語が一致する最初のエントリ番号
+int dna_code_table_find_word(const DnaCodeTable* table, const void* entries, int type, const char* word) {
+    if (table->bucket_count == 0 || !word) {
+        return -1;
+    }
+    if (table->type_offset < 0) {
+        type = DNA_CODE_TABLE_NO_TYPE;
+    }
+
+    uint32_t hash = dna_code_table_hash(type, word);
+    unsigned int mask = (unsigned int)table->bucket_count - 1;
+    unsigned int slot = hash & mask;
+    while (table->word_buckets[slot] >= 0) {
+        int index = table->word_buckets[slot];
+        if (table->word_hashes[index] == hash &&
+            dna_code_table_type(table, entries, index) == type &&
+            strcmp(dna_code_table_field(table, entries, index, table->word_offset), word) == 0) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+// コードが一致する最初のエントリ番号
+int dna_code_table_find_code(const DnaCodeTable* table, const void* entries, const char* code) {
+    if (table->bucket_count == 0 || !code) {
+        return -1;
+    }
+
+    uint32_t hash = dna_code_table_hash(DNA_CODE_TABLE_NO_TYPE, code);
+    unsigned int mask = (unsigned int)table->bucket_count - 1;
+    unsigned int slot = hash & mask;
+    while (table->code_buckets[slot] >= 0) {
+        int index = table->code_buckets[slot];
+        if (table->code_hashes[index] == hash &&
+            strcmp(dna_code_table_field(table, entries, index, table->code_offset), code) == 0) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+// 種類の次のIDを払い出す
+int dna_code_table_next_id(DnaCodeTable* table, char type) {
+    if (type < 'A' || type > 'Z') {
+        return -1;
+    }
+    return table->next_ids[type - 'A']++;
+}
+
+// 読み込んだコードのIDより後から払い出すようにする
+void dna_code_table_reserve_id(DnaCodeTable* table, char type, int id) {
+    if (type < 'A' || type > 'Z' || id < 0) {
+        return;
+    }
+    if (table->next_ids[type - 'A'] <= id) {
+        table->next_ids[type - 'A'] = id + 1;
+    }
+}
@@ -0,0 +1,51 @@
+#ifndef DNA_CODE_TABLE_H
+#define DNA_CODE_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DNA_CODE_TABLE_NO_TYPE -1      // 種類を区別せず単語だけで引く
+#define DNA_CODE_TABLE_TYPES 26        // 種類の文字（'A'〜'Z'）の数
+
+// DNA辞書の索引（単語→エントリと、コード→エントリの2つのハッシュ表）
+// エントリの配列は各辞書が持ち、索引はエントリの番号だけを覚える
+// 配列は realloc で動くので、引くたびに現在の先頭を渡す
+typedef struct {
+    uint32_t* word_hashes;          // エントリごとの単語のハッシュ値
+    uint32_t* code_hashes;          // エントリごとのコードのハッシュ値
+    int count;                      // 索引したエントリ数
+    int capacity;
+    int* word_buckets;              // オープンアドレス法、空きは -1
+    int* code_buckets;
+    int bucket_count;
+    int next_ids[DNA_CODE_TABLE_TYPES];   // 種類ごとの次のID
+    size_t entry_size;              // エントリ構造体の大きさ
+    size_t code_offset;             // エントリ内のコード（char 配列）の位置
+    size_t word_offset;             // エントリ内の単語（char 配列）の位置
+    long type_offset;               // エントリ内の種類（int）の位置、DNA_CODE_TABLE_NO_TYPE なら区別しない
+} DnaCodeTable;
+
+// 初期化（offsetof でエントリ構造体のフィールドの位置を渡す）
+void dna_code_table_init(DnaCodeTable* table, size_t entry_size, size_t code_offset,
+                         size_t word_offset, long type_offset);
+
+// 解放（init し直せば再び使える）
+void dna_code_table_free(DnaCodeTable* table);
+
+// entries[index] を索引に加える（index は索引したエントリ数と同じであること）
+bool dna_code_table_add(DnaCodeTable* table, const void* entries, int index);
+
+// 種類と単語が一致する最初のエントリ番号（なければ -1）
+int dna_code_table_find_word(const DnaCodeTable* table, const void* entries, int type, const char* word);
+
+// コードが一致する最初のエントリ番号（なければ -1）
+int dna_code_table_find_code(const DnaCodeTable* table, const void* entries, const char* code);
+
+// 種類（'E', 'C' など）の次のIDを払い出す
+int dna_code_table_next_id(DnaCodeTable* table, char type);
+
+// 読み込んだコードのIDより後から払い出すようにする
+void dna_code_table_reserve_id(DnaCodeTable* table, char type, int id);
+
+#endif // DNA_CODE_TABLE_H
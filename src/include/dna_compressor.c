@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+#include "dna_code_table.h"
 
 // DNA圧縮用の辞書エントリ
 typedef struct {
@@ -17,6 +19,7 @@ typedef struct {
     int next_entity_id;   // 次の主語ID
     int next_concept_id;  // 次の動詞ID
     int next_result_id;   // 次の結果ID
+    DnaCodeTable table;   // 単語とコードの索引
 } DnaDictionary;
 
 // 辞書の初期化
@@ -39,6 +42,8 @@ DnaDictionary* dna_dictionary_init(int initial_capacity) {
     dict->next_entity_id = 0;
     dict->next_concept_id = 0;
     dict->next_result_id = 0;
+    dna_code_table_init(&dict->table, sizeof(DnaEntry), offsetof(DnaEntry, code),
+                        offsetof(DnaEntry, word), DNA_CODE_TABLE_NO_TYPE);
     
     // エントリを初期化
     for (int i = 0; i < initial_capacity; i++) {
@@ -56,6 +61,7 @@ void dna_dictionary_free(DnaDictionary* dict) {
         if (dict->entries) {
             free(dict->entries);
         }
+        dna_code_table_free(&dict->table);
         free(dict);
     }
 }
@@ -89,10 +95,9 @@ const char* dna_dictionary_get_code(DnaDictionary* dict, const char* word, char
     }
     
     // 既存のエントリを検索
-    for (int i = 0; i < dict->count; i++) {
-        if (dict->entries[i].used && strcmp(dict->entries[i].word, word) == 0) {
-            return dict->entries[i].code;
-        }
+    int found = dna_code_table_find_word(&dict->table, dict->entries, DNA_CODE_TABLE_NO_TYPE, word);
+    if (found >= 0) {
+        return dict->entries[found].code;
     }
     
     // 新しいエントリを作成
@@ -128,6 +133,11 @@ const char* dna_dictionary_get_code(DnaDictionary* dict, const char* word, char
     
     dict->entries[dict->count].used = 1;
     
+    if (!dna_code_table_add(&dict->table, dict->entries, dict->count)) {
+        dict->entries[dict->count].used = 0;
+        return NULL;
+    }
+    
     return dict->entries[dict->count++].code;
 }
 
@@ -137,13 +147,8 @@ const char* dna_dictionary_get_word(DnaDictionary* dict, const char* code) {
         return NULL;
     }
     
-    for (int i = 0; i < dict->count; i++) {
-        if (dict->entries[i].used && strcmp(dict->entries[i].code, code) == 0) {
-            return dict->entries[i].word;
-        }
-    }
-    
-    return NULL;
+    int index = dna_code_table_find_code(&dict->table, dict->entries, code);
+    return index >= 0 ? dict->entries[index].word : NULL;
 }
 
 // 文をDNA形式に圧縮
@@ -300,6 +305,9 @@ DnaDictionary* dna_dictionary_load(const char* filename) {
         dict->entries[dict->count].word[sizeof(dict->entries[dict->count].word) - 1] = '\0';
         
         dict->entries[dict->count].used = 1;
+        if (!dna_code_table_add(&dict->table, dict->entries, dict->count)) {
+            break;
+        }
         dict->count++;
     }
     
@@ -1,6 +1,8 @@
 #ifndef DNA_COMPRESSOR_H
 #define DNA_COMPRESSOR_H
 
+#include "dna_code_table.h"
+
 // DNA圧縮用の辞書エントリ
 typedef struct {
     char code[8];     // DNAコード（例：E00, C01, R02）
@@ -16,6 +18,7 @@ typedef struct {
     int next_entity_id;   // 次の主語ID
     int next_concept_id;  // 次の動詞ID
     int next_result_id;   // 次の結果ID
+    DnaCodeTable table;   // 単語とコードの索引
 } DnaDictionary;
 
 // 辞書の初期化
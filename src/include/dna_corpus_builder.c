@@ -0,0 +1,815 @@
+#include "dna_corpus_builder.h"
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define DNA_CORPUS_OUTPUT_BUFFER (1024 * 1024)
+
+// 塊の状態
+typedef enum {
+    DNA_CORPUS_CHUNK_EMPTY = 0,     // 未使用（読み込み側が使う）
+    DNA_CORPUS_CHUNK_READY,         // 読み込み済み、解析待ち
+    DNA_CORPUS_CHUNK_RUNNING,       // 解析中
+    DNA_CORPUS_CHUNK_DONE           // 解析済み、書き出し待ち
+} DnaCorpusChunkState;
+
+// 文から取り出した要素（塊の words の中の位置）
+typedef struct {
+    uint32_t offsets[ENHANCED_DNA_TYPE_COUNT];
+    uint16_t lengths[ENHANCED_DNA_TYPE_COUNT];
+} DnaCorpusSentence;
+
+// 入力の塊（バッファは使い回す）
+typedef struct {
+    DnaCorpusChunkState state;
+    long long sequence;             // 読み込んだ順の番号
+    int file;                       // 入力ファイルの番号
+    char* text;                     // '\0' 終端
+    size_t length;
+    size_t capacity;
+    DnaCorpusSentence* sentences;
+    int sentence_count;
+    int sentence_capacity;
+    char* words;                    // 取り出した語（それぞれ '\0' 終端）
+    size_t words_length;
+    size_t words_capacity;
+    bool failed;
+} DnaCorpusChunk;
+
+// 読み込み・解析・書き出しの受け渡し
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    DnaCorpusChunk* chunks;         // 読み込んだ順の番号 % chunk_count の位置に置く
+    int chunk_count;
+    bool stopping;
+} DnaCorpusPipeline;
+
+// 解析スレッド（MeCab のモデルは共有し、セッションはスレッドごと）
+typedef struct {
+    pthread_t thread;
+    DnaCorpusPipeline* pipeline;
+    MecabSession* session;
+} DnaCorpusWorker;
+
+// 入力ファイルと読み込み位置
+typedef struct {
+    char** paths;
+    char** names;
+    int count;
+    int current;
+    FILE* file;
+    char* pending;                  // 前の塊に入らなかった行の続き
+    size_t pending_length;
+    size_t pending_capacity;
+    bool failed;                    // メモリ不足で読み込みを打ち切った
+} DnaCorpusInput;
+
+// 単調増加時計の現在時刻（ミリ秒）
+static double dna_corpus_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// バッファを少なくとも needed バイトにする
+static bool dna_corpus_reserve(char** buffer, size_t* capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return true;
+    }
+    size_t new_capacity = *capacity > 0 ? *capacity : 4096;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    char* new_buffer = (char*)realloc(*buffer, new_capacity);
+    if (!new_buffer) {
+        fprintf(stderr, "メモリ割り当てエラー: DNAコーパスのバッファを拡張できませんでした\n");
+        return false;
+    }
+    *buffer = new_buffer;
+    *capacity = new_capacity;
+    return true;
+}
+
+// 名前順に並べる
+static int dna_corpus_compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// 入力を解放
+static void dna_corpus_input_free(DnaCorpusInput* input) {
+    for (int i = 0; i < input->count; i++) {
+        free(input->paths[i]);
+    }
+    free(input->paths);
+    free(input->names);
+    if (input->file) {
+        fclose(input->file);
+    }
+    free(input->pending);
+    memset(input, 0, sizeof(*input));
+}
+
+// directory の *.txt を名前順に並べる
+static bool dna_corpus_list_files(const char* directory, DnaCorpusInput* input) {
+    memset(input, 0, sizeof(*input));
+
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        fprintf(stderr, "ディレクトリを開けませんでした: %s\n", directory);
+        return false;
+    }
+
+    int capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t name_length = strlen(entry->d_name);
+        if (name_length <= 4 || strcmp(entry->d_name + name_length - 4, ".txt") != 0) {
+            continue;
+        }
+
+        size_t path_length = strlen(directory) + 1 + name_length;
+        char* path = (char*)malloc(path_length + 1);
+        if (!path) {
+            fprintf(stderr, "メモリ割り当てエラー: ファイル一覧を作れませんでした\n");
+            closedir(dir);
+            dna_corpus_input_free(input);
+            return false;
+        }
+        snprintf(path, path_length + 1, "%s/%s", directory, entry->d_name);
+
+        struct stat st;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+            free(path);
+            continue;
+        }
+
+        if (input->count >= capacity) {
+            int new_capacity = capacity > 0 ? capacity * 2 : 16;
+            char** paths = (char**)realloc(input->paths, sizeof(char*) * new_capacity);
+            if (!paths) {
+                fprintf(stderr, "メモリ割り当てエラー: ファイル一覧を作れませんでした\n");
+                free(path);
+                closedir(dir);
+                dna_corpus_input_free(input);
+                return false;
+            }
+            input->paths = paths;
+            capacity = new_capacity;
+        }
+        input->paths[input->count++] = path;
+    }
+    closedir(dir);
+
+    // ディレクトリ名は共通なのでパスの順がファイル名の順になる
+    qsort(input->paths, input->count, sizeof(char*), dna_corpus_compare_names);
+
+    input->names = (char**)malloc(sizeof(char*) * (input->count > 0 ? input->count : 1));
+    if (!input->names) {
+        fprintf(stderr, "メモリ割り当てエラー: ファイル一覧を作れませんでした\n");
+        dna_corpus_input_free(input);
+        return false;
+    }
+    for (int i = 0; i < input->count; i++) {
+        input->names[i] = input->paths[i] + strlen(directory) + 1;
+    }
+    return true;
+}
+
+// 次の塊を読む（行の途中では切らず、残りは次の塊に回す）
+// すべて読み終えたら false（メモリ不足で打ち切ったときも false で、input->failed を立てる）
+static bool dna_corpus_read_chunk(DnaCorpusInput* input, DnaCorpusChunk* chunk, long long* bytes) {
+    while (input->current < input->count) {
+        if (!input->file) {
+            input->file = fopen(input->paths[input->current], "rb");
+            input->pending_length = 0;
+            if (!input->file) {
+                fprintf(stderr, "ファイルを開けませんでした: %s\n", input->paths[input->current]);
+                input->current++;
+                continue;
+            }
+        }
+
+        chunk->length = 0;
+        if (!dna_corpus_reserve(&chunk->text, &chunk->capacity, input->pending_length + DNA_CORPUS_CHUNK_BYTES + 1)) {
+            input->failed = true;
+            return false;
+        }
+        memcpy(chunk->text, input->pending, input->pending_length);
+        chunk->length = input->pending_length;
+        input->pending_length = 0;
+
+        // 改行が見つかるかファイルの終わりまで読む
+        size_t scanned = 0;
+        size_t cut = 0;
+        bool at_end = false;
+        for (;;) {
+            if (!dna_corpus_reserve(&chunk->text, &chunk->capacity, chunk->length + DNA_CORPUS_CHUNK_BYTES + 1)) {
+                input->failed = true;
+                return false;
+            }
+            size_t read = fread(chunk->text + chunk->length, 1, DNA_CORPUS_CHUNK_BYTES, input->file);
+            chunk->length += read;
+            *bytes += (long long)read;
+            if (read < DNA_CORPUS_CHUNK_BYTES) {
+                if (ferror(input->file)) {
+                    fprintf(stderr, "ファイルの読み込みに失敗しました: %s\n", input->paths[input->current]);
+                }
+                at_end = true;
+                break;
+            }
+
+            for (size_t i = chunk->length; i > scanned; i--) {
+                if (chunk->text[i - 1] == '\n') {
+                    cut = i;
+                    break;
+                }
+            }
+            if (cut > 0) {
+                break;
+            }
+            scanned = chunk->length;
+        }
+
+        chunk->file = input->current;
+        if (at_end) {
+            fclose(input->file);
+            input->file = NULL;
+            input->current++;
+            if (chunk->length == 0) {
+                continue;
+            }
+        } else {
+            // 最後の改行より後ろは次の塊に回す
+            size_t rest = chunk->length - cut;
+            if (!dna_corpus_reserve(&input->pending, &input->pending_capacity, rest)) {
+                input->failed = true;
+                return false;
+            }
+            memcpy(input->pending, chunk->text + cut, rest);
+            input->pending_length = rest;
+            chunk->length = cut;
+        }
+        chunk->text[chunk->length] = '\0';
+        return true;
+    }
+    return false;
+}
+
+// 文の終わり（改行、句点、感嘆符、疑問符の直後）
+static char* dna_corpus_sentence_end(char* p, char* end) {
+    while (p < end) {
+        unsigned char c = (unsigned char)*p;
+        if (c == '\n' || c == '!' || c == '?') {
+            return p + 1;
+        }
+        if (c == 0xE3 && p + 2 < end && (unsigned char)p[1] == 0x80 && (unsigned char)p[2] == 0x82) {
+            return p + 3;   // 。
+        }
+        if (c == 0xEF && p + 2 < end && (unsigned char)p[1] == 0xBC &&
+            ((unsigned char)p[2] == 0x81 || (unsigned char)p[2] == 0x9F)) {
+            return p + 3;   // ！ ？
+        }
+        p++;
+    }
+    return end;
+}
+
+// 取り出した要素を塊に加える
+static bool dna_corpus_add_sentence(DnaCorpusChunk* chunk, const EnhancedDNASlots* slots) {
+    if (chunk->sentence_count >= chunk->sentence_capacity) {
+        int capacity = chunk->sentence_capacity > 0 ? chunk->sentence_capacity * 2 : 256;
+        DnaCorpusSentence* sentences = (DnaCorpusSentence*)realloc(chunk->sentences, sizeof(DnaCorpusSentence) * capacity);
+        if (!sentences) {
+            fprintf(stderr, "メモリ割り当てエラー: DNAコーパスの文を追加できませんでした\n");
+            return false;
+        }
+        chunk->sentences = sentences;
+        chunk->sentence_capacity = capacity;
+    }
+
+    DnaCorpusSentence* sentence = &chunk->sentences[chunk->sentence_count];
+    for (int type = 0; type < ENHANCED_DNA_TYPE_COUNT; type++) {
+        size_t length = slots->lengths[type];
+        sentence->offsets[type] = (uint32_t)chunk->words_length;
+        sentence->lengths[type] = (uint16_t)length;
+        if (length == 0) {
+            continue;
+        }
+        if (!dna_corpus_reserve(&chunk->words, &chunk->words_capacity, chunk->words_length + length + 1)) {
+            return false;
+        }
+        memcpy(chunk->words + chunk->words_length, slots->words[type], length);
+        chunk->words[chunk->words_length + length] = '\0';
+        chunk->words_length += length + 1;
+    }
+    chunk->sentence_count++;
+    return true;
+}
+
+// 塊を文に分けて解析し、要素を取り出す
+static void dna_corpus_tag_chunk(MecabSession* session, DnaCorpusChunk* chunk) {
+    chunk->sentence_count = 0;
+    chunk->words_length = 0;
+    chunk->failed = false;
+
+    char* p = chunk->text;
+    char* end = chunk->text + chunk->length;
+    while (p < end) {
+        char* next = dna_corpus_sentence_end(p, end);
+
+        // 空白だけの文は飛ばす
+        char* start = p;
+        while (start < next && (*start == ' ' || *start == '\t' || *start == '\r' || *start == '\n')) {
+            start++;
+        }
+        if (start == next) {
+            p = next;
+            continue;
+        }
+
+        // 末尾の改行などを除き、文の直後を一時的に終端にして解析する
+        char* stop = next;
+        while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t' || stop[-1] == '\r' || stop[-1] == '\n')) {
+            stop--;
+        }
+        char saved = *stop;
+        *stop = '\0';
+        const mecab_node_t* node = mecab_session_parse(session, start);
+        *stop = saved;
+
+        if (node) {
+            EnhancedDNASlots slots;
+            extract_enhanced_dna_slots(node, &slots);
+
+            bool has_element = false;
+            for (int type = 0; type < ENHANCED_DNA_TYPE_COUNT; type++) {
+                has_element = has_element || slots.lengths[type] > 0;
+            }
+            if (has_element && !dna_corpus_add_sentence(chunk, &slots)) {
+                chunk->failed = true;
+                return;
+            }
+        }
+        p = next;
+    }
+}
+
+// リトルエンディアンで書き出す
+static void dna_corpus_put_u16(FILE* out, uint16_t value) {
+    fputc(value & 0xFF, out);
+    fputc(value >> 8, out);
+}
+
+static void dna_corpus_put_u32(FILE* out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        fputc((value >> (i * 8)) & 0xFF, out);
+    }
+}
+
+static void dna_corpus_put_u64(FILE* out, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        fputc((int)((value >> (i * 8)) & 0xFF), out);
+    }
+}
+
+// LEB128 の可変長整数
+static void dna_corpus_put_varint(FILE* out, uint32_t value) {
+    while (value >= 0x80) {
+        fputc((int)(value & 0x7F) | 0x80, out);
+        value >>= 7;
+    }
+    fputc((int)value, out);
+}
+
+// ヘッダー（文とファイルの数は最後に書き直す）
+static void dna_corpus_put_header(FILE* out, uint64_t sentences, uint32_t files) {
+    fwrite(DNA_CORPUS_MAGIC, 1, 4, out);
+    dna_corpus_put_u32(out, DNA_CORPUS_VERSION);
+    dna_corpus_put_u64(out, sentences);
+    dna_corpus_put_u32(out, files);
+}
+
+// 解析済みの塊を符号化して書き出す（呼び出し元のスレッドだけが辞書に触る）
+static bool dna_corpus_write_chunk(FILE* out, EnhancedDNADictionary* dict, const DnaCorpusChunk* chunk,
+                                   DnaCorpusStats* stats) {
+    for (int i = 0; i < chunk->sentence_count; i++) {
+        const DnaCorpusSentence* sentence = &chunk->sentences[i];
+        uint32_t ids[ENHANCED_DNA_TYPE_COUNT];
+        uint8_t mask = 0;
+        int elements = 0;
+
+        for (int type = 0; type < ENHANCED_DNA_TYPE_COUNT; type++) {
+            if (sentence->lengths[type] == 0) {
+                continue;
+            }
+            const EnhancedDNAEntry* entry = get_enhanced_dna_entry(dict, chunk->words + sentence->offsets[type],
+                                                                   (EnhancedDNAType)type);
+            if (!entry) {
+                return false;
+            }
+            mask |= (uint8_t)(1u << type);
+            ids[type] = (uint32_t)entry->id;
+            elements++;
+        }
+
+        fputc(mask, out);
+        for (int type = 0; type < ENHANCED_DNA_TYPE_COUNT; type++) {
+            if (mask & (1u << type)) {
+                dna_corpus_put_varint(out, ids[type]);
+            }
+        }
+        stats->sentences++;
+        stats->elements += elements;
+    }
+    return !ferror(out);
+}
+
+// 解析を待っている最も古い塊（mutex を保持した状態で呼ぶ）
+static DnaCorpusChunk* dna_corpus_next_ready(DnaCorpusPipeline* pipeline) {
+    DnaCorpusChunk* found = NULL;
+    for (int i = 0; i < pipeline->chunk_count; i++) {
+        DnaCorpusChunk* chunk = &pipeline->chunks[i];
+        if (chunk->state == DNA_CORPUS_CHUNK_READY && (!found || chunk->sequence < found->sequence)) {
+            found = chunk;
+        }
+    }
+    return found;
+}
+
+// 解析スレッド
+static void* dna_corpus_worker_main(void* arg) {
+    DnaCorpusWorker* worker = (DnaCorpusWorker*)arg;
+    DnaCorpusPipeline* pipeline = worker->pipeline;
+
+    pthread_mutex_lock(&pipeline->mutex);
+    for (;;) {
+        DnaCorpusChunk* chunk = NULL;
+        while (!pipeline->stopping && (chunk = dna_corpus_next_ready(pipeline)) == NULL) {
+            pthread_cond_wait(&pipeline->cond, &pipeline->mutex);
+        }
+        if (pipeline->stopping) {
+            break;
+        }
+
+        chunk->state = DNA_CORPUS_CHUNK_RUNNING;
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        dna_corpus_tag_chunk(worker->session, chunk);
+
+        pthread_mutex_lock(&pipeline->mutex);
+        chunk->state = DNA_CORPUS_CHUNK_DONE;
+        pthread_cond_broadcast(&pipeline->cond);
+    }
+    pthread_mutex_unlock(&pipeline->mutex);
+    return NULL;
+}
+
+// スレッド数を決定（未指定ならCPU数）
+static int dna_corpus_thread_count(int threads) {
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    return threads < DNA_CORPUS_MAX_THREADS ? threads : DNA_CORPUS_MAX_THREADS;
+}
+
+// 解析スレッドを開始する（開始できた数を返す）
+static int dna_corpus_start_workers(DnaCorpusPipeline* pipeline, DnaCorpusWorker* workers, int wanted) {
+    // シグナルは呼び出し元のスレッドで受け取るよう、ワーカーではブロックする
+    sigset_t block_set;
+    sigset_t old_set;
+    sigfillset(&block_set);
+    pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+
+    int started = 0;
+    while (started < wanted) {
+        DnaCorpusWorker* worker = &workers[started];
+        worker->pipeline = pipeline;
+        worker->session = mecab_session_create();
+        if (!worker->session) {
+            break;
+        }
+        if (pthread_create(&worker->thread, NULL, dna_corpus_worker_main, worker) != 0) {
+            fprintf(stderr, "DNAコーパスの解析スレッドを作成できませんでした\n");
+            mecab_session_destroy(worker->session);
+            break;
+        }
+        started++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+    return started;
+}
+
+// directory の *.txt を拡張DNAコードにして output_path に書き出す
+bool dna_corpus_build(const char* directory, const char* output_path, EnhancedDNADictionary* dict,
+                      int threads, DnaCorpusStats* stats) {
+    DnaCorpusStats local_stats;
+    if (!stats) {
+        stats = &local_stats;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!directory || !output_path || !dict) {
+        return false;
+    }
+
+    double start = dna_corpus_now_ms();
+    int initial_words = dict->count;
+
+    // MeCab のモデルは全スレッドで共有する（初期化済みなら何もしない）
+    if (!mecab_tagger_init("")) {
+        return false;
+    }
+
+    DnaCorpusInput input;
+    if (!dna_corpus_list_files(directory, &input)) {
+        return false;
+    }
+    stats->file_count = input.count;
+
+    FILE* out = fopen(output_path, "wb");
+    if (!out) {
+        fprintf(stderr, "ファイルを開けませんでした: %s\n", output_path);
+        dna_corpus_input_free(&input);
+        return false;
+    }
+    setvbuf(out, NULL, _IOFBF, DNA_CORPUS_OUTPUT_BUFFER);
+    dna_corpus_put_header(out, 0, 0);
+
+    // ファイルごとの先頭の文の番号
+    uint64_t* file_first = (uint64_t*)calloc(input.count > 0 ? input.count : 1, sizeof(uint64_t));
+
+    // 読み込みが解析に先行しすぎないよう、塊はスレッド数の2倍だけ用意する
+    int thread_count = dna_corpus_thread_count(threads);
+    DnaCorpusPipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pthread_mutex_init(&pipeline.mutex, NULL);
+    pthread_cond_init(&pipeline.cond, NULL);
+    pipeline.chunk_count = thread_count * 2;
+    pipeline.chunks = (DnaCorpusChunk*)calloc(pipeline.chunk_count, sizeof(DnaCorpusChunk));
+    DnaCorpusWorker* workers = (DnaCorpusWorker*)calloc(thread_count, sizeof(DnaCorpusWorker));
+
+    bool ok = file_first && pipeline.chunks && workers;
+    if (!ok) {
+        fprintf(stderr, "メモリ割り当てエラー: DNAコーパスの作成を開始できませんでした\n");
+    }
+
+    // スレッドを作れなければ呼び出し元のスレッドで解析する
+    int worker_count = ok ? dna_corpus_start_workers(&pipeline, workers, thread_count) : 0;
+    MecabSession* inline_session = NULL;
+    if (ok && worker_count == 0) {
+        inline_session = mecab_tagger_default_session();
+        ok = inline_session != NULL;
+    }
+    stats->threads = worker_count > 0 ? worker_count : 1;
+
+    long long next_read = 0;
+    long long next_write = 0;
+    int written_files = 0;
+    bool input_done = false;
+
+    pthread_mutex_lock(&pipeline.mutex);
+    while (ok) {
+        // 解析の終わった塊を読み込んだ順に書き出す
+        DnaCorpusChunk* head = &pipeline.chunks[next_write % pipeline.chunk_count];
+        if (next_write < next_read && head->state == DNA_CORPUS_CHUNK_DONE) {
+            pthread_mutex_unlock(&pipeline.mutex);
+            while (written_files <= head->file) {
+                file_first[written_files++] = (uint64_t)stats->sentences;
+            }
+            ok = !head->failed && dna_corpus_write_chunk(out, dict, head, stats);
+            pthread_mutex_lock(&pipeline.mutex);
+            head->state = DNA_CORPUS_CHUNK_EMPTY;
+            next_write++;
+            continue;
+        }
+
+        if (input_done && next_write == next_read) {
+            break;
+        }
+
+        // 空いた塊に次を読み込む
+        DnaCorpusChunk* tail = &pipeline.chunks[next_read % pipeline.chunk_count];
+        if (!input_done && tail->state == DNA_CORPUS_CHUNK_EMPTY) {
+            pthread_mutex_unlock(&pipeline.mutex);
+            bool has_chunk = dna_corpus_read_chunk(&input, tail, &stats->bytes);
+            if (has_chunk && inline_session) {
+                dna_corpus_tag_chunk(inline_session, tail);
+            }
+            pthread_mutex_lock(&pipeline.mutex);
+            if (!has_chunk) {
+                // 途中で打ち切った入力から欠けたコーパスを書かない
+                input_done = true;
+                ok = !input.failed;
+                continue;
+            }
+            tail->sequence = next_read++;
+            tail->state = inline_session ? DNA_CORPUS_CHUNK_DONE : DNA_CORPUS_CHUNK_READY;
+            pthread_cond_broadcast(&pipeline.cond);
+            continue;
+        }
+
+        pthread_cond_wait(&pipeline.cond, &pipeline.mutex);
+    }
+    pipeline.stopping = true;
+    pthread_cond_broadcast(&pipeline.cond);
+    pthread_mutex_unlock(&pipeline.mutex);
+
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+        mecab_session_destroy(workers[i].session);
+    }
+
+    if (ok) {
+        // 文のなかったファイルも次の文の番号を先頭にする
+        while (written_files < input.count) {
+            file_first[written_files++] = (uint64_t)stats->sentences;
+        }
+        for (int i = 0; i < input.count; i++) {
+            size_t name_length = strlen(input.names[i]);
+            if (name_length > UINT16_MAX) {
+                name_length = UINT16_MAX;
+            }
+            dna_corpus_put_u16(out, (uint16_t)name_length);
+            fwrite(input.names[i], 1, name_length, out);
+            dna_corpus_put_u64(out, file_first[i]);
+        }
+        fseek(out, 0, SEEK_SET);
+        dna_corpus_put_header(out, (uint64_t)stats->sentences, (uint32_t)input.count);
+        ok = !ferror(out);
+    }
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "DNAコーパスの作成に失敗しました: %s\n", output_path);
+    }
+
+    if (pipeline.chunks) {
+        for (int i = 0; i < pipeline.chunk_count; i++) {
+            free(pipeline.chunks[i].text);
+            free(pipeline.chunks[i].sentences);
+            free(pipeline.chunks[i].words);
+        }
+    }
+    free(pipeline.chunks);
+    free(workers);
+    free(file_first);
+    pthread_cond_destroy(&pipeline.cond);
+    pthread_mutex_destroy(&pipeline.mutex);
+    dna_corpus_input_free(&input);
+
+    stats->new_words = dict->count - initial_words;
+    stats->elapsed_ms = dna_corpus_now_ms() - start;
+    return ok;
+}
+
+// リトルエンディアンで読む
+static bool dna_corpus_get_uint(FILE* file, int bytes, uint64_t* value) {
+    *value = 0;
+    for (int i = 0; i < bytes; i++) {
+        int c = fgetc(file);
+        if (c == EOF) {
+            return false;
+        }
+        *value |= (uint64_t)c << (i * 8);
+    }
+    return true;
+}
+
+// DNAコーパスファイルを開く
+bool dna_corpus_reader_open(DnaCorpusReader* reader, const char* path) {
+    memset(reader, 0, sizeof(*reader));
+
+    reader->file = fopen(path, "rb");
+    if (!reader->file) {
+        fprintf(stderr, "ファイルを開けませんでした: %s\n", path);
+        return false;
+    }
+
+    char magic[4];
+    uint64_t version, sentences, files;
+    if (fread(magic, 1, 4, reader->file) != 4 || memcmp(magic, DNA_CORPUS_MAGIC, 4) != 0 ||
+        !dna_corpus_get_uint(reader->file, 4, &version) || version != DNA_CORPUS_VERSION ||
+        !dna_corpus_get_uint(reader->file, 8, &sentences) || !dna_corpus_get_uint(reader->file, 4, &files)) {
+        fprintf(stderr, "DNAコーパスファイルの形式が無効です: %s\n", path);
+        dna_corpus_reader_close(reader);
+        return false;
+    }
+
+    reader->sentence_count = sentences;
+    reader->remaining = sentences;
+    reader->file_count = (uint32_t)files;
+    return true;
+}
+
+// 次の文を読む
+bool dna_corpus_reader_next(DnaCorpusReader* reader, uint8_t* mask, uint32_t ids[ENHANCED_DNA_TYPE_COUNT]) {
+    if (!reader->file || reader->remaining == 0) {
+        return false;
+    }
+
+    int c = fgetc(reader->file);
+    if (c == EOF) {
+        return false;
+    }
+    *mask = (uint8_t)c;
+
+    for (int type = 0; type < ENHANCED_DNA_TYPE_COUNT; type++) {
+        ids[type] = 0;
+        if (!(*mask & (1u << type))) {
+            continue;
+        }
+        uint32_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            c = fgetc(reader->file);
+            if (c == EOF || shift > 28) {
+                return false;
+            }
+            value |= (uint32_t)(c & 0x7F) << shift;
+            if (!(c & 0x80)) {
+                break;
+            }
+        }
+        ids[type] = value;
+    }
+
+    reader->remaining--;
+    return true;
+}
+
+// DNAコーパスファイルを閉じる
+void dna_corpus_reader_close(DnaCorpusReader* reader) {
+    if (reader->file) {
+        fclose(reader->file);
+    }
+    memset(reader, 0, sizeof(*reader));
+}
+
+// コマンドラインツール
+#ifdef TEST_DNA_CORPUS_BUILDER
+int main(int argc, char* argv[]) {
+    const char* directory = argc > 1 ? argv[1] : "knowledge/docs";
+    const char* output_path = argc > 2 ? argv[2] : "data/dna_corpus.bin";
+    const char* dictionary_path = argc > 3 ? argv[3] : "data/enhanced_dna_dictionary.txt";
+    int threads = argc > 4 ? atoi(argv[4]) : 0;
+
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        printf("使用法: %s [入力ディレクトリ] [出力ファイル] [辞書ファイル] [スレッド数]\n", argv[0]);
+        printf("例: %s knowledge/docs data/dna_corpus.bin data/enhanced_dna_dictionary.txt 4\n", argv[0]);
+        return 0;
+    }
+
+    // 既存の辞書があれば同じコードを使い続ける
+    EnhancedDNADictionary dict;
+    init_enhanced_dna_dictionary(&dict);
+    FILE* existing = fopen(dictionary_path, "r");
+    if (existing) {
+        fclose(existing);
+        load_enhanced_dna_dictionary(&dict, dictionary_path);
+    }
+
+    DnaCorpusStats stats;
+    if (!dna_corpus_build(directory, output_path, &dict, threads, &stats)) {
+        free_enhanced_dna_dictionary(&dict);
+        mecab_tagger_free();
+        return 1;
+    }
+    if (stats.new_words > 0 && !save_enhanced_dna_dictionary(&dict, dictionary_path)) {
+        fprintf(stderr, "辞書を保存できませんでした: %s\n", dictionary_path);
+    }
+
+    printf("DNAコーパスを作成しました: %s\n", output_path);
+    printf("  ファイル: %d, 入力: %lld バイト, 文: %lld, 要素: %lld\n",
+           stats.file_count, stats.bytes, stats.sentences, stats.elements);
+    printf("  辞書: %d 語（新規 %d 語）, スレッド: %d, 時間: %.1f ms\n",
+           dict.count, stats.new_words, stats.threads, stats.elapsed_ms);
+
+    // 先頭の数文をコードに戻して表示
+    DnaCorpusReader reader;
+    if (dna_corpus_reader_open(&reader, output_path)) {
+        uint8_t mask;
+        uint32_t ids[ENHANCED_DNA_TYPE_COUNT];
+        for (int i = 0; i < 5 && dna_corpus_reader_next(&reader, &mask, ids); i++) {
+            printf("  ");
+            for (int type = 0; type < ENHANCED_DNA_TYPE_COUNT; type++) {
+                if (mask & (1u << type)) {
+                    printf("%c%u", enhanced_dna_type_char((EnhancedDNAType)type), ids[type]);
+                }
+            }
+            printf("\n");
+        }
+        dna_corpus_reader_close(&reader);
+    }
+
+    free_enhanced_dna_dictionary(&dict);
+    mecab_tagger_free();
+    return 0;
+}
+#endif
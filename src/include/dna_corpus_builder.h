@@ -0,0 +1,57 @@
+#ifndef DNA_CORPUS_BUILDER_H
+#define DNA_CORPUS_BUILDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "enhanced_dna_compressor.h"
+
+#define DNA_CORPUS_MAGIC "GDNA"
+#define DNA_CORPUS_VERSION 1
+#define DNA_CORPUS_CHUNK_BYTES (1024 * 1024)    // 1回の解析に渡す大きさ（行の途中では切らない）
+#define DNA_CORPUS_MAX_THREADS 64
+
+// DNAコーパスファイルの形式（数値はリトルエンディアン）
+//   ヘッダー: "GDNA"、版（uint32）、文の数（uint64）、ファイルの数（uint32）
+//   文: 要素のあるタイプのビット（uint8、ビット i が EnhancedDNAType i）と、
+//       ビットの立ったタイプのID（LEB128 の可変長整数）をタイプの順に並べる
+//   末尾: ファイルごとに名前の長さ（uint16）、名前、先頭の文の番号（uint64）
+// 文は入力ファイルの名前順、ファイル内の出現順に並ぶ（スレッド数によらない）
+
+// 書き出しの統計情報
+typedef struct {
+    int file_count;
+    long long bytes;            // 読み込んだバイト数
+    long long sentences;        // 書き出した文の数
+    long long elements;         // 書き出した要素の数
+    int new_words;              // 辞書に加えた語の数
+    int threads;                // 解析に使ったスレッド数
+    double elapsed_ms;
+} DnaCorpusStats;
+
+// DNAコーパスファイルの読み込み
+typedef struct {
+    FILE* file;
+    uint64_t sentence_count;
+    uint64_t remaining;
+    uint32_t file_count;
+} DnaCorpusReader;
+
+// directory の *.txt を文に分けて形態素解析し、拡張DNAコードを output_path に書き出す
+// 解析はファイルを塊に分けて threads 個のスレッド（0 なら CPU 数）で行い、
+// 符号化と書き出しは呼び出し元のスレッドが入力の順に行う
+// 新しい語は dict に加わる（辞書の読み込みと保存は呼び出し側で行う）
+bool dna_corpus_build(const char* directory, const char* output_path, EnhancedDNADictionary* dict,
+                      int threads, DnaCorpusStats* stats);
+
+// DNAコーパスファイルを開く
+bool dna_corpus_reader_open(DnaCorpusReader* reader, const char* path);
+
+// 次の文を読む（ids はタイプごと、mask のビットが立ったタイプだけ有効）
+// 終わりに達したか壊れている場合は false
+bool dna_corpus_reader_next(DnaCorpusReader* reader, uint8_t* mask, uint32_t ids[ENHANCED_DNA_TYPE_COUNT]);
+
+// DNAコーパスファイルを閉じる
+void dna_corpus_reader_close(DnaCorpusReader* reader);
+
+#endif // DNA_CORPUS_BUILDER_H
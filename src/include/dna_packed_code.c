@@ -0,0 +1,140 @@
+#include "dna_packed_code.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DNA_PACKED_PRESENT_BITS 0x8000800080008000ULL   // 各要素の最上位ビット
+#define DNA_PACKED_ID_BITS 0x7FFF7FFF7FFF7FFFULL        // 各要素のIDのビット
+
+// 要素のタイプの位置
+int dna_packed_slot(char type) {
+    switch (type) {
+        case 'E': return 0;
+        case 'C': return 1;
+        case 'R': return 2;
+        case 'A': return 3;
+        case 'T': return 4;
+        case 'L': return 5;
+        case 'M': return 6;
+        case 'Q': return 7;
+        default:  return -1;
+    }
+}
+
+// i 番目の要素を設定
+bool dna_code_set(DnaPackedCode* code, int slot, int id) {
+    if (slot < 0 || slot >= DNA_PACKED_SLOT_COUNT || id > DNA_PACKED_ID_MAX) {
+        return false;
+    }
+
+    int shift = (slot & 3) * 16;
+    uint64_t* word = &code->words[slot >> 2];
+    *word &= ~(0xFFFFULL << shift);
+    if (id >= 0) {
+        *word |= (uint64_t)(0x8000 | id) << shift;
+    }
+    return true;
+}
+
+// i 番目の要素のID
+int dna_code_id(const DnaPackedCode* code, int slot) {
+    if (slot < 0 || slot >= DNA_PACKED_SLOT_COUNT) {
+        return -1;
+    }
+    unsigned int lane = (unsigned int)(code->words[slot >> 2] >> ((slot & 3) * 16)) & 0xFFFF;
+    return (lane & 0x8000) ? (int)(lane & DNA_PACKED_ID_MAX) : -1;
+}
+
+// 各要素の最上位ビットを下位4ビットに集める
+static unsigned int dna_packed_gather(uint64_t bits) {
+    return (unsigned int)(((bits >> 15) & 1) | ((bits >> 30) & 2) | ((bits >> 45) & 4) | ((bits >> 60) & 8));
+}
+
+// 要素の有無
+unsigned int dna_code_mask(const DnaPackedCode* code) {
+    return dna_packed_gather(code->words[0] & DNA_PACKED_PRESENT_BITS) |
+           (dna_packed_gather(code->words[1] & DNA_PACKED_PRESENT_BITS) << 4);
+}
+
+// 16ビットごとに、0 の要素の最上位ビットだけを立てる
+static uint64_t dna_packed_zero_lanes(uint64_t x) {
+    // 下位15ビットに 0x7FFF を足すと、0 でなければ最上位ビットに繰り上がる（隣の要素には及ばない）
+    uint64_t nonzero = ((x & DNA_PACKED_ID_BITS) + DNA_PACKED_ID_BITS) | x;
+    return ~nonzero & DNA_PACKED_PRESENT_BITS;
+}
+
+// 両方にある要素と、そのうちIDが一致する要素
+void dna_code_compare(const DnaPackedCode* a, const DnaPackedCode* b, unsigned int* shared, unsigned int* matched) {
+    uint64_t shared0 = a->words[0] & b->words[0] & DNA_PACKED_PRESENT_BITS;
+    uint64_t shared1 = a->words[1] & b->words[1] & DNA_PACKED_PRESENT_BITS;
+    uint64_t equal0 = dna_packed_zero_lanes(a->words[0] ^ b->words[0]);
+    uint64_t equal1 = dna_packed_zero_lanes(a->words[1] ^ b->words[1]);
+
+    if (shared) {
+        *shared = dna_packed_gather(shared0) | (dna_packed_gather(shared1) << 4);
+    }
+    if (matched) {
+        *matched = dna_packed_gather(shared0 & equal0) | (dna_packed_gather(shared1 & equal1) << 4);
+    }
+}
+
+// 同じコードか
+bool dna_code_equal(const DnaPackedCode* a, const DnaPackedCode* b) {
+    return ((a->words[0] ^ b->words[0]) | (a->words[1] ^ b->words[1])) == 0;
+}
+
+// テキストのDNAコードを詰める
+bool dna_code_pack(const char* text, DnaPackedCode* code) {
+    code->words[0] = 0;
+    code->words[1] = 0;
+    if (!text) {
+        return false;
+    }
+
+    bool ok = true;
+    const char* p = text;
+    while (*p) {
+        int slot = dna_packed_slot(*p++);
+
+        // 数字部分を読む（数字がなければ ID 0）
+        long id = 0;
+        while (*p >= '0' && *p <= '9') {
+            if (id <= DNA_PACKED_ID_MAX) {
+                id = id * 10 + (*p - '0');
+            }
+            p++;
+        }
+
+        if (slot < 0) {
+            continue;
+        }
+        if (id > DNA_PACKED_ID_MAX) {
+            ok = false;
+            continue;
+        }
+        dna_code_set(code, slot, (int)id);
+    }
+    return ok;
+}
+
+// テキストに戻す
+int dna_code_format(const DnaPackedCode* code, char* text, size_t size) {
+    if (!text || size == 0) {
+        return 0;
+    }
+
+    size_t length = 0;
+    text[0] = '\0';
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        int id = dna_code_id(code, slot);
+        if (id < 0) {
+            continue;
+        }
+        int written = snprintf(text + length, size - length, "%c%d", DNA_PACKED_SLOT_TYPES[slot], id);
+        if (written < 0 || (size_t)written >= size - length) {
+            text[length] = '\0';
+            break;
+        }
+        length += (size_t)written;
+    }
+    return (int)length;
+}
@@ -0,0 +1,47 @@
+#ifndef DNA_PACKED_CODE_H
+#define DNA_PACKED_CODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DNA_PACKED_SLOT_COUNT 8
+#define DNA_PACKED_SLOT_TYPES "ECRATLMQ"    // 要素の並び（i 番目の文字が i 番目の要素）
+#define DNA_PACKED_ID_MAX 0x7FFF            // 1要素のIDの上限（15ビット）
+#define DNA_PACKED_TEXT_MAX 64              // テキストに戻したときの最大長（終端を含む）
+
+// DNAコードの固定長表現（16バイト）
+// 要素ごとに16ビット（最上位ビットが要素の有無、下位15ビットがID）を
+// words[0] に E, C, R, A、words[1] に T, L, M, Q の順で下位から詰める
+// 要素のない部分は 0 なので、同じコードは同じビット列になる
+typedef struct {
+    uint64_t words[2];
+} DnaPackedCode;
+
+// 要素のタイプの位置（'E' なら 0、DNAコードの文字でなければ -1）
+int dna_packed_slot(char type);
+
+// テキストのDNAコード（E0C5R1A7L2M3 など）を詰める
+// 知らない文字はその後の数字ごと読み飛ばし、同じタイプが続けば後のものを使う
+// IDが DNA_PACKED_ID_MAX を超える要素は含めず、false を返す
+bool dna_code_pack(const char* text, DnaPackedCode* code);
+
+// テキストに戻す（E, C, R, A, T, L, M, Q の順、書いた長さを返す）
+int dna_code_format(const DnaPackedCode* code, char* text, size_t size);
+
+// 要素の有無（ビット i が i 番目の要素）
+unsigned int dna_code_mask(const DnaPackedCode* code);
+
+// i 番目の要素のID（なければ -1）
+int dna_code_id(const DnaPackedCode* code, int slot);
+
+// i 番目の要素を設定（id が負なら要素を消す、上限を超える場合は false）
+bool dna_code_set(DnaPackedCode* code, int slot, int id);
+
+// 両方にある要素と、そのうちIDが一致する要素（どちらもビット i が i 番目の要素）
+void dna_code_compare(const DnaPackedCode* a, const DnaPackedCode* b, unsigned int* shared, unsigned int* matched);
+
+// 同じコードか
+bool dna_code_equal(const DnaPackedCode* a, const DnaPackedCode* b);
+
+#endif // DNA_PACKED_CODE_H
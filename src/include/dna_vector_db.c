@@ -1,121 +1,270 @@
 #include "dna_vector_db.h"
+#include "../vector_search/vector_distance.h"
 
 // DNAベクトルデータベースの初期化
 void init_dna_vector_db(DNAVectorDB* db) {
     if (!db) return;
     
     db->size = 0;
+    db->normalized = true;
+    db->quantized = false;
+    db->codes = NULL;
+    db->code_scales = NULL;
+    db->code_capacity = 0;
+    db->indexed = false;
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        db->postings[slot] = NULL;
+        db->posting_counts[slot] = 0;
+    }
+    db->indexed_codes = NULL;
+    db->indexed_capacity = 0;
     memset(db->entries, 0, sizeof(DNAVectorEntry) * MAX_DNA_VECTORS);
 }
 
-// DNAベクトルデータベースのサイズを取得
-int get_dna_vector_db_size(DNAVectorDB* db) {
-    if (!db) return 0;
-    return db->size;
+// int8 符号を解放
+static void free_dna_codes(DNAVectorDB* db) {
+    free(db->codes);
+    free(db->code_scales);
+    db->codes = NULL;
+    db->code_scales = NULL;
+    db->code_capacity = 0;
+    db->quantized = false;
 }
 
-// DNAコードをベクトル化してデータベースに追加
-int add_dna_vector(DNAVectorDB* db, const char* dna_code, int id) {
-    if (!db || !dna_code || db->size >= MAX_DNA_VECTORS) return 0;
+// 転置リストを解放
+static void free_dna_postings(DNAVectorDB* db) {
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        for (int id = 0; id < db->posting_counts[slot]; id++) {
+            free(db->postings[slot][id].entries);
+        }
+        free(db->postings[slot]);
+        db->postings[slot] = NULL;
+        db->posting_counts[slot] = 0;
+    }
+    free(db->indexed_codes);
+    db->indexed_codes = NULL;
+    db->indexed_capacity = 0;
+    db->indexed = false;
+}
+
+// DNAベクトルデータベースの int8 符号と転置リストを解放
+void free_dna_vector_db(DNAVectorDB* db) {
+    if (!db) return;
     
-    // DNAコードからベクトルを生成
-    float vector[64];
-    generate_dna_vector(dna_code, vector);
+    free_dna_codes(db);
+    free_dna_postings(db);
+}
+
+// 符号の領域を少なくとも capacity 件分にする
+static int reserve_dna_codes(DNAVectorDB* db, int capacity) {
+    if (capacity <= db->code_capacity) {
+        return 1;
+    }
     
-    // エントリを追加
-    DNAVectorEntry* entry = &db->entries[db->size];
-    strncpy(entry->dna_code, dna_code, DNA_CODE_MAX_LEN - 1);
-    entry->dna_code[DNA_CODE_MAX_LEN - 1] = '\0';
-    memcpy(entry->vector, vector, sizeof(float) * 64);
-    entry->id = id;
+    int new_capacity = db->code_capacity > 0 ? db->code_capacity : 1024;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+    if (new_capacity > MAX_DNA_VECTORS) {
+        new_capacity = MAX_DNA_VECTORS;
+    }
     
-    db->size++;
+    int8_t* codes = (int8_t*)realloc(db->codes, (size_t)new_capacity * 64);
+    if (!codes) {
+        return 0;
+    }
+    db->codes = codes;
+    float* code_scales = (float*)realloc(db->code_scales, sizeof(float) * new_capacity);
+    if (!code_scales) {
+        return 0;
+    }
+    db->code_scales = code_scales;
+    db->code_capacity = new_capacity;
     return 1;
 }
 
-// DNAコードからベクトルを生成
-void generate_dna_vector(const char* dna_code, float* vector) {
-    if (!dna_code || !vector) return;
+// int8 符号での検索を切り替える
+int set_dna_vector_db_quantized(DNAVectorDB* db, bool quantized) {
+    if (!db) return 0;
     
-    // ベクトルを初期化
-    for (int i = 0; i < 64; i++) {
-        vector[i] = 0.0f;
+    if (!quantized) {
+        free_dna_codes(db);
+        return 1;
+    }
+    if (db->quantized) {
+        return 1;
     }
     
-    // DNAコードの構造を解析
-    char entity[32] = {0};
-    char concept[32] = {0};
-    char result[32] = {0};
-    char attribute[32] = {0};
-    char time[32] = {0};
-    char location[32] = {0};
-    char manner[32] = {0};
-    char quantity[32] = {0};
-    
-    parse_dna_code(dna_code, entity, concept, result, attribute, time, location, manner, quantity);
-    
-    // 各要素の値を使用してベクトルを生成
-    // 主語（Entity）: 0-7
-    if (entity[0] == 'E') {
-        int entity_id = atoi(entity + 1);
-        for (int i = 0; i < 8; i++) {
-            vector[i] = (entity_id % (i + 1 + 8)) / 8.0f;
+    if (!reserve_dna_codes(db, db->size > 0 ? db->size : 1)) {
+        fprintf(stderr, "メモリ割り当てエラー: int8 符号の領域を確保できませんでした\n");
+        return 0;
+    }
+    for (int i = 0; i < db->size; i++) {
+        db->code_scales[i] = vector_quantize_int8(db->entries[i].vector, 64, db->codes + (size_t)i * 64);
+    }
+    db->quantized = true;
+    return 1;
+}
+
+// 要素のIDから8次元のブロックを作る
+static void generate_dna_block(int id, float* block) {
+    for (int i = 0; i < 8; i++) {
+        block[i] = (id % (i + 1 + 8)) / 8.0f;
+    }
+}
+
+// エントリの要素を転置リストに加える
+static int index_dna_entry(DNAVectorDB* db, int index) {
+    // 要素のIDとノルムの逆数を詰めた表（転置リストの検索で内積を表から求めるのに使う）
+    if (index >= db->indexed_capacity) {
+        int capacity = db->indexed_capacity > 0 ? db->indexed_capacity * 2 : 1024;
+        while (capacity <= index) {
+            capacity *= 2;
         }
+        DNAIndexedCode* indexed_codes = (DNAIndexedCode*)realloc(db->indexed_codes, sizeof(DNAIndexedCode) * capacity);
+        if (!indexed_codes) return 0;
+        db->indexed_codes = indexed_codes;
+        db->indexed_capacity = capacity;
     }
     
-    // 動詞（Concept）: 8-15
-    if (concept[0] == 'C') {
-        int concept_id = atoi(concept + 1);
-        for (int i = 0; i < 8; i++) {
-            vector[i + 8] = (concept_id % (i + 1 + 8)) / 8.0f;
+    const DnaPackedCode* code = &db->entries[index].code;
+    float norm = 0.0f;
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        int id = dna_code_id(code, slot);
+        db->indexed_codes[index].ids[slot] = (uint16_t)(id + 1);
+        if (id >= 0) {
+            float block[8];
+            generate_dna_block(id, block);
+            norm += vector_norm_squared(block, 8);
         }
     }
+    db->indexed_codes[index].inverse_norm = norm > 0.0f ? 1.0f / sqrtf(norm) : 0.0f;
     
-    // 目的語（Result）: 16-23
-    if (result[0] == 'R') {
-        int result_id = atoi(result + 1);
-        for (int i = 0; i < 8; i++) {
-            vector[i + 16] = (result_id % (i + 1 + 8)) / 8.0f;
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        int id = dna_code_id(code, slot);
+        if (id < 0) continue;
+        
+        // IDの数を2倍ずつ広げる
+        if (id >= db->posting_counts[slot]) {
+            int count = db->posting_counts[slot] > 0 ? db->posting_counts[slot] : 64;
+            while (count <= id) {
+                count *= 2;
+            }
+            DNASlotPosting* postings = (DNASlotPosting*)realloc(db->postings[slot], sizeof(DNASlotPosting) * count);
+            if (!postings) return 0;
+            memset(postings + db->posting_counts[slot], 0, sizeof(DNASlotPosting) * (count - db->posting_counts[slot]));
+            db->postings[slot] = postings;
+            db->posting_counts[slot] = count;
+        }
+        
+        DNASlotPosting* posting = &db->postings[slot][id];
+        if (posting->count >= posting->capacity) {
+            int capacity = posting->capacity > 0 ? posting->capacity * 2 : 8;
+            int* entries = (int*)realloc(posting->entries, sizeof(int) * capacity);
+            if (!entries) return 0;
+            posting->entries = entries;
+            posting->capacity = capacity;
         }
+        posting->entries[posting->count++] = index;
+    }
+    return 1;
+}
+
+// 要素のIDの転置リストでの検索を切り替える
+int set_dna_vector_db_indexed(DNAVectorDB* db, bool indexed) {
+    if (!db) return 0;
+    
+    if (!indexed) {
+        free_dna_postings(db);
+        return 1;
+    }
+    if (db->indexed) {
+        return 1;
     }
     
-    // 属性（Attribute）: 24-31
-    if (attribute[0] == 'A') {
-        int attribute_id = atoi(attribute + 1);
-        for (int i = 0; i < 8; i++) {
-            vector[i + 24] = (attribute_id % (i + 1 + 8)) / 8.0f;
+    for (int i = 0; i < db->size; i++) {
+        if (!index_dna_entry(db, i)) {
+            fprintf(stderr, "メモリ割り当てエラー: DNAコードの転置リストを作成できませんでした\n");
+            free_dna_postings(db);
+            return 0;
         }
     }
+    db->indexed = true;
+    return 1;
+}
+
+// DNAベクトルデータベースのサイズを取得
+int get_dna_vector_db_size(DNAVectorDB* db) {
+    if (!db) return 0;
+    return db->size;
+}
+
+// DNAコードをベクトル化してデータベースに追加
+int add_dna_vector(DNAVectorDB* db, const char* dna_code, int id) {
+    if (!db || !dna_code) return 0;
     
-    // 時間（Time）: 32-39
-    if (time[0] == 'T') {
-        int time_id = atoi(time + 1);
-        for (int i = 0; i < 8; i++) {
-            vector[i + 32] = (time_id % (i + 1 + 8)) / 8.0f;
-        }
+    DnaPackedCode code;
+    if (!dna_code_pack(dna_code, &code)) {
+        fprintf(stderr, "DNAコードのIDが大きすぎます: %s\n", dna_code);
+        return 0;
     }
+    return add_dna_vector_packed(db, &code, id);
+}
+
+// 詰めたDNAコードをベクトル化してデータベースに追加
+int add_dna_vector_packed(DNAVectorDB* db, const DnaPackedCode* code, int id) {
+    if (!db || !code || db->size >= MAX_DNA_VECTORS) return 0;
+    if (db->quantized && !reserve_dna_codes(db, db->size + 1)) return 0;
     
-    // 場所（Location）: 40-47
-    if (location[0] == 'L') {
-        int location_id = atoi(location + 1);
-        for (int i = 0; i < 8; i++) {
-            vector[i + 40] = (location_id % (i + 1 + 8)) / 8.0f;
-        }
+    // エントリを追加
+    DNAVectorEntry* entry = &db->entries[db->size];
+    entry->code = *code;
+    generate_dna_vector_packed(code, entry->vector);
+    entry->id = id;
+    
+    // generate_dna_vector_packed は正規化するが、念のため確かめる
+    if (db->normalized && !vector_is_unit(entry->vector, 64)) {
+        db->normalized = false;
     }
     
-    // 様態（Manner）: 48-55
-    if (manner[0] == 'M') {
-        int manner_id = atoi(manner + 1);
-        for (int i = 0; i < 8; i++) {
-            vector[i + 48] = (manner_id % (i + 1 + 8)) / 8.0f;
-        }
+    if (db->quantized) {
+        db->code_scales[db->size] = vector_quantize_int8(entry->vector, 64, db->codes + (size_t)db->size * 64);
+    }
+    
+    // 索引に失敗したら転置リストを使わない検索に戻す
+    if (db->indexed && !index_dna_entry(db, db->size)) {
+        fprintf(stderr, "メモリ割り当てエラー: DNAコードの転置リストを拡張できませんでした\n");
+        free_dna_postings(db);
     }
     
-    // 数量（Quantity）: 56-63
-    if (quantity[0] == 'Q') {
-        int quantity_id = atoi(quantity + 1);
-        for (int i = 0; i < 8; i++) {
-            vector[i + 56] = (quantity_id % (i + 1 + 8)) / 8.0f;
+    db->size++;
+    return 1;
+}
+
+// DNAコードからベクトルを生成
+void generate_dna_vector(const char* dna_code, float* vector) {
+    if (!dna_code || !vector) return;
+    
+    // 詰められない（IDが大きすぎる）要素は含めない
+    DnaPackedCode code;
+    dna_code_pack(dna_code, &code);
+    generate_dna_vector_packed(&code, vector);
+}
+
+// 詰めたDNAコードからベクトルを生成
+// 要素 i（E, C, R, A, T, L, M, Q の順）のIDが次元 8i から 8i+7 になる
+void generate_dna_vector_packed(const DnaPackedCode* code, float* vector) {
+    if (!code || !vector) return;
+    
+    // ベクトルを初期化
+    for (int i = 0; i < 64; i++) {
+        vector[i] = 0.0f;
+    }
+    
+    unsigned int mask = dna_code_mask(code);
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        if (mask & (1u << slot)) {
+            generate_dna_block(dna_code_id(code, slot), vector + slot * 8);
         }
     }
     
@@ -133,75 +282,344 @@ void generate_dna_vector(const char* dna_code, float* vector) {
     }
 }
 
-// 最も近いDNAコードを検索（ユークリッド距離）
-int search_nearest_dna_euclidean(DNAVectorDB* db, const char* query_dna_code) {
-    if (!db || !query_dna_code || db->size == 0) return -1;
-    
-    // クエリDNAコードをベクトル化
-    float query_vector[64];
-    generate_dna_vector(query_dna_code, query_vector);
-    
-    // 最も近いベクトルを検索
-    int nearest_id = -1;
-    float min_distance = INFINITY;
+// エントリのスコア（大きいほど良い、ユークリッド距離は距離の二乗の負値）
+static float dna_entry_score(const DNAVectorDB* db, const float* query_vector, float query_norm, int index, bool cosine) {
+    const float* vector = db->entries[index].vector;
+    if (!cosine) {
+        // 平方根は順序を変えないので距離の二乗で比べる
+        return -vector_squared_distance(query_vector, vector, 64);
+    }
     
-    for (int i = 0; i < db->size; i++) {
-        float distance = 0.0f;
-        for (int j = 0; j < 64; j++) {
-            float diff = query_vector[j] - db->entries[i].vector[j];
-            distance += diff * diff;
+    if (db->normalized) {
+        // 全エントリが単位ベクトルなら内積だけでよい
+        return query_norm > 0.0f ? vector_dot(query_vector, vector, 64) / query_norm : 0.0f;
+    }
+    float norm_entry = 0.0f;
+    float dot_product = vector_dot_norm(query_vector, vector, 64, &norm_entry);
+    if (query_norm > 0.0f && norm_entry > 0.0f) {
+        return dot_product / (query_norm * sqrtf(norm_entry));
+    }
+    return 0.0f;
+}
+
+// int8 符号のスコア（候補を選ぶための近似値）
+static float dna_code_score(const DNAVectorDB* db, const float* query_vector, float query_norm, int index, bool cosine) {
+    const int8_t* code = db->codes + (size_t)index * 64;
+    float scale = db->code_scales[index];
+    float code_norm = 0.0f;
+    float dot_product = vector_dot_norm_int8(query_vector, code, 64, &code_norm);
+    if (!cosine) {
+        // |q - s c|^2 のうち、エントリによらない |q|^2 を除いた負値
+        return scale * (2.0f * dot_product - scale * code_norm);
+    }
+    if (query_norm > 0.0f && code_norm > 0.0f) {
+        return dot_product / (query_norm * sqrtf(code_norm));
+    }
+    return 0.0f;
+}
+
+// 転置リストをたどる順序（要素ごとに、クエリのブロックとのコサイン類似度の高いIDから）
+typedef struct {
+    int id;
+    float cosine;
+} DNAPostingOrder;
+
+// コサイン類似度の降順（同じならIDの昇順）
+static int compare_dna_posting_order(const void* a, const void* b) {
+    const DNAPostingOrder* order_a = (const DNAPostingOrder*)a;
+    const DNAPostingOrder* order_b = (const DNAPostingOrder*)b;
+    if (order_a->cosine > order_b->cosine) return -1;
+    if (order_a->cosine < order_b->cosine) return 1;
+    return order_a->id - order_b->id;
+}
+
+// 転置リストの検索の作業領域
+typedef struct {
+    float* tables[DNA_PACKED_SLOT_COUNT];             // 要素ごとに、x + 1 番目にクエリのブロックとの内積 q_s・b(x)（0 番目は 0）
+    DNAPostingOrder* orders[DNA_PACKED_SLOT_COUNT];   // 転置リストをたどる順序
+    int order_counts[DNA_PACKED_SLOT_COUNT];
+    int positions[DNA_PACKED_SLOT_COUNT];             // 次にたどる orders の位置
+    float weights[DNA_PACKED_SLOT_COUNT];             // |q_s|^2
+    int slots[DNA_PACKED_SLOT_COUNT];                 // クエリにある要素
+    int slot_count;
+    bool cosine;
+} DNAPostingSearch;
+
+// 要素ごとに q_s・b(x) の表を作り、転置リストのあるIDをクエリのブロックとのコサイン類似度の高い順に並べる
+static int prepare_dna_posting_search(const DNAVectorDB* db, const float* query_vector, DNAPostingSearch* search) {
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        const float* query_block = query_vector + slot * 8;
+        search->weights[slot] = vector_norm_squared(query_block, 8);
+        if (search->weights[slot] <= 0.0f || db->posting_counts[slot] == 0) continue;
+        
+        search->orders[slot] = (DNAPostingOrder*)malloc(sizeof(DNAPostingOrder) * db->posting_counts[slot]);
+        search->tables[slot] = (float*)malloc(sizeof(float) * (db->posting_counts[slot] + 1));
+        if (!search->orders[slot] || !search->tables[slot]) return 0;
+        search->slots[search->slot_count++] = slot;
+        
+        float query_block_norm = sqrtf(search->weights[slot]);
+        float* table = search->tables[slot];
+        table[0] = 0.0f;
+        for (int id = 0; id < db->posting_counts[slot]; id++) {
+            float block[8];
+            generate_dna_block(id, block);
+            table[id + 1] = vector_dot(query_block, block, 8);
+            if (db->postings[slot][id].count == 0) continue;
+            
+            float block_norm = sqrtf(vector_norm_squared(block, 8));
+            DNAPostingOrder* order = &search->orders[slot][search->order_counts[slot]++];
+            order->id = id;
+            order->cosine = block_norm > 0.0f ? table[id + 1] / (query_block_norm * block_norm) : 0.0f;
+        }
+        qsort(search->orders[slot], search->order_counts[slot], sizeof(DNAPostingOrder), compare_dna_posting_order);
+    }
+    return 1;
+}
+
+static void free_dna_posting_search(DNAPostingSearch* search) {
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        free(search->orders[slot]);
+        free(search->tables[slot]);
+    }
+}
+
+// エントリのスコアを表から求める（要素がなければ表の 0 番目の 0 を引く）
+// クエリは単位ベクトル、エントリは単位ベクトルか（要素がなければ）0 なので、
+// ユークリッド距離は距離の二乗 |q|^2 + |v|^2 - 2 q・v から |q|^2 を除いた負値で比べる
+static float dna_indexed_score(const DNAPostingSearch* search, const DNAIndexedCode* indexed_code) {
+    float dot_product = 0.0f;
+    for (int i = 0; i < search->slot_count; i++) {
+        int slot = search->slots[i];
+        dot_product += search->tables[slot][indexed_code->ids[slot]];
+    }
+    dot_product *= indexed_code->inverse_norm;
+    if (search->cosine) {
+        return dot_product;
+    }
+    return 2.0f * dot_product - (indexed_code->inverse_norm > 0.0f ? 1.0f : 0.0f);
+}
+
+// 打ち切りの判定用の上位 k 件と、計算し直す候補の上位 k + DNA_RERANK_CANDIDATES 件に加える
+static void push_dna_indexed(TopKSelector* top, TopKSelector* pool, float score, int index) {
+    if (top->count < top->capacity || score >= top_k_threshold(top)) {
+        top_k_push(top, score, index, index);
+    }
+    if (pool->count < pool->capacity || score >= top_k_threshold(pool)) {
+        top_k_push(pool, score, index, index);
+    }
+}
+
+// 転置リストをたどって上位を集める（上限で打ち切れたら 1、たどったエントリが多すぎれば 0）
+//
+// エントリのベクトルは要素ごとのブロック b(x) をまとめて |b(x)| で割ったものなので、単位ベクトルのクエリ q との内積は
+//   sum_s q_s・b(x_s) / |b(x)| = sum_s |q_s| cos(q_s, b(x_s)) |b(x_s)| / |b(x)| <= sqrt(sum_s |q_s|^2 cos(q_s, b(x_s))^2)
+// となる（コーシー・シュワルツの不等式）。要素ごとにブロックのコサイン類似度の高いIDから転置リストをたどると、
+// まだ見ていないエントリの cos(q_s, b(x_s)) は次にたどるIDの値以下なので、上位 k 件目がこの上限を超えた時点で打ち切れる
+// 要素のないエントリは転置リストにないが、スコアはコサイン類似度でもユークリッド距離でも 0（上限以下）になる
+static int collect_dna_postings(const DNAVectorDB* db, DNAPostingSearch* search, uint8_t* visited,
+                                TopKSelector* top, TopKSelector* pool) {
+    int visited_count = 0;
+    for (;;) {
+        // まだ見ていないエントリの内積の上限と、次にたどる要素（上限への寄与が最も大きいもの）
+        float bound = 0.0f;
+        float best_term = 0.0f;
+        int best_slot = -1;
+        for (int i = 0; i < search->slot_count; i++) {
+            int slot = search->slots[i];
+            if (search->positions[slot] >= search->order_counts[slot]) continue;
+            float next_cosine = search->orders[slot][search->positions[slot]].cosine;
+            float term = search->weights[slot] * next_cosine * next_cosine;
+            bound += term;
+            if (term > best_term) {
+                best_term = term;
+                best_slot = slot;
+            }
+        }
+        
+        // 上位 k 件目が上限を（丸め誤差より大きく）超えれば、残りのエントリは結果に入らない
+        float bound_score = search->cosine ? sqrtf(bound) : fmaxf(2.0f * sqrtf(bound) - 1.0f, 0.0f);
+        if (top->count == top->capacity && top_k_threshold(top) > bound_score + DNA_POSTING_BOUND_SLACK) {
+            return 1;
+        }
+        if (best_slot < 0 || visited_count > db->size / DNA_POSTING_SCAN_RATIO) {
+            return 0;
         }
-        distance = sqrt(distance);
         
-        if (distance < min_distance) {
-            min_distance = distance;
-            nearest_id = db->entries[i].id;
+        // 次のIDの転置リストのエントリを調べる（走査順はエントリ番号の順ではないので、同じスコアの入れ替えは top_k_push に任せる）
+        const DNASlotPosting* posting = &db->postings[best_slot][search->orders[best_slot][search->positions[best_slot]].id];
+        search->positions[best_slot]++;
+        for (int i = 0; i < posting->count; i++) {
+            int index = posting->entries[i];
+            if (visited[index >> 3] & (1u << (index & 7))) continue;
+            visited[index >> 3] |= (uint8_t)(1u << (index & 7));
+            visited_count++;
+            push_dna_indexed(top, pool, dna_indexed_score(search, &db->indexed_codes[index]), index);
         }
     }
-    
-    return nearest_id;
 }
 
-// 最も近いDNAコードを検索（コサイン類似度）
-int search_nearest_dna_cosine(DNAVectorDB* db, const char* query_dna_code) {
-    if (!db || !query_dna_code || db->size == 0) return -1;
+// 転置リストで上位を集める（集められなければ 0 を返し、全件を調べ直す）
+// 候補の内積は要素とIDごとの表とエントリの 1/|b(x)| から求め、上位 k + DNA_RERANK_CANDIDATES 件だけを
+// エントリの float ベクトルで計算し直す。上限で打ち切れないときは、詰めたDNAコードを順に全件調べる
+static int search_dna_postings(const DNAVectorDB* db, const float* query_vector, float query_norm, bool cosine,
+                               TopKSelector* selector) {
+    int k = selector->capacity;
+    if (!db->normalized || k > db->size) return 0;
+    
+    DNAPostingSearch search;
+    memset(&search, 0, sizeof(search));
+    search.cosine = cosine;
+    int pool_capacity = k + DNA_RERANK_CANDIDATES;
+    TopKItem* items = (TopKItem*)malloc(sizeof(TopKItem) * (size_t)(k + pool_capacity));
+    uint8_t* visited = (uint8_t*)calloc((size_t)(db->size + 7) / 8, 1);
+    int found = items && visited && prepare_dna_posting_search(db, query_vector, &search);
+    
+    if (found) {
+        TopKSelector top;
+        TopKSelector pool;
+        top_k_init(&top, items, k);
+        top_k_init(&pool, items + k, pool_capacity);
+        if (!collect_dna_postings(db, &search, visited, &top, &pool)) {
+            pool.count = 0;
+            float threshold = top_k_threshold(&pool);
+            for (int i = 0; i < db->size; i++) {
+                float score = dna_indexed_score(&search, &db->indexed_codes[i]);
+                if (pool.count < pool.capacity || score > threshold) {
+                    top_k_push(&pool, score, i, i);
+                    threshold = top_k_threshold(&pool);
+                }
+            }
+        }
+        
+        // 候補をエントリの float ベクトルで計算し直す
+        for (int i = 0; i < pool.count; i++) {
+            int index = pool.items[i].order;
+            top_k_push(selector, dna_entry_score(db, query_vector, query_norm, index, cosine), db->entries[index].id, index);
+        }
+    }
     
+    free_dna_posting_search(&search);
+    free(visited);
+    free(items);
+    return found;
+}
+
+// 近い順に上位を selector に集めて件数を返す（スコアは大きいほど良い、ユークリッド距離は距離の二乗の負値）
+static int search_dna_candidates(DNAVectorDB* db, const DnaPackedCode* query, bool cosine, TopKSelector* selector) {
     // クエリDNAコードをベクトル化
     float query_vector[64];
-    generate_dna_vector(query_dna_code, query_vector);
+    generate_dna_vector_packed(query, query_vector);
     
-    // 最も近いベクトルを検索
-    int nearest_id = -1;
-    float max_similarity = -1.0f;
+    // クエリのノルムは一度だけ求める
+    float query_norm = cosine ? sqrtf(vector_norm_squared(query_vector, 64)) : 0.0f;
     
-    for (int i = 0; i < db->size; i++) {
-        float dot_product = 0.0f;
-        float norm_query = 0.0f;
-        float norm_entry = 0.0f;
-        
-        for (int j = 0; j < 64; j++) {
-            dot_product += query_vector[j] * db->entries[i].vector[j];
-            norm_query += query_vector[j] * query_vector[j];
-            norm_entry += db->entries[i].vector[j] * db->entries[i].vector[j];
+    // 転置リストで上位を集める（打ち切れなければ全件を調べ直す）
+    if (db->indexed) {
+        if (search_dna_postings(db, query_vector, query_norm, cosine, selector)) {
+            return top_k_finalize(selector);
         }
-        
-        norm_query = sqrt(norm_query);
-        norm_entry = sqrt(norm_entry);
-        
-        float similarity = 0.0f;
-        if (norm_query > 0.0f && norm_entry > 0.0f) {
-            similarity = dot_product / (norm_query * norm_entry);
+        selector->count = 0;
+    }
+    
+    // 連続した int8 符号だけを走査して候補を絞り、候補をエントリの float ベクトルで計算し直す
+    // 転置リストと同じく、上位 k 件に DNA_RERANK_CANDIDATES 件の余裕を足した数を計算し直す
+    int rerank_count = selector->capacity + DNA_RERANK_CANDIDATES;
+    TopKItem stack_candidates[DNA_RERANK_CANDIDATES * 2];
+    TopKItem* candidates = NULL;
+    if (db->quantized) {
+        candidates = rerank_count <= DNA_RERANK_CANDIDATES * 2 ? stack_candidates : (TopKItem*)malloc(sizeof(TopKItem) * rerank_count);
+    }
+    
+    if (candidates) {
+        TopKSelector rerank;
+        top_k_init(&rerank, candidates, rerank_count);
+        for (int i = 0; i < db->size; i++) {
+            float score = dna_code_score(db, query_vector, query_norm, i, cosine);
+            if (rerank.count < rerank.capacity || score > top_k_threshold(&rerank)) {
+                top_k_push(&rerank, score, db->entries[i].id, i);
+            }
         }
         
-        if (similarity > max_similarity) {
-            max_similarity = similarity;
-            nearest_id = db->entries[i].id;
+        int count = top_k_finalize(&rerank);
+        for (int i = 0; i < count; i++) {
+            int index = candidates[i].order;
+            top_k_push(selector, dna_entry_score(db, query_vector, query_norm, index, cosine), db->entries[index].id, index);
+        }
+        if (candidates != stack_candidates) {
+            free(candidates);
         }
+    } else {
+        for (int i = 0; i < db->size; i++) {
+            float score = dna_entry_score(db, query_vector, query_norm, i, cosine);
+            if (selector->count < selector->capacity || score > top_k_threshold(selector)) {
+                top_k_push(selector, score, db->entries[i].id, i);
+            }
+        }
+    }
+    
+    return top_k_finalize(selector);
+}
+
+// 近い順に最大 k 件を検索
+int search_dna_top_k(DNAVectorDB* db, const DnaPackedCode* query, bool cosine, DNASearchResult* results, int k) {
+    if (!db || !query || !results || k <= 0 || db->size == 0) return 0;
+    
+    TopKItem stack_items[DNA_RERANK_CANDIDATES];
+    TopKItem* items = k <= DNA_RERANK_CANDIDATES ? stack_items : (TopKItem*)malloc(sizeof(TopKItem) * k);
+    if (!items) {
+        fprintf(stderr, "メモリ割り当てエラー: 検索結果の領域を確保できませんでした\n");
+        return 0;
     }
     
-    return nearest_id;
+    TopKSelector selector;
+    top_k_init(&selector, items, k);
+    int count = search_dna_candidates(db, query, cosine, &selector);
+    for (int i = 0; i < count; i++) {
+        results[i].id = items[i].id;
+        results[i].score = cosine ? items[i].score : sqrtf(fmaxf(-items[i].score, 0.0f));
+    }
+    
+    if (items != stack_items) {
+        free(items);
+    }
+    return count;
 }
 
+// 最も近いDNAコードのIDを検索
+int search_nearest_dna_packed(DNAVectorDB* db, const DnaPackedCode* query, bool cosine) {
+    DNASearchResult result;
+    return search_dna_top_k(db, query, cosine, &result, 1) > 0 ? result.id : -1;
+}
+
+// 文字列のクエリを詰めて検索
+static int search_nearest_dna(DNAVectorDB* db, const char* query_dna_code, bool cosine) {
+    if (!query_dna_code) return -1;
+    
+    DnaPackedCode query;
+    if (!dna_code_pack(query_dna_code, &query)) {
+        fprintf(stderr, "DNAコードのIDが大きすぎます: %s\n", query_dna_code);
+        return -1;
+    }
+    return search_nearest_dna_packed(db, &query, cosine);
+}
+
+// 最も近いDNAコードを検索（ユークリッド距離）
+int search_nearest_dna_euclidean(DNAVectorDB* db, const char* query_dna_code) {
+    return search_nearest_dna(db, query_dna_code, false);
+}
+
+// 最も近いDNAコードを検索（コサイン類似度）
+int search_nearest_dna_cosine(DNAVectorDB* db, const char* query_dna_code) {
+    return search_nearest_dna(db, query_dna_code, true);
+}
+
+// 旧形式の保存ファイルのエントリ
+typedef struct {
+    char dna_code[DNA_CODE_MAX_LEN];
+    float vector[64];
+    int id;
+} DNAVectorLegacyEntry;
+
 // DNAベクトルデータベースをファイルから読み込む
 int load_dna_vector_db(DNAVectorDB* db, const char* filename) {
     if (!db || !filename) return 0;
@@ -209,12 +627,21 @@ int load_dna_vector_db(DNAVectorDB* db, const char* filename) {
     FILE* fp = fopen(filename, "rb");
     if (!fp) return 0;
     
-    // データベースを初期化
+    // 前に読み込んだ分の符号と転置リストを解放してから初期化する
+    free_dna_vector_db(db);
     init_dna_vector_db(db);
     
-    // エントリ数を読み込む
+    // 先頭が印でなければ旧形式（先頭の4バイトがエントリ数）
+    char header[4];
     int size;
-    if (fread(&size, sizeof(int), 1, fp) != 1) {
+    if (fread(header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        return 0;
+    }
+    bool legacy = memcmp(header, DNA_VECTOR_DB_MAGIC, sizeof(header)) != 0;
+    if (legacy) {
+        memcpy(&size, header, sizeof(size));
+    } else if (fread(&size, sizeof(int), 1, fp) != 1) {
         fclose(fp);
         return 0;
     }
@@ -222,12 +649,40 @@ int load_dna_vector_db(DNAVectorDB* db, const char* filename) {
     // 各エントリを読み込む
     for (int i = 0; i < size && i < MAX_DNA_VECTORS; i++) {
         DNAVectorEntry entry;
-        if (fread(&entry, sizeof(DNAVectorEntry), 1, fp) != 1) {
+        if (legacy) {
+            DNAVectorLegacyEntry old_entry;
+            if (fread(&old_entry, sizeof(DNAVectorLegacyEntry), 1, fp) != 1) {
+                fclose(fp);
+                return i;
+            }
+            old_entry.dna_code[DNA_CODE_MAX_LEN - 1] = '\0';
+            if (!dna_code_pack(old_entry.dna_code, &entry.code)) {
+                fprintf(stderr, "DNAコードのIDが大きすぎるため一部の要素を除きました: %s\n", old_entry.dna_code);
+            }
+            memcpy(entry.vector, old_entry.vector, sizeof(entry.vector));
+            entry.id = old_entry.id;
+        } else if (fread(&entry, sizeof(DNAVectorEntry), 1, fp) != 1) {
             fclose(fp);
             return i;
         }
         db->entries[i] = entry;
         db->size++;
+        
+        if (db->normalized && !vector_is_unit(entry.vector, 64)) {
+            db->normalized = false;
+        }
+    }
+    
+    // エントリの後に int8 符号があれば量子化した状態で読み込む
+    char magic[4];
+    if (db->size > 0 && fread(magic, sizeof(magic), 1, fp) == 1 &&
+        memcmp(magic, DNA_QUANTIZED_MAGIC, sizeof(magic)) == 0 && reserve_dna_codes(db, db->size)) {
+        if (fread(db->codes, 64, db->size, fp) == (size_t)db->size &&
+            fread(db->code_scales, sizeof(float), db->size, fp) == (size_t)db->size) {
+            db->quantized = true;
+        } else {
+            free_dna_vector_db(db);
+        }
     }
     
     fclose(fp);
@@ -241,15 +696,24 @@ int save_dna_vector_db(DNAVectorDB* db, const char* filename) {
     FILE* fp = fopen(filename, "wb");
     if (!fp) return 0;
     
-    // エントリ数を書き込む
-    if (fwrite(&db->size, sizeof(int), 1, fp) != 1) {
+    // 印とエントリ数を書き込む
+    if (fwrite(DNA_VECTOR_DB_MAGIC, 4, 1, fp) != 1 ||
+        fwrite(&db->size, sizeof(int), 1, fp) != 1) {
         fclose(fp);
         return 0;
     }
     
-    // 各エントリを書き込む
-    for (int i = 0; i < db->size; i++) {
-        if (fwrite(&db->entries[i], sizeof(DNAVectorEntry), 1, fp) != 1) {
+    // エントリはDNAコードが固定長なのでまとめて書き込む
+    if (db->size > 0 && fwrite(db->entries, sizeof(DNAVectorEntry), db->size, fp) != (size_t)db->size) {
+        fclose(fp);
+        return 0;
+    }
+    
+    // 量子化していれば int8 符号と復元係数を続ける
+    if (db->quantized && db->size > 0) {
+        if (fwrite(DNA_QUANTIZED_MAGIC, 4, 1, fp) != 1 ||
+            fwrite(db->codes, 64, db->size, fp) != (size_t)db->size ||
+            fwrite(db->code_scales, sizeof(float), db->size, fp) != (size_t)db->size) {
             fclose(fp);
             return 0;
         }
@@ -263,28 +727,42 @@ int save_dna_vector_db(DNAVectorDB* db, const char* filename) {
 float calculate_dna_similarity(const char* dna_code1, const char* dna_code2) {
     if (!dna_code1 || !dna_code2) return 0.0f;
     
-    // DNAコードをベクトル化
-    float vector1[64];
-    float vector2[64];
-    generate_dna_vector(dna_code1, vector1);
-    generate_dna_vector(dna_code2, vector2);
+    DnaPackedCode code1;
+    DnaPackedCode code2;
+    dna_code_pack(dna_code1, &code1);
+    dna_code_pack(dna_code2, &code2);
+    return calculate_dna_similarity_packed(&code1, &code2);
+}
+
+// 詰めたDNAコードの類似度を計算
+// 要素ごとのブロックは他の要素と次元が重ならないので、内積には両方にある要素だけが効く
+float calculate_dna_similarity_packed(const DnaPackedCode* code1, const DnaPackedCode* code2) {
+    if (!code1 || !code2) return 0.0f;
+    
+    unsigned int shared = 0;
+    dna_code_compare(code1, code2, &shared, NULL);
+    if (shared == 0) return 0.0f;
     
-    // コサイン類似度を計算
+    unsigned int mask1 = dna_code_mask(code1);
+    unsigned int mask2 = dna_code_mask(code2);
     float dot_product = 0.0f;
     float norm1 = 0.0f;
     float norm2 = 0.0f;
-    
-    for (int i = 0; i < 64; i++) {
-        dot_product += vector1[i] * vector2[i];
-        norm1 += vector1[i] * vector1[i];
-        norm2 += vector2[i] * vector2[i];
+    for (int slot = 0; slot < DNA_PACKED_SLOT_COUNT; slot++) {
+        unsigned int bit = 1u << slot;
+        if (!((mask1 | mask2) & bit)) continue;
+        
+        float block1[8] = {0};
+        float block2[8] = {0};
+        if (mask1 & bit) generate_dna_block(dna_code_id(code1, slot), block1);
+        if (mask2 & bit) generate_dna_block(dna_code_id(code2, slot), block2);
+        norm1 += vector_norm_squared(block1, 8);
+        norm2 += vector_norm_squared(block2, 8);
+        if (shared & bit) dot_product += vector_dot(block1, block2, 8);
     }
     
-    norm1 = sqrt(norm1);
-    norm2 = sqrt(norm2);
-    
     if (norm1 > 0.0f && norm2 > 0.0f) {
-        return dot_product / (norm1 * norm2);
+        return dot_product / (sqrtf(norm1) * sqrtf(norm2));
     }
     
     return 0.0f;
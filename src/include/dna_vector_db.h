@@ -5,34 +5,86 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "dna_packed_code.h"
 
 #define MAX_DNA_VECTORS 100000   // 最大DNAベクトル数
-#define DNA_CODE_MAX_LEN 128     // DNAコードの最大長
+#define DNA_CODE_MAX_LEN 128     // 旧形式の保存ファイルでのDNAコードの長さ
+#define DNA_RERANK_CANDIDATES 32 // int8 で走査するとき、float で計算し直す候補数
+#define DNA_POSTING_BOUND_SLACK 1e-5f  // 転置リストの検索を打ち切るとき、上限に足す丸め誤差の余裕
+#define DNA_POSTING_SCAN_RATIO 64      // 転置リストでたどったエントリが全体のこの分の1を超えたら、詰めた表を全件順に調べる
+#define DNA_QUANTIZED_MAGIC "DNAQ"  // 保存ファイルでエントリの後に int8 符号が続く印
+#define DNA_VECTOR_DB_MAGIC "DNAV"  // 保存ファイルの先頭（ない場合はDNAコードを文字列で持つ旧形式）
 
 // DNAベクトルエントリの構造体
 typedef struct {
-    char dna_code[DNA_CODE_MAX_LEN];  // DNAコード (例: E0C5R1A7L2M3)
+    DnaPackedCode code;               // DNAコード（16バイト、文字列とは dna_code_pack / dna_code_format で変換）
     float vector[64];                 // 64次元ベクトル表現
     int id;                           // エントリのID
 } DNAVectorEntry;
 
+// 転置リストの検索で読むエントリの情報（エントリ番号の順に詰めて並べる）
+typedef struct {
+    uint16_t ids[DNA_PACKED_SLOT_COUNT];      // 要素ごとの ID + 1（要素がなければ 0）
+    float inverse_norm;                       // 正規化前のベクトルのノルムの逆数
+} DNAIndexedCode;
+
+// 要素のIDごとの転置リスト（エントリ番号の昇順）
+typedef struct {
+    int* entries;
+    int count;
+    int capacity;
+} DNASlotPosting;
+
 // DNAベクトルデータベース
 typedef struct {
     DNAVectorEntry entries[MAX_DNA_VECTORS];  // DNAベクトルエントリの配列
     int size;                                 // 現在のエントリ数
+    bool normalized;                          // 全エントリが単位ベクトルか（コサイン類似度を内積で計算できる）
+    bool quantized;                           // int8 符号で候補を絞ってから float で計算し直す
+    int8_t* codes;                            // エントリごとの int8 符号（64バイト、quantized のとき）
+    float* code_scales;                       // エントリごとの復元係数
+    int code_capacity;
+    bool indexed;                             // 要素のIDの転置リストで候補を集める
+    DNASlotPosting* postings[DNA_PACKED_SLOT_COUNT];  // 要素ごと、IDで引く転置リスト（indexed のとき）
+    int posting_counts[DNA_PACKED_SLOT_COUNT];        // 要素ごとに確保したIDの数
+    DNAIndexedCode* indexed_codes;            // エントリのDNAコードを詰めて並べたもの（indexed のとき）
+    int indexed_capacity;
 } DNAVectorDB;
 
+// 検索結果
+typedef struct {
+    int id;                                   // エントリのID
+    float score;                              // コサイン類似度、またはユークリッド距離
+} DNASearchResult;
+
 // DNAベクトルデータベースの初期化
 void init_dna_vector_db(DNAVectorDB* db);
 
+// DNAベクトルデータベースの int8 符号と転置リストを解放（エントリはそのまま）
+void free_dna_vector_db(DNAVectorDB* db);
+
+// int8 符号での検索を切り替える（有効にすると既存のエントリも量子化する、失敗時は 0）
+// 走査は連続した符号だけを読み、上位 k + DNA_RERANK_CANDIDATES 件をエントリの float ベクトルで計算し直す
+int set_dna_vector_db_quantized(DNAVectorDB* db, bool quantized);
+
+// 要素のIDの転置リストでの検索を切り替える（有効にすると既存のエントリも索引する、失敗時は 0）
+// 検索はクエリのブロックに近いIDから転置リストをたどり、まだ見ていないエントリの類似度の上限を
+// 上位 k 件目が超えたところで打ち切る。候補は要素とIDごとの内積の表で求め、上位をエントリの float ベクトルで
+// 計算し直すので、結果は全件を調べた場合と同じになる（打ち切れなければ表で全件を順に調べる）
+int set_dna_vector_db_indexed(DNAVectorDB* db, bool indexed);
+
 // DNAベクトルデータベースのサイズを取得
 int get_dna_vector_db_size(DNAVectorDB* db);
 
-// DNAコードをベクトル化してデータベースに追加
+// DNAコードをベクトル化してデータベースに追加（文字列のコードは詰めてから追加する）
 int add_dna_vector(DNAVectorDB* db, const char* dna_code, int id);
+int add_dna_vector_packed(DNAVectorDB* db, const DnaPackedCode* code, int id);
 
 // DNAコードからベクトルを生成
 void generate_dna_vector(const char* dna_code, float* vector);
+void generate_dna_vector_packed(const DnaPackedCode* code, float* vector);
 
 // 最も近いDNAコードを検索（ユークリッド距離）
 int search_nearest_dna_euclidean(DNAVectorDB* db, const char* query_dna_code);
@@ -40,16 +92,25 @@ int search_nearest_dna_euclidean(DNAVectorDB* db, const char* query_dna_code);
 // 最も近いDNAコードを検索（コサイン類似度）
 int search_nearest_dna_cosine(DNAVectorDB* db, const char* query_dna_code);
 
-// DNAベクトルデータベースをファイルから読み込む
+// 最も近いDNAコードを検索（詰めたコードで問い合わせる）
+int search_nearest_dna_packed(DNAVectorDB* db, const DnaPackedCode* query, bool cosine);
+
+// 近い順に最大 k 件を results に入れ、件数を返す（同じスコアなら先に追加したエントリが先）
+// cosine ならコサイン類似度の高い順、そうでなければユークリッド距離の小さい順
+int search_dna_top_k(DNAVectorDB* db, const DnaPackedCode* query, bool cosine, DNASearchResult* results, int k);
+
+// DNAベクトルデータベースをファイルから読み込む（int8 符号が保存されていれば量子化した状態になる）
+// 旧形式のファイルはDNAコードを詰めて読み込む。db は初期化済みであること（前の内容は解放して置き換える）
 int load_dna_vector_db(DNAVectorDB* db, const char* filename);
 
-// DNAベクトルデータベースをファイルに保存
+// DNAベクトルデータベースをファイルに保存（量子化していれば int8 符号も保存する）
 int save_dna_vector_db(DNAVectorDB* db, const char* filename);
 
-// DNAコードの類似度を計算
+// DNAコードの類似度を計算（両方にある要素のブロックだけで内積を求める）
 float calculate_dna_similarity(const char* dna_code1, const char* dna_code2);
+float calculate_dna_similarity_packed(const DnaPackedCode* code1, const DnaPackedCode* code2);
 
-// DNAコードの構造を解析
+// DNAコードの構造を文字列の要素に分ける（ベクトル化や検索では使わない）
 void parse_dna_code(const char* dna_code, char* entity, char* concept, char* result, 
                    char* attribute, char* time, char* location, char* manner, char* quantity);
 
@@ -1,179 +1,310 @@
 #include "enhanced_dna_compressor.h"
+#include <stddef.h>
 
 // 拡張DNA辞書の初期化
 void init_enhanced_dna_dictionary(EnhancedDNADictionary *dict) {
+    dict->entries = NULL;
     dict->count = 0;
-    dict->capacity = MAX_DICT_ENTRIES;
-    memset(dict->entries, 0, sizeof(EnhancedDNAEntry) * MAX_DICT_ENTRIES);
+    dict->capacity = 0;
+    dna_code_table_init(&dict->table, sizeof(EnhancedDNAEntry), offsetof(EnhancedDNAEntry, code),
+                        offsetof(EnhancedDNAEntry, word), (long)offsetof(EnhancedDNAEntry, type));
 }
 
-// 単語からDNAコードを取得（なければ新規作成）
-const char* get_enhanced_dna_code(EnhancedDNADictionary *dict, const char *word, EnhancedDNAType type) {
+// 拡張DNA辞書の解放
+void free_enhanced_dna_dictionary(EnhancedDNADictionary *dict) {
+    if (!dict) return;
+    
+    free(dict->entries);
+    dna_code_table_free(&dict->table);
+    init_enhanced_dna_dictionary(dict);
+}
+
+// エントリを1つ追加できるようにする
+static int reserve_enhanced_dna_entry(EnhancedDNADictionary *dict) {
+    if (dict->count < dict->capacity) return 1;
+    
+    int capacity = dict->capacity > 0 ? dict->capacity * 2 : ENHANCED_DNA_INITIAL_ENTRIES;
+    EnhancedDNAEntry *entries = (EnhancedDNAEntry *)realloc(dict->entries, sizeof(EnhancedDNAEntry) * capacity);
+    if (!entries) {
+        fprintf(stderr, "メモリ割り当てエラー: 拡張DNA辞書の拡張に失敗しました\n");
+        return 0;
+    }
+    
+    memset(entries + dict->capacity, 0, sizeof(EnhancedDNAEntry) * (capacity - dict->capacity));
+    dict->entries = entries;
+    dict->capacity = capacity;
+    return 1;
+}
+
+// タイプのコードの文字
+char enhanced_dna_type_char(EnhancedDNAType type) {
+    switch (type) {
+        case ENTITY:    return 'E';
+        case CONCEPT:   return 'C';
+        case RESULT:    return 'R';
+        case ATTRIBUTE: return 'A';
+        case TIME:      return 'T';
+        case LOCATION:  return 'L';
+        case MANNER:    return 'M';
+        case QUANTITY:  return 'Q';
+        default:        return '\0';
+    }
+}
+
+// 単語のエントリを取得（なければ新規作成）
+const EnhancedDNAEntry* get_enhanced_dna_entry(EnhancedDNADictionary *dict, const char *word, EnhancedDNAType type) {
     if (!word || !dict) return NULL;
     
     // 既存のエントリを検索
-    for (int i = 0; i < dict->count; i++) {
-        if (dict->entries[i].type == type && strcmp(dict->entries[i].word, word) == 0) {
-            return dict->entries[i].code;
-        }
+    int found = dna_code_table_find_word(&dict->table, dict->entries, type, word);
+    if (found >= 0) {
+        return &dict->entries[found];
     }
     
-    // 新しいエントリを作成
-    if (dict->count < dict->capacity) {
-        EnhancedDNAEntry *entry = &dict->entries[dict->count];
-        strncpy(entry->word, word, MAX_WORD_LEN - 1);
-        entry->word[MAX_WORD_LEN - 1] = '\0';
-        entry->type = type;
-        
-        // タイプごとのIDカウントを取得
-        int type_count = 0;
-        for (int i = 0; i < dict->count; i++) {
-            if (dict->entries[i].type == type) {
-                type_count++;
-            }
-        }
-        entry->id = type_count;
-        
-        // DNAコードを生成
-        char type_char;
-        switch (type) {
-            case ENTITY:    type_char = 'E'; break;
-            case CONCEPT:   type_char = 'C'; break;
-            case RESULT:    type_char = 'R'; break;
-            case ATTRIBUTE: type_char = 'A'; break;
-            case TIME:      type_char = 'T'; break;
-            case LOCATION:  type_char = 'L'; break;
-            case MANNER:    type_char = 'M'; break;
-            case QUANTITY:  type_char = 'Q'; break;
-            default:
-                fprintf(stderr, "無効な拡張DNAタイプ: %d\n", type);
-                return NULL;
-        }
-        
-        snprintf(entry->code, MAX_DNA_CODE_LEN, "%c%d", type_char, entry->id);
-        dict->count++;
-        
-        return entry->code;
+    char type_char = enhanced_dna_type_char(type);
+    if (!type_char) {
+        fprintf(stderr, "無効な拡張DNAタイプ: %d\n", type);
+        return NULL;
     }
     
-    return NULL;
+    // 新しいエントリを作成
+    if (!reserve_enhanced_dna_entry(dict)) return NULL;
+    
+    EnhancedDNAEntry *entry = &dict->entries[dict->count];
+    strncpy(entry->word, word, MAX_WORD_LEN - 1);
+    entry->word[MAX_WORD_LEN - 1] = '\0';
+    entry->type = type;
+    
+    // タイプごとのIDは索引で数える
+    entry->id = dna_code_table_next_id(&dict->table, type_char);
+    
+    // DNAコードを生成
+    snprintf(entry->code, MAX_DNA_CODE_LEN, "%c%d", type_char, entry->id);
+    
+    if (!dna_code_table_add(&dict->table, dict->entries, dict->count)) return NULL;
+    dict->count++;
+    
+    return entry;
+}
+
+// 単語からDNAコードを取得（なければ新規作成）
+const char* get_enhanced_dna_code(EnhancedDNADictionary *dict, const char *word, EnhancedDNAType type) {
+    const EnhancedDNAEntry *entry = get_enhanced_dna_entry(dict, word, type);
+    return entry ? entry->code : NULL;
 }
 
 // DNAコードから単語を取得
 const char* get_word_from_enhanced_dna(EnhancedDNADictionary *dict, const char *code) {
-    if (!code || !dict || strlen(code) < 3) return NULL;
+    if (!code || !dict || strlen(code) < 2) return NULL;
     
-    for (int i = 0; i < dict->count; i++) {
-        if (strcmp(dict->entries[i].code, code) == 0) {
-            return dict->entries[i].word;
+    int index = dna_code_table_find_code(&dict->table, dict->entries, code);
+    return index >= 0 ? dict->entries[index].word : NULL;
+}
+
+// 素性（カンマ区切り）の index 番目のフィールド
+static const char* enhanced_dna_feature_field(const char *feature, int index, size_t *length) {
+    const char *start = feature;
+    for (int i = 0; i < index; i++) {
+        start = strchr(start, ',');
+        if (!start) {
+            *length = 0;
+            return NULL;
         }
+        start++;
+    }
+    
+    const char *end = strchr(start, ',');
+    *length = end ? (size_t)(end - start) : strlen(start);
+    return start;
+}
+
+// 素性の index 番目のフィールドが value と一致するか
+static int enhanced_dna_feature_is(const char *feature, int index, const char *value) {
+    size_t length;
+    const char *field = enhanced_dna_feature_field(feature, index, &length);
+    return field && length == strlen(value) && memcmp(field, value, length) == 0;
+}
+
+// text の先頭 length バイトに needle が含まれるか
+static int enhanced_dna_contains(const char *text, size_t length, const char *needle) {
+    size_t needle_length = strlen(needle);
+    for (size_t i = 0; i + needle_length <= length; i++) {
+        if (memcmp(text + i, needle, needle_length) == 0) return 1;
+    }
+    return 0;
+}
+
+// 空いているタイプに語を入れる（長すぎる語は辞書に入らないので使わない）
+static void enhanced_dna_set_slot(EnhancedDNASlots *slots, EnhancedDNAType type, const char *word, size_t length) {
+    if (slots->lengths[type] == 0 && length > 0 && length < MAX_WORD_LEN) {
+        slots->words[type] = word;
+        slots->lengths[type] = length;
     }
+}
+
+// 形態素解析の結果から要素を取り出す（scripts/enhanced_dna.sh と同じ規則）
+// 主語と目的語は1番目と2番目の名詞、動詞と属性は原形、ほかは表層形を使う
+void extract_enhanced_dna_slots(const mecab_node_t *node, EnhancedDNASlots *slots) {
+    memset(slots, 0, sizeof(*slots));
     
-    return NULL;
+    int noun_count = 0;
+    for (; node; node = node->next) {
+        if (node->stat == MECAB_BOS_NODE || node->stat == MECAB_EOS_NODE || !node->feature) continue;
+        
+        const char *surface = node->surface;
+        size_t length = node->length;
+        if (length == 0 || surface[0] == ' ' || surface[0] == '\t' || surface[0] == '\n' || surface[0] == '\r') continue;
+        
+        const char *feature = node->feature;
+        
+        // 原形（不明な場合は表層形）
+        size_t base_length;
+        const char *base = enhanced_dna_feature_field(feature, 6, &base_length);
+        if (!base || base_length == 0 || (base_length == 1 && base[0] == '*')) {
+            base = surface;
+            base_length = length;
+        }
+        
+        if (enhanced_dna_feature_is(feature, 0, "名詞")) {
+            if (noun_count == 0) {
+                enhanced_dna_set_slot(slots, ENTITY, surface, length);
+            } else if (noun_count == 1) {
+                enhanced_dna_set_slot(slots, RESULT, surface, length);
+            }
+            noun_count++;
+            
+            int adverbial = enhanced_dna_feature_is(feature, 1, "副詞可能");
+            if (adverbial || enhanced_dna_feature_is(feature, 1, "時相名詞")) {
+                enhanced_dna_set_slot(slots, TIME, surface, length);
+            }
+            if ((enhanced_dna_feature_is(feature, 1, "代名詞") && enhanced_dna_feature_is(feature, 2, "一般")) ||
+                (enhanced_dna_feature_is(feature, 1, "固有名詞") && enhanced_dna_feature_is(feature, 2, "地域"))) {
+                enhanced_dna_set_slot(slots, LOCATION, surface, length);
+            }
+            if (enhanced_dna_feature_is(feature, 1, "数") || adverbial) {
+                int numeric = enhanced_dna_contains(surface, length, "数") || enhanced_dna_contains(surface, length, "何");
+                for (size_t i = 0; i < length && !numeric; i++) {
+                    numeric = surface[i] >= '0' && surface[i] <= '9';
+                }
+                if (numeric) {
+                    enhanced_dna_set_slot(slots, QUANTITY, surface, length);
+                }
+            }
+        } else if (enhanced_dna_feature_is(feature, 0, "動詞")) {
+            enhanced_dna_set_slot(slots, CONCEPT, base, base_length);
+        } else if (enhanced_dna_feature_is(feature, 0, "形容詞")) {
+            enhanced_dna_set_slot(slots, ATTRIBUTE, base, base_length);
+        } else if (enhanced_dna_feature_is(feature, 0, "副詞")) {
+            enhanced_dna_set_slot(slots, MANNER, surface, length);
+        }
+    }
 }
 
-// 文を拡張DNA形式に圧縮
+// 文字列を追記する（size に収まる分だけ書き、position は切り詰めずに進める）
+static void enhanced_dna_append(char *text, size_t size, size_t *position, const char *string) {
+    size_t length = strlen(string);
+    if (*position < size) {
+        size_t available = size - *position - 1;
+        size_t copy = length < available ? length : available;
+        memcpy(text + *position, string, copy);
+        text[*position + copy] = '\0';
+    }
+    *position += length;
+}
+
+// 文を形態素解析して拡張DNA形式に圧縮
 char* compress_to_enhanced_dna(EnhancedDNADictionary *dict, const char *text) {
     if (!text || !dict) return NULL;
     
-    // 実際の実装では形態素解析を使用して文を解析し、
-    // 主語、動詞、目的語、属性などを抽出する必要があります
+    MecabSession *session = mecab_tagger_default_session();
+    const mecab_node_t *node = mecab_session_parse(session, text);
+    if (!node) return NULL;
     
-    // ここでは簡易的な実装として、最初の名詞を主語、最初の動詞を動詞、
-    // 2番目の名詞を目的語として扱います
+    EnhancedDNASlots slots;
+    extract_enhanced_dna_slots(node, &slots);
     
-    static char dna_code[MAX_DNA_CODE_LEN * 8]; // 最大8つの要素を想定
+    size_t dna_size = MAX_DNA_CODE_LEN * ENHANCED_DNA_TYPE_COUNT;
+    char *dna_code = (char *)malloc(dna_size);
+    if (!dna_code) {
+        fprintf(stderr, "メモリ割り当てエラー: 拡張DNAコードを確保できませんでした\n");
+        return NULL;
+    }
     dna_code[0] = '\0';
+    size_t position = 0;
     
-    // 実際の実装ではここで形態素解析を行う
-    // この例では簡易的に固定値を返す
-    const char *entity = "GeneLLM";
-    const char *concept = "実装する";
-    const char *result = "知識ベース";
-    const char *attribute = "高速";
-    const char *time = "今日";
-    const char *location = "メモリ上";
-    const char *manner = "効率的に";
-    const char *quantity = "多数";
-    
-    // 各要素のDNAコードを取得して結合
-    const char *e_code = get_enhanced_dna_code(dict, entity, ENTITY);
-    const char *c_code = get_enhanced_dna_code(dict, concept, CONCEPT);
-    const char *r_code = get_enhanced_dna_code(dict, result, RESULT);
-    const char *a_code = get_enhanced_dna_code(dict, attribute, ATTRIBUTE);
-    const char *t_code = get_enhanced_dna_code(dict, time, TIME);
-    const char *l_code = get_enhanced_dna_code(dict, location, LOCATION);
-    const char *m_code = get_enhanced_dna_code(dict, manner, MANNER);
-    const char *q_code = get_enhanced_dna_code(dict, quantity, QUANTITY);
-    
-    if (e_code) strcat(dna_code, e_code);
-    if (c_code) strcat(dna_code, c_code);
-    if (r_code) strcat(dna_code, r_code);
-    if (a_code) strcat(dna_code, a_code);
-    if (t_code) strcat(dna_code, t_code);
-    if (l_code) strcat(dna_code, l_code);
-    if (m_code) strcat(dna_code, m_code);
-    if (q_code) strcat(dna_code, q_code);
+    // 要素をタイプの順（E, C, R, A, T, L, M, Q）に並べる
+    for (int type = 0; type < ENHANCED_DNA_TYPE_COUNT; type++) {
+        if (slots.lengths[type] == 0) continue;
+        
+        char word[MAX_WORD_LEN];
+        memcpy(word, slots.words[type], slots.lengths[type]);
+        word[slots.lengths[type]] = '\0';
+        
+        const char *code = get_enhanced_dna_code(dict, word, (EnhancedDNAType)type);
+        if (code) enhanced_dna_append(dna_code, dna_size, &position, code);
+    }
     
     return dna_code;
 }
 
-// 拡張DNA形式から文を再構築
-char* decompress_from_enhanced_dna(EnhancedDNADictionary *dict, const char *dna_code) {
-    if (!dna_code || !dict) return NULL;
-    
-    static char text[1024];
-    text[0] = '\0';
+// コードの種類に応じて単語の後ろに付ける助詞や接続詞
+static const char* enhanced_dna_particle(char type) {
+    switch (type) {
+        case 'E': return "は";  // 主語
+        case 'R': return "を";  // 目的語
+        case 'A': return "な";  // 属性
+        case 'T': return "に";  // 時間
+        case 'L': return "で";  // 場所
+        case 'M': return "に";  // 様態
+        case 'Q': return "の";  // 数量
+        default: return "";     // 動詞など
+    }
+}
+
+// 拡張DNA形式の文を text に書く（size に収まる分だけ書き、必要な長さを返す）
+static size_t enhanced_dna_render(EnhancedDNADictionary *dict, const char *dna_code, char *text, size_t size) {
+    size_t position = 0;
+    if (size > 0) {
+        text[0] = '\0';
+    }
     
-    int i = 0;
-    while (i < strlen(dna_code)) {
-        char code[4] = {0}; // 3文字のコード + NULL終端
-        strncpy(code, dna_code + i, 3);
-        code[3] = '\0';
-        i += 3;
+    size_t i = 0;
+    size_t length = strlen(dna_code);
+    while (i < length) {
+        // コードはタイプの文字と10進数のID（E0, C12 など）
+        char code[MAX_DNA_CODE_LEN];
+        size_t code_length = 1;
+        while (i + code_length < length && dna_code[i + code_length] >= '0' && dna_code[i + code_length] <= '9' &&
+               code_length < MAX_DNA_CODE_LEN - 1) {
+            code_length++;
+        }
+        memcpy(code, dna_code + i, code_length);
+        code[code_length] = '\0';
+        i += code_length;
         
         const char *word = get_word_from_enhanced_dna(dict, code);
         if (!word) continue;
         
-        // コードの種類に応じて適切な助詞や接続詞を追加
-        switch (code[0]) {
-            case 'E': // 主語
-                strcat(text, word);
-                strcat(text, "は");
-                break;
-            case 'C': // 動詞
-                strcat(text, word);
-                break;
-            case 'R': // 目的語
-                strcat(text, word);
-                strcat(text, "を");
-                break;
-            case 'A': // 属性
-                strcat(text, word);
-                strcat(text, "な");
-                break;
-            case 'T': // 時間
-                strcat(text, word);
-                strcat(text, "に");
-                break;
-            case 'L': // 場所
-                strcat(text, word);
-                strcat(text, "で");
-                break;
-            case 'M': // 様態
-                strcat(text, word);
-                strcat(text, "に");
-                break;
-            case 'Q': // 数量
-                strcat(text, word);
-                strcat(text, "の");
-                break;
-            default:
-                strcat(text, word);
-                break;
-        }
+        enhanced_dna_append(text, size, &position, word);
+        enhanced_dna_append(text, size, &position, enhanced_dna_particle(code[0]));
     }
     
+    return position;
+}
+
+// 拡張DNA形式から文を再構築
+char* decompress_from_enhanced_dna(EnhancedDNADictionary *dict, const char *dna_code) {
+    if (!dna_code || !dict) return NULL;
+    
+    // 長さを求めてから、ちょうどの大きさで確保して書く
+    size_t length = enhanced_dna_render(dict, dna_code, NULL, 0);
+    char *text = (char *)malloc(length + 1);
+    if (!text) {
+        fprintf(stderr, "メモリ割り当てエラー: 再構築した文を確保できませんでした\n");
+        return NULL;
+    }
+    enhanced_dna_render(dict, dna_code, text, length + 1);
+    
     return text;
 }
 
@@ -199,7 +330,7 @@ int load_enhanced_dna_dictionary(EnhancedDNADictionary *dict, const char *filena
     FILE *fp = fopen(filename, "r");
     if (!fp) return 0;
     
-    init_enhanced_dna_dictionary(dict);
+    free_enhanced_dna_dictionary(dict);
     
     char line[MAX_WORD_LEN + MAX_DNA_CODE_LEN + 2]; // コード + | + 単語 + NULL終端
     while (fgets(line, sizeof(line), fp)) {
@@ -214,7 +345,7 @@ int load_enhanced_dna_dictionary(EnhancedDNADictionary *dict, const char *filena
         char *code = line;
         char *word = separator + 1;
         
-        if (strlen(code) < 3) continue;
+        if (strlen(code) < 2) continue;
         
         // タイプとIDを解析
         EnhancedDNAType type;
@@ -233,16 +364,21 @@ int load_enhanced_dna_dictionary(EnhancedDNADictionary *dict, const char *filena
         int id = atoi(code + 1);
         
         // 辞書に追加
-        if (dict->count < dict->capacity) {
-            EnhancedDNAEntry *entry = &dict->entries[dict->count];
-            strncpy(entry->code, code, MAX_DNA_CODE_LEN - 1);
-            entry->code[MAX_DNA_CODE_LEN - 1] = '\0';
-            strncpy(entry->word, word, MAX_WORD_LEN - 1);
-            entry->word[MAX_WORD_LEN - 1] = '\0';
-            entry->type = type;
-            entry->id = id;
-            dict->count++;
-        }
+        if (!reserve_enhanced_dna_entry(dict)) break;
+        
+        EnhancedDNAEntry *entry = &dict->entries[dict->count];
+        strncpy(entry->code, code, MAX_DNA_CODE_LEN - 1);
+        entry->code[MAX_DNA_CODE_LEN - 1] = '\0';
+        strncpy(entry->word, word, MAX_WORD_LEN - 1);
+        entry->word[MAX_WORD_LEN - 1] = '\0';
+        entry->type = type;
+        entry->id = id;
+        
+        if (!dna_code_table_add(&dict->table, dict->entries, dict->count)) break;
+        dict->count++;
+        
+        // 以後のIDは読み込んだIDの後から払い出す
+        dna_code_table_reserve_id(&dict->table, code[0], id);
     }
     
     fclose(fp);
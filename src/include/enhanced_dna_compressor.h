@@ -4,10 +4,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "dna_code_table.h"
+#include "mecab_tagger.h"
 
 #define MAX_WORD_LEN 128
 #define MAX_DNA_CODE_LEN 32
-#define MAX_DICT_ENTRIES 1000
+#define ENHANCED_DNA_INITIAL_ENTRIES 64
 
 // 拡張DNAタイプの定義
 typedef enum {
@@ -21,6 +23,8 @@ typedef enum {
     QUANTITY    // Q: 数量表現
 } EnhancedDNAType;
 
+#define ENHANCED_DNA_TYPE_COUNT 8
+
 // 拡張DNA辞書エントリの構造体
 typedef struct {
     char code[MAX_DNA_CODE_LEN];
@@ -31,30 +35,50 @@ typedef struct {
 
 // 拡張DNA辞書の構造体
 typedef struct {
-    EnhancedDNAEntry entries[MAX_DICT_ENTRIES];
+    EnhancedDNAEntry *entries;  // 必要に応じて2倍に広げる
     int count;
     int capacity;
+    DnaCodeTable table;         // 単語とコードの索引（タイプごとのIDもここで数える）
 } EnhancedDNADictionary;
 
+// 1文から取り出した要素（タイプごとに1語、なければ長さ 0）
+// words は解析結果のノードを指すので、次の解析までに使う
+typedef struct {
+    const char *words[ENHANCED_DNA_TYPE_COUNT];
+    size_t lengths[ENHANCED_DNA_TYPE_COUNT];
+} EnhancedDNASlots;
+
 // 拡張DNA辞書の初期化
 void init_enhanced_dna_dictionary(EnhancedDNADictionary *dict);
 
+// 拡張DNA辞書の解放（init し直せば再び使える）
+void free_enhanced_dna_dictionary(EnhancedDNADictionary *dict);
+
+// 単語のエントリを取得（なければ新規作成）
+const EnhancedDNAEntry* get_enhanced_dna_entry(EnhancedDNADictionary *dict, const char *word, EnhancedDNAType type);
+
 // 単語からDNAコードを取得（なければ新規作成）
 const char* get_enhanced_dna_code(EnhancedDNADictionary *dict, const char *word, EnhancedDNAType type);
 
 // DNAコードから単語を取得
 const char* get_word_from_enhanced_dna(EnhancedDNADictionary *dict, const char *code);
 
-// 文を拡張DNA形式に圧縮
+// タイプのコードの文字（'E', 'C' など、無効なら '\0'）
+char enhanced_dna_type_char(EnhancedDNAType type);
+
+// 形態素解析の結果から主語・動詞・目的語・属性・時間・場所・様態・数量を取り出す
+void extract_enhanced_dna_slots(const mecab_node_t *node, EnhancedDNASlots *slots);
+
+// 文を形態素解析して拡張DNA形式に圧縮（戻り値は呼び出し側で free）
 char* compress_to_enhanced_dna(EnhancedDNADictionary *dict, const char *text);
 
-// 拡張DNA形式から文を再構築
+// 拡張DNA形式から文を再構築（戻り値は呼び出し側で free）
 char* decompress_from_enhanced_dna(EnhancedDNADictionary *dict, const char *dna_code);
 
 // 拡張DNA辞書をファイルに保存
 int save_enhanced_dna_dictionary(EnhancedDNADictionary *dict, const char *filename);
 
-// ファイルから拡張DNA辞書を読み込む
+// ファイルから拡張DNA辞書を読み込む（dict は初期化済みであること、元の内容は捨てる）
 int load_enhanced_dna_dictionary(EnhancedDNADictionary *dict, const char *filename);
 
 // 拡張DNA辞書の内容を表示
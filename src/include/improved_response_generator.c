@@ -110,38 +110,29 @@ KnowledgeDocument** search_relevant_knowledge(KnowledgeBase* kb, const char* que
         return NULL;
     }
     
-    // 簡易的なベクトル化（実際の実装ではより高度な方法を使用）
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        query_vector[i] = 0.0f;
-    }
-    
-    for (size_t i = 0; i < strlen(query) && i < VECTOR_DIM; i++) {
-        int idx = i % VECTOR_DIM;
-        query_vector[idx] += (float)query[i] / 255.0f;
-    }
-    
-    // ベクトルを正規化
-    normalize_vector_improved(query_vector);
+    // ドキュメントと同じ文字 n-gram の特徴ハッシュでベクトル化する（単位ベクトルになる）
+    text_to_feature_vector(query, query_vector);
     
     // 最も関連性の高いドキュメントを検索
-    SearchResult search_result = search_nearest_cosine_improved(&kb->vector_db, query_vector, 5);
+    TopKItem results[MAX_RELEVANT_DOCUMENTS];
+    int result_count = search_nearest_cosine_top_k(&kb->vector_db, query_vector, MAX_RELEVANT_DOCUMENTS, results);
     free(query_vector);
     
-    if (search_result.count == 0) {
+    if (result_count == 0) {
         *count = 0;
         return NULL;
     }
     
     // 検索結果からドキュメントを取得
-    KnowledgeDocument** documents = (KnowledgeDocument**)malloc(sizeof(KnowledgeDocument*) * search_result.count);
+    KnowledgeDocument** documents = (KnowledgeDocument**)malloc(sizeof(KnowledgeDocument*) * result_count);
     if (!documents) {
         *count = 0;
         return NULL;
     }
     
-    *count = search_result.count;
-    for (int i = 0; i < search_result.count; i++) {
-        documents[i] = &kb->documents[search_result.ids[i]];
+    *count = result_count;
+    for (int i = 0; i < result_count; i++) {
+        documents[i] = &kb->documents[results[i].id];
     }
     
     return documents;
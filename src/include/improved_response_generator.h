@@ -5,6 +5,7 @@
 #include "response_evaluator.h"
 
 #define MAX_CANDIDATE_RESPONSES 5
+#define MAX_RELEVANT_DOCUMENTS 5     // 知識ベースから取り出す関連ドキュメント数
 #define MIN_ACCEPTABLE_SCORE 0.6f
 
 // 回答生成オプション
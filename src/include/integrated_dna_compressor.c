@@ -1,8 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include "utf8_verb_conjugator.h"
+#include "dna_code_table.h"
+
+// 辞書ファイルのヘッダー（件数と次のID）
+#define DNA_DICTIONARY_HEADER_FORMAT "%10d %10d %10d %10d\n"
 
 // DNA圧縮用の辞書エントリ
 typedef struct {
@@ -21,6 +26,8 @@ typedef struct {
     int next_concept_id;  // 次の動詞ID
     int next_result_id;   // 次の結果ID
     char filename[256];   // 辞書ファイル名
+    int saved_count;      // ファイルに書き込み済みのエントリ数（追記できるヘッダーの場合）
+    DnaCodeTable table;   // 単語とコードの索引
 } DnaDictionary;
 
 // 辞書の初期化
@@ -43,6 +50,9 @@ DnaDictionary* dna_dictionary_init(int initial_capacity, const char* filename) {
     dict->next_entity_id = 0;
     dict->next_concept_id = 0;
     dict->next_result_id = 0;
+    dict->saved_count = 0;
+    dna_code_table_init(&dict->table, sizeof(DnaEntry), offsetof(DnaEntry, code),
+                        offsetof(DnaEntry, word), offsetof(DnaEntry, type));
     
     // ファイル名を保存
     if (filename) {
@@ -106,6 +116,9 @@ DnaDictionary* dna_dictionary_init(int initial_capacity, const char* filename) {
                 
                 dict->entries[dict->count].type = type;
                 dict->entries[dict->count].used = 1;
+                if (!dna_code_table_add(&dict->table, dict->entries, dict->count)) {
+                    break;
+                }
                 dict->count++;
             }
         }
@@ -121,6 +134,7 @@ void dna_dictionary_free(DnaDictionary* dict) {
         if (dict->entries) {
             free(dict->entries);
         }
+        dna_code_table_free(&dict->table);
         free(dict);
     }
 }
@@ -151,6 +165,9 @@ int dna_dictionary_expand(DnaDictionary* dict) {
 // 辞書をファイルに保存
 int dna_dictionary_save(DnaDictionary* dict);
 
+// 最後に追加したエントリをファイルに保存
+static int dna_dictionary_append(DnaDictionary* dict);
+
 // 単語からDNAコードを取得（なければ新規作成）
 const char* dna_dictionary_get_code(DnaDictionary* dict, const char* word, char type) {
     if (!dict || !word || !*word) {
@@ -166,12 +183,9 @@ const char* dna_dictionary_get_code(DnaDictionary* dict, const char* word, char
     }
     
     // 既存のエントリを検索
-    for (int i = 0; i < dict->count; i++) {
-        if (dict->entries[i].used && 
-            dict->entries[i].type == word_type && 
-            strcmp(dict->entries[i].word, word) == 0) {
-            return dict->entries[i].code;
-        }
+    int found = dna_code_table_find_word(&dict->table, dict->entries, word_type, word);
+    if (found >= 0) {
+        return dict->entries[found].code;
     }
     
     // 新しいエントリを作成
@@ -208,10 +222,16 @@ const char* dna_dictionary_get_code(DnaDictionary* dict, const char* word, char
     dict->entries[dict->count].type = word_type;
     dict->entries[dict->count].used = 1;
     
-    // 辞書をファイルに自動保存
-    dna_dictionary_save(dict);
+    if (!dna_code_table_add(&dict->table, dict->entries, dict->count)) {
+        dict->entries[dict->count].used = 0;
+        return NULL;
+    }
+    dict->count++;
+    
+    // 辞書をファイルに自動保存（追加したエントリだけを追記する）
+    dna_dictionary_append(dict);
     
-    return dict->entries[dict->count++].code;
+    return dict->entries[dict->count - 1].code;
 }
 
 // DNAコードから単語を取得
@@ -220,13 +240,8 @@ const char* dna_dictionary_get_word(DnaDictionary* dict, const char* code) {
         return NULL;
     }
     
-    for (int i = 0; i < dict->count; i++) {
-        if (dict->entries[i].used && strcmp(dict->entries[i].code, code) == 0) {
-            return dict->entries[i].word;
-        }
-    }
-    
-    return NULL;
+    int index = dna_code_table_find_code(&dict->table, dict->entries, code);
+    return index >= 0 ? dict->entries[index].word : NULL;
 }
 
 // 文をDNA形式に圧縮
@@ -355,8 +370,8 @@ int dna_dictionary_save(DnaDictionary* dict) {
         return 0;
     }
     
-    // ヘッダー情報を書き込み
-    fprintf(file, "%d %d %d %d\n", dict->count, dict->next_entity_id, 
+    // ヘッダー情報を書き込み（追記のときに同じ位置で書き換えられるように幅をそろえる）
+    fprintf(file, DNA_DICTIONARY_HEADER_FORMAT, dict->count, dict->next_entity_id, 
             dict->next_concept_id, dict->next_result_id);
     
     // エントリを書き込み
@@ -366,7 +381,38 @@ int dna_dictionary_save(DnaDictionary* dict) {
         }
     }
     
-    fclose(file);
+    if (fclose(file) != 0) {
+        dict->saved_count = 0;
+        return 0;
+    }
+    dict->saved_count = dict->count;
+    return 1;
+}
+
+// 最後に追加したエントリをファイルに保存
+// ファイルがそれより前のエントリまでと一致していれば末尾に追記してヘッダーだけを書き換え、
+// そうでなければ（幅をそろえていない古いヘッダーなど）全体を書き直す
+static int dna_dictionary_append(DnaDictionary* dict) {
+    if (dict->saved_count != dict->count - 1) {
+        return dna_dictionary_save(dict);
+    }
+    
+    FILE* file = fopen(dict->filename, "r+");
+    if (!file) {
+        return dna_dictionary_save(dict);
+    }
+    
+    DnaEntry* entry = &dict->entries[dict->count - 1];
+    int ok = fseek(file, 0, SEEK_END) == 0 &&
+             fprintf(file, "%s %s %d\n", entry->code, entry->word, entry->type) > 0 &&
+             fseek(file, 0, SEEK_SET) == 0 &&
+             fprintf(file, DNA_DICTIONARY_HEADER_FORMAT, dict->count, dict->next_entity_id,
+                     dict->next_concept_id, dict->next_result_id) > 0;
+    if (fclose(file) != 0 || !ok) {
+        return dna_dictionary_save(dict);
+    }
+    
+    dict->saved_count = dict->count;
     return 1;
 }
 
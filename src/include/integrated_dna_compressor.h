@@ -2,6 +2,7 @@
 #define INTEGRATED_DNA_COMPRESSOR_H
 
 #include <stdbool.h>
+#include "dna_code_table.h"
 
 // DNA圧縮用の辞書エントリ
 typedef struct {
@@ -20,6 +21,8 @@ typedef struct {
     int next_concept_id;  // 次の動詞ID
     int next_result_id;   // 次の結果ID
     char filename[256];   // 辞書ファイル名
+    int saved_count;      // ファイルに書き込み済みのエントリ数（追記できるヘッダーの場合）
+    DnaCodeTable table;   // 単語とコードの索引
 } DnaDictionary;
 
 // 辞書の初期化
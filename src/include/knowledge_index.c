@@ -0,0 +1,476 @@
+#include "knowledge_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define KNOWLEDGE_INDEX_INITIAL_BUCKETS 1024
+#define KNOWLEDGE_INDEX_INITIAL_DOCS 64
+
+// 初期化
+void knowledge_index_init(KnowledgeIndex* index) {
+    memset(index, 0, sizeof(*index));
+    knowledge_store_init(&index->store);
+}
+
+// 解放
+void knowledge_index_free(KnowledgeIndex* index) {
+    for (int i = 0; i < index->term_count; i++) {
+        free(index->terms[i].docs);
+        free(index->terms[i].freqs);
+    }
+    free(index->terms);
+    free(index->buckets);
+    free(index->lengths);
+    knowledge_store_free(&index->store);
+    memset(index, 0, sizeof(*index));
+}
+
+// 語のハッシュ値（フィールドごとに別の語になるように混ぜる）
+static uint32_t knowledge_index_hash(KnowledgeIndexField field, const char* text, size_t length) {
+    uint32_t hash = 2166136261u ^ (uint32_t)field;
+    hash *= 16777619u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// UTF-8 の1文字のバイト数（壊れたバイトは1文字として扱う）
+static size_t knowledge_index_char_length(const char* text, size_t remaining) {
+    unsigned char c = (unsigned char)text[0];
+    size_t length = 1;
+    if (c >= 0xF0) {
+        length = 4;
+    } else if (c >= 0xE0) {
+        length = 3;
+    } else if (c >= 0xC0) {
+        length = 2;
+    }
+    return length < remaining ? length : remaining;
+}
+
+// 語を探す（なければ -1）
+static int knowledge_index_lookup(const KnowledgeIndex* index, KnowledgeIndexField field, const char* text,
+                                  size_t length, uint32_t hash) {
+    if (index->bucket_count == 0) {
+        return -1;
+    }
+
+    unsigned int mask = (unsigned int)index->bucket_count - 1;
+    unsigned int slot = hash & mask;
+    while (index->buckets[slot] >= 0) {
+        const KnowledgeIndexTerm* term = &index->terms[index->buckets[slot]];
+        if (term->hash == hash && term->field == field && term->length == length &&
+            memcmp(term->text, text, length) == 0) {
+            return index->buckets[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+// ハッシュ表を広げる
+static bool knowledge_index_grow_buckets(KnowledgeIndex* index) {
+    int bucket_count = index->bucket_count > 0 ? index->bucket_count * 2 : KNOWLEDGE_INDEX_INITIAL_BUCKETS;
+    int* buckets = (int*)malloc(sizeof(int) * bucket_count);
+    if (!buckets) {
+        return false;
+    }
+    memset(buckets, -1, sizeof(int) * bucket_count);
+
+    unsigned int mask = (unsigned int)bucket_count - 1;
+    for (int i = 0; i < index->term_count; i++) {
+        unsigned int slot = index->terms[i].hash & mask;
+        while (buckets[slot] >= 0) {
+            slot = (slot + 1) & mask;
+        }
+        buckets[slot] = i;
+    }
+
+    free(index->buckets);
+    index->buckets = buckets;
+    index->bucket_count = bucket_count;
+    return true;
+}
+
+// 語を探し、なければ追加する（失敗時は -1）
+static int knowledge_index_intern(KnowledgeIndex* index, KnowledgeIndexField field, const char* text, size_t length) {
+    uint32_t hash = knowledge_index_hash(field, text, length);
+    int found = knowledge_index_lookup(index, field, text, length, hash);
+    if (found >= 0) {
+        return found;
+    }
+
+    if ((index->term_count + 1) * 2 > index->bucket_count && !knowledge_index_grow_buckets(index)) {
+        return -1;
+    }
+    if (index->term_count >= index->term_capacity) {
+        int new_capacity = index->term_capacity > 0 ? index->term_capacity * 2 : KNOWLEDGE_INDEX_INITIAL_BUCKETS / 2;
+        KnowledgeIndexTerm* new_terms = (KnowledgeIndexTerm*)realloc(index->terms, sizeof(KnowledgeIndexTerm) * new_capacity);
+        if (!new_terms) {
+            return -1;
+        }
+        index->terms = new_terms;
+        index->term_capacity = new_capacity;
+    }
+
+    const char* copy = knowledge_store_copy(&index->store, text, length);
+    if (!copy) {
+        return -1;
+    }
+
+    KnowledgeIndexTerm* term = &index->terms[index->term_count];
+    memset(term, 0, sizeof(*term));
+    term->text = copy;
+    term->length = (uint32_t)length;
+    term->hash = hash;
+    term->field = field;
+
+    unsigned int mask = (unsigned int)index->bucket_count - 1;
+    unsigned int slot = hash & mask;
+    while (index->buckets[slot] >= 0) {
+        slot = (slot + 1) & mask;
+    }
+    index->buckets[slot] = index->term_count;
+    return index->term_count++;
+}
+
+// ドキュメント番号の位置を二分探索（なければ挿入する位置）
+static int knowledge_index_lower_bound(const KnowledgeIndexTerm* term, int begin, int doc) {
+    int low = begin;
+    int high = term->count;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (term->docs[mid] < doc) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+// 語の一覧にドキュメントを1回分加える
+static bool knowledge_index_add_posting(KnowledgeIndexTerm* term, int doc) {
+    // 追加はドキュメント番号の昇順に来るので、ほとんどは末尾で済む
+    int position = term->count;
+    if (term->count > 0 && term->docs[term->count - 1] == doc) {
+        if (term->freqs[term->count - 1] < UINT16_MAX) {
+            term->freqs[term->count - 1]++;
+        }
+        return true;
+    }
+    if (term->count > 0 && term->docs[term->count - 1] > doc) {
+        position = knowledge_index_lower_bound(term, 0, doc);
+        if (position < term->count && term->docs[position] == doc) {
+            if (term->freqs[position] < UINT16_MAX) {
+                term->freqs[position]++;
+            }
+            return true;
+        }
+    }
+
+    if (term->count >= term->capacity) {
+        int new_capacity = term->capacity > 0 ? term->capacity * 2 : 2;
+        int* docs = (int*)realloc(term->docs, sizeof(int) * new_capacity);
+        if (!docs) {
+            return false;
+        }
+        term->docs = docs;
+        uint16_t* freqs = (uint16_t*)realloc(term->freqs, sizeof(uint16_t) * new_capacity);
+        if (!freqs) {
+            return false;
+        }
+        term->freqs = freqs;
+        term->capacity = new_capacity;
+    }
+
+    if (position < term->count) {
+        memmove(term->docs + position + 1, term->docs + position, sizeof(int) * (term->count - position));
+        memmove(term->freqs + position + 1, term->freqs + position, sizeof(uint16_t) * (term->count - position));
+    }
+    term->docs[position] = doc;
+    term->freqs[position] = 1;
+    term->count++;
+    return true;
+}
+
+// 語の一覧からドキュメントを除く
+static void knowledge_index_remove_posting(KnowledgeIndexTerm* term, int doc) {
+    int position = knowledge_index_lower_bound(term, 0, doc);
+    if (position >= term->count || term->docs[position] != doc) {
+        return;
+    }
+    memmove(term->docs + position, term->docs + position + 1, sizeof(int) * (term->count - position - 1));
+    memmove(term->freqs + position, term->freqs + position + 1, sizeof(uint16_t) * (term->count - position - 1));
+    term->count--;
+}
+
+// ドキュメントごとの語数の表を広げる
+static bool knowledge_index_reserve_docs(KnowledgeIndex* index, int doc) {
+    if (doc < index->doc_capacity) {
+        return true;
+    }
+
+    int new_capacity = index->doc_capacity > 0 ? index->doc_capacity : KNOWLEDGE_INDEX_INITIAL_DOCS;
+    while (new_capacity <= doc) {
+        new_capacity *= 2;
+    }
+    int* lengths = (int*)realloc(index->lengths, sizeof(int) * KNOWLEDGE_FIELD_COUNT * new_capacity);
+    if (!lengths) {
+        return false;
+    }
+    memset(lengths + (size_t)index->doc_capacity * KNOWLEDGE_FIELD_COUNT, 0,
+           sizeof(int) * KNOWLEDGE_FIELD_COUNT * (new_capacity - index->doc_capacity));
+    index->lengths = lengths;
+    index->doc_capacity = new_capacity;
+    return true;
+}
+
+// ドキュメント doc のフィールドの文字列を索引に加える
+bool knowledge_index_add(KnowledgeIndex* index, KnowledgeIndexField field, int doc, const char* text, size_t length) {
+    if (!knowledge_index_reserve_docs(index, doc)) {
+        fprintf(stderr, "メモリ割り当てエラー: 索引の拡張に失敗しました\n");
+        return false;
+    }
+    if (doc >= index->doc_count) {
+        index->doc_count = doc + 1;
+    }
+
+    int added = 0;
+    bool ok = true;
+    if (field != KNOWLEDGE_FIELD_CONTENT) {
+        int term = knowledge_index_intern(index, field, text, length);
+        ok = term >= 0 && knowledge_index_add_posting(&index->terms[term], doc);
+        added = 1;
+    } else {
+        // 1文字と、続く1文字を合わせた2文字を語にする
+        size_t i = 0;
+        while (i < length && ok) {
+            size_t first = knowledge_index_char_length(text + i, length - i);
+            size_t second = i + first < length ? knowledge_index_char_length(text + i + first, length - i - first) : 0;
+
+            int unigram = knowledge_index_intern(index, field, text + i, first);
+            ok = unigram >= 0 && knowledge_index_add_posting(&index->terms[unigram], doc);
+            if (ok && second > 0) {
+                int bigram = knowledge_index_intern(index, field, text + i, first + second);
+                ok = bigram >= 0 && knowledge_index_add_posting(&index->terms[bigram], doc);
+            }
+            added++;
+            i += first;
+        }
+    }
+
+    // 途中で失敗しても、加えた分は remove で除けるように数えておく
+    index->lengths[(size_t)doc * KNOWLEDGE_FIELD_COUNT + field] += added;
+    index->total_lengths[field] += added;
+    if (!ok) {
+        fprintf(stderr, "メモリ割り当てエラー: 索引への追加に失敗しました\n");
+    }
+    return ok;
+}
+
+// 語の一覧からドキュメントを除く（語がなければ何もしない）
+static void knowledge_index_remove_term(KnowledgeIndex* index, KnowledgeIndexField field, int doc,
+                                        const char* text, size_t length) {
+    int term = knowledge_index_lookup(index, field, text, length, knowledge_index_hash(field, text, length));
+    if (term >= 0) {
+        knowledge_index_remove_posting(&index->terms[term], doc);
+    }
+}
+
+// knowledge_index_add で加えた文字列を索引から除く
+void knowledge_index_remove(KnowledgeIndex* index, KnowledgeIndexField field, int doc, const char* text, size_t length) {
+    if (doc >= index->doc_count) {
+        return;
+    }
+
+    int removed = 0;
+    if (field != KNOWLEDGE_FIELD_CONTENT) {
+        knowledge_index_remove_term(index, field, doc, text, length);
+        removed = 1;
+    } else {
+        // 同じ語が何度出ても一覧からは1回で消える（2回目以降は見つからない）
+        size_t i = 0;
+        while (i < length) {
+            size_t first = knowledge_index_char_length(text + i, length - i);
+            size_t second = i + first < length ? knowledge_index_char_length(text + i + first, length - i - first) : 0;
+            knowledge_index_remove_term(index, field, doc, text + i, first);
+            if (second > 0) {
+                knowledge_index_remove_term(index, field, doc, text + i, first + second);
+            }
+            removed++;
+            i += first;
+        }
+    }
+
+    int* doc_length = &index->lengths[(size_t)doc * KNOWLEDGE_FIELD_COUNT + field];
+    if (removed > *doc_length) {
+        removed = *doc_length;
+    }
+    *doc_length -= removed;
+    index->total_lengths[field] -= removed;
+}
+
+// スコアの高い順（同じならドキュメント番号の順）
+static int knowledge_index_hit_compare(const void* a, const void* b) {
+    const KnowledgeIndexHit* hit_a = (const KnowledgeIndexHit*)a;
+    const KnowledgeIndexHit* hit_b = (const KnowledgeIndexHit*)b;
+    if (hit_a->score != hit_b->score) {
+        return hit_a->score < hit_b->score ? 1 : -1;
+    }
+    return hit_a->doc - hit_b->doc;
+}
+
+// 一覧の短い順
+static int knowledge_index_term_compare(const void* a, const void* b) {
+    const KnowledgeIndexTerm* term_a = *(const KnowledgeIndexTerm* const*)a;
+    const KnowledgeIndexTerm* term_b = *(const KnowledgeIndexTerm* const*)b;
+    return term_a->count - term_b->count;
+}
+
+// クエリの語をすべて含むドキュメントを BM25 のスコア順に返す
+int knowledge_index_search(const KnowledgeIndex* index, KnowledgeIndexField field, const char* query, KnowledgeIndexHit** hits) {
+    *hits = NULL;
+    size_t length = strlen(query);
+
+    // 空のクエリはすべての内容に含まれる
+    if (field == KNOWLEDGE_FIELD_CONTENT && length == 0) {
+        if (index->doc_count == 0) {
+            return 0;
+        }
+        *hits = (KnowledgeIndexHit*)malloc(sizeof(KnowledgeIndexHit) * index->doc_count);
+        if (!*hits) {
+            return 0;
+        }
+        for (int i = 0; i < index->doc_count; i++) {
+            (*hits)[i].doc = i;
+            (*hits)[i].score = 0.0f;
+        }
+        return index->doc_count;
+    }
+
+    // クエリを語に分ける（内容は1文字ならその文字、2文字以上なら1文字ずつずらした、重なり合う2文字の並び）
+    int capacity = field == KNOWLEDGE_FIELD_CONTENT ? (int)length : 1;
+    const KnowledgeIndexTerm** terms = (const KnowledgeIndexTerm**)malloc(sizeof(KnowledgeIndexTerm*) * capacity);
+    if (!terms) {
+        return 0;
+    }
+    int term_count = 0;
+    bool missing = false;
+
+    if (field != KNOWLEDGE_FIELD_CONTENT) {
+        int term = knowledge_index_lookup(index, field, query, length, knowledge_index_hash(field, query, length));
+        if (term >= 0) {
+            terms[term_count++] = &index->terms[term];
+        } else {
+            missing = true;
+        }
+    } else {
+        size_t i = 0;
+        while (i < length) {
+            size_t first = knowledge_index_char_length(query + i, length - i);
+            size_t second = i + first < length ? knowledge_index_char_length(query + i + first, length - i - first) : 0;
+            if (second == 0 && i > 0) {
+                break;
+            }
+            size_t n = first + second;
+
+            int term = knowledge_index_lookup(index, field, query + i, n, knowledge_index_hash(field, query + i, n));
+            if (term < 0) {
+                missing = true;
+                break;
+            }
+            bool duplicate = false;
+            for (int t = 0; t < term_count; t++) {
+                if (terms[t] == &index->terms[term]) {
+                    duplicate = true;
+                    break;
+                }
+            }
+            if (!duplicate) {
+                terms[term_count++] = &index->terms[term];
+            }
+            i += first;
+        }
+    }
+
+    if (missing || term_count == 0 || terms[0]->count == 0) {
+        free(terms);
+        return 0;
+    }
+
+    // 一番短い一覧を候補にして、残りの語の一覧を二分探索で確かめる
+    qsort(terms, term_count, sizeof(KnowledgeIndexTerm*), knowledge_index_term_compare);
+    const KnowledgeIndexTerm* rarest = terms[0];
+    int* cursors = (int*)calloc(term_count, sizeof(int));
+    KnowledgeIndexHit* results = (KnowledgeIndexHit*)malloc(sizeof(KnowledgeIndexHit) * rarest->count);
+    if (!cursors || !results) {
+        free(terms);
+        free(cursors);
+        free(results);
+        return 0;
+    }
+
+    float doc_count = (float)index->doc_count;
+    float average_length = index->doc_count > 0 ? (float)index->total_lengths[field] / doc_count : 1.0f;
+    if (average_length <= 0.0f) {
+        average_length = 1.0f;
+    }
+
+    int result_count = 0;
+    for (int c = 0; c < rarest->count; c++) {
+        int doc = rarest->docs[c];
+        float doc_length = (float)index->lengths[(size_t)doc * KNOWLEDGE_FIELD_COUNT + field];
+        float norm = KNOWLEDGE_INDEX_BM25_K1 * (1.0f - KNOWLEDGE_INDEX_BM25_B + KNOWLEDGE_INDEX_BM25_B * doc_length / average_length);
+        float score = 0.0f;
+        bool matched = true;
+
+        for (int t = 0; t < term_count; t++) {
+            const KnowledgeIndexTerm* term = terms[t];
+            int position = c;
+            if (t > 0) {
+                // 候補は昇順なので、前の位置から探せばよい
+                position = knowledge_index_lower_bound(term, cursors[t], doc);
+                cursors[t] = position;
+                if (position >= term->count || term->docs[position] != doc) {
+                    matched = false;
+                    break;
+                }
+            }
+            float df = (float)term->count;
+            float idf = logf(1.0f + (doc_count - df + 0.5f) / (df + 0.5f));
+            float tf = (float)term->freqs[position];
+            score += idf * tf * (KNOWLEDGE_INDEX_BM25_K1 + 1.0f) / (tf + norm);
+        }
+
+        if (matched) {
+            results[result_count].doc = doc;
+            results[result_count].score = score;
+            result_count++;
+        }
+    }
+
+    free(terms);
+    free(cursors);
+
+    if (result_count == 0) {
+        free(results);
+        return 0;
+    }
+    qsort(results, result_count, sizeof(KnowledgeIndexHit), knowledge_index_hit_compare);
+    *hits = results;
+    return result_count;
+}
+
+// 文字列全体が一致する最初のドキュメント番号
+int knowledge_index_find_first(const KnowledgeIndex* index, KnowledgeIndexField field, const char* text) {
+    size_t length = strlen(text);
+    int term = knowledge_index_lookup(index, field, text, length, knowledge_index_hash(field, text, length));
+    if (term < 0 || index->terms[term].count == 0) {
+        return -1;
+    }
+    return index->terms[term].docs[0];
+}
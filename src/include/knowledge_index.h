@@ -0,0 +1,73 @@
+#ifndef KNOWLEDGE_INDEX_H
+#define KNOWLEDGE_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "knowledge_store.h"
+
+#define KNOWLEDGE_INDEX_BM25_K1 1.2f       // BM25 の語の出現回数の飽和の強さ
+#define KNOWLEDGE_INDEX_BM25_B 0.75f       // BM25 の文書の長さによる補正の強さ
+
+// 索引するフィールド
+typedef enum {
+    KNOWLEDGE_FIELD_CONTENT = 0,    // 内容（UTF-8 の1文字と2文字の並びを語にする）
+    KNOWLEDGE_FIELD_TITLE,          // 以下は文字列全体を1語にする
+    KNOWLEDGE_FIELD_CATEGORY,
+    KNOWLEDGE_FIELD_TAG,
+    KNOWLEDGE_FIELD_COUNT
+} KnowledgeIndexField;
+
+// 語と、その語を含むドキュメントの一覧（ドキュメント番号の昇順）
+typedef struct {
+    const char* text;
+    uint32_t length;
+    uint32_t hash;
+    KnowledgeIndexField field;
+    int* docs;
+    uint16_t* freqs;                // ドキュメント内の出現回数（上限で止める）
+    int count;
+    int capacity;
+} KnowledgeIndexTerm;
+
+// 検索結果（score の高い順に並ぶ）
+typedef struct {
+    int doc;
+    float score;
+} KnowledgeIndexHit;
+
+// 知識ドキュメントの転置インデックス
+// ドキュメントは知識ベースの配列の番号で表し、追加と更新のたびに差分だけ反映する
+typedef struct {
+    KnowledgeIndexTerm* terms;
+    int term_count;
+    int term_capacity;
+    int* buckets;                   // オープンアドレス法、空きは -1
+    int bucket_count;
+    KnowledgeStore store;           // 語の文字列
+    int* lengths;                   // ドキュメントごと・フィールドごとの語数（doc_capacity × KNOWLEDGE_FIELD_COUNT）
+    int doc_count;                  // 索引したドキュメント番号の最大値 + 1
+    int doc_capacity;
+    long long total_lengths[KNOWLEDGE_FIELD_COUNT];
+} KnowledgeIndex;
+
+// 初期化
+void knowledge_index_init(KnowledgeIndex* index);
+
+// 解放（init し直せば再び使える）
+void knowledge_index_free(KnowledgeIndex* index);
+
+// ドキュメント doc のフィールドの文字列を索引に加える
+bool knowledge_index_add(KnowledgeIndex* index, KnowledgeIndexField field, int doc, const char* text, size_t length);
+
+// knowledge_index_add で加えた文字列を索引から除く（更新の前に古い文字列で呼ぶ）
+void knowledge_index_remove(KnowledgeIndex* index, KnowledgeIndexField field, int doc, const char* text, size_t length);
+
+// クエリの語をすべて含むドキュメントを BM25 のスコア順に返す（*hits は呼び出し側で free、件数を返す）
+// 内容のクエリは1文字ずつずらした2文字の並びに分けるので、部分文字列として含むかは呼び出し側で確かめる
+int knowledge_index_search(const KnowledgeIndex* index, KnowledgeIndexField field, const char* query, KnowledgeIndexHit** hits);
+
+// 文字列全体が一致する最初のドキュメント番号（なければ -1）
+int knowledge_index_find_first(const KnowledgeIndex* index, KnowledgeIndexField field, const char* text);
+
+#endif // KNOWLEDGE_INDEX_H
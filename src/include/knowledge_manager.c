@@ -4,6 +4,7 @@
 #include <unistd.h>
 #include <math.h>
 #include <time.h>
+#include <stdint.h>
 #include "../vector_search/vector_search.h"
 
 // strptimeの宣言を追加
@@ -11,6 +12,11 @@ extern char *strptime(const char *s, const char *format, struct tm *tm);
 
 #define KB_INITIAL_CAPACITY 50
 #define MAX_LINE_LENGTH 4096
+#define KB_SNAPSHOT_FILE ".knowledge_snapshot"   // ベースディレクトリに置く、解析済みドキュメントとベクトルのキャッシュ
+#define KB_SNAPSHOT_MAGIC "GKBS"
+#define KB_SNAPSHOT_VERSION 3                    // 形式や解析・ベクトル化の結果を変えたら上げる
+#define KB_LOAD_MAX_THREADS 16                   // 解析に使うスレッド数の上限
+#define KB_LOAD_FILES_PER_THREAD 16              // 1スレッドに任せる最小のファイル数
 
 // 知識ベースの初期化
 KnowledgeBase* knowledge_base_init(const char* base_dir) {
@@ -26,11 +32,25 @@ KnowledgeBase* knowledge_base_init(const char* base_dir) {
         free(kb);
         return NULL;
     }
+    kb->sources = (KnowledgeSource*)malloc(sizeof(KnowledgeSource) * KB_INITIAL_CAPACITY);
+    if (!kb->sources) {
+        fprintf(stderr, "メモリ割り当てエラー: 知識ドキュメントの初期化に失敗しました\n");
+        free(kb->documents);
+        free(kb);
+        return NULL;
+    }
     
     kb->count = 0;
     kb->capacity = KB_INITIAL_CAPACITY;
+    kb->log_segments = NULL;
+    kb->log_segment_count = 0;
+    kb->log_segment_capacity = 0;
+    knowledge_store_init(&kb->store);
+    knowledge_index_init(&kb->index);
+    kb->content_indexed = false;
     strncpy(kb->base_dir, base_dir, sizeof(kb->base_dir) - 1);
     kb->base_dir[sizeof(kb->base_dir) - 1] = '\0';
+    pthread_rwlock_init(&kb->lock, NULL);
     
     // ベクトルデータベースを初期化
     init_vector_db(&kb->vector_db);
@@ -53,223 +73,397 @@ void knowledge_base_free(KnowledgeBase* kb) {
         if (kb->documents) {
             free(kb->documents);
         }
+        free(kb->sources);
+        free(kb->log_segments);
+        knowledge_store_free(&kb->store);
+        knowledge_index_free(&kb->index);
+        free_vector_db(&kb->vector_db);
+        pthread_rwlock_destroy(&kb->lock);
         free(kb);
     }
 }
 
-// 知識ドキュメントの追加
-bool knowledge_base_add_document(KnowledgeBase* kb, const char* title, const char* content, 
-                                const char* category, const char** tags, int tag_count) {
-    if (!kb || !title || !content) {
+// ドキュメントの配列を少なくとも count 件分にする（文字列はストアにあるので、動くのは小さなヘッダーだけ）
+static bool knowledge_base_reserve(KnowledgeBase* kb, int count) {
+    if (count <= kb->capacity) {
+        return true;
+    }
+    
+    int new_capacity = kb->capacity > 0 ? kb->capacity : KB_INITIAL_CAPACITY;
+    while (new_capacity < count) {
+        new_capacity *= 2;
+    }
+    KnowledgeDocument* new_documents = (KnowledgeDocument*)realloc(kb->documents, sizeof(KnowledgeDocument) * new_capacity);
+    if (!new_documents) {
         return false;
     }
+    kb->documents = new_documents;
+    KnowledgeSource* new_sources = (KnowledgeSource*)realloc(kb->sources, sizeof(KnowledgeSource) * new_capacity);
+    if (!new_sources) {
+        return false;
+    }
+    kb->sources = new_sources;
+    kb->capacity = new_capacity;
+    return true;
+}
+
+// ログファイルの番号（なければ create が true のときだけ加える、失敗・未登録は -1）
+static int knowledge_base_log_segment(KnowledgeBase* kb, const char* path, size_t path_len, bool create) {
+    for (int i = 0; i < kb->log_segment_count; i++) {
+        const char* known = kb->log_segments[i].path;
+        if (strncmp(known, path, path_len) == 0 && known[path_len] == '\0') {
+            return i;
+        }
+    }
+    if (!create) {
+        return -1;
+    }
     
-    // 既存のドキュメントを検索
-    for (int i = 0; i < kb->count; i++) {
-        if (strcmp(kb->documents[i].title, title) == 0) {
-            // 既存のドキュメントを更新
-            strncpy(kb->documents[i].content, content, sizeof(kb->documents[i].content) - 1);
-            kb->documents[i].content[sizeof(kb->documents[i].content) - 1] = '\0';
-            
-            strncpy(kb->documents[i].category, category, sizeof(kb->documents[i].category) - 1);
-            kb->documents[i].category[sizeof(kb->documents[i].category) - 1] = '\0';
-            
-            kb->documents[i].tag_count = 0;
-            for (int j = 0; j < tag_count && j < 10; j++) {
-                strncpy(kb->documents[i].tags[j], tags[j], sizeof(kb->documents[i].tags[j]) - 1);
-                kb->documents[i].tags[j][sizeof(kb->documents[i].tags[j]) - 1] = '\0';
-                kb->documents[i].tag_count++;
-            }
-            
-            kb->documents[i].updated_at = time(NULL);
-            
-            // ドキュメントをベクトル化してベクトルデータベースに追加
-            float* vector = knowledge_document_vectorize(&kb->documents[i]);
-            if (vector) {
-                // 既存のベクトルを更新
-                add_vector(&kb->vector_db, vector, i);
-                free(vector);
-            }
-            
-            // ドキュメントをファイルに保存
-            knowledge_base_save_document(kb, &kb->documents[i]);
-            
-            return true;
+    if (kb->log_segment_count >= kb->log_segment_capacity) {
+        int new_capacity = kb->log_segment_capacity > 0 ? kb->log_segment_capacity * 2 : 16;
+        KnowledgeLogSegment* segments = (KnowledgeLogSegment*)realloc(kb->log_segments, sizeof(KnowledgeLogSegment) * new_capacity);
+        if (!segments) {
+            return -1;
         }
+        kb->log_segments = segments;
+        kb->log_segment_capacity = new_capacity;
     }
     
-    // 容量が足りない場合は拡張
-    if (kb->count >= kb->capacity) {
-        int new_capacity = kb->capacity * 2;
-        KnowledgeDocument* new_documents = (KnowledgeDocument*)realloc(kb->documents, sizeof(KnowledgeDocument) * new_capacity);
-        if (!new_documents) {
-            fprintf(stderr, "メモリ割り当てエラー: 知識ベースの拡張に失敗しました\n");
+    const char* copy = knowledge_store_copy(&kb->store, path, path_len);
+    if (!copy) {
+        return -1;
+    }
+    KnowledgeLogSegment* segment = &kb->log_segments[kb->log_segment_count];
+    segment->path = copy;
+    segment->mtime = 0;
+    segment->size = 0;
+    return kb->log_segment_count++;
+}
+
+// 内容・カテゴリ・タグをストアにコピーして設定（失敗時は false で、doc はそのまま）
+static bool knowledge_document_set_fields(KnowledgeBase* kb, KnowledgeDocument* doc, const char* content,
+                                          const char* category, const char** tags, int tag_count) {
+    size_t content_length = strlen(content);
+    const char* content_copy = knowledge_store_copy(&kb->store, content, content_length);
+    const char* category_copy = knowledge_store_copy(&kb->store, category ? category : "", category ? strlen(category) : 0);
+    if (!content_copy || !category_copy) {
+        return false;
+    }
+    
+    const char* tag_copies[KNOWLEDGE_MAX_TAGS];
+    int count = 0;
+    for (int i = 0; i < tag_count && count < KNOWLEDGE_MAX_TAGS; i++) {
+        tag_copies[count] = knowledge_store_copy(&kb->store, tags[i], strlen(tags[i]));
+        if (!tag_copies[count]) {
             return false;
         }
-        kb->documents = new_documents;
-        kb->capacity = new_capacity;
+        count++;
     }
     
-    // 新しいドキュメントを追加
-    strncpy(kb->documents[kb->count].title, title, sizeof(kb->documents[kb->count].title) - 1);
-    kb->documents[kb->count].title[sizeof(kb->documents[kb->count].title) - 1] = '\0';
+    doc->content = content_copy;
+    doc->content_length = content_length;
+    doc->category = category_copy;
+    memcpy(doc->tags, tag_copies, sizeof(const char*) * count);
+    doc->tag_count = count;
+    return true;
+}
+
+// ドキュメントを転置インデックスに加える（remove が true なら除く）
+// 内容は、まだ索引を作っていなければ knowledge_base_index_content でまとめて加える
+static bool knowledge_base_index_document(KnowledgeBase* kb, int index, bool remove) {
+    const KnowledgeDocument* doc = &kb->documents[index];
+    if (remove) {
+        knowledge_index_remove(&kb->index, KNOWLEDGE_FIELD_TITLE, index, doc->title, strlen(doc->title));
+        if (kb->content_indexed) {
+            knowledge_index_remove(&kb->index, KNOWLEDGE_FIELD_CONTENT, index, doc->content, doc->content_length);
+        }
+        knowledge_index_remove(&kb->index, KNOWLEDGE_FIELD_CATEGORY, index, doc->category, strlen(doc->category));
+        for (int i = 0; i < doc->tag_count; i++) {
+            knowledge_index_remove(&kb->index, KNOWLEDGE_FIELD_TAG, index, doc->tags[i], strlen(doc->tags[i]));
+        }
+        return true;
+    }
     
-    strncpy(kb->documents[kb->count].content, content, sizeof(kb->documents[kb->count].content) - 1);
-    kb->documents[kb->count].content[sizeof(kb->documents[kb->count].content) - 1] = '\0';
+    bool ok = knowledge_index_add(&kb->index, KNOWLEDGE_FIELD_TITLE, index, doc->title, strlen(doc->title)) &&
+              (!kb->content_indexed ||
+               knowledge_index_add(&kb->index, KNOWLEDGE_FIELD_CONTENT, index, doc->content, doc->content_length)) &&
+              knowledge_index_add(&kb->index, KNOWLEDGE_FIELD_CATEGORY, index, doc->category, strlen(doc->category));
+    for (int i = 0; ok && i < doc->tag_count; i++) {
+        ok = knowledge_index_add(&kb->index, KNOWLEDGE_FIELD_TAG, index, doc->tags[i], strlen(doc->tags[i]));
+    }
+    return ok;
+}
+
+// すべてのドキュメントの内容を索引に加える（書き込みロックを取得済みで呼ぶ）
+// 内容の2文字の並びの索引は作るのに時間がかかるので、起動時ではなく最初の内容の検索で作る
+static void knowledge_base_index_content(KnowledgeBase* kb) {
+    for (int i = 0; i < kb->count; i++) {
+        const KnowledgeDocument* doc = &kb->documents[i];
+        if (!knowledge_index_add(&kb->index, KNOWLEDGE_FIELD_CONTENT, i, doc->content, doc->content_length)) {
+            fprintf(stderr, "メモリ割り当てエラー: 内容の索引を作れませんでした\n");
+            break;
+        }
+    }
+    kb->content_indexed = true;
+}
+
+// 知識ドキュメントの追加（書き込みロックを取得済みで呼ぶ、save が false ならファイルに保存しない）
+// segment はログファイルから加えるときのその番号（それ以外は -1）
+static bool knowledge_base_add_document_unlocked(KnowledgeBase* kb, const char* title, const char* content, 
+                                                 const char* category, const char** tags, int tag_count, bool save,
+                                                 int segment) {
+    KnowledgeSource source = {NULL, 0, 0, segment};
+    
+    // 既存のドキュメントを検索
+    int i = knowledge_index_find_first(&kb->index, KNOWLEDGE_FIELD_TITLE, title);
+    if (i >= 0) {
+        // 既存のドキュメントを更新（前の文字列はストアに残り、次の読み込みで解放される）
+        knowledge_base_index_document(kb, i, true);
+        bool updated = knowledge_document_set_fields(kb, &kb->documents[i], content, category, tags, tag_count);
+        knowledge_base_index_document(kb, i, false);
+        if (!updated) {
+            fprintf(stderr, "メモリ割り当てエラー: 知識ドキュメントの更新に失敗しました\n");
+            return false;
+        }
+        
+        kb->documents[i].updated_at = time(NULL);
+        kb->sources[i] = source;
+        
+        // ドキュメントをベクトル化してベクトルデータベースに追加
+        float* vector = knowledge_document_vectorize(&kb->documents[i]);
+        if (vector) {
+            // 既存のベクトルを更新
+            add_vector(&kb->vector_db, vector, i);
+            free(vector);
+        }
+        
+        // ドキュメントをファイルに保存
+        if (save) {
+            knowledge_base_save_document(kb, &kb->documents[i]);
+        }
+        
+        return true;
+    }
     
-    strncpy(kb->documents[kb->count].category, category, sizeof(kb->documents[kb->count].category) - 1);
-    kb->documents[kb->count].category[sizeof(kb->documents[kb->count].category) - 1] = '\0';
+    // 容量が足りない場合は拡張
+    if (!knowledge_base_reserve(kb, kb->count + 1)) {
+        fprintf(stderr, "メモリ割り当てエラー: 知識ベースの拡張に失敗しました\n");
+        return false;
+    }
     
-    kb->documents[kb->count].tag_count = 0;
-    for (int i = 0; i < tag_count && i < 10; i++) {
-        strncpy(kb->documents[kb->count].tags[i], tags[i], sizeof(kb->documents[kb->count].tags[i]) - 1);
-        kb->documents[kb->count].tags[i][sizeof(kb->documents[kb->count].tags[i]) - 1] = '\0';
-        kb->documents[kb->count].tag_count++;
+    // 新しいドキュメントを追加
+    KnowledgeDocument* doc = &kb->documents[kb->count];
+    memset(doc, 0, sizeof(KnowledgeDocument));
+    doc->title = knowledge_store_copy(&kb->store, title, strlen(title));
+    if (!doc->title || !knowledge_document_set_fields(kb, doc, content, category, tags, tag_count)) {
+        fprintf(stderr, "メモリ割り当てエラー: 知識ドキュメントの追加に失敗しました\n");
+        return false;
     }
     
-    kb->documents[kb->count].created_at = time(NULL);
-    kb->documents[kb->count].updated_at = kb->documents[kb->count].created_at;
+    doc->created_at = time(NULL);
+    doc->updated_at = doc->created_at;
+    kb->sources[kb->count] = source;
+    
+    if (!knowledge_base_index_document(kb, kb->count, false)) {
+        // 索引に一部だけ残った分を除いてから諦める
+        knowledge_base_index_document(kb, kb->count, true);
+        return false;
+    }
     
     // ドキュメントをベクトル化してベクトルデータベースに追加
-    float* vector = knowledge_document_vectorize(&kb->documents[kb->count]);
+    float* vector = knowledge_document_vectorize(doc);
     if (vector) {
         add_vector(&kb->vector_db, vector, kb->count);
         free(vector);
     }
     
     // ドキュメントをファイルに保存
-    knowledge_base_save_document(kb, &kb->documents[kb->count]);
+    if (save) {
+        knowledge_base_save_document(kb, doc);
+    }
     
     kb->count++;
     
     return true;
 }
 
-// 知識ドキュメントの検索（タイトルで）
-KnowledgeDocument* knowledge_base_find_by_title(KnowledgeBase* kb, const char* title) {
-    if (!kb || !title) {
-        return NULL;
+// 知識ドキュメントの追加
+bool knowledge_base_add_document(KnowledgeBase* kb, const char* title, const char* content, 
+                                const char* category, const char** tags, int tag_count) {
+    if (!kb || !title || !content) {
+        return false;
     }
     
-    for (int i = 0; i < kb->count; i++) {
-        if (strcmp(kb->documents[i].title, title) == 0) {
-            return &kb->documents[i];
-        }
-    }
+    pthread_rwlock_wrlock(&kb->lock);
+    bool result = knowledge_base_add_document_unlocked(kb, title, content, category, tags, tag_count, true, -1);
+    pthread_rwlock_unlock(&kb->lock);
     
-    return NULL;
+    return result;
 }
 
-// 知識ドキュメントの検索（カテゴリで）
-KnowledgeDocument** knowledge_base_find_by_category(KnowledgeBase* kb, const char* category, int* count) {
-    if (!kb || !category || !count) {
-        return NULL;
+// 知識ドキュメントの追加（ファイルには保存しない）
+bool knowledge_base_add_document_unsaved(KnowledgeBase* kb, const char* title, const char* content, 
+                                         const char* category, const char** tags, int tag_count) {
+    if (!kb || !title || !content) {
+        return false;
     }
     
-    // 該当するドキュメント数をカウント
-    *count = 0;
-    for (int i = 0; i < kb->count; i++) {
-        if (strcmp(kb->documents[i].category, category) == 0) {
-            (*count)++;
-        }
+    pthread_rwlock_wrlock(&kb->lock);
+    bool result = knowledge_base_add_document_unlocked(kb, title, content, category, tags, tag_count, false, -1);
+    pthread_rwlock_unlock(&kb->lock);
+    
+    return result;
+}
+
+// ログファイルから読んだ知識ドキュメントの追加（ファイルには保存しない）
+bool knowledge_base_add_log_document(KnowledgeBase* kb, const char* path, const char* title, const char* content,
+                                     const char* category, const char** tags, int tag_count) {
+    if (!kb || !path || !title || !content) {
+        return false;
     }
     
-    if (*count == 0) {
-        return NULL;
+    pthread_rwlock_wrlock(&kb->lock);
+    int segment = knowledge_base_log_segment(kb, path, strlen(path), true);
+    bool result = segment >= 0 &&
+                  knowledge_base_add_document_unlocked(kb, title, content, category, tags, tag_count, false, segment);
+    pthread_rwlock_unlock(&kb->lock);
+    
+    return result;
+}
+
+// ログファイルのうち、知識ベースに加えた大きさ
+long long knowledge_base_log_offset(KnowledgeBase* kb, const char* path) {
+    if (!kb || !path) {
+        return 0;
     }
     
-    // 結果配列を確保
-    KnowledgeDocument** results = (KnowledgeDocument**)malloc(sizeof(KnowledgeDocument*) * (*count));
-    if (!results) {
-        *count = 0;
-        return NULL;
+    pthread_rwlock_rdlock(&kb->lock);
+    int segment = knowledge_base_log_segment(kb, path, strlen(path), false);
+    long long size = segment >= 0 ? kb->log_segments[segment].size : 0;
+    pthread_rwlock_unlock(&kb->lock);
+    
+    return size;
+}
+
+// ログファイルを先頭から size バイトまで加えたことを記録する
+bool knowledge_base_set_log_offset(KnowledgeBase* kb, const char* path, long long mtime, long long size) {
+    if (!kb || !path) {
+        return false;
     }
     
-    // 該当するドキュメントを結果配列に追加
-    int index = 0;
-    for (int i = 0; i < kb->count; i++) {
-        if (strcmp(kb->documents[i].category, category) == 0) {
-            results[index++] = &kb->documents[i];
-        }
+    pthread_rwlock_wrlock(&kb->lock);
+    int segment = knowledge_base_log_segment(kb, path, strlen(path), true);
+    if (segment >= 0) {
+        kb->log_segments[segment].mtime = mtime;
+        kb->log_segments[segment].size = size;
     }
+    pthread_rwlock_unlock(&kb->lock);
     
-    return results;
+    return segment >= 0;
 }
 
-// 知識ドキュメントの検索（タグで）
-KnowledgeDocument** knowledge_base_find_by_tag(KnowledgeBase* kb, const char* tag, int* count) {
-    if (!kb || !tag || !count) {
+// 知識ドキュメントの検索（タイトルで）
+KnowledgeDocument* knowledge_base_find_by_title(KnowledgeBase* kb, const char* title) {
+    if (!kb || !title) {
         return NULL;
     }
     
-    // 該当するドキュメント数をカウント
-    *count = 0;
-    for (int i = 0; i < kb->count; i++) {
-        for (int j = 0; j < kb->documents[i].tag_count; j++) {
-            if (strcmp(kb->documents[i].tags[j], tag) == 0) {
-                (*count)++;
-                break;
-            }
-        }
+    KnowledgeDocument* found = NULL;
+    
+    pthread_rwlock_rdlock(&kb->lock);
+    int index = knowledge_index_find_first(&kb->index, KNOWLEDGE_FIELD_TITLE, title);
+    if (index >= 0 && index < kb->count) {
+        found = &kb->documents[index];
     }
+    pthread_rwlock_unlock(&kb->lock);
     
-    if (*count == 0) {
+    return found;
+}
+
+// 転置インデックスで検索して、スコア順のドキュメントの配列にする（読み込みロックを取得済みで呼ぶ）
+// 内容の検索は、候補が本当にクエリを部分文字列として含むかを確かめてから結果に入れる
+static KnowledgeDocument** knowledge_base_find_indexed(KnowledgeBase* kb, KnowledgeIndexField field, const char* query, int* count) {
+    *count = 0;
+    
+    KnowledgeIndexHit* hits = NULL;
+    int hit_count = knowledge_index_search(&kb->index, field, query, &hits);
+    if (hit_count == 0) {
         return NULL;
     }
     
     // 結果配列を確保
-    KnowledgeDocument** results = (KnowledgeDocument**)malloc(sizeof(KnowledgeDocument*) * (*count));
+    KnowledgeDocument** results = (KnowledgeDocument**)malloc(sizeof(KnowledgeDocument*) * hit_count);
     if (!results) {
-        *count = 0;
+        free(hits);
         return NULL;
     }
     
-    // 該当するドキュメントを結果配列に追加
-    int index = 0;
-    for (int i = 0; i < kb->count; i++) {
-        for (int j = 0; j < kb->documents[i].tag_count; j++) {
-            if (strcmp(kb->documents[i].tags[j], tag) == 0) {
-                results[index++] = &kb->documents[i];
-                break;
-            }
+    // 該当するドキュメントをスコアの高い順に結果配列に追加
+    for (int i = 0; i < hit_count; i++) {
+        if (hits[i].doc >= kb->count) {
+            continue;
+        }
+        KnowledgeDocument* doc = &kb->documents[hits[i].doc];
+        if (field == KNOWLEDGE_FIELD_CONTENT && strstr(doc->content, query) == NULL) {
+            continue;
         }
+        results[(*count)++] = doc;
+    }
+    free(hits);
+    
+    if (*count == 0) {
+        free(results);
+        return NULL;
     }
     
     return results;
 }
 
-// 知識ドキュメントの検索（内容で）
-KnowledgeDocument** knowledge_base_find_by_content(KnowledgeBase* kb, const char* query, int* count) {
-    if (!kb || !query || !count) {
+// 知識ドキュメントの検索（カテゴリで）
+KnowledgeDocument** knowledge_base_find_by_category(KnowledgeBase* kb, const char* category, int* count) {
+    if (!kb || !category || !count) {
         return NULL;
     }
     
-    // 該当するドキュメント数をカウント
-    *count = 0;
-    for (int i = 0; i < kb->count; i++) {
-        if (strstr(kb->documents[i].content, query) != NULL) {
-            (*count)++;
-        }
-    }
+    pthread_rwlock_rdlock(&kb->lock);
+    KnowledgeDocument** results = knowledge_base_find_indexed(kb, KNOWLEDGE_FIELD_CATEGORY, category, count);
+    pthread_rwlock_unlock(&kb->lock);
     
-    if (*count == 0) {
+    return results;
+}
+
+// 知識ドキュメントの検索（タグで）
+KnowledgeDocument** knowledge_base_find_by_tag(KnowledgeBase* kb, const char* tag, int* count) {
+    if (!kb || !tag || !count) {
         return NULL;
     }
     
-    // 結果配列を確保
-    KnowledgeDocument** results = (KnowledgeDocument**)malloc(sizeof(KnowledgeDocument*) * (*count));
-    if (!results) {
-        *count = 0;
+    pthread_rwlock_rdlock(&kb->lock);
+    KnowledgeDocument** results = knowledge_base_find_indexed(kb, KNOWLEDGE_FIELD_TAG, tag, count);
+    pthread_rwlock_unlock(&kb->lock);
+    
+    return results;
+}
+
+// 知識ドキュメントの検索（内容で）
+KnowledgeDocument** knowledge_base_find_by_content(KnowledgeBase* kb, const char* query, int* count) {
+    if (!kb || !query || !count) {
         return NULL;
     }
     
-    // 該当するドキュメントを結果配列に追加
-    int index = 0;
-    for (int i = 0; i < kb->count; i++) {
-        if (strstr(kb->documents[i].content, query) != NULL) {
-            results[index++] = &kb->documents[i];
+    pthread_rwlock_rdlock(&kb->lock);
+    while (!kb->content_indexed) {
+        // 内容の索引がまだなければ書き込みロックを取り直して作る
+        pthread_rwlock_unlock(&kb->lock);
+        pthread_rwlock_wrlock(&kb->lock);
+        if (!kb->content_indexed) {
+            knowledge_base_index_content(kb);
         }
+        pthread_rwlock_unlock(&kb->lock);
+        pthread_rwlock_rdlock(&kb->lock);
     }
+    KnowledgeDocument** results = knowledge_base_find_indexed(kb, KNOWLEDGE_FIELD_CONTENT, query, count);
+    pthread_rwlock_unlock(&kb->lock);
     
     return results;
 }
@@ -314,8 +508,9 @@ bool knowledge_base_save_document(KnowledgeBase* kb, const KnowledgeDocument* do
     
     char created_at_str[32];
     char updated_at_str[32];
-    strftime(created_at_str, sizeof(created_at_str), "%Y-%m-%d %H:%M:%S", localtime(&doc->created_at));
-    strftime(updated_at_str, sizeof(updated_at_str), "%Y-%m-%d %H:%M:%S", localtime(&doc->updated_at));
+    struct tm tm_buf;
+    strftime(created_at_str, sizeof(created_at_str), "%Y-%m-%d %H:%M:%S", localtime_r(&doc->created_at, &tm_buf));
+    strftime(updated_at_str, sizeof(updated_at_str), "%Y-%m-%d %H:%M:%S", localtime_r(&doc->updated_at, &tm_buf));
     
     fprintf(file, "created_at: %s\n", created_at_str);
     fprintf(file, "updated_at: %s\n", updated_at_str);
@@ -335,339 +530,934 @@ bool knowledge_base_save_all(KnowledgeBase* kb) {
     }
     
     bool success = true;
+    pthread_rwlock_rdlock(&kb->lock);
     for (int i = 0; i < kb->count; i++) {
         if (!knowledge_base_save_document(kb, &kb->documents[i])) {
             success = false;
         }
     }
+    pthread_rwlock_unlock(&kb->lock);
     
     return success;
 }
 
-// 知識ベースの読み込み
-bool knowledge_base_load(KnowledgeBase* kb) {
-    if (!kb) {
-        return false;
+// 読み込むマークダウンファイル
+typedef struct {
+    char path[512];
+    char title[256];
+    long long mtime;
+    long long size;
+    bool cached;        // スナップショットの内容をそのまま使う
+    bool loaded;        // 読み込めた（開けなかったファイルは飛ばす）
+} KnowledgeFile;
+
+// ファイルの一覧
+typedef struct {
+    KnowledgeFile* files;
+    int count;
+    int capacity;
+} KnowledgeFileList;
+
+// スナップショットに記録されたドキュメント（record は解析を後回しにした本体を指す）
+typedef struct {
+    const char* path;
+    uint32_t path_len;
+    long long mtime;
+    long long size;
+    const unsigned char* record;
+    size_t record_size;
+} KnowledgeSnapshotEntry;
+
+// スナップショットに記録されたログファイル（records は [大きさ, 本体] の並びで、書いた順に復元する）
+typedef struct {
+    const char* path;
+    uint32_t path_len;
+    long long mtime;
+    long long size;             // 先頭からこの大きさまでのレコードを加えた
+    uint32_t record_count;
+    const unsigned char* records;
+    const unsigned char* records_end;
+} KnowledgeSnapshotSegment;
+
+// 読み込んだスナップショット（パスから引くハッシュ表付き）
+typedef struct {
+    unsigned char* data;
+    KnowledgeSnapshotEntry* entries;
+    int count;
+    int* buckets;       // オープンアドレス法、空きは -1
+    int bucket_count;
+    KnowledgeSnapshotSegment* segments;
+    int segment_count;
+} KnowledgeSnapshot;
+
+// スナップショットの読み取り位置
+typedef struct {
+    const unsigned char* p;
+    const unsigned char* end;
+    bool ok;
+} SnapshotReader;
+
+// 並列に解析するファイルの割り振り
+typedef struct {
+    KnowledgeDocument* documents;
+    KnowledgeFile* files;
+    float* vectors;
+    const int* pending;         // 解析するファイルの番号
+    int pending_count;
+    int next;
+    pthread_mutex_t mutex;
+} KnowledgeLoadJob;
+
+// 解析を受け持つスレッド（文字列はスレッドごとのストアに置き、最後に知識ベースのストアへ移す）
+typedef struct {
+    KnowledgeLoadJob* job;
+    KnowledgeStore store;
+    char* content;              // 内容を組み立てる作業領域（ファイル間で使い回す）
+    size_t content_capacity;
+    pthread_t thread;
+} KnowledgeLoadWorker;
+
+// .md ファイルを readdir の順に集める（サブディレクトリも含む）
+static void collect_knowledge_files(const char* dir_path, KnowledgeFileList* list) {
+    DIR* dir = opendir(dir_path);
+    if (!dir) {
+        return;
     }
     
-    DIR* dir = opendir(kb->base_dir);
-    if (!dir) {
-        fprintf(stderr, "ディレクトリオープンエラー: %s\n", kb->base_dir);
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        // "."と".."は無視
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+        
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            // サブディレクトリを再帰的に処理
+            collect_knowledge_files(path, list);
+            continue;
+        }
+        if (!S_ISREG(st.st_mode)) {
+            continue;
+        }
+        
+        // .mdファイルのみ処理
+        size_t len = strlen(entry->d_name);
+        if (len < 4 || strcmp(entry->d_name + len - 3, ".md") != 0) {
+            continue;
+        }
+        
+        if (list->count >= list->capacity) {
+            int new_capacity = list->capacity > 0 ? list->capacity * 2 : KB_INITIAL_CAPACITY;
+            KnowledgeFile* files = (KnowledgeFile*)realloc(list->files, sizeof(KnowledgeFile) * new_capacity);
+            if (!files) {
+                fprintf(stderr, "メモリ割り当てエラー: ファイル一覧の拡張に失敗しました\n");
+                break;
+            }
+            list->files = files;
+            list->capacity = new_capacity;
+        }
+        
+        KnowledgeFile* file = &list->files[list->count++];
+        memset(file, 0, sizeof(*file));
+        snprintf(file->path, sizeof(file->path), "%s", path);
+        
+        // タイトルはファイル名から
+        size_t title_len = len - 3 < sizeof(file->title) ? len - 3 : sizeof(file->title) - 1;
+        memcpy(file->title, entry->d_name, title_len);
+        file->title[title_len] = '\0';
+        
+        file->mtime = (long long)st.st_mtime;
+        file->size = (long long)st.st_size;
+    }
+    
+    closedir(dir);
+}
+
+// ファイルのタグ行（カンマ区切り）を解析
+static bool parse_knowledge_tags(KnowledgeDocument* doc, char* value, KnowledgeStore* store) {
+    char* saveptr = NULL;
+    char* tag = strtok_r(value, ",", &saveptr);
+    doc->tag_count = 0;
+    while (tag && doc->tag_count < KNOWLEDGE_MAX_TAGS) {
+        // 先頭と末尾の空白をスキップ
+        while (*tag == ' ') {
+            tag++;
+        }
+        char* end = tag + strlen(tag) - 1;
+        while (end > tag && *end == ' ') {
+            *end = '\0';
+            end--;
+        }
+        
+        doc->tags[doc->tag_count] = knowledge_store_copy(store, tag, strlen(tag));
+        if (!doc->tags[doc->tag_count]) {
+            return false;
+        }
+        doc->tag_count++;
+        
+        tag = strtok_r(NULL, ",", &saveptr);
+    }
+    return true;
+}
+
+// マークダウンファイルを1つ解析し、文字列をワーカーのストアに置く（ワーカーごとに別のストアなので同時に呼べる）
+static bool parse_knowledge_file(const KnowledgeFile* source, KnowledgeDocument* doc, KnowledgeLoadWorker* worker) {
+    FILE* file = fopen(source->path, "r");
+    if (!file) {
         return false;
     }
     
-    struct dirent* entry;
-    kb->count = 0;
+    // ドキュメントを初期化
+    memset(doc, 0, sizeof(KnowledgeDocument));
+    doc->title = knowledge_store_copy(&worker->store, source->title, strlen(source->title));
+    doc->category = "";
+    if (!doc->title) {
+        fclose(file);
+        return false;
+    }
     
-    // ベクトルデータベースをクリア
-    init_vector_db(&kb->vector_db);
+    // メタデータを読み込む
+    char line[MAX_LINE_LENGTH];
+    bool in_metadata = false;
+    bool in_content = false;
+    bool ok = true;
+    size_t content_len = 0;
     
-    // サブディレクトリも含めて処理するための関数
-    bool process_directory(const char* dir_path) {
-        DIR* subdir = opendir(dir_path);
-        if (!subdir) {
-            return false;
+    while (ok && fgets(line, sizeof(line), file)) {
+        // 改行を削除
+        size_t line_len = strlen(line);
+        if (line_len > 0 && line[line_len - 1] == '\n') {
+            line[line_len - 1] = '\0';
+            line_len--;
         }
         
-        struct dirent* subentry;
-        while ((subentry = readdir(subdir)) != NULL) {
-            // "."と".."は無視
-            if (strcmp(subentry->d_name, ".") == 0 || strcmp(subentry->d_name, "..") == 0) {
-                continue;
+        // メタデータセクションの開始/終了
+        if (strcmp(line, "---") == 0) {
+            if (!in_metadata) {
+                in_metadata = true;
+            } else {
+                in_metadata = false;
+                in_content = true;
             }
-            
-            char subpath[512];
-            snprintf(subpath, sizeof(subpath), "%s/%s", dir_path, subentry->d_name);
-            
-            struct stat st;
-            if (stat(subpath, &st) == 0) {
-                if (S_ISDIR(st.st_mode)) {
-                    // サブディレクトリを再帰的に処理
-                    process_directory(subpath);
-                } else if (S_ISREG(st.st_mode)) {
-                    // .mdファイルのみ処理
-                    size_t len = strlen(subentry->d_name);
-                    if (len < 4 || strcmp(subentry->d_name + len - 3, ".md") != 0) {
-                        continue;
-                    }
-                    
-                    // ファイルを開く
-                    FILE* file = fopen(subpath, "r");
-                    if (!file) {
-                        continue;
-                    }
-                    
-                    // 容量が足りない場合は拡張
-                    if (kb->count >= kb->capacity) {
-                        int new_capacity = kb->capacity * 2;
-                        KnowledgeDocument* new_documents = (KnowledgeDocument*)realloc(kb->documents, sizeof(KnowledgeDocument) * new_capacity);
-                        if (!new_documents) {
-                            fprintf(stderr, "メモリ割り当てエラー: 知識ベースの拡張に失敗しました\n");
-                            fclose(file);
-                            continue;
-                        }
-                        kb->documents = new_documents;
-                        kb->capacity = new_capacity;
-                    }
-                    
-                    // ドキュメントを初期化
-                    memset(&kb->documents[kb->count], 0, sizeof(KnowledgeDocument));
-                    
-                    // タイトルを設定（ファイル名から）
-                    strncpy(kb->documents[kb->count].title, subentry->d_name, len - 3);
-                    kb->documents[kb->count].title[len - 3] = '\0';
-                    
-                    // メタデータを読み込む
-                    char line[MAX_LINE_LENGTH];
-                    bool in_metadata = false;
-                    bool in_content = false;
-                    
-                    while (fgets(line, sizeof(line), file)) {
-                        // 改行を削除
-                        size_t line_len = strlen(line);
-                        if (line_len > 0 && line[line_len - 1] == '\n') {
-                            line[line_len - 1] = '\0';
-                            line_len--;
-                        }
-                        
-                        // メタデータセクションの開始/終了
-                        if (strcmp(line, "---") == 0) {
-                            if (!in_metadata) {
-                                in_metadata = true;
-                            } else {
-                                in_metadata = false;
-                                in_content = true;
-                                continue;
-                            }
-                            continue;
-                        }
-                        
-                        if (in_metadata) {
-                            // メタデータの解析
-                            char* key = line;
-                            char* value = strchr(line, ':');
-                            if (value) {
-                                *value = '\0';
-                                value++;
-                                // 先頭の空白をスキップ
-                                while (*value == ' ') {
-                                    value++;
-                                }
-                                
-                                if (strcmp(key, "category") == 0) {
-                                    strncpy(kb->documents[kb->count].category, value, sizeof(kb->documents[kb->count].category) - 1);
-                                    kb->documents[kb->count].category[sizeof(kb->documents[kb->count].category) - 1] = '\0';
-                                } else if (strcmp(key, "tags") == 0) {
-                                    // タグをカンマで分割
-                                    char* tag = strtok(value, ",");
-                                    kb->documents[kb->count].tag_count = 0;
-                                    while (tag && kb->documents[kb->count].tag_count < 10) {
-                                        // 先頭と末尾の空白をスキップ
-                                        while (*tag == ' ') {
-                                            tag++;
-                                        }
-                                        char* end = tag + strlen(tag) - 1;
-                                        while (end > tag && *end == ' ') {
-                                            *end = '\0';
-                                            end--;
-                                        }
-                                        
-                                        strncpy(kb->documents[kb->count].tags[kb->documents[kb->count].tag_count], tag, sizeof(kb->documents[kb->count].tags[0]) - 1);
-                                        kb->documents[kb->count].tags[kb->documents[kb->count].tag_count][sizeof(kb->documents[kb->count].tags[0]) - 1] = '\0';
-                                        kb->documents[kb->count].tag_count++;
-                                        
-                                        tag = strtok(NULL, ",");
-                                    }
-                                } else if (strcmp(key, "created_at") == 0) {
-                                    struct tm tm = {0};
-                                    if (strptime(value, "%Y-%m-%d %H:%M:%S", &tm) != NULL) {
-                                        kb->documents[kb->count].created_at = mktime(&tm);
-                                    }
-                                } else if (strcmp(key, "updated_at") == 0) {
-                                    struct tm tm = {0};
-                                    if (strptime(value, "%Y-%m-%d %H:%M:%S", &tm) != NULL) {
-                                        kb->documents[kb->count].updated_at = mktime(&tm);
-                                    }
-                                }
-                            }
-                        } else if (in_content) {
-                            // 内容を追加
-                            size_t content_len = strlen(kb->documents[kb->count].content);
-                            size_t remaining = sizeof(kb->documents[kb->count].content) - content_len - 1;
-                            
-                            if (remaining > 0) {
-                                strncat(kb->documents[kb->count].content, line, remaining);
-                                strncat(kb->documents[kb->count].content, "\n", remaining - strlen(line));
-                            }
-                        }
+            continue;
+        }
+        
+        if (in_metadata) {
+            // メタデータの解析
+            char* key = line;
+            char* value = strchr(line, ':');
+            if (value) {
+                *value = '\0';
+                value++;
+                // 先頭の空白をスキップ
+                while (*value == ' ') {
+                    value++;
+                }
+                
+                if (strcmp(key, "category") == 0) {
+                    doc->category = knowledge_store_copy(&worker->store, value, strlen(value));
+                    ok = doc->category != NULL;
+                } else if (strcmp(key, "tags") == 0) {
+                    ok = parse_knowledge_tags(doc, value, &worker->store);
+                } else if (strcmp(key, "created_at") == 0) {
+                    struct tm tm = {0};
+                    if (strptime(value, "%Y-%m-%d %H:%M:%S", &tm) != NULL) {
+                        doc->created_at = mktime(&tm);
                     }
-                    
-                    fclose(file);
-                    
-                    // ドキュメントをベクトル化してベクトルデータベースに追加
-                    float* vector = knowledge_document_vectorize(&kb->documents[kb->count]);
-                    if (vector) {
-                        add_vector(&kb->vector_db, vector, kb->count);
-                        free(vector);
+                } else if (strcmp(key, "updated_at") == 0) {
+                    struct tm tm = {0};
+                    if (strptime(value, "%Y-%m-%d %H:%M:%S", &tm) != NULL) {
+                        doc->updated_at = mktime(&tm);
                     }
-                    
-                    kb->count++;
                 }
             }
+        } else if (in_content) {
+            // 内容を作業領域に追加（足りなければ倍に広げる）
+            if (content_len + line_len + 2 > worker->content_capacity) {
+                size_t new_capacity = worker->content_capacity > 0 ? worker->content_capacity : MAX_LINE_LENGTH;
+                while (content_len + line_len + 2 > new_capacity) {
+                    new_capacity *= 2;
+                }
+                char* new_content = (char*)realloc(worker->content, new_capacity);
+                if (!new_content) {
+                    ok = false;
+                    break;
+                }
+                worker->content = new_content;
+                worker->content_capacity = new_capacity;
+            }
+            memcpy(worker->content + content_len, line, line_len);
+            content_len += line_len;
+            worker->content[content_len++] = '\n';
+        }
+    }
+    
+    fclose(file);
+    
+    // 内容はちょうどの長さでストアに置く
+    if (ok) {
+        doc->content = knowledge_store_copy(&worker->store, content_len > 0 ? worker->content : "", content_len);
+        doc->content_length = content_len;
+        ok = doc->content != NULL;
+    }
+    return ok;
+}
+
+// 割り振られたファイルを順に解析してベクトル化する
+static void* knowledge_load_worker(void* arg) {
+    KnowledgeLoadWorker* worker = (KnowledgeLoadWorker*)arg;
+    KnowledgeLoadJob* job = worker->job;
+    
+    for (;;) {
+        pthread_mutex_lock(&job->mutex);
+        int k = job->next < job->pending_count ? job->next++ : -1;
+        pthread_mutex_unlock(&job->mutex);
+        if (k < 0) {
+            break;
         }
         
-        closedir(subdir);
-        return true;
+        int index = job->pending[k];
+        KnowledgeDocument* doc = &job->documents[index];
+        job->files[index].loaded = parse_knowledge_file(&job->files[index], doc, worker);
+        if (job->files[index].loaded) {
+            float* vector = knowledge_document_vectorize(doc);
+            if (vector) {
+                memcpy(job->vectors + (size_t)index * VECTOR_DIM, vector, sizeof(float) * VECTOR_DIM);
+                free(vector);
+            } else {
+                job->files[index].loaded = false;
+            }
+        }
     }
     
-    // ルートディレクトリを処理
-    while ((entry = readdir(dir)) != NULL) {
-        // "."と".."は無視
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
+    return NULL;
+}
+
+// 解析するファイルを複数スレッドで処理する（呼び出し元も解析を受け持つ）
+static void knowledge_load_parallel(KnowledgeLoadJob* job, KnowledgeStore* store) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 0 ? (int)cpus : 1;
+    int by_files = (job->pending_count + KB_LOAD_FILES_PER_THREAD - 1) / KB_LOAD_FILES_PER_THREAD;
+    if (threads > by_files) threads = by_files;
+    if (threads > KB_LOAD_MAX_THREADS) threads = KB_LOAD_MAX_THREADS;
+    if (threads < 1) threads = 1;
+    
+    KnowledgeLoadWorker workers[KB_LOAD_MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+        workers[i].job = job;
+        knowledge_store_init(&workers[i].store);
+        workers[i].content = NULL;
+        workers[i].content_capacity = 0;
+    }
+    
+    int started = 1;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&workers[started].thread, NULL, knowledge_load_worker, &workers[started]) != 0) {
+            break;
+        }
+        started++;
+    }
+    
+    knowledge_load_worker(&workers[0]);
+    
+    for (int i = 0; i < started; i++) {
+        if (i > 0) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        knowledge_store_merge(store, &workers[i].store);
+        free(workers[i].content);
+    }
+}
+
+// パスのハッシュ値
+static unsigned int knowledge_path_hash(const char* path, size_t len) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t snapshot_read_u32(SnapshotReader* reader) {
+    uint32_t value = 0;
+    if (reader->ok && (size_t)(reader->end - reader->p) >= sizeof(value)) {
+        memcpy(&value, reader->p, sizeof(value));
+        reader->p += sizeof(value);
+    } else {
+        reader->ok = false;
+    }
+    return value;
+}
+
+static long long snapshot_read_i64(SnapshotReader* reader) {
+    int64_t value = 0;
+    if (reader->ok && (size_t)(reader->end - reader->p) >= sizeof(value)) {
+        memcpy(&value, reader->p, sizeof(value));
+        reader->p += sizeof(value);
+    } else {
+        reader->ok = false;
+    }
+    return (long long)value;
+}
+
+// len バイトを読み飛ばし、その先頭を返す
+static const unsigned char* snapshot_read_bytes(SnapshotReader* reader, size_t len) {
+    if (!reader->ok || (size_t)(reader->end - reader->p) < len) {
+        reader->ok = false;
+        return NULL;
+    }
+    const unsigned char* bytes = reader->p;
+    reader->p += len;
+    return bytes;
+}
+
+// 長さ付きの文字列をストアにコピー（length があれば長さを返す）
+static const char* snapshot_read_string(SnapshotReader* reader, KnowledgeStore* store, size_t* length) {
+    uint32_t len = snapshot_read_u32(reader);
+    const unsigned char* bytes = snapshot_read_bytes(reader, len);
+    if (!bytes) {
+        return NULL;
+    }
+    const char* copy = knowledge_store_copy(store, (const char*)bytes, len);
+    if (!copy) {
+        reader->ok = false;
+    }
+    if (length) {
+        *length = len;
+    }
+    return copy;
+}
+
+// スナップショットを解放
+static void knowledge_snapshot_free(KnowledgeSnapshot* snapshot) {
+    free(snapshot->data);
+    free(snapshot->entries);
+    free(snapshot->buckets);
+    free(snapshot->segments);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+// スナップショットを読み込む（なければ、または形式が違えば空のまま false を返す）
+static bool knowledge_snapshot_load(KnowledgeSnapshot* snapshot, const char* filename) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        return false;
+    }
+    
+    long file_size = -1;
+    if (fseek(file, 0, SEEK_END) == 0) {
+        file_size = ftell(file);
+        rewind(file);
+    }
+    if (file_size <= 0) {
+        fclose(file);
+        return false;
+    }
+    
+    snapshot->data = (unsigned char*)malloc((size_t)file_size);
+    if (!snapshot->data || fread(snapshot->data, 1, (size_t)file_size, file) != (size_t)file_size) {
+        fclose(file);
+        knowledge_snapshot_free(snapshot);
+        return false;
+    }
+    fclose(file);
+    
+    // ヘッダーを確認
+    SnapshotReader reader = {snapshot->data, snapshot->data + file_size, true};
+    const unsigned char* magic = snapshot_read_bytes(&reader, 4);
+    uint32_t version = snapshot_read_u32(&reader);
+    uint32_t vector_dim = snapshot_read_u32(&reader);
+    uint32_t count = snapshot_read_u32(&reader);
+    if (!reader.ok || memcmp(magic, KB_SNAPSHOT_MAGIC, 4) != 0 ||
+        version != KB_SNAPSHOT_VERSION || vector_dim != VECTOR_DIM || count > (uint32_t)file_size) {
+        knowledge_snapshot_free(snapshot);
+        return false;
+    }
+    
+    snapshot->bucket_count = 16;
+    while (snapshot->bucket_count < (int)count * 2) {
+        snapshot->bucket_count *= 2;
+    }
+    snapshot->entries = (KnowledgeSnapshotEntry*)malloc(sizeof(KnowledgeSnapshotEntry) * (count > 0 ? count : 1));
+    snapshot->buckets = (int*)malloc(sizeof(int) * snapshot->bucket_count);
+    if (!snapshot->entries || !snapshot->buckets) {
+        knowledge_snapshot_free(snapshot);
+        return false;
+    }
+    memset(snapshot->buckets, -1, sizeof(int) * snapshot->bucket_count);
+    
+    // 各エントリはパスとファイルの状態だけを読み、本体は使うときに解析する
+    unsigned int mask = (unsigned int)snapshot->bucket_count - 1;
+    for (uint32_t i = 0; i < count; i++) {
+        KnowledgeSnapshotEntry* entry = &snapshot->entries[i];
+        entry->path_len = snapshot_read_u32(&reader);
+        entry->path = (const char*)snapshot_read_bytes(&reader, entry->path_len);
+        entry->mtime = snapshot_read_i64(&reader);
+        entry->size = snapshot_read_i64(&reader);
+        uint32_t record_size = snapshot_read_u32(&reader);
+        entry->record = snapshot_read_bytes(&reader, record_size);
+        entry->record_size = record_size;
+        if (!reader.ok) {
+            knowledge_snapshot_free(snapshot);
+            return false;
         }
         
+        unsigned int slot = knowledge_path_hash(entry->path, entry->path_len) & mask;
+        while (snapshot->buckets[slot] >= 0) {
+            slot = (slot + 1) & mask;
+        }
+        snapshot->buckets[slot] = (int)i;
+        snapshot->count++;
+    }
+    
+    // 続いてログファイルごとのドキュメント
+    uint32_t segment_count = snapshot_read_u32(&reader);
+    if (!reader.ok || segment_count > (uint32_t)file_size) {
+        knowledge_snapshot_free(snapshot);
+        return false;
+    }
+    snapshot->segments = (KnowledgeSnapshotSegment*)malloc(sizeof(KnowledgeSnapshotSegment) * (segment_count > 0 ? segment_count : 1));
+    if (!snapshot->segments) {
+        knowledge_snapshot_free(snapshot);
+        return false;
+    }
+    for (uint32_t i = 0; i < segment_count; i++) {
+        KnowledgeSnapshotSegment* segment = &snapshot->segments[i];
+        segment->path_len = snapshot_read_u32(&reader);
+        segment->path = (const char*)snapshot_read_bytes(&reader, segment->path_len);
+        segment->mtime = snapshot_read_i64(&reader);
+        segment->size = snapshot_read_i64(&reader);
+        segment->record_count = snapshot_read_u32(&reader);
+        segment->records = reader.p;
+        for (uint32_t j = 0; j < segment->record_count && reader.ok; j++) {
+            snapshot_read_bytes(&reader, snapshot_read_u32(&reader));
+        }
+        segment->records_end = reader.p;
+        if (!reader.ok) {
+            knowledge_snapshot_free(snapshot);
+            return false;
+        }
+        snapshot->segment_count++;
+    }
+    
+    return true;
+}
+
+// 記録したログファイルがすべて残っているか（追記されて大きくなったものはよい）
+static bool knowledge_snapshot_segments_valid(const KnowledgeSnapshot* snapshot) {
+    for (int i = 0; i < snapshot->segment_count; i++) {
+        const KnowledgeSnapshotSegment* segment = &snapshot->segments[i];
         char path[512];
-        snprintf(path, sizeof(path), "%s/%s", kb->base_dir, entry->d_name);
+        if (segment->path_len >= sizeof(path)) {
+            return false;
+        }
+        memcpy(path, segment->path, segment->path_len);
+        path[segment->path_len] = '\0';
         
         struct stat st;
-        if (stat(path, &st) == 0) {
-            if (S_ISDIR(st.st_mode)) {
-                // サブディレクトリを処理
-                process_directory(path);
-            } else if (S_ISREG(st.st_mode)) {
-                // .mdファイルのみ処理
-                size_t len = strlen(entry->d_name);
-                if (len < 4 || strcmp(entry->d_name + len - 3, ".md") != 0) {
-                    continue;
-                }
-                
-                // ファイルを開く
-                FILE* file = fopen(path, "r");
-                if (!file) {
-                    continue;
-                }
-                
-                // 容量が足りない場合は拡張
-                if (kb->count >= kb->capacity) {
-                    int new_capacity = kb->capacity * 2;
-                    KnowledgeDocument* new_documents = (KnowledgeDocument*)realloc(kb->documents, sizeof(KnowledgeDocument) * new_capacity);
-                    if (!new_documents) {
-                        fprintf(stderr, "メモリ割り当てエラー: 知識ベースの拡張に失敗しました\n");
-                        fclose(file);
-                        continue;
-                    }
-                    kb->documents = new_documents;
-                    kb->capacity = new_capacity;
-                }
-                
-                // ドキュメントを初期化
-                memset(&kb->documents[kb->count], 0, sizeof(KnowledgeDocument));
-                
-                // タイトルを設定（ファイル名から）
-                strncpy(kb->documents[kb->count].title, entry->d_name, len - 3);
-                kb->documents[kb->count].title[len - 3] = '\0';
-                
-                // メタデータを読み込む
-                char line[MAX_LINE_LENGTH];
-                bool in_metadata = false;
-                bool in_content = false;
-                
-                while (fgets(line, sizeof(line), file)) {
-                    // 改行を削除
-                    size_t line_len = strlen(line);
-                    if (line_len > 0 && line[line_len - 1] == '\n') {
-                        line[line_len - 1] = '\0';
-                        line_len--;
-                    }
-                    
-                    // メタデータセクションの開始/終了
-                    if (strcmp(line, "---") == 0) {
-                        if (!in_metadata) {
-                            in_metadata = true;
-                        } else {
-                            in_metadata = false;
-                            in_content = true;
-                            continue;
-                        }
-                        continue;
-                    }
-                    
-                    if (in_metadata) {
-                        // メタデータの解析
-                        char* key = line;
-                        char* value = strchr(line, ':');
-                        if (value) {
-                            *value = '\0';
-                            value++;
-                            // 先頭の空白をスキップ
-                            while (*value == ' ') {
-                                value++;
-                            }
-                            
-                            if (strcmp(key, "category") == 0) {
-                                strncpy(kb->documents[kb->count].category, value, sizeof(kb->documents[kb->count].category) - 1);
-                                kb->documents[kb->count].category[sizeof(kb->documents[kb->count].category) - 1] = '\0';
-                            } else if (strcmp(key, "tags") == 0) {
-                                // タグをカンマで分割
-                                char* tag = strtok(value, ",");
-                                kb->documents[kb->count].tag_count = 0;
-                                while (tag && kb->documents[kb->count].tag_count < 10) {
-                                    // 先頭と末尾の空白をスキップ
-                                    while (*tag == ' ') {
-                                        tag++;
-                                    }
-                                    char* end = tag + strlen(tag) - 1;
-                                    while (end > tag && *end == ' ') {
-                                        *end = '\0';
-                                        end--;
-                                    }
-                                    
-                                    strncpy(kb->documents[kb->count].tags[kb->documents[kb->count].tag_count], tag, sizeof(kb->documents[kb->count].tags[0]) - 1);
-                                    kb->documents[kb->count].tags[kb->documents[kb->count].tag_count][sizeof(kb->documents[kb->count].tags[0]) - 1] = '\0';
-                                    kb->documents[kb->count].tag_count++;
-                                    
-                                    tag = strtok(NULL, ",");
-                                }
-                            } else if (strcmp(key, "created_at") == 0) {
-                                struct tm tm = {0};
-                                if (strptime(value, "%Y-%m-%d %H:%M:%S", &tm) != NULL) {
-                                    kb->documents[kb->count].created_at = mktime(&tm);
-                                }
-                            } else if (strcmp(key, "updated_at") == 0) {
-                                struct tm tm = {0};
-                                if (strptime(value, "%Y-%m-%d %H:%M:%S", &tm) != NULL) {
-                                    kb->documents[kb->count].updated_at = mktime(&tm);
-                                }
-                            }
-                        }
-                    } else if (in_content) {
-                        // 内容を追加
-                        size_t content_len = strlen(kb->documents[kb->count].content);
-                        size_t remaining = sizeof(kb->documents[kb->count].content) - content_len - 1;
-                        
-                        if (remaining > 0) {
-                            strncat(kb->documents[kb->count].content, line, remaining);
-                            strncat(kb->documents[kb->count].content, "\n", remaining - strlen(line));
-                        }
-                    }
-                }
-                
-                fclose(file);
-                
-                // ドキュメントをベクトル化してベクトルデータベースに追加
-                float* vector = knowledge_document_vectorize(&kb->documents[kb->count]);
-                if (vector) {
-                    add_vector(&kb->vector_db, vector, kb->count);
-                    free(vector);
+        if (stat(path, &st) != 0 || (long long)st.st_size < segment->size ||
+            ((long long)st.st_size == segment->size && (long long)st.st_mtime != segment->mtime)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// パスとファイルの状態が一致するエントリを探す（なければ NULL）
+static const KnowledgeSnapshotEntry* knowledge_snapshot_find(const KnowledgeSnapshot* snapshot, const KnowledgeFile* file) {
+    if (snapshot->count == 0) {
+        return NULL;
+    }
+    
+    size_t path_len = strlen(file->path);
+    unsigned int mask = (unsigned int)snapshot->bucket_count - 1;
+    unsigned int slot = knowledge_path_hash(file->path, path_len) & mask;
+    while (snapshot->buckets[slot] >= 0) {
+        const KnowledgeSnapshotEntry* entry = &snapshot->entries[snapshot->buckets[slot]];
+        if (entry->path_len == path_len && memcmp(entry->path, file->path, path_len) == 0) {
+            return (entry->mtime == file->mtime && entry->size == file->size) ? entry : NULL;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+// スナップショットに記録した本体からドキュメントとベクトルを復元
+static bool knowledge_snapshot_restore(const unsigned char* record, size_t record_size, KnowledgeDocument* doc, float* vector,
+                                       KnowledgeStore* store) {
+    SnapshotReader reader = {record, record + record_size, true};
+    
+    memset(doc, 0, sizeof(KnowledgeDocument));
+    doc->title = snapshot_read_string(&reader, store, NULL);
+    doc->category = snapshot_read_string(&reader, store, NULL);
+    uint32_t tag_count = snapshot_read_u32(&reader);
+    for (uint32_t i = 0; i < tag_count && reader.ok; i++) {
+        if (i < KNOWLEDGE_MAX_TAGS) {
+            doc->tags[doc->tag_count++] = snapshot_read_string(&reader, store, NULL);
+        } else {
+            snapshot_read_bytes(&reader, snapshot_read_u32(&reader));
+        }
+    }
+    doc->created_at = (time_t)snapshot_read_i64(&reader);
+    doc->updated_at = (time_t)snapshot_read_i64(&reader);
+    doc->content = snapshot_read_string(&reader, store, &doc->content_length);
+    
+    const unsigned char* bytes = snapshot_read_bytes(&reader, sizeof(float) * VECTOR_DIM);
+    if (bytes) {
+        memcpy(vector, bytes, sizeof(float) * VECTOR_DIM);
+    }
+    return reader.ok;
+}
+
+static bool snapshot_write_u32(FILE* file, uint32_t value) {
+    return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+static bool snapshot_write_i64(FILE* file, long long value) {
+    int64_t v = (int64_t)value;
+    return fwrite(&v, sizeof(v), 1, file) == 1;
+}
+
+static bool snapshot_write_string(FILE* file, const char* s, size_t length) {
+    uint32_t len = (uint32_t)length;
+    return snapshot_write_u32(file, len) && (len == 0 || fwrite(s, 1, len, file) == len);
+}
+
+// ドキュメント本体の大きさ（エントリの record_size）
+static uint32_t snapshot_record_size(const KnowledgeDocument* doc) {
+    size_t size = 4 + strlen(doc->title) + 4 + strlen(doc->category) + 4;
+    for (int i = 0; i < doc->tag_count; i++) {
+        size += 4 + strlen(doc->tags[i]);
+    }
+    size += 8 + 8 + 4 + doc->content_length + sizeof(float) * VECTOR_DIM;
+    return (uint32_t)size;
+}
+
+// ドキュメント本体を大きさ付きで書く
+static bool snapshot_write_record(FILE* file, const KnowledgeDocument* doc, const float* vector) {
+    bool ok = snapshot_write_u32(file, snapshot_record_size(doc)) &&
+              snapshot_write_string(file, doc->title, strlen(doc->title)) &&
+              snapshot_write_string(file, doc->category, strlen(doc->category)) &&
+              snapshot_write_u32(file, (uint32_t)doc->tag_count);
+    for (int t = 0; ok && t < doc->tag_count; t++) {
+        ok = snapshot_write_string(file, doc->tags[t], strlen(doc->tags[t]));
+    }
+    return ok && snapshot_write_i64(file, (long long)doc->created_at) &&
+           snapshot_write_i64(file, (long long)doc->updated_at) &&
+           snapshot_write_string(file, doc->content, doc->content_length) &&
+           fwrite(vector, sizeof(float), VECTOR_DIM, file) == VECTOR_DIM;
+}
+
+// スナップショットを書き出す（一時ファイルに書いてから置き換える、読み込みロックを取得済みで呼ぶ）
+// 知識ファイルのドキュメントはパスごとに、ログファイルのドキュメントはファイルごとにまとめて書く
+static bool knowledge_snapshot_save(const char* filename, const KnowledgeBase* kb) {
+    // ドキュメントごとの最新のベクトルの行（更新したドキュメントは後ろの行に新しいベクトルがある）
+    // ログファイルのドキュメントは、ファイルごとに数えてから並べる
+    int count = kb->count;
+    int* rows = (int*)malloc(sizeof(int) * (count > 0 ? count : 1));
+    int* segment_starts = (int*)calloc((size_t)kb->log_segment_count + 1, sizeof(int));
+    int* order = (int*)malloc(sizeof(int) * (count > 0 ? count : 1));
+    if (!rows || !segment_starts || !order) {
+        fprintf(stderr, "メモリ割り当てエラー: 知識ベースのスナップショットを保存できませんでした\n");
+        free(rows);
+        free(segment_starts);
+        free(order);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        rows[i] = -1;
+    }
+    for (int row = 0; row < kb->vector_db.size; row++) {
+        int id = kb->vector_db.ids[row];
+        if (id >= 0 && id < count) {
+            rows[id] = row;
+        }
+    }
+    uint32_t file_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (rows[i] < 0) {
+            continue;
+        }
+        if (kb->sources[i].path) {
+            file_count++;
+        } else if (kb->sources[i].segment >= 0) {
+            segment_starts[kb->sources[i].segment + 1]++;
+        }
+    }
+    for (int s = 0; s < kb->log_segment_count; s++) {
+        segment_starts[s + 1] += segment_starts[s];
+    }
+    int* cursors = segment_starts;
+    for (int i = 0; i < count; i++) {
+        if (rows[i] >= 0 && !kb->sources[i].path && kb->sources[i].segment >= 0) {
+            order[cursors[kb->sources[i].segment]++] = i;
+        }
+    }
+    // 振り分けで各ファイルの開始位置が次のファイルの開始位置まで進んだので、一つずらして戻す
+    for (int s = kb->log_segment_count; s > 0; s--) {
+        segment_starts[s] = segment_starts[s - 1];
+    }
+    segment_starts[0] = 0;
+    
+    char temp_filename[600];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+    
+    FILE* file = fopen(temp_filename, "wb");
+    if (!file) {
+        fprintf(stderr, "ファイルオープンエラー: %s\n", temp_filename);
+        free(rows);
+        free(segment_starts);
+        free(order);
+        return false;
+    }
+    
+    bool ok = fwrite(KB_SNAPSHOT_MAGIC, 4, 1, file) == 1 &&
+              snapshot_write_u32(file, KB_SNAPSHOT_VERSION) &&
+              snapshot_write_u32(file, VECTOR_DIM) &&
+              snapshot_write_u32(file, file_count);
+    
+    for (int i = 0; ok && i < count; i++) {
+        const KnowledgeSource* source = &kb->sources[i];
+        if (rows[i] < 0 || !source->path) {
+            continue;
+        }
+        ok = snapshot_write_string(file, source->path, strlen(source->path)) &&
+             snapshot_write_i64(file, source->mtime) &&
+             snapshot_write_i64(file, source->size) &&
+             snapshot_write_record(file, &kb->documents[i], get_vector(&kb->vector_db, rows[i]));
+    }
+    
+    ok = ok && snapshot_write_u32(file, (uint32_t)kb->log_segment_count);
+    for (int s = 0; ok && s < kb->log_segment_count; s++) {
+        const KnowledgeLogSegment* segment = &kb->log_segments[s];
+        ok = snapshot_write_string(file, segment->path, strlen(segment->path)) &&
+             snapshot_write_i64(file, segment->mtime) &&
+             snapshot_write_i64(file, segment->size) &&
+             snapshot_write_u32(file, (uint32_t)(segment_starts[s + 1] - segment_starts[s]));
+        for (int j = segment_starts[s]; ok && j < segment_starts[s + 1]; j++) {
+            ok = snapshot_write_record(file, &kb->documents[order[j]], get_vector(&kb->vector_db, rows[order[j]]));
+        }
+    }
+    
+    free(rows);
+    free(segment_starts);
+    free(order);
+    
+    if (fclose(file) != 0) {
+        ok = false;
+    }
+    if (!ok || rename(temp_filename, filename) != 0) {
+        fprintf(stderr, "知識ベースのスナップショットを保存できませんでした: %s\n", filename);
+        remove(temp_filename);
+        return false;
+    }
+    return true;
+}
+
+// 復元したドキュメントを加える（同じタイトルがあれば置き換える、書き込みロックを取得済みで呼ぶ）
+// 文字列は知識ベースのストアにあるものを使う
+static bool knowledge_base_put_document_unlocked(KnowledgeBase* kb, const KnowledgeDocument* doc, float* vector, int segment) {
+    int i = knowledge_index_find_first(&kb->index, KNOWLEDGE_FIELD_TITLE, doc->title);
+    bool added = i < 0;
+    if (added) {
+        if (!knowledge_base_reserve(kb, kb->count + 1)) {
+            fprintf(stderr, "メモリ割り当てエラー: 知識ベースの拡張に失敗しました\n");
+            return false;
+        }
+        i = kb->count;
+    } else {
+        knowledge_base_index_document(kb, i, true);
+    }
+    
+    kb->documents[i] = *doc;
+    kb->sources[i].path = NULL;
+    kb->sources[i].mtime = 0;
+    kb->sources[i].size = 0;
+    kb->sources[i].segment = segment;
+    if (!knowledge_base_index_document(kb, i, false) && added) {
+        knowledge_base_index_document(kb, i, true);
+        return false;
+    }
+    
+    add_vector(&kb->vector_db, vector, i);
+    if (added) {
+        kb->count++;
+    }
+    return true;
+}
+
+// スナップショットを書き出す
+bool knowledge_base_save_snapshot(KnowledgeBase* kb) {
+    if (!kb) {
+        return false;
+    }
+    
+    char snapshot_filename[512];
+    snprintf(snapshot_filename, sizeof(snapshot_filename), "%s/%s", kb->base_dir, KB_SNAPSHOT_FILE);
+    
+    pthread_rwlock_rdlock(&kb->lock);
+    bool ok = knowledge_snapshot_save(snapshot_filename, kb);
+    pthread_rwlock_unlock(&kb->lock);
+    
+    return ok;
+}
+
+// 知識ベースの読み込み
+// 前回の内容をスナップショットから復元し、新しいファイルと変更されたファイルだけを解析する
+// ログファイルから加えたドキュメントは、記録した範囲がすべて残っていればスナップショットから戻す
+bool knowledge_base_load(KnowledgeBase* kb) {
+    if (!kb) {
+        return false;
+    }
+    
+    DIR* dir = opendir(kb->base_dir);
+    if (!dir) {
+        fprintf(stderr, "ディレクトリオープンエラー: %s\n", kb->base_dir);
+        return false;
+    }
+    closedir(dir);
+    
+    pthread_rwlock_wrlock(&kb->lock);
+    kb->count = 0;
+    kb->log_segment_count = 0;
+    
+    // ドキュメントの文字列と索引、ベクトルデータベースをクリア
+    knowledge_store_free(&kb->store);
+    knowledge_index_free(&kb->index);
+    knowledge_index_init(&kb->index);
+    kb->content_indexed = false;
+    free_vector_db(&kb->vector_db);
+    
+    KnowledgeFileList list = {NULL, 0, 0};
+    collect_knowledge_files(kb->base_dir, &list);
+    
+    // 容量が足りない場合は拡張
+    if (!knowledge_base_reserve(kb, list.count)) {
+        fprintf(stderr, "メモリ割り当てエラー: 知識ベースの拡張に失敗しました\n");
+        free(list.files);
+        pthread_rwlock_unlock(&kb->lock);
+        return false;
+    }
+    
+    float* vectors = (float*)malloc(sizeof(float) * VECTOR_DIM * (list.count > 0 ? list.count : 1));
+    int* pending = (int*)malloc(sizeof(int) * (list.count > 0 ? list.count : 1));
+    if (!vectors || !pending) {
+        fprintf(stderr, "メモリ割り当てエラー: 知識ベースの読み込みに失敗しました\n");
+        free(vectors);
+        free(pending);
+        free(list.files);
+        pthread_rwlock_unlock(&kb->lock);
+        return false;
+    }
+    
+    // 変わっていないファイルはスナップショットから復元する
+    char snapshot_filename[512];
+    snprintf(snapshot_filename, sizeof(snapshot_filename), "%s/%s", kb->base_dir, KB_SNAPSHOT_FILE);
+    KnowledgeSnapshot snapshot;
+    knowledge_snapshot_load(&snapshot, snapshot_filename);
+    
+    int pending_count = 0;
+    for (int i = 0; i < list.count; i++) {
+        KnowledgeFile* file = &list.files[i];
+        const KnowledgeSnapshotEntry* entry = knowledge_snapshot_find(&snapshot, file);
+        if (entry && knowledge_snapshot_restore(entry->record, entry->record_size, &kb->documents[i],
+                                                vectors + (size_t)i * VECTOR_DIM, &kb->store)) {
+            file->cached = true;
+            file->loaded = true;
+        } else {
+            pending[pending_count++] = i;
+        }
+    }
+    bool changed = pending_count > 0 || snapshot.count != list.count;
+    
+    // 新しいファイルと変更されたファイルを並列に解析する
+    if (pending_count > 0) {
+        KnowledgeLoadJob job;
+        job.documents = kb->documents;
+        job.files = list.files;
+        job.vectors = vectors;
+        job.pending = pending;
+        job.pending_count = pending_count;
+        job.next = 0;
+        pthread_mutex_init(&job.mutex, NULL);
+        knowledge_load_parallel(&job, &kb->store);
+        pthread_mutex_destroy(&job.mutex);
+    }
+    
+    // 読み込めたドキュメントをファイルの順に詰め、ベクトルデータベースに追加
+    reserve_vector_db(&kb->vector_db, list.count);
+    for (int i = 0; i < list.count; i++) {
+        if (!list.files[i].loaded) {
+            changed = true;
+            continue;
+        }
+        if (i != kb->count) {
+            memcpy(&kb->documents[kb->count], &kb->documents[i], sizeof(KnowledgeDocument));
+        }
+        add_vector(&kb->vector_db, vectors + (size_t)i * VECTOR_DIM, kb->count);
+        knowledge_base_index_document(kb, kb->count, false);
+        KnowledgeSource* source = &kb->sources[kb->count];
+        source->path = knowledge_store_copy(&kb->store, list.files[i].path, strlen(list.files[i].path));
+        source->mtime = list.files[i].mtime;
+        source->size = list.files[i].size;
+        source->segment = -1;
+        kb->count++;
+    }
+    
+    // ログファイルのドキュメントを書いた順に戻す（同じタイトルは後のもので置き換わる）
+    // 消えたり縮んだりしたファイルがあると、そのファイルで置き換えられた前の内容を戻せないので、
+    // どれも戻さずにログファイルを先頭から読み直させる
+    if (snapshot.segment_count > 0 && !knowledge_snapshot_segments_valid(&snapshot)) {
+        changed = true;
+    } else {
+        for (int s = 0; s < snapshot.segment_count; s++) {
+            const KnowledgeSnapshotSegment* recorded = &snapshot.segments[s];
+            int segment = knowledge_base_log_segment(kb, recorded->path, recorded->path_len, true);
+            if (segment < 0) {
+                changed = true;
+                break;
+            }
+            kb->log_segments[segment].mtime = recorded->mtime;
+            kb->log_segments[segment].size = recorded->size;
+            
+            SnapshotReader reader = {recorded->records, recorded->records_end, true};
+            for (uint32_t j = 0; j < recorded->record_count; j++) {
+                uint32_t record_size = snapshot_read_u32(&reader);
+                const unsigned char* record = snapshot_read_bytes(&reader, record_size);
+                KnowledgeDocument doc;
+                float vector[VECTOR_DIM];
+                if (!reader.ok || !knowledge_snapshot_restore(record, record_size, &doc, vector, &kb->store) ||
+                    !knowledge_base_put_document_unlocked(kb, &doc, vector, segment)) {
+                    // 途中までしか戻せなかったファイルは先頭から読み直させる
+                    kb->log_segments[segment].size = 0;
+                    changed = true;
+                    break;
                 }
-                
-                kb->count++;
             }
         }
     }
+    knowledge_snapshot_free(&snapshot);
     
-    closedir(dir);
+    // 次回の起動のためにスナップショットを更新
+    if (changed) {
+        knowledge_snapshot_save(snapshot_filename, kb);
+    }
+    
+    pthread_rwlock_unlock(&kb->lock);
+    
+    free(vectors);
+    free(pending);
+    free(list.files);
     return true;
 }
 
@@ -683,38 +1473,21 @@ float* knowledge_document_vectorize(const KnowledgeDocument* doc) {
         return NULL;
     }
     
-    // 初期化
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        vector[i] = 0.0f;
-    }
-    
     // タイトルと内容を組み合わせてベクトル化
-    char combined[16640]; // title + content の最大長 (16KB + 256B)
-    snprintf(combined, sizeof(combined), "%s %s", doc->title, doc->content);
-    
-    // 単語の文字コードを使用して決定論的にベクトル値を生成
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        float val = 0.0f;
-        for (size_t j = 0; j < strlen(combined); j++) {
-            val += (float)(combined[j] * (j+1) * (i+1)) / 10000.0f;
-        }
-        // -1.0から1.0の範囲に正規化
-        vector[i] = fmodf(val, 2.0f) - 1.0f;
-    }
-    
-    // 正規化（コサイン類似度用）
-    float sum = 0.0f;
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        sum += vector[i] * vector[i];
+    size_t title_length = strlen(doc->title);
+    char* combined = (char*)malloc(title_length + 1 + doc->content_length + 1);
+    if (!combined) {
+        free(vector);
+        return NULL;
     }
+    memcpy(combined, doc->title, title_length);
+    combined[title_length] = ' ';
+    memcpy(combined + title_length + 1, doc->content, doc->content_length + 1);
     
-    if (sum > 0.0f) {
-        float norm = sqrt(sum);
-        for (int i = 0; i < VECTOR_DIM; i++) {
-            vector[i] /= norm;
-        }
-    }
+    // 文字 n-gram の特徴ハッシュで全次元を1回の走査で求める（単位ベクトルになる）
+    text_to_feature_vector(combined, vector);
     
+    free(combined);
     return vector;
 }
 
@@ -6,26 +6,55 @@
 #include <string.h>
 #include <stdbool.h>
 #include <time.h>
+#include <pthread.h>
 #include "../vector_search/vector_search.h"
+#include "knowledge_store.h"
+#include "knowledge_index.h"
 
-// 知識ドキュメント構造体
+#define KNOWLEDGE_MAX_TAGS 10              // ドキュメントあたりのタグ数の上限
+
+// 知識ドキュメント構造体（文字列は知識ベースのストアに置き、長さの上限はない）
 typedef struct {
-    char title[256];
-    char content[16384]; // 16KBに拡大
-    char category[64];
-    char tags[10][32];
+    const char* title;
+    const char* content;
+    const char* category;
+    const char* tags[KNOWLEDGE_MAX_TAGS];
     int tag_count;
+    size_t content_length;
     time_t created_at;
     time_t updated_at;
 } KnowledgeDocument;
 
+// ドキュメントの元になったファイル（スナップショットに記録する鍵）
+typedef struct {
+    const char* path;           // 知識ファイルのパス（ストアに置く、ファイルから読んだものでなければ NULL）
+    long long mtime;
+    long long size;
+    int segment;                // ログファイルから加えたものなら log_segments の番号（それ以外は -1）
+} KnowledgeSource;
+
+// 追記だけされるログファイル（質問応答ログのセグメント）のうち、知識ベースに加えた範囲
+typedef struct {
+    const char* path;           // ストアに置く
+    long long mtime;
+    long long size;             // 先頭からこの大きさまでのレコードを加えた
+} KnowledgeLogSegment;
+
 // 知識ベース構造体
 typedef struct {
     KnowledgeDocument* documents;
+    KnowledgeSource* sources;  // ドキュメントごとの元のファイル（documents と同じ番号）
     int count;
     int capacity;
     char base_dir[256];
     VectorDB vector_db;  // ベクトルデータベース
+    KnowledgeStore store;  // ドキュメントの文字列（読み込み直すと作り直す）
+    KnowledgeIndex index;  // タイトル・内容・カテゴリ・タグの転置インデックス
+    bool content_indexed;  // 内容を索引に加えたか（起動を軽くするため、最初の内容の検索まで後回しにする）
+    KnowledgeLogSegment* log_segments;  // ドキュメントを加えたログファイル
+    int log_segment_count;
+    int log_segment_capacity;
+    pthread_rwlock_t lock;  // 検索は並行、追加・読み込みは排他
 } KnowledgeBase;
 
 // 知識ベースの初期化
@@ -38,6 +67,31 @@ void knowledge_base_free(KnowledgeBase* kb);
 bool knowledge_base_add_document(KnowledgeBase* kb, const char* title, const char* content, 
                                 const char* category, const char** tags, int tag_count);
 
+// 知識ドキュメントの追加（ファイルには保存しない）
+// 質問応答ログのように別のファイルで永続化するものに使い、knowledge_base_load で読み込み直すと消える
+bool knowledge_base_add_document_unsaved(KnowledgeBase* kb, const char* title, const char* content, 
+                                         const char* category, const char** tags, int tag_count);
+
+// 追記だけされるログファイル path から読んだ知識ドキュメントの追加（ファイルには保存しない）
+// ログから加えたドキュメントはスナップショットに記録され、ログファイルが消えたり縮んだりしていなければ
+// 次の knowledge_base_load で解析せずに復元される
+bool knowledge_base_add_log_document(KnowledgeBase* kb, const char* path, const char* title, const char* content,
+                                     const char* category, const char** tags, int tag_count);
+
+// ログファイル path のうち、知識ベースに加えた大きさ（知らないファイルなら 0、続きだけを読めばよい）
+long long knowledge_base_log_offset(KnowledgeBase* kb, const char* path);
+
+// ログファイル path を先頭から size バイトまで加えたことを記録する（mtime は読んだときの更新時刻）
+bool knowledge_base_set_log_offset(KnowledgeBase* kb, const char* path, long long mtime, long long size);
+
+// スナップショットを書き出す（知識ファイルとログファイルから加えたドキュメントだけを記録する）
+bool knowledge_base_save_snapshot(KnowledgeBase* kb);
+
+// 検索結果のポインタは次の追加（配列の再確保）まで、ドキュメントの文字列は次の読み込みまで有効
+// 検索はロックを外してから返すので、他のスレッドが追加・更新・読み込みをする場合は、その前に使い終えるか
+// 必要な内容をコピーしておくこと（書き込みをまたいでポインタを持ち続けない）
+// カテゴリ・タグ・内容の検索結果は BM25 のスコアの高い順に並ぶ
+
 // 知識ドキュメントの検索（タイトルで）
 KnowledgeDocument* knowledge_base_find_by_title(KnowledgeBase* kb, const char* title);
 
@@ -60,6 +114,7 @@ bool knowledge_base_save_document(KnowledgeBase* kb, const KnowledgeDocument* do
 bool knowledge_base_save_all(KnowledgeBase* kb);
 
 // 知識ベースの読み込み
+// 変わっていない知識ファイルと、記録した範囲が残っているログファイルのドキュメントはスナップショットから復元する
 bool knowledge_base_load(KnowledgeBase* kb);
 
 // 知識ドキュメントのベクトル化
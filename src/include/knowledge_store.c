@@ -0,0 +1,205 @@
+#include "knowledge_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// 初期化
+void knowledge_store_init(KnowledgeStore* store) {
+    store->blocks = NULL;
+    store->arena_bytes = 0;
+    store->mappings = NULL;
+    store->mapping_count = 0;
+    store->mapping_capacity = 0;
+    store->mapped_bytes = 0;
+}
+
+// アリーナとすべての mmap を解放
+void knowledge_store_free(KnowledgeStore* store) {
+    KnowledgeArenaBlock* block = store->blocks;
+    while (block) {
+        KnowledgeArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    for (int i = 0; i < store->mapping_count; i++) {
+        munmap(store->mappings[i].addr, store->mappings[i].length);
+    }
+    free(store->mappings);
+
+    knowledge_store_init(store);
+}
+
+// アリーナから size バイトを確保
+static char* knowledge_store_alloc(KnowledgeStore* store, size_t size) {
+    KnowledgeArenaBlock* block = store->blocks;
+    if (block && block->size - block->used >= size) {
+        char* ptr = block->data + block->used;
+        block->used += size;
+        return ptr;
+    }
+
+    // 標準ブロックに収まらないテキストは専用のブロックに置く
+    size_t block_size = size > KNOWLEDGE_ARENA_BLOCK_SIZE ? size : KNOWLEDGE_ARENA_BLOCK_SIZE;
+    KnowledgeArenaBlock* new_block = (KnowledgeArenaBlock*)malloc(sizeof(KnowledgeArenaBlock) + block_size);
+    if (!new_block) {
+        fprintf(stderr, "メモリ割り当てエラー: 知識テキストの領域を確保できませんでした\n");
+        return NULL;
+    }
+    new_block->size = block_size;
+    new_block->used = size;
+
+    // 専用ブロックは現在のブロックの後ろにつなぎ、残り領域を使い続ける
+    if (block && block_size == size) {
+        new_block->next = block->next;
+        block->next = new_block;
+    } else {
+        new_block->next = block;
+        store->blocks = new_block;
+    }
+
+    return new_block->data;
+}
+
+// テキストをアリーナにコピー（終端の '\0' を付ける）
+const char* knowledge_store_copy(KnowledgeStore* store, const char* text, size_t length) {
+    char* dest = knowledge_store_alloc(store, length + 1);
+    if (!dest) {
+        return NULL;
+    }
+
+    memcpy(dest, text, length);
+    dest[length] = '\0';
+    store->arena_bytes += length + 1;
+
+    return dest;
+}
+
+// mmap の一覧に追加
+static bool knowledge_store_add_mapping(KnowledgeStore* store, void* addr, size_t length);
+
+// other のブロックと mmap をすべて store に移す
+bool knowledge_store_merge(KnowledgeStore* store, KnowledgeStore* other) {
+    // mmap を先に移す（失敗したら other はそのまま）
+    for (int i = 0; i < other->mapping_count; i++) {
+        if (!knowledge_store_add_mapping(store, other->mappings[i].addr, other->mappings[i].length)) {
+            for (int j = 0; j < i; j++) {
+                store->mapping_count--;
+                store->mapped_bytes -= other->mappings[j].length;
+            }
+            return false;
+        }
+    }
+    free(other->mappings);
+
+    // other のブロックは store の先頭の後ろにつなぎ、store の現在のブロックはそのまま使い続ける
+    if (other->blocks) {
+        KnowledgeArenaBlock* tail = other->blocks;
+        while (tail->next) {
+            tail = tail->next;
+        }
+        if (store->blocks) {
+            tail->next = store->blocks->next;
+            store->blocks->next = other->blocks;
+        } else {
+            store->blocks = other->blocks;
+        }
+    }
+    store->arena_bytes += other->arena_bytes;
+
+    knowledge_store_init(other);
+    return true;
+}
+
+// mmap の一覧に追加
+static bool knowledge_store_add_mapping(KnowledgeStore* store, void* addr, size_t length) {
+    if (store->mapping_count >= store->mapping_capacity) {
+        int new_capacity = store->mapping_capacity > 0 ? store->mapping_capacity * 2 : 16;
+        KnowledgeMapping* new_mappings = (KnowledgeMapping*)realloc(store->mappings, sizeof(KnowledgeMapping) * new_capacity);
+        if (!new_mappings) {
+            fprintf(stderr, "メモリ割り当てエラー: mmap の一覧を拡張できませんでした\n");
+            return false;
+        }
+        store->mappings = new_mappings;
+        store->mapping_capacity = new_capacity;
+    }
+
+    store->mappings[store->mapping_count].addr = addr;
+    store->mappings[store->mapping_count].length = length;
+    store->mapping_count++;
+    store->mapped_bytes += length;
+
+    return true;
+}
+
+// ファイルをアリーナに読み込む（読めたバイト数を length に返す）
+static const char* knowledge_store_read_file(KnowledgeStore* store, int fd, size_t size, size_t* length) {
+    char* dest = knowledge_store_alloc(store, size + 1);
+    if (!dest) {
+        return NULL;
+    }
+
+    size_t total = 0;
+    while (total < size) {
+        ssize_t n = read(fd, dest + total, size - total);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        total += (size_t)n;
+    }
+    dest[total] = '\0';
+    store->arena_bytes += size + 1;
+    *length = total;
+
+    return dest;
+}
+
+// ファイルを読み込み専用で mmap してテキストとして返す（長さはファイルサイズ）
+const char* knowledge_store_map_file(KnowledgeStore* store, const char* path, size_t* length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    size_t text_length = size;
+    const char* text = NULL;
+
+    // マッピングは '\0' で終わるとは限らないので、呼び出し側は長さで扱う
+    // 空ファイルは mmap できないのでアリーナに読み込む
+    if (size > 0) {
+        void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            if (knowledge_store_add_mapping(store, addr, size)) {
+                text = (const char*)addr;
+            } else {
+                munmap(addr, size);
+            }
+        }
+    }
+
+    if (!text) {
+        text = knowledge_store_read_file(store, fd, size, &text_length);
+    }
+
+    close(fd);
+
+    if (text && length) {
+        *length = text_length;
+    }
+    return text;
+}
@@ -0,0 +1,50 @@
+#ifndef KNOWLEDGE_STORE_H
+#define KNOWLEDGE_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define KNOWLEDGE_ARENA_BLOCK_SIZE 65536   // アリーナの標準ブロックサイズ
+
+// アリーナのブロック（大きなテキストは専用のブロックを確保する）
+typedef struct KnowledgeArenaBlock {
+    struct KnowledgeArenaBlock* next;
+    size_t used;
+    size_t size;
+    char data[];
+} KnowledgeArenaBlock;
+
+// mmap したファイル
+typedef struct {
+    void* addr;
+    size_t length;
+} KnowledgeMapping;
+
+// トピック知識のテキスト置き場
+// テキストはアリーナにちょうどのサイズで置くか、コーパスファイルを mmap して直接参照する
+typedef struct {
+    KnowledgeArenaBlock* blocks;    // アリーナのブロック（先頭が現在のブロック）
+    size_t arena_bytes;             // アリーナに置いたテキストの合計
+    KnowledgeMapping* mappings;     // mmap したファイル
+    int mapping_count;
+    int mapping_capacity;
+    size_t mapped_bytes;            // mmap したテキストの合計
+} KnowledgeStore;
+
+// 初期化
+void knowledge_store_init(KnowledgeStore* store);
+
+// アリーナとすべての mmap を解放
+void knowledge_store_free(KnowledgeStore* store);
+
+// テキストをアリーナにコピー（終端の '\0' を付ける）
+const char* knowledge_store_copy(KnowledgeStore* store, const char* text, size_t length);
+
+// other のブロックと mmap をすべて store に移す（テキストの位置は変わらず、other は空になる）
+bool knowledge_store_merge(KnowledgeStore* store, KnowledgeStore* other);
+
+// ファイルを読み込み専用で mmap してテキストとその長さ（length）を返す
+// '\0' で終わるとは限らないので、テキストは length の範囲だけを読むこと（mmap できなければアリーナに読み込む）
+const char* knowledge_store_map_file(KnowledgeStore* store, const char* path, size_t* length);
+
+#endif // KNOWLEDGE_STORE_H
@@ -0,0 +1,142 @@
+// 知識ドキュメントのベクトル化のマイクロベンチマーク
+// ビルド: gcc -std=gnu99 -O2 -o bin/knowledge_vectorize_benchmark src/include/knowledge_vectorize_benchmark.c src/include/knowledge_manager.c src/include/knowledge_store.c src/include/knowledge_index.c src/vector_search/vector_search.c src/vector_search/vector_distance.c src/vector_search/vector_scan.c -lm -lpthread
+// 実行: bin/knowledge_vectorize_benchmark [ドキュメント数]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "knowledge_manager.h"
+
+#define BENCHMARK_DEFAULT_DOCUMENTS 300
+
+// 経過時間（ミリ秒）
+static double elapsed_ms(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+#define BENCHMARK_MAX_CONTENT 16384
+
+// 以前の実装（次元ごとに文字列全体を走査し、文字ごとに strlen を呼ぶ）
+static void legacy_vectorize(const KnowledgeDocument* doc, float* vector) {
+    char combined[16640];
+    snprintf(combined, sizeof(combined), "%s %s", doc->title, doc->content);
+
+    for (int i = 0; i < VECTOR_DIM; i++) {
+        float val = 0.0f;
+        for (size_t j = 0; j < strlen(combined); j++) {
+            val += (float)(combined[j] * (j+1) * (i+1)) / 10000.0f;
+        }
+        vector[i] = fmodf(val, 2.0f) - 1.0f;
+    }
+    normalize_vector(vector);
+}
+
+// 日本語と英数字が混ざった内容を length バイト程度で作る（content と title は呼び出し側の領域）
+static void fill_document(KnowledgeDocument* doc, char* title, char* content, int index, size_t length) {
+    static const char* words[] = {
+        "ベクトル", "検索", "知識", "ドキュメント", "GeneLLM", "DNA", "圧縮", "辞書",
+        "search", "vector", "のため", "を使って", "です。", "\n"
+    };
+    int word_count = (int)(sizeof(words) / sizeof(words[0]));
+
+    memset(doc, 0, sizeof(*doc));
+    snprintf(title, 64, "ベンチマーク文書 %d", index);
+    doc->title = title;
+    doc->category = "";
+
+    size_t used = 0;
+    unsigned int state = 2463534242u + (unsigned int)index;
+    while (used < length && used < BENCHMARK_MAX_CONTENT - 32) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        const char* word = words[state % word_count];
+        size_t word_length = strlen(word);
+        memcpy(content + used, word, word_length);
+        used += word_length;
+    }
+    content[used] = '\0';
+    doc->content = content;
+    doc->content_length = used;
+}
+
+int main(int argc, char* argv[]) {
+    int document_count = argc > 1 ? atoi(argv[1]) : BENCHMARK_DEFAULT_DOCUMENTS;
+    if (document_count <= 0) {
+        document_count = BENCHMARK_DEFAULT_DOCUMENTS;
+    }
+
+    const size_t sizes[] = {1024, 4096, 16000};
+    // 類似度の確認に2件使うので、少なくとも2件分確保する
+    int allocated = document_count < 2 ? 2 : document_count;
+    KnowledgeDocument* docs = (KnowledgeDocument*)malloc(sizeof(KnowledgeDocument) * allocated);
+    char* titles = (char*)malloc((size_t)64 * allocated);
+    char* contents = (char*)malloc((size_t)BENCHMARK_MAX_CONTENT * allocated);
+    if (!docs || !titles || !contents) {
+        fprintf(stderr, "メモリ割り当てエラー\n");
+        return 1;
+    }
+
+    printf("知識ドキュメントのベクトル化（%d 件）\n", document_count);
+    printf("%10s %14s %14s %10s\n", "サイズ", "以前 (ms/件)", "現在 (ms/件)", "倍率");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int i = 0; i < document_count; i++) {
+            fill_document(&docs[i], titles + (size_t)i * 64, contents + (size_t)i * BENCHMARK_MAX_CONTENT, i, sizes[s]);
+        }
+
+        // 以前の実装は時間がかかるので先頭の一部だけで測る
+        int legacy_count = document_count < 20 ? document_count : 20;
+        float vector[VECTOR_DIM];
+        float checksum = 0.0f;
+        struct timespec start, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < legacy_count; i++) {
+            legacy_vectorize(&docs[i], vector);
+            checksum += vector[0];
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double legacy_ms = elapsed_ms(&start, &end) / legacy_count;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < document_count; i++) {
+            float* result = knowledge_document_vectorize(&docs[i]);
+            if (result) {
+                checksum += result[0];
+                free(result);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double current_ms = elapsed_ms(&start, &end) / document_count;
+
+        printf("%10zu %14.4f %14.4f %9.0fx\n", sizes[s], legacy_ms, current_ms,
+               current_ms > 0.0 ? legacy_ms / current_ms : 0.0);
+
+        // 最適化で計算が消えないように結果を使う
+        if (checksum == 12345.0f) {
+            printf("%f\n", checksum);
+        }
+    }
+
+    // 似た内容の文書ほど類似度が高いかを確認
+    KnowledgeDocument* a = &docs[0];
+    KnowledgeDocument* b = &docs[1];
+    char* b_content = contents + BENCHMARK_MAX_CONTENT;
+    fill_document(a, titles, contents, 0, 4096);
+    memcpy(b, a, sizeof(*b));
+    memcpy(b_content, a->content, a->content_length + 1);
+    memcpy(b_content + 2048, "まったく別の話題の段落です。", strlen("まったく別の話題の段落です。"));
+    b->content = b_content;
+    printf("\n類似度: 一部だけ違う文書 %.4f", knowledge_document_similarity(a, b));
+    b->title = "天気";
+    b->content = "明日は晴れのち曇りで、夕方から雨が降るでしょう。";
+    b->content_length = strlen(b->content);
+    printf(" / 関係のない文書 %.4f\n", knowledge_document_similarity(a, b));
+
+    free(contents);
+    free(titles);
+    free(docs);
+    return 0;
+}
@@ -2,10 +2,352 @@
 
 #define INITIAL_CAPACITY 100
 #define SIMILARITY_THRESHOLD 0.8
+#define MAX_QUESTION_WORDS 100
+#define QUESTION_DELIMITERS " 　、。？！,.?!"
+#define TERM_INITIAL_BUCKETS 1024
+#define LOG_COMPACT_MIN_RECORDS 1024    // 追記ログを圧縮する最小レコード数
+#define RECORD_LINE_SIZE 2056           // "A: " + 回答 + 改行が収まる長さ
+
+static bool learning_db_save_unlocked(LearningDB* db);
+static bool learning_db_load_unlocked(LearningDB* db);
+
+// 質問を単語に分割（buffer は 1024 バイトの作業領域、words は MAX_QUESTION_WORDS 個）
+static int learning_split_words(const char* question, char* buffer, char** words) {
+    strncpy(buffer, question, 1023);
+    buffer[1023] = '\0';
+    
+    // 複数スレッドから呼ばれるため strtok_r を使う
+    int count = 0;
+    char* saveptr = NULL;
+    char* token = strtok_r(buffer, QUESTION_DELIMITERS, &saveptr);
+    while (token && count < MAX_QUESTION_WORDS) {
+        words[count++] = token;
+        token = strtok_r(NULL, QUESTION_DELIMITERS, &saveptr);
+    }
+    
+    return count;
+}
+
+// 単語のハッシュ値（FNV-1a）
+static unsigned int learning_term_hash(const char* word) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)word; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 単語IDを返す（未登録なら -1）
+static int learning_term_lookup(const LearningDB* db, const char* word) {
+    if (!db->term_buckets) {
+        return -1;
+    }
+    
+    unsigned int mask = (unsigned int)db->term_bucket_count - 1;
+    unsigned int slot = learning_term_hash(word) & mask;
+    while (db->term_buckets[slot] != -1) {
+        int id = db->term_buckets[slot];
+        if (strcmp(db->terms[id].word, word) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & mask;
+    }
+    
+    return -1;
+}
+
+// ハッシュ表を拡張して再配置
+static bool learning_term_rehash(LearningDB* db, int new_bucket_count) {
+    int* new_buckets = (int*)malloc(sizeof(int) * new_bucket_count);
+    if (!new_buckets) {
+        fprintf(stderr, "メモリ割り当てエラー: 学習データの索引の拡張に失敗しました\n");
+        return false;
+    }
+    
+    for (int i = 0; i < new_bucket_count; i++) {
+        new_buckets[i] = -1;
+    }
+    for (int id = 0; id < db->term_count; id++) {
+        unsigned int slot = learning_term_hash(db->terms[id].word) & (new_bucket_count - 1);
+        while (new_buckets[slot] != -1) {
+            slot = (slot + 1) & (new_bucket_count - 1);
+        }
+        new_buckets[slot] = id;
+    }
+    
+    free(db->term_buckets);
+    db->term_buckets = new_buckets;
+    db->term_bucket_count = new_bucket_count;
+    return true;
+}
+
+// 単語を登録してIDを返す
+static int learning_term_intern(LearningDB* db, const char* word) {
+    int id = learning_term_lookup(db, word);
+    if (id >= 0) {
+        return id;
+    }
+    
+    // 負荷率を 1/2 以下に保つ
+    if ((db->term_count + 1) * 2 > db->term_bucket_count &&
+        !learning_term_rehash(db, db->term_bucket_count > 0 ? db->term_bucket_count * 2 : TERM_INITIAL_BUCKETS)) {
+        return -1;
+    }
+    
+    if (db->term_count >= db->term_capacity) {
+        int new_capacity = db->term_capacity > 0 ? db->term_capacity * 2 : TERM_INITIAL_BUCKETS / 2;
+        LearningTerm* new_terms = (LearningTerm*)realloc(db->terms, sizeof(LearningTerm) * new_capacity);
+        if (!new_terms) {
+            fprintf(stderr, "メモリ割り当てエラー: 学習データの索引の拡張に失敗しました\n");
+            return -1;
+        }
+        db->terms = new_terms;
+        db->term_capacity = new_capacity;
+    }
+    
+    char* copy = strdup(word);
+    if (!copy) {
+        fprintf(stderr, "メモリ割り当てエラー: 学習データの索引に単語を登録できませんでした\n");
+        return -1;
+    }
+    
+    id = db->term_count++;
+    db->terms[id].word = copy;
+    db->terms[id].postings = NULL;
+    db->terms[id].posting_count = 0;
+    db->terms[id].posting_capacity = 0;
+    db->terms[id].max_count = 0;
+    
+    unsigned int slot = learning_term_hash(word) & (db->term_bucket_count - 1);
+    while (db->term_buckets[slot] != -1) {
+        slot = (slot + 1) & (db->term_bucket_count - 1);
+    }
+    db->term_buckets[slot] = id;
+    
+    return id;
+}
+
+// 転置リストに追加
+static bool learning_term_add_posting(LearningTerm* term, int entry, int count) {
+    if (term->posting_count >= term->posting_capacity) {
+        int new_capacity = term->posting_capacity > 0 ? term->posting_capacity * 2 : 4;
+        LearningPosting* new_postings = (LearningPosting*)realloc(term->postings, sizeof(LearningPosting) * new_capacity);
+        if (!new_postings) {
+            fprintf(stderr, "メモリ割り当てエラー: 学習データの索引の拡張に失敗しました\n");
+            return false;
+        }
+        term->postings = new_postings;
+        term->posting_capacity = new_capacity;
+    }
+    
+    term->postings[term->posting_count].entry = entry;
+    term->postings[term->posting_count].count = count;
+    term->posting_count++;
+    if (count > term->max_count) {
+        term->max_count = count;
+    }
+    return true;
+}
+
+// エントリの質問を索引に登録
+static bool learning_index_entry(LearningDB* db, int entry) {
+    char buffer[1024];
+    char* words[MAX_QUESTION_WORDS];
+    int ids[MAX_QUESTION_WORDS];
+    int word_count = learning_split_words(db->entries[entry].question, buffer, words);
+    db->entries[entry].word_count = word_count;
+    
+    for (int i = 0; i < word_count; i++) {
+        ids[i] = learning_term_intern(db, words[i]);
+        if (ids[i] < 0) {
+            return false;
+        }
+    }
+    
+    // 異なる単語ごとに出現回数を記録
+    for (int i = 0; i < word_count; i++) {
+        bool seen = false;
+        int count = 1;
+        for (int j = 0; j < i; j++) {
+            if (ids[j] == ids[i]) {
+                seen = true;
+                break;
+            }
+        }
+        if (seen) {
+            continue;
+        }
+        for (int j = i + 1; j < word_count; j++) {
+            if (ids[j] == ids[i]) {
+                count++;
+            }
+        }
+        if (!learning_term_add_posting(&db->terms[ids[i]], entry, count)) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+// 索引を空にする
+static void learning_index_clear(LearningDB* db) {
+    for (int i = 0; i < db->term_count; i++) {
+        free(db->terms[i].word);
+        free(db->terms[i].postings);
+    }
+    free(db->terms);
+    free(db->term_buckets);
+    db->terms = NULL;
+    db->term_count = 0;
+    db->term_capacity = 0;
+    db->term_buckets = NULL;
+    db->term_bucket_count = 0;
+}
+
+// 転置リストからエントリの出現回数を求める（含まれなければ 0）
+static int learning_term_count(const LearningTerm* term, int entry) {
+    int low = 0;
+    int high = term->posting_count - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        if (term->postings[mid].entry == entry) {
+            return term->postings[mid].count;
+        }
+        if (term->postings[mid].entry < entry) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return 0;
+}
+
+// 類似度が閾値を超え得るエントリだけを採点する
+// first_match が true なら類似度が閾値を超える最初のエントリ、false なら類似度が最も高いエントリ（同じなら番号の小さいもの）を返す
+static int learning_db_match(const LearningDB* db, const char* question, bool first_match, float* best_similarity) {
+    char buffer[1024];
+    char* words[MAX_QUESTION_WORDS];
+    int ids[MAX_QUESTION_WORDS];
+    int id_count = 0;
+    int word_count = learning_split_words(question, buffer, words);
+    
+    *best_similarity = 0.0f;
+    
+    // 索引にある異なる単語だけを集め、転置リストの長い順に並べる
+    for (int i = 0; i < word_count; i++) {
+        int id = learning_term_lookup(db, words[i]);
+        if (id < 0) {
+            continue;
+        }
+        bool seen = false;
+        for (int j = 0; j < id_count; j++) {
+            if (ids[j] == id) {
+                seen = true;
+                break;
+            }
+        }
+        if (seen) {
+            continue;
+        }
+        int k = id_count++;
+        while (k > 0 && db->terms[ids[k - 1]].posting_count < db->terms[id].posting_count) {
+            ids[k] = ids[k - 1];
+            k--;
+        }
+        ids[k] = id;
+    }
+    
+    // 一致数を m とすると類似度は m / (エントリの単語数 + word_count - m) <= m / word_count なので、
+    // 閾値を超えるには m が word_count の 8 割程度必要になる
+    // 出現回数の上限の合計がそれに届かない範囲で、ありふれた単語を候補の生成から外す
+    int skip = 0;
+    int skip_max = 0;
+    while (skip < id_count &&
+           skip_max + db->terms[ids[skip]].max_count < (SIMILARITY_THRESHOLD - 0.01) * word_count) {
+        skip_max += db->terms[ids[skip]].max_count;
+        skip++;
+    }
+    
+    size_t posting_total = 0;
+    for (int i = skip; i < id_count; i++) {
+        posting_total += db->terms[ids[i]].posting_count;
+    }
+    if (posting_total == 0) {
+        return -1;
+    }
+    
+    // 残りの単語を含むエントリごとに一致単語数を集計
+    size_t bucket_count = 16;
+    while (bucket_count < posting_total * 2) {
+        bucket_count *= 2;
+    }
+    int* candidates = (int*)malloc(sizeof(int) * bucket_count);
+    int* matches = (int*)malloc(sizeof(int) * bucket_count);
+    if (!candidates || !matches) {
+        fprintf(stderr, "メモリ割り当てエラー: 学習データの検索に失敗しました\n");
+        free(candidates);
+        free(matches);
+        return -1;
+    }
+    for (size_t i = 0; i < bucket_count; i++) {
+        candidates[i] = -1;
+    }
+    
+    for (int i = skip; i < id_count; i++) {
+        const LearningTerm* term = &db->terms[ids[i]];
+        for (int j = 0; j < term->posting_count; j++) {
+            int entry = term->postings[j].entry;
+            size_t slot = ((unsigned int)entry * 2654435761u) & (bucket_count - 1);
+            while (candidates[slot] != -1 && candidates[slot] != entry) {
+                slot = (slot + 1) & (bucket_count - 1);
+            }
+            if (candidates[slot] == -1) {
+                candidates[slot] = entry;
+                matches[slot] = 0;
+            }
+            matches[slot] += term->postings[j].count;
+        }
+    }
+    
+    // 外した単語の出現回数も加えて類似度を計算（calculate_question_similarity と同じ式）
+    int best = -1;
+    for (size_t i = 0; i < bucket_count; i++) {
+        int entry = candidates[i];
+        if (entry < 0) {
+            continue;
+        }
+        
+        int match_count = matches[i];
+        for (int k = 0; k < skip; k++) {
+            match_count += learning_term_count(&db->terms[ids[k]], entry);
+        }
+        
+        int total_unique_words = db->entries[entry].word_count + word_count - match_count;
+        float similarity = total_unique_words == 0 ? 0.0f : (float)match_count / total_unique_words;
+        if (similarity <= SIMILARITY_THRESHOLD) {
+            continue;
+        }
+        if (first_match) {
+            if (best < 0 || entry < best) {
+                best = entry;
+                *best_similarity = similarity;
+            }
+        } else if (best < 0 || similarity > *best_similarity || (similarity == *best_similarity && entry < best)) {
+            best = entry;
+            *best_similarity = similarity;
+        }
+    }
+    
+    free(candidates);
+    free(matches);
+    return best;
+}
 
 // 学習データベースの初期化
 LearningDB* learning_db_init(const char* filename) {
-    LearningDB* db = (LearningDB*)malloc(sizeof(LearningDB));
+    LearningDB* db = (LearningDB*)calloc(1, sizeof(LearningDB));
     if (!db) {
         fprintf(stderr, "メモリ割り当てエラー: 学習データベースの初期化に失敗しました\n");
         return NULL;
@@ -22,9 +364,11 @@ LearningDB* learning_db_init(const char* filename) {
     db->capacity = INITIAL_CAPACITY;
     strncpy(db->filename, filename, sizeof(db->filename) - 1);
     db->filename[sizeof(db->filename) - 1] = '\0';
+    snprintf(db->log_filename, sizeof(db->log_filename), "%s.log", db->filename);
+    pthread_rwlock_init(&db->lock, NULL);
     
     // 既存のデータがあれば読み込む
-    learning_db_load(db);
+    learning_db_load_unlocked(db);
     
     return db;
 }
@@ -32,55 +376,139 @@ LearningDB* learning_db_init(const char* filename) {
 // 学習データベースの解放
 void learning_db_free(LearningDB* db) {
     if (db) {
+        if (db->log) {
+            fclose(db->log);
+        }
+        learning_index_clear(db);
         if (db->entries) {
             free(db->entries);
         }
+        pthread_rwlock_destroy(&db->lock);
         free(db);
     }
 }
 
-// 学習データの追加
-bool learning_db_add(LearningDB* db, const char* question, const char* answer, float confidence) {
-    if (!db || !question || !answer) {
-        return false;
+// エントリ配列の容量を確保
+static bool learning_db_reserve(LearningDB* db, int capacity) {
+    if (capacity <= db->capacity) {
+        return true;
     }
     
-    // 既存の質問と類似していないか確認
-    for (int i = 0; i < db->count; i++) {
-        float similarity = calculate_question_similarity(db->entries[i].question, question);
-        if (similarity > SIMILARITY_THRESHOLD) {
-            // 既存の質問が類似している場合は更新
-            strncpy(db->entries[i].answer, answer, sizeof(db->entries[i].answer) - 1);
-            db->entries[i].answer[sizeof(db->entries[i].answer) - 1] = '\0';
-            db->entries[i].confidence = confidence;
-            return learning_db_save(db);
-        }
+    LearningEntry* new_entries = (LearningEntry*)realloc(db->entries, sizeof(LearningEntry) * capacity);
+    if (!new_entries) {
+        fprintf(stderr, "メモリ割り当てエラー: 学習データベースの拡張に失敗しました\n");
+        return false;
     }
-    
+    db->entries = new_entries;
+    db->capacity = capacity;
+    return true;
+}
+
+// 末尾にエントリを追加して索引に登録
+static bool learning_db_append_entry(LearningDB* db, const char* question, const char* answer, float confidence) {
     // 容量が足りない場合は拡張
-    if (db->count >= db->capacity) {
-        int new_capacity = db->capacity * 2;
-        LearningEntry* new_entries = (LearningEntry*)realloc(db->entries, sizeof(LearningEntry) * new_capacity);
-        if (!new_entries) {
-            fprintf(stderr, "メモリ割り当てエラー: 学習データベースの拡張に失敗しました\n");
-            return false;
-        }
-        db->entries = new_entries;
-        db->capacity = new_capacity;
+    if (db->count >= db->capacity && !learning_db_reserve(db, db->capacity * 2)) {
+        return false;
     }
     
-    // 新しいエントリを追加
-    strncpy(db->entries[db->count].question, question, sizeof(db->entries[db->count].question) - 1);
-    db->entries[db->count].question[sizeof(db->entries[db->count].question) - 1] = '\0';
+    LearningEntry* entry = &db->entries[db->count];
+    strncpy(entry->question, question, sizeof(entry->question) - 1);
+    entry->question[sizeof(entry->question) - 1] = '\0';
     
-    strncpy(db->entries[db->count].answer, answer, sizeof(db->entries[db->count].answer) - 1);
-    db->entries[db->count].answer[sizeof(db->entries[db->count].answer) - 1] = '\0';
+    strncpy(entry->answer, answer, sizeof(entry->answer) - 1);
+    entry->answer[sizeof(entry->answer) - 1] = '\0';
     
-    db->entries[db->count].confidence = confidence;
+    entry->confidence = confidence;
     db->count++;
     
-    // データベースを保存
-    return learning_db_save(db);
+    return learning_index_entry(db, db->count - 1);
+}
+
+// 類似する質問があれば回答を更新し、なければ追加する（メモリ上のみ）
+static bool learning_db_store_unlocked(LearningDB* db, const char* question, const char* answer, float confidence) {
+    float similarity = 0.0f;
+    int match = learning_db_match(db, question, true, &similarity);
+    if (match >= 0) {
+        // 既存の質問が類似している場合は更新
+        strncpy(db->entries[match].answer, answer, sizeof(db->entries[match].answer) - 1);
+        db->entries[match].answer[sizeof(db->entries[match].answer) - 1] = '\0';
+        db->entries[match].confidence = confidence;
+        return true;
+    }
+    
+    return learning_db_append_entry(db, question, answer, confidence);
+}
+
+// 1件分のレコードを書き込む
+static void learning_db_write_record(FILE* file, const char* question, const char* answer, float confidence) {
+    fprintf(file, "Q: %s\n", question);
+    fprintf(file, "A: %s\n", answer);
+    fprintf(file, "C: %.4f\n", confidence);
+}
+
+// 1行を読み込み、接頭辞を除いて改行を削除する
+static bool learning_db_read_field(FILE* file, const char* prefix, char* dest, size_t size) {
+    char line[RECORD_LINE_SIZE];
+    if (!fgets(line, sizeof(line), file) || strncmp(line, prefix, 3) != 0) {
+        return false;
+    }
+    
+    // 長すぎる行は切り詰める（snprintf の戻り値は切り詰める前の長さ）
+    int written = snprintf(dest, size, "%s", line + 3);
+    size_t len = written < 0 ? 0 : ((size_t)written < size ? (size_t)written : size - 1);
+    if (len > 0 && dest[len-1] == '\n') {
+        dest[len-1] = '\0';
+    }
+    return true;
+}
+
+// 1件分のレコードを読み込む
+static bool learning_db_read_record(FILE* file, char* question, char* answer, float* confidence) {
+    char value[32];
+    if (!learning_db_read_field(file, "Q: ", question, 1024) ||
+        !learning_db_read_field(file, "A: ", answer, 2048) ||
+        !learning_db_read_field(file, "C: ", value, sizeof(value))) {
+        return false;
+    }
+    
+    *confidence = atof(value);
+    return true;
+}
+
+// 学習データの追加（書き込みロックを取得済みで呼ぶ）
+static bool learning_db_add_unlocked(LearningDB* db, const char* question, const char* answer, float confidence) {
+    if (!learning_db_store_unlocked(db, question, answer, confidence)) {
+        return false;
+    }
+    
+    // 追記ログが使えない場合は全体を書き直す
+    if (!db->log) {
+        return learning_db_save_unlocked(db);
+    }
+    
+    learning_db_write_record(db->log, question, answer, confidence);
+    fflush(db->log);
+    db->log_records++;
+    
+    // ログが件数の半分を超えたら圧縮する（書き直しの費用は追加1件あたり定数）
+    if (db->log_records >= LOG_COMPACT_MIN_RECORDS && db->log_records * 2 > db->count) {
+        return learning_db_save_unlocked(db);
+    }
+    
+    return true;
+}
+
+// 学習データの追加
+bool learning_db_add(LearningDB* db, const char* question, const char* answer, float confidence) {
+    if (!db || !question || !answer) {
+        return false;
+    }
+    
+    pthread_rwlock_wrlock(&db->lock);
+    bool result = learning_db_add_unlocked(db, question, answer, confidence);
+    pthread_rwlock_unlock(&db->lock);
+    
+    return result;
 }
 
 // 学習データの検索
@@ -89,27 +517,25 @@ bool learning_db_find(LearningDB* db, const char* question, char* answer, float*
         return false;
     }
     
-    float max_similarity = 0.0f;
-    int best_match = -1;
+    bool found = false;
     
-    // 最も類似度の高い質問を検索
-    for (int i = 0; i < db->count; i++) {
-        float similarity = calculate_question_similarity(db->entries[i].question, question);
-        if (similarity > max_similarity) {
-            max_similarity = similarity;
-            best_match = i;
-        }
-    }
+    pthread_rwlock_rdlock(&db->lock);
+    
+    // 類似度が閾値を超え得るエントリから最も類似度の高い質問を検索
+    float max_similarity = 0.0f;
+    int best_match = learning_db_match(db, question, false, &max_similarity);
     
     // 類似度が閾値を超えていれば回答を返す
     if (max_similarity > SIMILARITY_THRESHOLD && best_match >= 0) {
         strncpy(answer, db->entries[best_match].answer, 2047);
         answer[2047] = '\0';
         *confidence = db->entries[best_match].confidence;
-        return true;
+        found = true;
     }
     
-    return false;
+    pthread_rwlock_unlock(&db->lock);
+    
+    return found;
 }
 
 // 学習データの保存
@@ -118,9 +544,23 @@ bool learning_db_save(LearningDB* db) {
         return false;
     }
     
-    FILE* file = fopen(db->filename, "w");
+    // 追記ログを空にするため書き込みロックを取る
+    pthread_rwlock_wrlock(&db->lock);
+    bool result = learning_db_save_unlocked(db);
+    pthread_rwlock_unlock(&db->lock);
+    
+    return result;
+}
+
+// 学習データの保存（書き込みロックを取得済みで呼ぶ）
+// 一時ファイルに書いてから置き換え、追記ログを空にする
+static bool learning_db_save_unlocked(LearningDB* db) {
+    char temp_filename[272];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", db->filename);
+    
+    FILE* file = fopen(temp_filename, "w");
     if (!file) {
-        fprintf(stderr, "ファイルオープンエラー: %s\n", db->filename);
+        fprintf(stderr, "ファイルオープンエラー: %s\n", temp_filename);
         return false;
     }
     
@@ -129,13 +569,22 @@ bool learning_db_save(LearningDB* db) {
     
     // 各エントリを書き込む
     for (int i = 0; i < db->count; i++) {
-        // 質問と回答をエスケープして保存
-        fprintf(file, "Q: %s\n", db->entries[i].question);
-        fprintf(file, "A: %s\n", db->entries[i].answer);
-        fprintf(file, "C: %.4f\n", db->entries[i].confidence);
+        learning_db_write_record(file, db->entries[i].question, db->entries[i].answer, db->entries[i].confidence);
     }
     
-    fclose(file);
+    if (fclose(file) != 0 || rename(temp_filename, db->filename) != 0) {
+        fprintf(stderr, "ファイル書き込みエラー: %s\n", db->filename);
+        remove(temp_filename);
+        return false;
+    }
+    
+    // スナップショットに含まれたので追記ログを空にする
+    if (db->log) {
+        fclose(db->log);
+    }
+    db->log = fopen(db->log_filename, "w");
+    db->log_records = 0;
+    
     return true;
 }
 
@@ -145,81 +594,69 @@ bool learning_db_load(LearningDB* db) {
         return false;
     }
     
-    FILE* file = fopen(db->filename, "r");
-    if (!file) {
-        // ファイルが存在しない場合は新規作成とみなす
-        return true;
-    }
+    pthread_rwlock_wrlock(&db->lock);
+    bool result = learning_db_load_unlocked(db);
+    pthread_rwlock_unlock(&db->lock);
     
-    char line[2048];
+    return result;
+}
+
+// 学習データの読み込み（書き込みロックを取得済みで呼ぶ）
+static bool learning_db_load_unlocked(LearningDB* db) {
+    db->count = 0;
+    learning_index_clear(db);
     
-    // ヘッダー情報を読み込む
-    if (fgets(line, sizeof(line), file)) {
-        int count = atoi(line);
+    char question[1024];
+    char answer[2048];
+    float confidence = 0.0f;
+    
+    // スナップショット（ファイルが存在しない場合は新規作成とみなす）
+    FILE* file = fopen(db->filename, "r");
+    if (file) {
+        char line[64];
         
-        // 容量が足りない場合は拡張
-        if (count > db->capacity) {
-            LearningEntry* new_entries = (LearningEntry*)realloc(db->entries, sizeof(LearningEntry) * count);
-            if (!new_entries) {
-                fprintf(stderr, "メモリ割り当てエラー: 学習データベースの拡張に失敗しました\n");
+        // ヘッダー情報を読み込む
+        if (fgets(line, sizeof(line), file)) {
+            int count = atoi(line);
+            
+            // 容量が足りない場合は拡張
+            if (!learning_db_reserve(db, count)) {
                 fclose(file);
                 return false;
             }
-            db->entries = new_entries;
-            db->capacity = count;
-        }
-        
-        // 各エントリを読み込む
-        db->count = 0;
-        while (db->count < count) {
-            char question[1024] = {0};
-            char answer[2048] = {0};
-            float confidence = 0.0f;
             
-            // 質問を読み込む
-            if (fgets(line, sizeof(line), file) && strncmp(line, "Q: ", 3) == 0) {
-                strncpy(question, line + 3, sizeof(question) - 1);
-                // 改行を削除
-                size_t len = strlen(question);
-                if (len > 0 && question[len-1] == '\n') {
-                    question[len-1] = '\0';
+            // 各エントリを読み込む
+            while (db->count < count && learning_db_read_record(file, question, answer, &confidence)) {
+                if (!learning_db_append_entry(db, question, answer, confidence)) {
+                    fclose(file);
+                    return false;
                 }
-            } else {
-                break;
-            }
-            
-            // 回答を読み込む
-            if (fgets(line, sizeof(line), file) && strncmp(line, "A: ", 3) == 0) {
-                strncpy(answer, line + 3, sizeof(answer) - 1);
-                // 改行を削除
-                size_t len = strlen(answer);
-                if (len > 0 && answer[len-1] == '\n') {
-                    answer[len-1] = '\0';
-                }
-            } else {
-                break;
             }
-            
-            // 確信度を読み込む
-            if (fgets(line, sizeof(line), file) && strncmp(line, "C: ", 3) == 0) {
-                confidence = atof(line + 3);
-            } else {
-                break;
-            }
-            
-            // エントリを追加
-            strncpy(db->entries[db->count].question, question, sizeof(db->entries[db->count].question) - 1);
-            db->entries[db->count].question[sizeof(db->entries[db->count].question) - 1] = '\0';
-            
-            strncpy(db->entries[db->count].answer, answer, sizeof(db->entries[db->count].answer) - 1);
-            db->entries[db->count].answer[sizeof(db->entries[db->count].answer) - 1] = '\0';
-            
-            db->entries[db->count].confidence = confidence;
-            db->count++;
         }
+        
+        fclose(file);
+    }
+    
+    // 追記ログを再生（追加と同じく類似する質問は更新になる）
+    if (db->log) {
+        fclose(db->log);
+    }
+    db->log_records = 0;
+    file = fopen(db->log_filename, "r");
+    if (file) {
+        while (learning_db_read_record(file, question, answer, &confidence)) {
+            learning_db_store_unlocked(db, question, answer, confidence);
+            db->log_records++;
+        }
+        fclose(file);
+    }
+    
+    // 以降の追加は追記ログに書く
+    db->log = fopen(db->log_filename, "a");
+    if (!db->log) {
+        fprintf(stderr, "ファイルオープンエラー: %s\n", db->log_filename);
     }
     
-    fclose(file);
     return true;
 }
 
@@ -229,31 +666,13 @@ float calculate_question_similarity(const char* q1, const char* q2) {
         return 0.0f;
     }
     
-    // 単語の一致数をカウント
+    // 単語に分割
     char q1_copy[1024];
     char q2_copy[1024];
-    strncpy(q1_copy, q1, sizeof(q1_copy) - 1);
-    q1_copy[sizeof(q1_copy) - 1] = '\0';
-    strncpy(q2_copy, q2, sizeof(q2_copy) - 1);
-    q2_copy[sizeof(q2_copy) - 1] = '\0';
-    
-    // 単語に分割
-    char* q1_words[100] = {0};
-    char* q2_words[100] = {0};
-    int q1_word_count = 0;
-    int q2_word_count = 0;
-    
-    char* token = strtok(q1_copy, " 　、。？！,.?!");
-    while (token && q1_word_count < 100) {
-        q1_words[q1_word_count++] = token;
-        token = strtok(NULL, " 　、。？！,.?!");
-    }
-    
-    token = strtok(q2_copy, " 　、。？！,.?!");
-    while (token && q2_word_count < 100) {
-        q2_words[q2_word_count++] = token;
-        token = strtok(NULL, " 　、。？！,.?!");
-    }
+    char* q1_words[MAX_QUESTION_WORDS];
+    char* q2_words[MAX_QUESTION_WORDS];
+    int q1_word_count = learning_split_words(q1, q1_copy, q1_words);
+    int q2_word_count = learning_split_words(q2, q2_copy, q2_words);
     
     // 一致する単語をカウント
     int match_count = 0;
@@ -5,20 +5,50 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 // 学習データの構造体
 typedef struct {
     char question[1024];
     char answer[2048];
     float confidence;
+    int word_count;         // 質問の単語数（類似度計算に使う）
 } LearningEntry;
 
+// 転置リストの要素（単語を含むエントリとその出現回数）
+typedef struct {
+    int entry;
+    int count;
+} LearningPosting;
+
+// 索引の単語
+typedef struct {
+    char* word;
+    LearningPosting* postings;  // エントリ番号の昇順
+    int posting_count;
+    int posting_capacity;
+    int max_count;              // 1つのエントリでの最大出現回数（候補の絞り込みに使う）
+} LearningTerm;
+
 // 学習データベース
 typedef struct {
     LearningEntry* entries;
     int count;
     int capacity;
     char filename[256];
+    pthread_rwlock_t lock;  // 検索は並行、追加・保存は排他
+
+    // 単語 → エントリの転置索引（共通の単語を持つエントリだけを採点する）
+    LearningTerm* terms;
+    int term_count;
+    int term_capacity;
+    int* term_buckets;      // オープンアドレス法のハッシュ表（単語ID、空きは -1）
+    int term_bucket_count;
+
+    // 追記ログ（追加・更新を1レコードずつ追記し、大きくなったらスナップショットに圧縮する）
+    FILE* log;
+    char log_filename[272];
+    int log_records;        // 前回の圧縮以降に追記したレコード数
 } LearningDB;
 
 // 学習データベースの初期化
@@ -33,10 +63,10 @@ bool learning_db_add(LearningDB* db, const char* question, const char* answer, f
 // 学習データの検索
 bool learning_db_find(LearningDB* db, const char* question, char* answer, float* confidence);
 
-// 学習データの保存
+// 学習データの保存（スナップショットを書き直して追記ログを空にする）
 bool learning_db_save(LearningDB* db);
 
-// 学習データの読み込み
+// 学習データの読み込み（スナップショットの後に追記ログを再生する）
 bool learning_db_load(LearningDB* db);
 
 // 質問の類似度計算
@@ -0,0 +1,148 @@
+#include "mecab_tagger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// 共有モデル（辞書）はプロセスで一つだけ読み込む
+static mecab_model_t* shared_model = NULL;
+static MecabSession* default_session = NULL;
+
+// 統計情報
+static double model_init_ms = 0.0;
+static double session_total_ms = 0.0;
+static long session_count = 0;
+static long parse_count = 0;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 単調増加時計の現在時刻（ミリ秒）
+static double mecab_tagger_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// 共有モデルを初期化
+bool mecab_tagger_init(const char* arg) {
+    if (shared_model) {
+        return true;  // 初期化済み
+    }
+
+    double start = mecab_tagger_now_ms();
+    shared_model = mecab_model_new2(arg ? arg : "");
+    if (!shared_model) {
+        fprintf(stderr, "MeCabの初期化に失敗しました: %s\n", mecab_strerror(NULL));
+        return false;
+    }
+    model_init_ms = mecab_tagger_now_ms() - start;
+
+    return true;
+}
+
+// 共有モデルとデフォルトセッションを解放
+void mecab_tagger_free() {
+    if (default_session) {
+        mecab_session_destroy(default_session);
+        default_session = NULL;
+    }
+
+    if (shared_model) {
+        mecab_model_destroy(shared_model);
+        shared_model = NULL;
+    }
+}
+
+// 新しいセッションを生成
+MecabSession* mecab_session_create() {
+    if (!shared_model && !mecab_tagger_init("")) {
+        return NULL;
+    }
+
+    MecabSession* session = (MecabSession*)malloc(sizeof(MecabSession));
+    if (!session) {
+        fprintf(stderr, "メモリ割り当てエラー: MeCabセッションの生成に失敗しました\n");
+        return NULL;
+    }
+
+    double start = mecab_tagger_now_ms();
+    session->tagger = mecab_model_new_tagger(shared_model);
+    session->lattice = mecab_model_new_lattice(shared_model);
+    if (!session->tagger || !session->lattice) {
+        fprintf(stderr, "MeCabセッションの生成に失敗しました: %s\n", mecab_strerror(NULL));
+        mecab_session_destroy(session);
+        return NULL;
+    }
+
+    double elapsed = mecab_tagger_now_ms() - start;
+    pthread_mutex_lock(&stats_mutex);
+    session_count++;
+    session_total_ms += elapsed;
+    pthread_mutex_unlock(&stats_mutex);
+
+    return session;
+}
+
+// セッションを解放
+void mecab_session_destroy(MecabSession* session) {
+    if (!session) {
+        return;
+    }
+
+    if (session->lattice) {
+        mecab_lattice_destroy(session->lattice);
+    }
+    if (session->tagger) {
+        mecab_destroy(session->tagger);
+    }
+    free(session);
+}
+
+// デフォルトセッションを取得
+MecabSession* mecab_tagger_default_session() {
+    if (!default_session) {
+        default_session = mecab_session_create();
+    }
+    return default_session;
+}
+
+// テキストを解析
+const mecab_node_t* mecab_session_parse(MecabSession* session, const char* text) {
+    if (!session || !text) {
+        return NULL;
+    }
+
+    mecab_lattice_set_sentence(session->lattice, text);
+    if (!mecab_parse_lattice(session->tagger, session->lattice)) {
+        fprintf(stderr, "形態素解析に失敗しました: %s\n", mecab_lattice_strerror(session->lattice));
+        return NULL;
+    }
+
+    __sync_fetch_and_add(&parse_count, 1);
+
+    return mecab_lattice_get_bos_node(session->lattice);
+}
+
+// 再利用の統計情報を取得
+void mecab_tagger_get_stats(MecabTaggerStats* stats) {
+    if (!stats) {
+        return;
+    }
+
+    pthread_mutex_lock(&stats_mutex);
+    double total_ms = session_total_ms;
+    stats->session_count = session_count;
+    pthread_mutex_unlock(&stats_mutex);
+
+    stats->init_ms = model_init_ms;
+    stats->session_ms = stats->session_count > 0 ? total_ms / stats->session_count : 0.0;
+    stats->parse_count = __sync_fetch_and_add(&parse_count, 0);
+
+    // 以前は解析のたびにモデル読み込みとタガー生成を行っていた
+    double per_call_ms = stats->init_ms + stats->session_ms;
+    double actual_ms = stats->init_ms + total_ms;
+    stats->saved_ms = stats->parse_count * per_call_ms - actual_ms;
+    if (stats->saved_ms < 0.0) {
+        stats->saved_ms = 0.0;
+    }
+}
@@ -0,0 +1,308 @@
+#include "pattern_matcher.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATTERN_SYMBOLS_INITIAL_CAPACITY 256
+
+// 文字列のハッシュ値（FNV-1a）
+static unsigned int pattern_symbols_hash(const char* str) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)str; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// シンボル表を初期化（ID 0 は "*"）
+bool pattern_symbols_init(PatternSymbols* symbols) {
+    symbols->count = 0;
+    symbols->capacity = PATTERN_SYMBOLS_INITIAL_CAPACITY;
+    symbols->bucket_count = PATTERN_SYMBOLS_INITIAL_CAPACITY * 2;
+    symbols->strings = (char**)malloc(sizeof(char*) * symbols->capacity);
+    symbols->buckets = (int*)malloc(sizeof(int) * symbols->bucket_count);
+    if (!symbols->strings || !symbols->buckets) {
+        fprintf(stderr, "メモリ割り当てエラー: シンボル表の初期化に失敗しました\n");
+        free(symbols->strings);
+        free(symbols->buckets);
+        symbols->strings = NULL;
+        symbols->buckets = NULL;
+        return false;
+    }
+
+    for (int i = 0; i < symbols->bucket_count; i++) {
+        symbols->buckets[i] = -1;
+    }
+
+    return pattern_symbols_intern(symbols, "*") == PATTERN_SYMBOL_WILDCARD;
+}
+
+// シンボル表を解放
+void pattern_symbols_free(PatternSymbols* symbols) {
+    if (symbols->strings) {
+        for (int i = 0; i < symbols->count; i++) {
+            free(symbols->strings[i]);
+        }
+        free(symbols->strings);
+    }
+    free(symbols->buckets);
+    symbols->strings = NULL;
+    symbols->buckets = NULL;
+    symbols->count = 0;
+}
+
+// ハッシュ表を2倍に拡張して再配置
+static bool pattern_symbols_rehash(PatternSymbols* symbols) {
+    int new_bucket_count = symbols->bucket_count * 2;
+    int* new_buckets = (int*)malloc(sizeof(int) * new_bucket_count);
+    if (!new_buckets) {
+        fprintf(stderr, "メモリ割り当てエラー: シンボル表の拡張に失敗しました\n");
+        return false;
+    }
+
+    for (int i = 0; i < new_bucket_count; i++) {
+        new_buckets[i] = -1;
+    }
+    for (int id = 0; id < symbols->count; id++) {
+        unsigned int slot = pattern_symbols_hash(symbols->strings[id]) & (new_bucket_count - 1);
+        while (new_buckets[slot] != -1) {
+            slot = (slot + 1) & (new_bucket_count - 1);
+        }
+        new_buckets[slot] = id;
+    }
+
+    free(symbols->buckets);
+    symbols->buckets = new_buckets;
+    symbols->bucket_count = new_bucket_count;
+    return true;
+}
+
+// 文字列を登録してIDを返す
+int pattern_symbols_intern(PatternSymbols* symbols, const char* str) {
+    int id = pattern_symbols_lookup(symbols, str);
+    if (id != PATTERN_SYMBOL_NONE) {
+        return id;
+    }
+
+    // 負荷率を 1/2 以下に保つ
+    if ((symbols->count + 1) * 2 > symbols->bucket_count && !pattern_symbols_rehash(symbols)) {
+        return PATTERN_SYMBOL_NONE;
+    }
+
+    if (symbols->count >= symbols->capacity) {
+        int new_capacity = symbols->capacity * 2;
+        char** new_strings = (char**)realloc(symbols->strings, sizeof(char*) * new_capacity);
+        if (!new_strings) {
+            fprintf(stderr, "メモリ割り当てエラー: シンボル表の拡張に失敗しました\n");
+            return PATTERN_SYMBOL_NONE;
+        }
+        symbols->strings = new_strings;
+        symbols->capacity = new_capacity;
+    }
+
+    char* copy = strdup(str);
+    if (!copy) {
+        fprintf(stderr, "メモリ割り当てエラー: シンボルを登録できませんでした\n");
+        return PATTERN_SYMBOL_NONE;
+    }
+
+    id = symbols->count++;
+    symbols->strings[id] = copy;
+
+    unsigned int slot = pattern_symbols_hash(str) & (symbols->bucket_count - 1);
+    while (symbols->buckets[slot] != -1) {
+        slot = (slot + 1) & (symbols->bucket_count - 1);
+    }
+    symbols->buckets[slot] = id;
+
+    return id;
+}
+
+// 文字列のIDを返す（未登録なら PATTERN_SYMBOL_NONE）
+int pattern_symbols_lookup(const PatternSymbols* symbols, const char* str) {
+    if (!symbols->buckets || !str) {
+        return PATTERN_SYMBOL_NONE;
+    }
+
+    unsigned int slot = pattern_symbols_hash(str) & (symbols->bucket_count - 1);
+    while (symbols->buckets[slot] != -1) {
+        int id = symbols->buckets[slot];
+        if (strcmp(symbols->strings[id], str) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & (symbols->bucket_count - 1);
+    }
+
+    return PATTERN_SYMBOL_NONE;
+}
+
+// マッチャーを初期化
+void pattern_matcher_init(PatternMatcher* matcher, PatternSymbols* symbols, int owner_count) {
+    memset(matcher, 0, sizeof(PatternMatcher));
+    matcher->symbols = symbols;
+    matcher->owner_count = owner_count;
+    matcher->owner_pattern_counts = (int*)calloc(owner_count > 0 ? owner_count : 1, sizeof(int));
+    if (!matcher->owner_pattern_counts) {
+        fprintf(stderr, "メモリ割り当てエラー: パターンマッチャーの初期化に失敗しました\n");
+        matcher->owner_count = 0;
+    }
+}
+
+// マッチャーを解放
+void pattern_matcher_free(PatternMatcher* matcher) {
+    free(matcher->patterns);
+    free(matcher->keyword_offsets);
+    free(matcher->keyword_entries);
+    free(matcher->wildcard_entries);
+    free(matcher->owner_pattern_counts);
+    memset(matcher, 0, sizeof(PatternMatcher));
+}
+
+// パターンを追加
+bool pattern_matcher_add(PatternMatcher* matcher, int owner, const char* keyword, const char* pos, int type, float weight) {
+    if (owner < 0 || owner >= matcher->owner_count) {
+        return false;
+    }
+
+    if (matcher->pattern_count >= matcher->pattern_capacity) {
+        int new_capacity = matcher->pattern_capacity > 0 ? matcher->pattern_capacity * 2 : 64;
+        CompiledPattern* new_patterns = (CompiledPattern*)realloc(matcher->patterns, sizeof(CompiledPattern) * new_capacity);
+        if (!new_patterns) {
+            fprintf(stderr, "メモリ割り当てエラー: パターンを追加できませんでした\n");
+            return false;
+        }
+        matcher->patterns = new_patterns;
+        matcher->pattern_capacity = new_capacity;
+    }
+
+    CompiledPattern* pattern = &matcher->patterns[matcher->pattern_count];
+    pattern->owner = owner;
+    pattern->keyword = pattern_symbols_intern(matcher->symbols, keyword);
+    pattern->pos = pattern_symbols_intern(matcher->symbols, pos);
+    pattern->type = type;
+    pattern->weight = weight;
+    if (pattern->keyword == PATTERN_SYMBOL_NONE || pattern->pos == PATTERN_SYMBOL_NONE) {
+        return false;
+    }
+
+    matcher->pattern_count++;
+    matcher->owner_pattern_counts[owner]++;
+    return true;
+}
+
+// 転置表を作成
+bool pattern_matcher_compile(PatternMatcher* matcher) {
+    free(matcher->keyword_offsets);
+    free(matcher->keyword_entries);
+    free(matcher->wildcard_entries);
+
+    matcher->keyword_count = matcher->symbols->count;
+    matcher->keyword_offsets = (int*)calloc(matcher->keyword_count + 1, sizeof(int));
+    matcher->keyword_entries = (int*)malloc(sizeof(int) * (matcher->pattern_count > 0 ? matcher->pattern_count : 1));
+    matcher->wildcard_entries = (int*)malloc(sizeof(int) * (matcher->pattern_count > 0 ? matcher->pattern_count : 1));
+    matcher->wildcard_count = 0;
+    if (!matcher->keyword_offsets || !matcher->keyword_entries || !matcher->wildcard_entries) {
+        fprintf(stderr, "メモリ割り当てエラー: パターンの転置表を作成できませんでした\n");
+        return false;
+    }
+
+    // キーワードごとのパターン数を数えて開始位置を決める
+    for (int i = 0; i < matcher->pattern_count; i++) {
+        int keyword = matcher->patterns[i].keyword;
+        if (keyword != PATTERN_SYMBOL_WILDCARD) {
+            matcher->keyword_offsets[keyword + 1]++;
+        }
+    }
+    for (int k = 0; k < matcher->keyword_count; k++) {
+        matcher->keyword_offsets[k + 1] += matcher->keyword_offsets[k];
+    }
+
+    // パターン番号を詰める（同じキーワード内では追加順を保つ）
+    int* fill = (int*)malloc(sizeof(int) * (matcher->keyword_count > 0 ? matcher->keyword_count : 1));
+    if (!fill) {
+        fprintf(stderr, "メモリ割り当てエラー: パターンの転置表を作成できませんでした\n");
+        return false;
+    }
+    memcpy(fill, matcher->keyword_offsets, sizeof(int) * matcher->keyword_count);
+
+    for (int i = 0; i < matcher->pattern_count; i++) {
+        int keyword = matcher->patterns[i].keyword;
+        if (keyword == PATTERN_SYMBOL_WILDCARD) {
+            matcher->wildcard_entries[matcher->wildcard_count++] = i;
+        } else {
+            matcher->keyword_entries[fill[keyword]++] = i;
+        }
+    }
+
+    free(fill);
+    return true;
+}
+
+// パターンの品詞とタイプがトークンにマッチするか
+static bool pattern_matcher_accepts(const CompiledPattern* pattern, const PatternTokenIds* token) {
+    if (pattern->pos != PATTERN_SYMBOL_WILDCARD &&
+        pattern->pos != token->pos &&
+        pattern->pos != token->pos_detail) {
+        return false;
+    }
+    return pattern->type == PATTERN_ANY_TYPE || pattern->type == token->type;
+}
+
+// パターン一覧のうちトークンにマッチするものを加点する（同じパターンは一度だけ）
+static void pattern_matcher_visit(const PatternMatcher* matcher, const int* entries, int count,
+                                  const PatternTokenIds* token, unsigned int* seen, unsigned int stamp, float* scores) {
+    for (int i = 0; i < count; i++) {
+        int index = entries[i];
+        if (seen[index] == stamp) {
+            continue;
+        }
+
+        const CompiledPattern* pattern = &matcher->patterns[index];
+        if (pattern_matcher_accepts(pattern, token)) {
+            seen[index] = stamp;
+            scores[pattern->owner] += pattern->weight;
+        }
+    }
+}
+
+// 表層形または基本形のキーワードに対応するパターン一覧
+static const int* pattern_matcher_postings(const PatternMatcher* matcher, int keyword, int* count) {
+    if (keyword <= PATTERN_SYMBOL_WILDCARD || keyword >= matcher->keyword_count) {
+        *count = 0;
+        return NULL;
+    }
+
+    int begin = matcher->keyword_offsets[keyword];
+    *count = matcher->keyword_offsets[keyword + 1] - begin;
+    return matcher->keyword_entries + begin;
+}
+
+// 全所有者のスコアを1回のトークン走査で計算する
+void pattern_matcher_score(const PatternMatcher* matcher, const PatternTokenIds* tokens, int token_count,
+                           unsigned int* seen, unsigned int stamp, float* scores) {
+    for (int i = 0; i < matcher->owner_count; i++) {
+        scores[i] = 0.0f;
+    }
+
+    for (int j = 0; j < token_count; j++) {
+        const PatternTokenIds* token = &tokens[j];
+        int count = 0;
+        const int* entries = pattern_matcher_postings(matcher, token->surface, &count);
+        pattern_matcher_visit(matcher, entries, count, token, seen, stamp, scores);
+
+        if (token->base != token->surface) {
+            entries = pattern_matcher_postings(matcher, token->base, &count);
+            pattern_matcher_visit(matcher, entries, count, token, seen, stamp, scores);
+        }
+
+        pattern_matcher_visit(matcher, matcher->wildcard_entries, matcher->wildcard_count, token, seen, stamp, scores);
+    }
+
+    // パターン数で正規化
+    for (int i = 0; i < matcher->owner_count; i++) {
+        if (matcher->owner_pattern_counts[i] > 0) {
+            scores[i] /= matcher->owner_pattern_counts[i];
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef PATTERN_MATCHER_H
+#define PATTERN_MATCHER_H
+
+#include <stdbool.h>
+
+#define PATTERN_SYMBOL_NONE -1      // 登録されていない文字列
+#define PATTERN_SYMBOL_WILDCARD 0   // "*"（どの文字列にもマッチ）
+#define PATTERN_ANY_TYPE -1         // どの概念タイプにもマッチ
+
+// 文字列を整数IDに変換する表（起動時に登録し、以降は読み取り専用）
+typedef struct {
+    char** strings;         // ID → 文字列
+    int count;
+    int capacity;
+    int* buckets;           // オープンアドレス法のハッシュ表（ID、空きは -1）
+    int bucket_count;
+} PatternSymbols;
+
+// トークンの各文字列のID
+typedef struct {
+    int surface;            // 表層形
+    int base;               // 基本形
+    int pos;                // 品詞
+    int pos_detail;         // 品詞細分類
+    int type;               // 概念タイプ
+} PatternTokenIds;
+
+// コンパイル済みパターン
+typedef struct {
+    int owner;              // 所有者（エージェントまたはトピックの番号）
+    int keyword;            // キーワードのID
+    int pos;                // 品詞のID
+    int type;               // 概念タイプ（PATTERN_ANY_TYPE は任意）
+    float weight;           // 重み
+} CompiledPattern;
+
+// キーワード → パターンの転置表
+typedef struct {
+    PatternSymbols* symbols;    // 共有のシンボル表
+    CompiledPattern* patterns;
+    int pattern_count;
+    int pattern_capacity;
+    int* keyword_offsets;       // キーワードID k のパターンは keyword_entries[offsets[k]..offsets[k+1])
+    int* keyword_entries;
+    int keyword_count;          // 転置表を作成した時点のシンボル数
+    int* wildcard_entries;      // キーワードが "*" のパターン
+    int wildcard_count;
+    int* owner_pattern_counts;  // 所有者ごとのパターン数（正規化に使う）
+    int owner_count;
+} PatternMatcher;
+
+// シンボル表を初期化（ID 0 は "*"）
+bool pattern_symbols_init(PatternSymbols* symbols);
+
+// シンボル表を解放
+void pattern_symbols_free(PatternSymbols* symbols);
+
+// 文字列を登録してIDを返す
+int pattern_symbols_intern(PatternSymbols* symbols, const char* str);
+
+// 文字列のIDを返す（未登録なら PATTERN_SYMBOL_NONE、複数スレッドから呼べる）
+int pattern_symbols_lookup(const PatternSymbols* symbols, const char* str);
+
+// マッチャーを初期化
+void pattern_matcher_init(PatternMatcher* matcher, PatternSymbols* symbols, int owner_count);
+
+// マッチャーを解放
+void pattern_matcher_free(PatternMatcher* matcher);
+
+// パターンを追加（キーワードと品詞はシンボル表に登録される）
+bool pattern_matcher_add(PatternMatcher* matcher, int owner, const char* keyword, const char* pos, int type, float weight);
+
+// 転置表を作成（パターンを追加し終えたら一度だけ呼ぶ）
+bool pattern_matcher_compile(PatternMatcher* matcher);
+
+// 全所有者のスコアを1回のトークン走査で計算する
+// seen はパターン数分の作業領域、stamp は呼び出しごとに異なる値（0以外）
+void pattern_matcher_score(const PatternMatcher* matcher, const PatternTokenIds* tokens, int token_count,
+                           unsigned int* seen, unsigned int stamp, float* scores);
+
+#endif // PATTERN_MATCHER_H
@@ -0,0 +1,542 @@
+#include "qa_log_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define QA_LOG_WORD_DELIMITERS " \t\n,.!?;:()[]{}\"'"
+#define QA_LOG_RECORD_HEADER "=== %s %zu ==="     // セグメントのレコードの見出し（タイトルと本文のバイト数）
+
+// キューに積む質問応答（文字列は構造体の直後に続けて置く）
+typedef struct {
+    const char* question;
+    const char* answer;
+    const char* agent;
+    const char* topic;
+    float topic_confidence;
+    double elapsed;
+    time_t answered_at;
+} QALogRecord;
+
+// キューの要素（sequence で空きと書き込み済みを見分ける）
+typedef struct {
+    uint64_t sequence;
+    QALogRecord* record;
+} QALogSlot;
+
+// 書き込みスレッドの状態
+// キューは複数の要求スレッドが積み、書き込みスレッドだけが取り出すロックなしのリングバッファ
+typedef struct {
+    QALogSlot slots[QA_LOG_QUEUE_SIZE];
+    uint64_t enqueue_pos;
+    uint64_t dequeue_pos;
+    sem_t items;                    // 積まれたら増やして書き込みスレッドを起こす
+    sem_t free_slots;               // 空いている要素の数（要求スレッドは満杯ならここで待つ）
+    pthread_t thread;
+    bool running;
+    bool closing;                   // 停止を始めた（これ以降の要求スレッドは呼び出し元で書く）
+    bool stopping;                  // 積まれることがなくなった（書き込みスレッドは残りを書き出して終わる）
+    pthread_rwlock_t state_lock;    // 積む間は読み込み、停止の開始は書き込み（停止後に積まれて失われないように）
+    pthread_mutex_t lock;           // セグメントへの書き込み（スレッドがない場合の呼び出し元と共有）
+    KnowledgeBase* knowledge_base;
+    char directory[256];
+    FILE* segment;
+    size_t segment_bytes;
+    QALogStats stats;
+} QALogWriter;
+
+static QALogWriter qa_log_writer = {.lock = PTHREAD_MUTEX_INITIALIZER, .state_lock = PTHREAD_RWLOCK_INITIALIZER};
+
+// 質問応答を1回の確保でコピーする
+static QALogRecord* qa_log_record_create(const QALogEntry* entry) {
+    const char* fields[4] = {entry->question, entry->answer, entry->agent ? entry->agent : "", entry->topic ? entry->topic : ""};
+    size_t lengths[4];
+    size_t total = sizeof(QALogRecord);
+    for (int i = 0; i < 4; i++) {
+        lengths[i] = strlen(fields[i]);
+        total += lengths[i] + 1;
+    }
+
+    QALogRecord* record = (QALogRecord*)malloc(total);
+    if (!record) {
+        return NULL;
+    }
+
+    char* p = (char*)(record + 1);
+    const char** copies[4] = {&record->question, &record->answer, &record->agent, &record->topic};
+    for (int i = 0; i < 4; i++) {
+        memcpy(p, fields[i], lengths[i] + 1);
+        *copies[i] = p;
+        p += lengths[i] + 1;
+    }
+    record->topic_confidence = entry->topic_confidence;
+    record->elapsed = entry->elapsed;
+    record->answered_at = entry->answered_at;
+    return record;
+}
+
+// キューに積む（満杯なら false、free_slots で空きを確保してから呼べば失敗しない）
+static bool qa_log_queue_push(QALogRecord* record) {
+    QALogWriter* writer = &qa_log_writer;
+    uint64_t pos = __atomic_load_n(&writer->enqueue_pos, __ATOMIC_RELAXED);
+    QALogSlot* slot;
+
+    for (;;) {
+        slot = &writer->slots[pos & (QA_LOG_QUEUE_SIZE - 1)];
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(sequence - pos);
+        if (diff == 0) {
+            // 空いている要素を他の要求スレッドと取り合う
+            if (__atomic_compare_exchange_n(&writer->enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = __atomic_load_n(&writer->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->record = record;
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// キューから取り出す（書き込みスレッドだけが呼ぶ、空なら NULL）
+static QALogRecord* qa_log_queue_pop(void) {
+    QALogWriter* writer = &qa_log_writer;
+    uint64_t pos = writer->dequeue_pos;
+    QALogSlot* slot = &writer->slots[pos & (QA_LOG_QUEUE_SIZE - 1)];
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != pos + 1) {
+        return NULL;
+    }
+
+    QALogRecord* record = slot->record;
+    __atomic_store_n(&slot->sequence, pos + QA_LOG_QUEUE_SIZE, __ATOMIC_RELEASE);
+    writer->dequeue_pos = pos + 1;
+    sem_post(&writer->free_slots);
+    return record;
+}
+
+// 書き込み先のセグメントを用意する（大きくなったら新しいセグメントに切り替える）
+static bool qa_log_open_segment(QALogWriter* writer) {
+    if (writer->segment && writer->segment_bytes < QA_LOG_SEGMENT_BYTES) {
+        return true;
+    }
+    if (writer->segment) {
+        fflush(writer->segment);
+        fdatasync(fileno(writer->segment));
+        fclose(writer->segment);
+        writer->segment = NULL;
+    }
+
+    struct stat st = {0};
+    if (stat(writer->directory, &st) == -1) {
+        mkdir(writer->directory, 0700);
+    }
+
+    time_t now = time(NULL);
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d_%H-%M-%S", &tm_info);
+
+    // 同じ秒に切り替えた場合は番号を付けて、満杯でないセグメントを探す
+    char path[512];
+    for (int n = 0; ; n++) {
+        if (n == 0) {
+            snprintf(path, sizeof(path), "%s/qa_%s.log", writer->directory, timestamp);
+        } else {
+            snprintf(path, sizeof(path), "%s/qa_%s_%d.log", writer->directory, timestamp, n);
+        }
+        if (stat(path, &st) == -1 || st.st_size < QA_LOG_SEGMENT_BYTES) {
+            break;
+        }
+    }
+
+    writer->segment = fopen(path, "a");
+    if (!writer->segment) {
+        fprintf(stderr, "ログファイルを開けませんでした: %s\n", path);
+        return false;
+    }
+
+    fseek(writer->segment, 0, SEEK_END);
+    long size = ftell(writer->segment);
+    writer->segment_bytes = size > 0 ? (size_t)size : 0;
+    return true;
+}
+
+// 質問応答をログの本文にする（戻り値は呼び出し側で free）
+static char* qa_log_format(const QALogRecord* record, const char* title) {
+    struct tm tm_info;
+    localtime_r(&record->answered_at, &tm_info);
+    char timestamp[32];
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d_%H-%M-%S", &tm_info);
+
+    // 単語数をカウント
+    int word_count = 0;
+    char* text_copy = strdup(record->question);
+    char* saveptr = NULL;
+    char* token = text_copy ? strtok_r(text_copy, QA_LOG_WORD_DELIMITERS, &saveptr) : NULL;
+    while (token != NULL) {
+        word_count++;
+        token = strtok_r(NULL, QA_LOG_WORD_DELIMITERS, &saveptr);
+    }
+    free(text_copy);
+
+    // デバッグ情報を含むコンテンツを作成
+    const char* format =
+        "# 質問応答ログ: %s\n\n"
+        "## タイムスタンプ\n%s\n\n"
+        "## 質問\n%s\n\n"
+        "## 回答\n%s\n\n"
+        "## デバッグ情報\n"
+        "- 処理時間: %.3f秒\n"
+        "- 最適エージェント: %s\n"
+        "- 関連トピック: %s (信頼度: %.2f)\n"
+        "- 単語数: %d\n"
+        "- 文字数: %d\n"
+        "- 回答文字数: %d\n";
+    int length = snprintf(NULL, 0, format, title, timestamp, record->question, record->answer,
+                          record->elapsed, record->agent, record->topic, record->topic_confidence,
+                          word_count, (int)strlen(record->question), (int)strlen(record->answer));
+    char* content = length >= 0 ? (char*)malloc((size_t)length + 1) : NULL;
+    if (!content) {
+        return NULL;
+    }
+    snprintf(content, (size_t)length + 1, format, title, timestamp, record->question, record->answer,
+             record->elapsed, record->agent, record->topic, record->topic_confidence,
+             word_count, (int)strlen(record->question), (int)strlen(record->answer));
+    return content;
+}
+
+// 質問応答を知識ベースに加える（1件ずつのファイルは作らない）
+// セグメントから読み直したもの（path があるもの）は、次の起動でスナップショットから戻せるように記録する
+static void qa_log_add_to_knowledge_base(QALogWriter* writer, const char* path, const char* title, const char* content) {
+    if (writer->knowledge_base) {
+        const char* tags[] = {"自動生成", "Q&A", "ログ"};
+        if (path) {
+            knowledge_base_add_log_document(writer->knowledge_base, path, title, content, "質問回答", tags, 3);
+        } else {
+            knowledge_base_add_document_unsaved(writer->knowledge_base, title, content, "質問回答", tags, 3);
+        }
+    }
+}
+
+// まとめてセグメントに追記し、1回の fsync で確定させてから知識ベースに加える
+static void qa_log_write_batch(QALogWriter* writer, QALogRecord** records, int count) {
+    char* contents[QA_LOG_BATCH_MAX];
+    char titles[QA_LOG_BATCH_MAX][32];
+
+    pthread_mutex_lock(&writer->lock);
+
+    bool written = false;
+    for (int i = 0; i < count; i++) {
+        snprintf(titles[i], sizeof(titles[i]), "Q_%lu", (unsigned long)records[i]->answered_at);
+        contents[i] = qa_log_format(records[i], titles[i]);
+        if (!contents[i]) {
+            fprintf(stderr, "メモリ割り当てエラー: 質問応答ログの作成に失敗しました\n");
+            continue;
+        }
+        if (!qa_log_open_segment(writer)) {
+            continue;
+        }
+
+        // レコードは見出し行（タイトルと本文のバイト数）の後に本文と空行を続ける
+        size_t length = strlen(contents[i]);
+        int header = fprintf(writer->segment, QA_LOG_RECORD_HEADER "\n", titles[i], length);
+        if (header < 0 || fwrite(contents[i], 1, length, writer->segment) != length || fputc('\n', writer->segment) == EOF) {
+            fprintf(stderr, "ログファイルに書き込めませんでした\n");
+            continue;
+        }
+        writer->segment_bytes += (size_t)header + length + 1;
+        written = true;
+    }
+
+    if (written) {
+        fflush(writer->segment);
+        fdatasync(fileno(writer->segment));
+        __sync_fetch_and_add(&writer->stats.batches, 1);
+    }
+
+    // 知識ベースにも追加（ファイルはセグメントだけで、次回の起動時にセグメントから読み込み直す）
+    for (int i = 0; i < count; i++) {
+        if (contents[i]) {
+            qa_log_add_to_knowledge_base(writer, NULL, titles[i], contents[i]);
+        }
+        free(contents[i]);
+        free(records[i]);
+    }
+    __sync_fetch_and_add(&writer->stats.records, count);
+
+    pthread_mutex_unlock(&writer->lock);
+}
+
+// 書き込みスレッド（積まれた分をまとめて書き、空になったら待つ）
+static void* qa_log_writer_main(void* arg) {
+    QALogWriter* writer = (QALogWriter*)arg;
+    QALogRecord* batch[QA_LOG_BATCH_MAX];
+
+    for (;;) {
+        // 停止の印は取り出す前に読む（印が立つ前に積まれた分は、この後の取り出しで必ず見える）
+        bool stopping = __atomic_load_n(&writer->stopping, __ATOMIC_ACQUIRE);
+
+        // fsync の間に積まれた分は次の1回にまとまる
+        int count = 0;
+        while (count < QA_LOG_BATCH_MAX && (batch[count] = qa_log_queue_pop()) != NULL) {
+            count++;
+        }
+        if (count > 0) {
+            qa_log_write_batch(writer, batch, count);
+            continue;
+        }
+
+        if (stopping) {
+            break;
+        }
+        while (sem_wait(&writer->items) == -1 && errno == EINTR) {
+        }
+    }
+
+    return NULL;
+}
+
+// セグメントのファイル名の比較（名前に時刻が入っているので、名前の順が書いた順になる）
+static int qa_log_compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// 1つのセグメントのうち、まだ知識ベースにない質問応答を加えて件数を返す（見出しのないところは読み飛ばす）
+// 前回までに加えた範囲はスナップショットから戻っているので、その続きから読む
+static int qa_log_replay_segment(QALogWriter* writer, const char* path) {
+    KnowledgeBase* kb = writer->knowledge_base;
+    long long offset = knowledge_base_log_offset(kb, path);
+
+    struct stat st;
+    if (stat(path, &st) != 0 || (long long)st.st_size <= offset) {
+        return 0;
+    }
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "ログファイルを開けませんでした: %s\n", path);
+        return 0;
+    }
+    if (offset > 0 && fseeko(file, (off_t)offset, SEEK_SET) != 0) {
+        fclose(file);
+        return 0;
+    }
+
+    int count = 0;
+    long long consumed = offset;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char title[32];
+        size_t length;
+        if (sscanf(line, "=== %31s %zu ===", title, &length) != 2) {
+            continue;
+        }
+
+        char* content = (char*)malloc(length + 1);
+        if (!content) {
+            fprintf(stderr, "メモリ割り当てエラー: 質問応答ログの読み込みに失敗しました\n");
+            break;
+        }
+        if (fread(content, 1, length, file) != length) {
+            // 書きかけのレコード（次の起動でもここから読む）
+            free(content);
+            break;
+        }
+        content[length] = '\0';
+        qa_log_add_to_knowledge_base(writer, path, title, content);
+        free(content);
+        consumed = (long long)ftello(file);
+        count++;
+    }
+
+    fclose(file);
+    knowledge_base_set_log_offset(kb, path, (long long)st.st_mtime, consumed);
+    return count;
+}
+
+// 前回までのセグメントの質問応答のうち、知識ベースにないものを書いた順に加える
+static void qa_log_replay(QALogWriter* writer) {
+    if (!writer->knowledge_base) {
+        return;
+    }
+    DIR* dir = opendir(writer->directory);
+    if (!dir) {
+        return;
+    }
+
+    char** names = NULL;
+    int count = 0;
+    int capacity = 0;
+    int replayed = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (strncmp(entry->d_name, "qa_", 3) != 0 || len < 7 || strcmp(entry->d_name + len - 4, ".log") != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            int new_capacity = capacity > 0 ? capacity * 2 : 16;
+            char** new_names = (char**)realloc(names, sizeof(char*) * new_capacity);
+            if (!new_names) {
+                break;
+            }
+            names = new_names;
+            capacity = new_capacity;
+        }
+        names[count] = strdup(entry->d_name);
+        if (names[count]) {
+            count++;
+        }
+    }
+    closedir(dir);
+
+    if (count > 1) {
+        qsort(names, count, sizeof(char*), qa_log_compare_names);
+    }
+    for (int i = 0; i < count; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", writer->directory, names[i]);
+        replayed += qa_log_replay_segment(writer, path);
+        free(names[i]);
+    }
+    free(names);
+
+    // 読んだ分をスナップショットに残し、次の起動では新しく書かれた分だけを読む
+    if (replayed > 0) {
+        knowledge_base_save_snapshot(writer->knowledge_base);
+    }
+}
+
+// 書き込みスレッドを開始する
+bool qa_log_writer_start(const char* directory, KnowledgeBase* knowledge_base) {
+    QALogWriter* writer = &qa_log_writer;
+    if (writer->running) {
+        return true;
+    }
+
+    strncpy(writer->directory, directory, sizeof(writer->directory) - 1);
+    writer->directory[sizeof(writer->directory) - 1] = '\0';
+    writer->knowledge_base = knowledge_base;
+    writer->enqueue_pos = 0;
+    writer->dequeue_pos = 0;
+    writer->closing = false;
+    writer->stopping = false;
+    for (int i = 0; i < QA_LOG_QUEUE_SIZE; i++) {
+        writer->slots[i].sequence = (uint64_t)i;
+        writer->slots[i].record = NULL;
+    }
+
+    // 前回までのセグメントの質問応答を知識ベースに戻す
+    qa_log_replay(writer);
+
+    if (sem_init(&writer->items, 0, 0) != 0) {
+        fprintf(stderr, "ログ書き込みスレッドを開始できませんでした\n");
+        return false;
+    }
+    if (sem_init(&writer->free_slots, 0, QA_LOG_QUEUE_SIZE) != 0) {
+        fprintf(stderr, "ログ書き込みスレッドを開始できませんでした\n");
+        sem_destroy(&writer->items);
+        return false;
+    }
+    if (pthread_create(&writer->thread, NULL, qa_log_writer_main, writer) != 0) {
+        fprintf(stderr, "ログ書き込みスレッドを開始できませんでした\n");
+        sem_destroy(&writer->items);
+        sem_destroy(&writer->free_slots);
+        return false;
+    }
+
+    pthread_rwlock_wrlock(&writer->state_lock);
+    writer->running = true;
+    pthread_rwlock_unlock(&writer->state_lock);
+    return true;
+}
+
+// 質問応答をキューに積む
+bool qa_log_writer_submit(const QALogEntry* entry) {
+    QALogWriter* writer = &qa_log_writer;
+    if (!entry || !entry->question || !entry->answer) {
+        return false;
+    }
+
+    QALogRecord* record = qa_log_record_create(entry);
+    if (!record) {
+        fprintf(stderr, "メモリ割り当てエラー: 質問応答ログの追加に失敗しました\n");
+        return false;
+    }
+
+    // スレッドがないか停止を始めていれば、その場で書く
+    pthread_rwlock_rdlock(&writer->state_lock);
+    if (!writer->running || __atomic_load_n(&writer->closing, __ATOMIC_ACQUIRE)) {
+        pthread_rwlock_unlock(&writer->state_lock);
+        qa_log_write_batch(writer, &record, 1);
+        return true;
+    }
+
+    // 満杯なら書き込みスレッドが取り出して空けるまで待つ
+    if (sem_trywait(&writer->free_slots) != 0) {
+        __sync_fetch_and_add(&writer->stats.waits, 1);
+        while (sem_wait(&writer->free_slots) == -1 && errno == EINTR) {
+        }
+    }
+    bool queued = qa_log_queue_push(record);
+    if (queued) {
+        sem_post(&writer->items);
+    }
+    pthread_rwlock_unlock(&writer->state_lock);
+
+    if (!queued) {
+        qa_log_write_batch(writer, &record, 1);
+    }
+    return true;
+}
+
+// キューに残った分を書き出してスレッドを止める
+void qa_log_writer_stop(void) {
+    QALogWriter* writer = &qa_log_writer;
+
+    // 先に印を立てて新しい要求スレッドを呼び出し元での書き込みに回し、積んでいる途中の分だけを待つ
+    // （読み込みロックを取り続けられて停止が進まないことがないように）。
+    // 書き込みロックを取った後は新しく積まれないので、スレッドは残りを書き出して終わる
+    __atomic_store_n(&writer->closing, true, __ATOMIC_RELEASE);
+    pthread_rwlock_wrlock(&writer->state_lock);
+    bool running = writer->running;
+    __atomic_store_n(&writer->stopping, true, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&writer->state_lock);
+
+    if (running) {
+        sem_post(&writer->items);
+        pthread_join(writer->thread, NULL);
+        sem_destroy(&writer->items);
+        sem_destroy(&writer->free_slots);
+
+        pthread_rwlock_wrlock(&writer->state_lock);
+        writer->running = false;
+        pthread_rwlock_unlock(&writer->state_lock);
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    if (writer->segment) {
+        fclose(writer->segment);
+        writer->segment = NULL;
+    }
+    pthread_mutex_unlock(&writer->lock);
+}
+
+// 統計情報を取得
+void qa_log_writer_get_stats(QALogStats* stats) {
+    stats->records = __sync_fetch_and_add(&qa_log_writer.stats.records, 0);
+    stats->batches = __sync_fetch_and_add(&qa_log_writer.stats.batches, 0);
+    stats->waits = __sync_fetch_and_add(&qa_log_writer.stats.waits, 0);
+}
@@ -0,0 +1,46 @@
+#ifndef QA_LOG_WRITER_H
+#define QA_LOG_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "knowledge_manager.h"
+
+#define QA_LOG_QUEUE_SIZE 1024                      // キューの長さ（2の累乗）
+#define QA_LOG_BATCH_MAX 64                         // 1回の fsync でまとめる最大件数
+#define QA_LOG_SEGMENT_BYTES (4 * 1024 * 1024)      // ログセグメントを切り替える大きさ
+
+// 1件の質問応答
+typedef struct {
+    const char* question;
+    const char* answer;
+    const char* agent;          // 選ばれたエージェント
+    const char* topic;          // 関連トピック
+    float topic_confidence;
+    double elapsed;             // 処理時間（秒）
+    time_t answered_at;
+} QALogEntry;
+
+// 書き込みの統計情報
+typedef struct {
+    long records;               // 書き込んだ件数
+    long batches;               // fsync の回数
+    long waits;                 // キューが満杯で待った回数
+} QALogStats;
+
+// 書き込みスレッドを開始する（ログは directory のセグメントに追記し、knowledge_base にも加える）
+// 知識ベースには1件ずつのファイルを作らずに加え、開始時に directory のセグメントから読み込み直す
+// 開始できなかった場合も qa_log_writer_submit は呼び出し元で書き込む
+bool qa_log_writer_start(const char* directory, KnowledgeBase* knowledge_base);
+
+// 質問応答をキューに積む（文字列はコピーするので、戻ったら呼び出し元で再利用してよい）
+// キューが満杯なら空くまで待ち、停止を始めた後は呼び出し元で書き込む
+bool qa_log_writer_submit(const QALogEntry* entry);
+
+// キューに残った分を書き出してスレッドを止める（以降の qa_log_writer_submit は呼び出し元で書き込む）
+void qa_log_writer_stop(void);
+
+// 統計情報を取得
+void qa_log_writer_get_stats(QALogStats* stats);
+
+#endif // QA_LOG_WRITER_H
@@ -0,0 +1,670 @@
+#include "query_server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <strings.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// 待ち受け中かどうか（シグナルで停止する）
+static volatile sig_atomic_t server_running = 0;
+static bool server_debug = false;
+// 行プロトコルの応答を書き出す記述子（標準出力の複製）
+static int protocol_fd = -1;
+
+// 処理待ち接続のキュー（受け付けスレッドが積み、ワーカーが取り出す）
+typedef struct {
+    int fds[QUERY_SERVER_QUEUE_SIZE];
+    int head;
+    int count;
+    int active_fds[QUERY_SERVER_MAX_THREADS];  // 各ワーカーが処理中の接続（停止時に切断する）
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+} QueryServerQueue;
+
+// ワーカースレッドの情報
+typedef struct {
+    int index;
+    pthread_t thread;
+    const QueryServerConfig* config;
+} QueryServerWorker;
+
+static QueryServerQueue connection_queue;
+
+// 設定をデフォルト値で初期化
+void query_server_config_init(QueryServerConfig* config) {
+    config->port = 0;
+    config->socket_path[0] = '\0';
+    config->threads = 0;
+    config->debug = false;
+    config->handler = NULL;
+    config->worker_init = NULL;
+    config->worker_free = NULL;
+}
+
+// 待ち受けを停止する
+void query_server_stop() {
+    server_running = 0;
+}
+
+// 終了シグナルのハンドラ
+static void query_server_signal_handler(int sig) {
+    (void)sig;
+    server_running = 0;
+}
+
+// シグナルハンドラを設定（acceptを中断できるようSA_RESTARTは付けない）
+static void query_server_install_signals() {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = query_server_signal_handler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    // 切断されたクライアントへの書き込みで終了しないようにする
+    signal(SIGPIPE, SIG_IGN);
+}
+
+// 単調増加時計の現在時刻（ミリ秒）
+static double query_server_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// 末尾の改行を削除
+static void query_server_chomp(char* line) {
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+        line[--len] = '\0';
+    }
+}
+
+// 質問を処理する
+static int query_server_answer(const QueryServerConfig* config, void* worker, const char* text, char* response) {
+    double start = query_server_now_ms();
+
+    response[0] = '\0';
+    int result = config->handler(worker, text, response);
+    response[QUERY_SERVER_MAX_RESPONSE - 1] = '\0';
+
+    if (server_debug) {
+        fprintf(stderr, "[server] %.2f ms: %s\n", query_server_now_ms() - start, text);
+    }
+
+    return result;
+}
+
+// 行プロトコルで応答を書き出す（"." で始まる行は "." を重ねる）
+static void query_server_write_lines(FILE* out, const char* response) {
+    const char* p = response;
+    while (*p) {
+        const char* newline = strchr(p, '\n');
+        size_t len = newline ? (size_t)(newline - p) : strlen(p);
+
+        if (*p == '.') {
+            fputc('.', out);
+        }
+        fwrite(p, 1, len, out);
+        fputc('\n', out);
+
+        p += len;
+        if (newline) {
+            p++;
+        }
+    }
+
+    fputs(".\n", out);
+    fflush(out);
+}
+
+// 行プロトコルの終了コマンドかどうか
+static bool query_server_is_quit(const char* line) {
+    return strcmp(line, "exit") == 0 || strcmp(line, "quit") == 0;
+}
+
+// 応答用に標準出力を複製し、以降のログ出力は標準エラーへ回す
+int query_server_reserve_stdout() {
+    if (protocol_fd >= 0) {
+        return protocol_fd;
+    }
+
+    fflush(stdout);
+    protocol_fd = dup(STDOUT_FILENO);
+    if (protocol_fd < 0) {
+        perror("dup");
+        return -1;
+    }
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    return protocol_fd;
+}
+
+// 標準入出力の行プロトコルで質問を処理する
+int query_server_run_stdio(const QueryServerConfig* config) {
+    int out_fd = query_server_reserve_stdout();
+    if (out_fd < 0) {
+        return 1;
+    }
+    protocol_fd = -1;
+
+    FILE* out = fdopen(out_fd, "w");
+    char* line = (char*)malloc(QUERY_SERVER_MAX_REQUEST);
+    char* response = (char*)malloc(QUERY_SERVER_MAX_RESPONSE);
+    if (!out || !line || !response) {
+        fprintf(stderr, "メモリ割り当てエラー: サーバーの初期化に失敗しました\n");
+        free(line);
+        free(response);
+        if (out) fclose(out);
+        return 1;
+    }
+
+    server_debug = config->debug;
+    void* worker = config->worker_init ? config->worker_init() : NULL;
+
+    query_server_install_signals();
+    server_running = 1;
+
+    while (server_running && fgets(line, QUERY_SERVER_MAX_REQUEST, stdin)) {
+        query_server_chomp(line);
+        if (line[0] == '\0') {
+            continue;
+        }
+        if (query_server_is_quit(line)) {
+            break;
+        }
+
+        query_server_answer(config, worker, line, response);
+        query_server_write_lines(out, response);
+    }
+
+    if (config->worker_free) {
+        config->worker_free(worker);
+    }
+    free(line);
+    free(response);
+    fclose(out);
+    return 0;
+}
+
+// URLエンコードされた文字列をデコード（その場で書き換える）
+static void query_server_url_decode(char* str) {
+    char* src = str;
+    char* dst = str;
+
+    while (*src) {
+        if (*src == '+') {
+            *dst++ = ' ';
+            src++;
+        } else if (*src == '%' && isxdigit((unsigned char)src[1]) && isxdigit((unsigned char)src[2])) {
+            char hex[3] = {src[1], src[2], '\0'};
+            *dst++ = (char)strtol(hex, NULL, 16);
+            src += 3;
+        } else {
+            *dst++ = *src++;
+        }
+    }
+    *dst = '\0';
+}
+
+// "a=1&q=..." 形式からパラメータ q を取り出す
+static bool query_server_extract_param(const char* params, char* out, size_t out_size) {
+    const char* p = params;
+    while (p && *p) {
+        if (strncmp(p, "q=", 2) == 0) {
+            p += 2;
+            size_t len = strcspn(p, "&");
+            if (len >= out_size) {
+                len = out_size - 1;
+            }
+            memcpy(out, p, len);
+            out[len] = '\0';
+            query_server_url_decode(out);
+            return true;
+        }
+        p = strchr(p, '&');
+        if (p) {
+            p++;
+        }
+    }
+    return false;
+}
+
+// HTTPレスポンスを書き出す
+static void query_server_write_http(FILE* out, int status, const char* reason, const char* body) {
+    fprintf(out, "HTTP/1.1 %d %s\r\n", status, reason);
+    fprintf(out, "Content-Type: text/plain; charset=utf-8\r\n");
+    fprintf(out, "Content-Length: %zu\r\n", strlen(body));
+    fprintf(out, "Connection: close\r\n\r\n");
+    fputs(body, out);
+    fflush(out);
+}
+
+// 簡易HTTPリクエストを処理（1接続1リクエスト）
+static void query_server_handle_http(FILE* in, FILE* out, char* request_line, char* response,
+                                     const QueryServerConfig* config, void* worker) {
+    char method[8] = {0};
+    char target[2048] = {0};
+    if (sscanf(request_line, "%7s %2047s", method, target) != 2) {
+        query_server_write_http(out, 400, "Bad Request", "不正なリクエストです\n");
+        return;
+    }
+
+    // ヘッダーを読み飛ばしつつ Content-Length を取得
+    char header[1024];
+    long content_length = 0;
+    while (fgets(header, sizeof(header), in)) {
+        query_server_chomp(header);
+        if (header[0] == '\0') {
+            break;
+        }
+        if (strncasecmp(header, "Content-Length:", 15) == 0) {
+            content_length = atol(header + 15);
+        }
+    }
+
+    // パスとクエリ文字列に分割
+    char* params = strchr(target, '?');
+    if (params) {
+        *params++ = '\0';
+    }
+
+    char* question = (char*)malloc(QUERY_SERVER_MAX_REQUEST);
+    if (!question) {
+        query_server_write_http(out, 500, "Internal Server Error", "メモリ割り当てエラー\n");
+        return;
+    }
+    question[0] = '\0';
+
+    if (strcmp(target, "/status") == 0) {
+        strcpy(question, "status");
+    } else if (strcmp(target, "/") == 0 || strcmp(target, "/ask") == 0 || strcmp(target, "/api/ask") == 0) {
+        if (strcmp(method, "POST") == 0 && content_length > 0) {
+            // 本文は生テキストまたはフォーム形式（q=...）
+            if (content_length >= QUERY_SERVER_MAX_REQUEST) {
+                content_length = QUERY_SERVER_MAX_REQUEST - 1;
+            }
+            size_t read_size = fread(question, 1, (size_t)content_length, in);
+            question[read_size] = '\0';
+
+            if (strncmp(question, "q=", 2) == 0) {
+                char* body = strdup(question);
+                if (body) {
+                    query_server_extract_param(body, question, QUERY_SERVER_MAX_REQUEST);
+                    free(body);
+                }
+            }
+            query_server_chomp(question);
+        } else if (params) {
+            query_server_extract_param(params, question, QUERY_SERVER_MAX_REQUEST);
+        }
+    } else {
+        query_server_write_http(out, 404, "Not Found", "見つかりません\n");
+        free(question);
+        return;
+    }
+
+    if (question[0] == '\0') {
+        query_server_write_http(out, 400, "Bad Request", "質問を q パラメータで指定してください\n");
+        free(question);
+        return;
+    }
+
+    query_server_answer(config, worker, question, response);
+    strncat(response, "\n", QUERY_SERVER_MAX_RESPONSE - strlen(response) - 1);
+    query_server_write_http(out, 200, "OK", response);
+
+    free(question);
+}
+
+// 1つの接続を処理する（client_fd 自体は呼び出し側で閉じる）
+static void query_server_handle_connection(int client_fd, char* line, char* response,
+                                           const QueryServerConfig* config, void* worker) {
+    // 質問を送らないまま接続し続けるクライアントがワーカーを占有しないよう、読み書きに時間制限を付ける
+    struct timeval timeout;
+    timeout.tv_sec = QUERY_SERVER_IDLE_TIMEOUT;
+    timeout.tv_usec = 0;
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    int in_fd = dup(client_fd);
+    int out_fd = dup(client_fd);
+    FILE* in = in_fd >= 0 ? fdopen(in_fd, "r") : NULL;
+    FILE* out = out_fd >= 0 ? fdopen(out_fd, "w") : NULL;
+    if (!in || !out) {
+        if (in) fclose(in); else if (in_fd >= 0) close(in_fd);
+        if (out) fclose(out); else if (out_fd >= 0) close(out_fd);
+        return;
+    }
+
+    if (fgets(line, QUERY_SERVER_MAX_REQUEST, in)) {
+        if (strncmp(line, "GET ", 4) == 0 || strncmp(line, "POST ", 5) == 0) {
+            query_server_handle_http(in, out, line, response, config, worker);
+        } else {
+            // 行プロトコル：接続が閉じられるか、上限の数に達するまで質問を受け付ける
+            int requests = 0;
+            do {
+                query_server_chomp(line);
+                if (line[0] == '\0') {
+                    continue;
+                }
+                if (query_server_is_quit(line)) {
+                    break;
+                }
+
+                query_server_answer(config, worker, line, response);
+                query_server_write_lines(out, response);
+                requests++;
+            } while (server_running && requests < QUERY_SERVER_MAX_CONNECTION_REQUESTS &&
+                     fgets(line, QUERY_SERVER_MAX_REQUEST, in));
+        }
+    }
+
+    fclose(out);
+    fclose(in);
+}
+
+// 接続をキューに積む（満杯または停止中の場合は待たずに閉じる）
+// 受け付けスレッドは終了シグナルも受け取るので、ここでは決してブロックしない
+static void query_server_queue_push(int client_fd) {
+    pthread_mutex_lock(&connection_queue.mutex);
+    if (connection_queue.count == QUERY_SERVER_QUEUE_SIZE || !server_running) {
+        pthread_mutex_unlock(&connection_queue.mutex);
+        if (server_debug) {
+            fprintf(stderr, "[server] 処理待ちの接続が多すぎるため切断しました\n");
+        }
+        close(client_fd);
+        return;
+    }
+
+    int tail = (connection_queue.head + connection_queue.count) % QUERY_SERVER_QUEUE_SIZE;
+    connection_queue.fds[tail] = client_fd;
+    connection_queue.count++;
+    pthread_cond_signal(&connection_queue.not_empty);
+    pthread_mutex_unlock(&connection_queue.mutex);
+}
+
+// 接続をキューから取り出す（停止時は -1 を返す）
+static int query_server_queue_pop(int worker_index) {
+    pthread_mutex_lock(&connection_queue.mutex);
+    while (connection_queue.count == 0 && server_running) {
+        pthread_cond_wait(&connection_queue.not_empty, &connection_queue.mutex);
+    }
+
+    int client_fd = -1;
+    if (connection_queue.count > 0 && server_running) {
+        client_fd = connection_queue.fds[connection_queue.head];
+        connection_queue.head = (connection_queue.head + 1) % QUERY_SERVER_QUEUE_SIZE;
+        connection_queue.count--;
+        connection_queue.active_fds[worker_index] = client_fd;
+    }
+    pthread_mutex_unlock(&connection_queue.mutex);
+
+    return client_fd;
+}
+
+// 処理の終わった接続を閉じる
+static void query_server_queue_done(int worker_index, int client_fd) {
+    pthread_mutex_lock(&connection_queue.mutex);
+    connection_queue.active_fds[worker_index] = -1;
+    pthread_mutex_unlock(&connection_queue.mutex);
+
+    close(client_fd);
+}
+
+// ワーカースレッド（状態・バッファはスレッドごとに持つ）
+static void* query_server_worker_main(void* arg) {
+    QueryServerWorker* worker = (QueryServerWorker*)arg;
+    const QueryServerConfig* config = worker->config;
+
+    char* line = (char*)malloc(QUERY_SERVER_MAX_REQUEST);
+    char* response = (char*)malloc(QUERY_SERVER_MAX_RESPONSE);
+    void* state = config->worker_init ? config->worker_init() : NULL;
+    if (!line || !response) {
+        fprintf(stderr, "メモリ割り当てエラー: ワーカー %d の初期化に失敗しました\n", worker->index);
+        free(line);
+        free(response);
+        if (config->worker_free) {
+            config->worker_free(state);
+        }
+        return NULL;
+    }
+
+    int client_fd;
+    while ((client_fd = query_server_queue_pop(worker->index)) >= 0) {
+        query_server_handle_connection(client_fd, line, response, config, state);
+        query_server_queue_done(worker->index, client_fd);
+    }
+
+    if (config->worker_free) {
+        config->worker_free(state);
+    }
+    free(line);
+    free(response);
+    return NULL;
+}
+
+// ワーカー数を決定（未指定ならCPU数）
+static int query_server_thread_count(const QueryServerConfig* config) {
+    int threads = config->threads;
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > QUERY_SERVER_MAX_THREADS) {
+        threads = QUERY_SERVER_MAX_THREADS;
+    }
+    return threads;
+}
+
+// TCPソケットを作成して待ち受ける
+static int query_server_listen_tcp(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        fprintf(stderr, "ポート %d で待ち受けできませんでした: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Unixソケットを作成して待ち受ける
+static int query_server_listen_unix(const char* path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    struct sockaddr_un addr;
+    size_t path_len = strlen(path);
+    if (path_len >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "ソケットのパスが長すぎます（%zu バイトまで）: %s\n", sizeof(addr.sun_path) - 1, path);
+        close(fd);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, path_len + 1);
+
+    // 前回の実行で残ったソケットファイルを削除
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+        fprintf(stderr, "ソケット %s で待ち受けできませんでした: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// TCPポートまたはUnixソケットで待ち受ける
+int query_server_run(const QueryServerConfig* config) {
+    struct pollfd listeners[2];
+    int listener_count = 0;
+
+    server_debug = config->debug;
+
+    if (config->port > 0) {
+        int fd = query_server_listen_tcp(config->port);
+        if (fd < 0) {
+            return 1;
+        }
+        listeners[listener_count].fd = fd;
+        listeners[listener_count].events = POLLIN;
+        listener_count++;
+        fprintf(stderr, "サーバーを起動しました: http://127.0.0.1:%d/ask?q=...\n", config->port);
+    }
+
+    if (config->socket_path[0] != '\0') {
+        int fd = query_server_listen_unix(config->socket_path);
+        if (fd < 0) {
+            for (int i = 0; i < listener_count; i++) {
+                close(listeners[i].fd);
+            }
+            return 1;
+        }
+        listeners[listener_count].fd = fd;
+        listeners[listener_count].events = POLLIN;
+        listener_count++;
+        fprintf(stderr, "サーバーを起動しました: %s\n", config->socket_path);
+    }
+
+    if (listener_count == 0) {
+        fprintf(stderr, "待ち受け先が指定されていません\n");
+        return 1;
+    }
+
+    int thread_count = query_server_thread_count(config);
+    QueryServerWorker* workers = (QueryServerWorker*)calloc(thread_count, sizeof(QueryServerWorker));
+    if (!workers) {
+        fprintf(stderr, "メモリ割り当てエラー: サーバーの初期化に失敗しました\n");
+        for (int i = 0; i < listener_count; i++) {
+            close(listeners[i].fd);
+        }
+        return 1;
+    }
+
+    connection_queue.head = 0;
+    connection_queue.count = 0;
+    for (int i = 0; i < QUERY_SERVER_MAX_THREADS; i++) {
+        connection_queue.active_fds[i] = -1;
+    }
+    pthread_mutex_init(&connection_queue.mutex, NULL);
+    pthread_cond_init(&connection_queue.not_empty, NULL);
+
+    query_server_install_signals();
+    server_running = 1;
+
+    // 終了シグナルは受け付けスレッド（poll）で受け取るよう、ワーカーではブロックする
+    sigset_t block_set;
+    sigset_t old_set;
+    sigemptyset(&block_set);
+    sigaddset(&block_set, SIGINT);
+    sigaddset(&block_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+
+    int started = 0;
+    for (int i = 0; i < thread_count; i++) {
+        workers[i].index = i;
+        workers[i].config = config;
+        if (pthread_create(&workers[i].thread, NULL, query_server_worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "ワーカースレッドの作成に失敗しました: %s\n", strerror(errno));
+            break;
+        }
+        started++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    if (started == 0) {
+        server_running = 0;
+    } else {
+        fprintf(stderr, "ワーカースレッド数: %d\n", started);
+    }
+
+    while (server_running) {
+        int ready = poll(listeners, listener_count, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+
+        for (int i = 0; i < listener_count; i++) {
+            if (!(listeners[i].revents & POLLIN)) {
+                continue;
+            }
+
+            int client_fd = accept(listeners[i].fd, NULL, NULL);
+            if (client_fd < 0) {
+                continue;
+            }
+
+            query_server_queue_push(client_fd);
+        }
+    }
+
+    // ワーカーを停止（処理中の接続は切断し、未処理の接続は閉じる）
+    pthread_mutex_lock(&connection_queue.mutex);
+    server_running = 0;
+    for (int i = 0; i < started; i++) {
+        if (connection_queue.active_fds[i] >= 0) {
+            shutdown(connection_queue.active_fds[i], SHUT_RDWR);
+        }
+    }
+    while (connection_queue.count > 0) {
+        close(connection_queue.fds[connection_queue.head]);
+        connection_queue.head = (connection_queue.head + 1) % QUERY_SERVER_QUEUE_SIZE;
+        connection_queue.count--;
+    }
+    pthread_cond_broadcast(&connection_queue.not_empty);
+    pthread_mutex_unlock(&connection_queue.mutex);
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    free(workers);
+
+    pthread_mutex_destroy(&connection_queue.mutex);
+    pthread_cond_destroy(&connection_queue.not_empty);
+
+    for (int i = 0; i < listener_count; i++) {
+        close(listeners[i].fd);
+    }
+    if (config->socket_path[0] != '\0') {
+        unlink(config->socket_path);
+    }
+
+    fprintf(stderr, "サーバーを停止しました\n");
+    return 0;
+}
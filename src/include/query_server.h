@@ -0,0 +1,53 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <stdbool.h>
+
+#define QUERY_SERVER_MAX_REQUEST 102400   // 1リクエストの最大長
+#define QUERY_SERVER_MAX_RESPONSE 65536   // 1レスポンスの最大長
+#define QUERY_SERVER_DEFAULT_PORT 50065   // genellm.sh と同じデフォルトポート
+#define QUERY_SERVER_MAX_THREADS 64       // ワーカースレッド数の上限
+#define QUERY_SERVER_QUEUE_SIZE 256       // 処理待ち接続の最大数（超えた接続は閉じる）
+#define QUERY_SERVER_IDLE_TIMEOUT 30      // 接続で次の入力を待つ最大秒数
+#define QUERY_SERVER_MAX_CONNECTION_REQUESTS 1000  // 1接続の行プロトコルで受け付ける質問数の上限
+
+// 質問を処理して応答を書き込む関数
+// worker はワーカースレッドごとの状態（worker_init の戻り値）
+typedef int (*QueryHandler)(void* worker, const char* text, char* response);
+
+// ワーカースレッドごとの状態を生成・解放する関数
+typedef void* (*QueryWorkerInit)();
+typedef void (*QueryWorkerFree)(void* worker);
+
+// サーバー設定
+typedef struct {
+    int port;                  // TCPポート（0の場合は使用しない）
+    char socket_path[256];     // Unixソケットのパス（空の場合は使用しない）
+    int threads;               // ワーカースレッド数（0の場合はCPU数）
+    bool debug;                // デバッグ出力
+    QueryHandler handler;      // 質問の処理関数
+    QueryWorkerInit worker_init;  // ワーカー状態の生成（NULL可）
+    QueryWorkerFree worker_free;  // ワーカー状態の解放（NULL可）
+} QueryServerConfig;
+
+// 設定をデフォルト値で初期化
+void query_server_config_init(QueryServerConfig* config);
+
+// 応答用に標準出力を確保し、以降の printf 出力を標準エラーへ回す
+// 初期化中のログが応答に混ざらないよう、起動直後に呼ぶ
+int query_server_reserve_stdout();
+
+// 標準入出力の行プロトコルで質問を処理する
+// 1行が1つの質問で、応答の後に "." だけの行を出力する
+int query_server_run_stdio(const QueryServerConfig* config);
+
+// TCPポートまたはUnixソケットで待ち受ける
+// 行プロトコルと簡易HTTP（GET /ask?q=... / POST /ask）の両方に対応
+// 接続はワーカースレッドのプールで並行に処理する
+// 処理待ちが QUERY_SERVER_QUEUE_SIZE を超えた接続と、QUERY_SERVER_IDLE_TIMEOUT 秒入力のない接続は閉じる
+int query_server_run(const QueryServerConfig* config);
+
+// 待ち受けを停止する（シグナルハンドラからも呼べる）
+void query_server_stop();
+
+#endif // QUERY_SERVER_H
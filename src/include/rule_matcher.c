@@ -0,0 +1,460 @@
+#include "rule_matcher.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RULE_MATCHER_INITIAL_STATES 256
+#define RULE_MATCHER_INITIAL_RULES 64
+#define RULE_MATCHER_CLAUSE_SEPARATOR " AND "
+
+// 遷移表のキー（状態と文字）
+static uint64_t rule_matcher_edge_key(int state, unsigned char c) {
+    return ((uint64_t)(unsigned int)state << 8) | c;
+}
+
+// 遷移表のハッシュ値
+static unsigned int rule_matcher_edge_hash(uint64_t key) {
+    key *= 0x9E3779B97F4A7C15ull;
+    return (unsigned int)(key >> 32);
+}
+
+// 遷移先を返す（なければ -1）
+static int rule_matcher_goto(const RuleMatcher* matcher, int state, unsigned char c) {
+    uint64_t key = rule_matcher_edge_key(state, c);
+    unsigned int mask = (unsigned int)matcher->edge_bucket_count - 1;
+    unsigned int slot = rule_matcher_edge_hash(key) & mask;
+    while (matcher->edge_values[slot] != -1) {
+        if (matcher->edge_keys[slot] == key) {
+            return matcher->edge_values[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+// 遷移表に登録（キーは未登録であること）
+static void rule_matcher_put_edge(uint64_t* keys, int* values, int bucket_count, uint64_t key, int value) {
+    unsigned int mask = (unsigned int)bucket_count - 1;
+    unsigned int slot = rule_matcher_edge_hash(key) & mask;
+    while (values[slot] != -1) {
+        slot = (slot + 1) & mask;
+    }
+    keys[slot] = key;
+    values[slot] = value;
+}
+
+// 遷移表を2倍に拡張して再配置
+static bool rule_matcher_rehash(RuleMatcher* matcher) {
+    int new_bucket_count = matcher->edge_bucket_count * 2;
+    uint64_t* new_keys = (uint64_t*)malloc(sizeof(uint64_t) * new_bucket_count);
+    int* new_values = (int*)malloc(sizeof(int) * new_bucket_count);
+    if (!new_keys || !new_values) {
+        fprintf(stderr, "メモリ割り当てエラー: 推論ルールの遷移表を拡張できませんでした\n");
+        free(new_keys);
+        free(new_values);
+        return false;
+    }
+
+    for (int i = 0; i < new_bucket_count; i++) {
+        new_values[i] = -1;
+    }
+    for (int i = 0; i < matcher->edge_bucket_count; i++) {
+        if (matcher->edge_values[i] != -1) {
+            rule_matcher_put_edge(new_keys, new_values, new_bucket_count, matcher->edge_keys[i], matcher->edge_values[i]);
+        }
+    }
+
+    free(matcher->edge_keys);
+    free(matcher->edge_values);
+    matcher->edge_keys = new_keys;
+    matcher->edge_values = new_values;
+    matcher->edge_bucket_count = new_bucket_count;
+    return true;
+}
+
+// 状態配列を拡張
+static bool rule_matcher_grow_states(RuleMatcher* matcher) {
+    int new_capacity = matcher->state_capacity > 0 ? matcher->state_capacity * 2 : RULE_MATCHER_INITIAL_STATES;
+    int* fail = (int*)realloc(matcher->fail, sizeof(int) * new_capacity);
+    if (fail) matcher->fail = fail;
+    int* output = (int*)realloc(matcher->output, sizeof(int) * new_capacity);
+    if (output) matcher->output = output;
+    int* output_link = (int*)realloc(matcher->output_link, sizeof(int) * new_capacity);
+    if (output_link) matcher->output_link = output_link;
+    int* first_child = (int*)realloc(matcher->first_child, sizeof(int) * new_capacity);
+    if (first_child) matcher->first_child = first_child;
+    int* next_sibling = (int*)realloc(matcher->next_sibling, sizeof(int) * new_capacity);
+    if (next_sibling) matcher->next_sibling = next_sibling;
+    unsigned char* label = (unsigned char*)realloc(matcher->label, new_capacity);
+    if (label) matcher->label = label;
+
+    if (!fail || !output || !output_link || !first_child || !next_sibling || !label) {
+        fprintf(stderr, "メモリ割り当てエラー: 推論ルールのオートマトンを拡張できませんでした\n");
+        return false;
+    }
+
+    matcher->state_capacity = new_capacity;
+    return true;
+}
+
+// 新しい状態を作成して番号を返す
+static int rule_matcher_new_state(RuleMatcher* matcher, unsigned char c) {
+    if (matcher->state_count >= matcher->state_capacity && !rule_matcher_grow_states(matcher)) {
+        return -1;
+    }
+
+    int state = matcher->state_count++;
+    matcher->fail[state] = 0;
+    matcher->output[state] = -1;
+    matcher->output_link[state] = -1;
+    matcher->first_child[state] = -1;
+    matcher->next_sibling[state] = -1;
+    matcher->label[state] = c;
+    return state;
+}
+
+// 照合器を初期化
+bool rule_matcher_init(RuleMatcher* matcher) {
+    memset(matcher, 0, sizeof(RuleMatcher));
+    matcher->always_rule = -1;
+    matcher->edge_bucket_count = RULE_MATCHER_INITIAL_STATES * 2;
+    matcher->edge_keys = (uint64_t*)malloc(sizeof(uint64_t) * matcher->edge_bucket_count);
+    matcher->edge_values = (int*)malloc(sizeof(int) * matcher->edge_bucket_count);
+    if (!matcher->edge_keys || !matcher->edge_values || rule_matcher_new_state(matcher, 0) != 0) {
+        fprintf(stderr, "メモリ割り当てエラー: 推論ルールの照合器を初期化できませんでした\n");
+        rule_matcher_free(matcher);
+        return false;
+    }
+
+    for (int i = 0; i < matcher->edge_bucket_count; i++) {
+        matcher->edge_values[i] = -1;
+    }
+    return true;
+}
+
+// 照合器を解放
+void rule_matcher_free(RuleMatcher* matcher) {
+    free(matcher->fail);
+    free(matcher->output);
+    free(matcher->output_link);
+    free(matcher->first_child);
+    free(matcher->next_sibling);
+    free(matcher->label);
+    free(matcher->edge_keys);
+    free(matcher->edge_values);
+    free(matcher->refs);
+    free(matcher->pattern_offsets);
+    free(matcher->pattern_refs);
+    free(matcher->required_masks);
+    free(matcher->confidences);
+    memset(matcher, 0, sizeof(RuleMatcher));
+    matcher->always_rule = -1;
+}
+
+// 条件語をトライに登録して条件語IDを返す（登録済みなら同じID）
+static int rule_matcher_insert(RuleMatcher* matcher, const char* clause, size_t length) {
+    int state = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)clause[i];
+        int next = rule_matcher_goto(matcher, state, c);
+        if (next < 0) {
+            // 負荷率を 1/2 以下に保つ
+            if ((matcher->edge_count + 1) * 2 > matcher->edge_bucket_count && !rule_matcher_rehash(matcher)) {
+                return -1;
+            }
+            next = rule_matcher_new_state(matcher, c);
+            if (next < 0) {
+                return -1;
+            }
+            rule_matcher_put_edge(matcher->edge_keys, matcher->edge_values, matcher->edge_bucket_count,
+                                  rule_matcher_edge_key(state, c), next);
+            matcher->edge_count++;
+            matcher->next_sibling[next] = matcher->first_child[state];
+            matcher->first_child[state] = next;
+        }
+        state = next;
+    }
+
+    if (matcher->output[state] < 0) {
+        matcher->output[state] = matcher->pattern_count++;
+    }
+    return matcher->output[state];
+}
+
+// 条件語の参照を追加
+static bool rule_matcher_add_ref(RuleMatcher* matcher, int pattern, int rule, uint64_t bit) {
+    if (matcher->ref_count >= matcher->ref_capacity) {
+        int new_capacity = matcher->ref_capacity > 0 ? matcher->ref_capacity * 2 : RULE_MATCHER_INITIAL_RULES * 2;
+        RuleClauseRef* new_refs = (RuleClauseRef*)realloc(matcher->refs, sizeof(RuleClauseRef) * new_capacity);
+        if (!new_refs) {
+            fprintf(stderr, "メモリ割り当てエラー: 推論ルールの条件を追加できませんでした\n");
+            return false;
+        }
+        matcher->refs = new_refs;
+        matcher->ref_capacity = new_capacity;
+    }
+
+    matcher->refs[matcher->ref_count].pattern = pattern;
+    matcher->refs[matcher->ref_count].rule = rule;
+    matcher->refs[matcher->ref_count].bit = bit;
+    matcher->ref_count++;
+    return true;
+}
+
+// ルールを追加してルール番号を返す（失敗時は -1）
+int rule_matcher_add(RuleMatcher* matcher, const char* condition, float confidence) {
+    if (matcher->rule_count >= matcher->rule_capacity) {
+        int new_capacity = matcher->rule_capacity > 0 ? matcher->rule_capacity * 2 : RULE_MATCHER_INITIAL_RULES;
+        uint64_t* masks = (uint64_t*)realloc(matcher->required_masks, sizeof(uint64_t) * new_capacity);
+        if (masks) matcher->required_masks = masks;
+        float* confidences = (float*)realloc(matcher->confidences, sizeof(float) * new_capacity);
+        if (confidences) matcher->confidences = confidences;
+        if (!masks || !confidences) {
+            fprintf(stderr, "メモリ割り当てエラー: 推論ルールを追加できませんでした\n");
+            return -1;
+        }
+        matcher->rule_capacity = new_capacity;
+    }
+
+    int rule = matcher->rule_count;
+    int first_ref = matcher->ref_count;
+    int clause_count = 0;
+    uint64_t required = 0;
+
+    // 条件を " AND " で区切り、前後の空白を除いた語ごとにビットを割り当てる
+    const char* p = condition;
+    while (p) {
+        const char* sep = strstr(p, RULE_MATCHER_CLAUSE_SEPARATOR);
+        const char* begin = p;
+        const char* end = sep ? sep : p + strlen(p);
+        p = sep ? sep + strlen(RULE_MATCHER_CLAUSE_SEPARATOR) : NULL;
+
+        while (begin < end && (*begin == ' ' || *begin == '\t')) begin++;
+        while (end > begin && (end[-1] == ' ' || end[-1] == '\t')) end--;
+        if (end == begin || (end - begin == 1 && *begin == '*')) {
+            continue;
+        }
+
+        int pattern = rule_matcher_insert(matcher, begin, (size_t)(end - begin));
+        if (pattern < 0) {
+            matcher->ref_count = first_ref;
+            return -1;
+        }
+
+        // 同じ語が重複していれば一つの条件として扱う
+        bool duplicate = false;
+        for (int i = first_ref; i < matcher->ref_count; i++) {
+            if (matcher->refs[i].pattern == pattern) {
+                duplicate = true;
+                break;
+            }
+        }
+        if (duplicate) {
+            continue;
+        }
+
+        if (clause_count >= RULE_MATCHER_MAX_CLAUSES) {
+            fprintf(stderr, "警告: 推論ルールの条件が多すぎます（最大 %d）: %s\n", RULE_MATCHER_MAX_CLAUSES, condition);
+            matcher->ref_count = first_ref;
+            return -1;
+        }
+
+        uint64_t bit = (uint64_t)1 << clause_count;
+        if (!rule_matcher_add_ref(matcher, pattern, rule, bit)) {
+            matcher->ref_count = first_ref;
+            return -1;
+        }
+        required |= bit;
+        clause_count++;
+    }
+
+    matcher->required_masks[rule] = required;
+    matcher->confidences[rule] = confidence;
+    matcher->rule_count++;
+    matcher->compiled = false;
+    return rule;
+}
+
+// ルール a が b より優先されるか（確信度が高いもの、同じなら先に登録したもの）
+static bool rule_matcher_prefers(const RuleMatcher* matcher, int a, int b) {
+    if (b < 0) {
+        return matcher->confidences[a] > 0.0f;
+    }
+    return matcher->confidences[a] > matcher->confidences[b] ||
+           (matcher->confidences[a] == matcher->confidences[b] && a < b);
+}
+
+// 失敗遷移と参照表を作成（ルールを追加し終えたら呼ぶ）
+bool rule_matcher_compile(RuleMatcher* matcher) {
+    // 幅優先で失敗遷移と出力リンクを求める
+    int* queue = (int*)malloc(sizeof(int) * matcher->state_count);
+    if (!queue) {
+        fprintf(stderr, "メモリ割り当てエラー: 推論ルールのオートマトンを作成できませんでした\n");
+        return false;
+    }
+
+    int head = 0;
+    int tail = 0;
+    for (int child = matcher->first_child[0]; child >= 0; child = matcher->next_sibling[child]) {
+        matcher->fail[child] = 0;
+        matcher->output_link[child] = -1;
+        queue[tail++] = child;
+    }
+
+    while (head < tail) {
+        int state = queue[head++];
+        for (int child = matcher->first_child[state]; child >= 0; child = matcher->next_sibling[child]) {
+            unsigned char c = matcher->label[child];
+            int f = matcher->fail[state];
+            int next = rule_matcher_goto(matcher, f, c);
+            while (next < 0 && f != 0) {
+                f = matcher->fail[f];
+                next = rule_matcher_goto(matcher, f, c);
+            }
+            matcher->fail[child] = next >= 0 ? next : 0;
+
+            int fail = matcher->fail[child];
+            matcher->output_link[child] = matcher->output[fail] >= 0 ? fail : matcher->output_link[fail];
+            queue[tail++] = child;
+        }
+    }
+    free(queue);
+
+    // 条件語ごとの参照表（同じ条件語内ではルールの登録順を保つ）
+    free(matcher->pattern_offsets);
+    free(matcher->pattern_refs);
+    matcher->pattern_offsets = (int*)calloc(matcher->pattern_count + 1, sizeof(int));
+    matcher->pattern_refs = (RuleClauseRef*)malloc(sizeof(RuleClauseRef) * (matcher->ref_count > 0 ? matcher->ref_count : 1));
+    int* fill = (int*)malloc(sizeof(int) * (matcher->pattern_count > 0 ? matcher->pattern_count : 1));
+    if (!matcher->pattern_offsets || !matcher->pattern_refs || !fill) {
+        fprintf(stderr, "メモリ割り当てエラー: 推論ルールの参照表を作成できませんでした\n");
+        free(fill);
+        return false;
+    }
+
+    for (int i = 0; i < matcher->ref_count; i++) {
+        matcher->pattern_offsets[matcher->refs[i].pattern + 1]++;
+    }
+    for (int p = 0; p < matcher->pattern_count; p++) {
+        matcher->pattern_offsets[p + 1] += matcher->pattern_offsets[p];
+    }
+    memcpy(fill, matcher->pattern_offsets, sizeof(int) * matcher->pattern_count);
+    for (int i = 0; i < matcher->ref_count; i++) {
+        matcher->pattern_refs[fill[matcher->refs[i].pattern]++] = matcher->refs[i];
+    }
+    free(fill);
+
+    // 条件語のないルールは入力によらず成立する
+    matcher->always_rule = -1;
+    for (int r = 0; r < matcher->rule_count; r++) {
+        if (matcher->required_masks[r] == 0 && rule_matcher_prefers(matcher, r, matcher->always_rule)) {
+            matcher->always_rule = r;
+        }
+    }
+
+    matcher->compiled = true;
+    return true;
+}
+
+// 作業領域を初期化
+void rule_match_scratch_init(RuleMatchScratch* scratch) {
+    memset(scratch, 0, sizeof(RuleMatchScratch));
+}
+
+// 作業領域を解放
+void rule_match_scratch_free(RuleMatchScratch* scratch) {
+    free(scratch->pattern_seen);
+    free(scratch->rule_seen);
+    free(scratch->rule_masks);
+    memset(scratch, 0, sizeof(RuleMatchScratch));
+}
+
+// 作業領域を照合器の大きさに合わせる
+static bool rule_match_scratch_reserve(RuleMatchScratch* scratch, const RuleMatcher* matcher) {
+    if (scratch->pattern_capacity < matcher->pattern_count) {
+        unsigned int* seen = (unsigned int*)calloc(matcher->pattern_count, sizeof(unsigned int));
+        if (!seen) {
+            return false;
+        }
+        free(scratch->pattern_seen);
+        scratch->pattern_seen = seen;
+        scratch->pattern_capacity = matcher->pattern_count;
+        scratch->stamp = 0;
+    }
+
+    if (scratch->rule_capacity < matcher->rule_count) {
+        unsigned int* seen = (unsigned int*)calloc(matcher->rule_count, sizeof(unsigned int));
+        uint64_t* masks = (uint64_t*)malloc(sizeof(uint64_t) * matcher->rule_count);
+        if (!seen || !masks) {
+            free(seen);
+            free(masks);
+            return false;
+        }
+        free(scratch->rule_seen);
+        free(scratch->rule_masks);
+        scratch->rule_seen = seen;
+        scratch->rule_masks = masks;
+        scratch->rule_capacity = matcher->rule_count;
+        scratch->stamp = 0;
+    }
+
+    // スタンプが一周したら印をすべて消す
+    if (++scratch->stamp == 0) {
+        memset(scratch->pattern_seen, 0, sizeof(unsigned int) * scratch->pattern_capacity);
+        memset(scratch->rule_seen, 0, sizeof(unsigned int) * scratch->rule_capacity);
+        scratch->stamp = 1;
+    }
+    return true;
+}
+
+// 入力を一度だけ走査し、全条件が含まれるルールのうち確信度が最も高いものを返す
+int rule_matcher_find(const RuleMatcher* matcher, const char* text, RuleMatchScratch* scratch) {
+    if (!matcher->compiled || !text) {
+        return -1;
+    }
+
+    int best = matcher->always_rule;
+    if (matcher->pattern_count == 0) {
+        return best;
+    }
+    if (!rule_match_scratch_reserve(scratch, matcher)) {
+        fprintf(stderr, "メモリ割り当てエラー: 推論ルールの作業領域を確保できませんでした\n");
+        return best;
+    }
+
+    unsigned int stamp = scratch->stamp;
+    int state = 0;
+    for (const unsigned char* p = (const unsigned char*)text; *p; p++) {
+        int next = rule_matcher_goto(matcher, state, *p);
+        while (next < 0 && state != 0) {
+            state = matcher->fail[state];
+            next = rule_matcher_goto(matcher, state, *p);
+        }
+        state = next >= 0 ? next : 0;
+
+        // この位置で終わる条件語をすべて調べる
+        int hit = matcher->output[state] >= 0 ? state : matcher->output_link[state];
+        for (; hit >= 0; hit = matcher->output_link[hit]) {
+            int pattern = matcher->output[hit];
+            if (scratch->pattern_seen[pattern] == stamp) {
+                continue;
+            }
+            scratch->pattern_seen[pattern] = stamp;
+
+            for (int i = matcher->pattern_offsets[pattern]; i < matcher->pattern_offsets[pattern + 1]; i++) {
+                const RuleClauseRef* ref = &matcher->pattern_refs[i];
+                if (scratch->rule_seen[ref->rule] != stamp) {
+                    scratch->rule_seen[ref->rule] = stamp;
+                    scratch->rule_masks[ref->rule] = 0;
+                }
+                scratch->rule_masks[ref->rule] |= ref->bit;
+                if (scratch->rule_masks[ref->rule] == matcher->required_masks[ref->rule] &&
+                    rule_matcher_prefers(matcher, ref->rule, best)) {
+                    best = ref->rule;
+                }
+            }
+        }
+    }
+
+    return best;
+}
@@ -0,0 +1,82 @@
+#ifndef RULE_MATCHER_H
+#define RULE_MATCHER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RULE_MATCHER_MAX_CLAUSES 64     // 1ルールあたりの条件数の上限（ビットマスクの幅）
+
+// 条件語が属するルールとビット
+typedef struct {
+    int pattern;
+    int rule;
+    uint64_t bit;
+} RuleClauseRef;
+
+// 推論ルールの条件照合器（全ルールの条件語を一つの Aho–Corasick オートマトンにまとめる）
+typedef struct {
+    // トライの状態（0 が根）
+    int* fail;                  // 失敗遷移
+    int* output;                // この状態で終わる条件語のID（なければ -1）
+    int* output_link;           // 出力を持つ最も近い接尾辞の状態（なければ -1）
+    int* first_child;           // 子の連結リスト（失敗遷移の計算に使う）
+    int* next_sibling;
+    unsigned char* label;       // 親からの遷移文字
+    int state_count;
+    int state_capacity;
+
+    // 遷移表（状態と文字 → 次の状態）
+    uint64_t* edge_keys;
+    int* edge_values;
+    int edge_count;
+    int edge_bucket_count;
+
+    // 条件語 → ルールとビット
+    int pattern_count;
+    RuleClauseRef* refs;        // 登録順の一覧
+    int ref_count;
+    int ref_capacity;
+    int* pattern_offsets;       // 条件語ID p の参照は pattern_refs[offsets[p]..offsets[p+1])
+    RuleClauseRef* pattern_refs;
+
+    // ルール
+    uint64_t* required_masks;   // 全条件がそろったときのビットマスク
+    float* confidences;
+    int rule_count;
+    int rule_capacity;
+    int always_rule;            // 条件語がなく常に成立する最良のルール（なければ -1）
+    bool compiled;
+} RuleMatcher;
+
+// 照合の作業領域（スレッドごとに一つ）
+typedef struct {
+    unsigned int* pattern_seen;
+    unsigned int* rule_seen;
+    uint64_t* rule_masks;
+    int pattern_capacity;
+    int rule_capacity;
+    unsigned int stamp;
+} RuleMatchScratch;
+
+// 照合器を初期化
+bool rule_matcher_init(RuleMatcher* matcher);
+
+// 照合器を解放
+void rule_matcher_free(RuleMatcher* matcher);
+
+// ルールを追加してルール番号を返す（失敗時は -1）
+// 条件は " AND " で区切った語の並びで、"*" は常に成立する
+int rule_matcher_add(RuleMatcher* matcher, const char* condition, float confidence);
+
+// 失敗遷移と参照表を作成（ルールを追加し終えたら呼ぶ）
+bool rule_matcher_compile(RuleMatcher* matcher);
+
+// 作業領域を初期化・解放
+void rule_match_scratch_init(RuleMatchScratch* scratch);
+void rule_match_scratch_free(RuleMatchScratch* scratch);
+
+// 入力を一度だけ走査し、全条件が含まれるルールのうち確信度が最も高いもの（同じなら先に登録したもの）を返す
+// 成立するルールがなければ -1
+int rule_matcher_find(const RuleMatcher* matcher, const char* text, RuleMatchScratch* scratch);
+
+#endif // RULE_MATCHER_H
@@ -16,12 +16,18 @@ void init_global_vector_db_impl() {
     
     // データファイルのパス
     const char* vector_file = "data/word_vectors.dat";
+    const char* binary_file = "data/word_vectors.bin";
     const char* japanese_words_file = "knowledge/text/japanese_words.txt";
     
     // 環境変数でデバッグモードをチェック
     const char* debug_env = getenv("DEBUG");
     bool debug_mode = debug_env && (strcmp(debug_env, "1") == 0 || strcmp(debug_env, "true") == 0);
     
+    // VECTOR_STORAGE=int8 なら int8 符号で走査する（float の行はバイナリ形式の mmap 領域を使う）
+    const char* storage_env = getenv("VECTOR_STORAGE");
+    VectorStorage storage = storage_env && strcmp(storage_env, "int8") == 0 ? VECTOR_STORAGE_INT8 : VECTOR_STORAGE_FLOAT;
+    set_vector_db_storage(&global_vector_db, storage);
+    
     // 日本語単語ファイルの最終更新時刻を取得
     struct stat japanese_words_stat;
     time_t japanese_words_mtime = 0;
@@ -36,6 +42,22 @@ void init_global_vector_db_impl() {
         vector_file_mtime = vector_file_stat.st_mtime;
     }
     
+    // バイナリ形式がテキスト形式と日本語単語ファイルより新しければ mmap して読み込む
+    struct stat binary_file_stat;
+    if (stat(binary_file, &binary_file_stat) == 0 &&
+        binary_file_stat.st_mtime >= vector_file_mtime &&
+        binary_file_stat.st_mtime >= japanese_words_mtime) {
+        int loaded = load_word_vectors_binary(binary_file, &global_vector_db, 0);
+        if (loaded >= 0) {
+            if (debug_mode) {
+                printf("%d 個の単語ベクトルをバイナリ形式から読み込みました\n", loaded);
+            }
+            return;
+        }
+        free_vector_db(&global_vector_db);
+        set_vector_db_storage(&global_vector_db, storage);
+    }
+    
     // ファイルからベクトルを読み込む
     FILE* file = fopen(vector_file, "r");
     if (file && (japanese_words_mtime <= vector_file_mtime)) {
@@ -53,6 +75,9 @@ void init_global_vector_db_impl() {
         if (debug_mode) {
             printf("%d 個の単語ベクトルを読み込みました\n", loaded);
         }
+        
+        // 次回の起動からはバイナリ形式を使う
+        convert_word_vectors_to_binary(vector_file, binary_file, storage);
     } else {
         // ファイルが存在しないか、日本語単語ファイルが更新されている場合は再生成
         if (!file) {
@@ -67,10 +92,19 @@ void init_global_vector_db_impl() {
         // 生成したベクトルを保存
         printf("生成した単語ベクトルを保存しています...\n");
         save_word_vectors(vector_file, &global_vector_db);
+        convert_word_vectors_to_binary(vector_file, binary_file, storage);
     }
+    
+    // 読み込み中に倍々で確保した分を返す
+    shrink_vector_db(&global_vector_db);
 }
 
 // 現在のベクトルデータベースのサイズを取得
 int get_global_vector_db_size_impl() {
     return global_vector_db.size;
+}
+
+// ベクトルデータベースの確保済みの領域（バイト）を取得
+size_t get_global_vector_db_bytes_impl() {
+    return get_vector_db_bytes(&global_vector_db);
 }
\ No newline at end of file
@@ -12,4 +12,7 @@ void init_global_vector_db_impl();
 // 現在のベクトルデータベースのサイズを取得
 int get_global_vector_db_size_impl();
 
+// ベクトルデータベースの確保済みの領域（バイト）を取得
+size_t get_global_vector_db_bytes_impl();
+
 #endif // VECTOR_DB_H
\ No newline at end of file
@@ -1,8 +1,14 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <curl/curl.h>
 #include <math.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "word_loader.h"
 
 // cURLのコールバック関数用の構造体
@@ -30,6 +36,32 @@ static size_t write_callback(void* contents, size_t size, size_t nmemb, void* us
     return realsize;
 }
 
+// テキスト形式の1行から単語とベクトルを取り出して正規化する
+static bool parse_word_vector_line(char* line, char* word, size_t word_size, float* vector) {
+    // 行から単語とベクトルを抽出
+    char* saveptr = NULL;
+    char* token = strtok_r(line, " ", &saveptr);
+    if (!token) {
+        return false;
+    }
+    
+    // 単語を取得
+    strncpy(word, token, word_size - 1);
+    word[word_size - 1] = '\0';
+    word[strcspn(word, "\r\n")] = '\0';
+    
+    // ベクトルを取得
+    for (int i = 0; i < VECTOR_DIM; i++) {
+        token = strtok_r(NULL, " ", &saveptr);
+        if (!token) break;
+        vector[i] = atof(token);
+    }
+    
+    // ベクトルを正規化
+    normalize_vector(vector);
+    return true;
+}
+
 // 単語ベクトルをファイルから読み込む
 int load_word_vectors(const char* filename, VectorDB* db, int max_words) {
     FILE* file = fopen(filename, "r");
@@ -50,29 +82,15 @@ int load_word_vectors(const char* filename, VectorDB* db, int max_words) {
             break;
         }
         
-        // 行から単語とベクトルを抽出
-        char* token = strtok(line, " ");
-        if (!token) continue;
-        
-        // 単語を取得
-        strncpy(word, token, sizeof(word) - 1);
-        word[sizeof(word) - 1] = '\0';
-        
-        // ベクトルを取得
-        for (int i = 0; i < VECTOR_DIM; i++) {
-            token = strtok(NULL, " ");
-            if (!token) break;
-            vector[i] = atof(token);
+        if (!parse_word_vector_line(line, word, sizeof(word), vector)) {
+            continue;
         }
         
-        // ベクトルを正規化
-        normalize_vector(vector);
-        
-        // ベクトルをデータベースに追加
-        if (add_vector(db, vector, word_count)) {
+        // ベクトルを単語付きでデータベースに追加
+        if (add_word_vector(db, vector, word_count, word)) {
             word_count++;
         } else {
-            printf("ベクトルデータベースが満杯です\n");
+            printf("ベクトルをデータベースに追加できませんでした\n");
             break;
         }
     }
@@ -81,6 +99,226 @@ int load_word_vectors(const char* filename, VectorDB* db, int max_words) {
     return word_count;
 }
 
+// 単語ベクトルをバイナリ形式のファイルから読み込む（mmap して解析せずにコピーする）
+int load_word_vectors_binary(const char* filename, VectorDB* db, int max_words) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        printf("ファイル %s を開けませんでした\n", filename);
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(WordVectorsHeader)) {
+        close(fd);
+        return -1;
+    }
+    
+    size_t size = (size_t)st.st_size;
+    void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        printf("ファイル %s をマップできませんでした\n", filename);
+        return -1;
+    }
+    
+    // ヘッダーを検証
+    const WordVectorsHeader* header = (const WordVectorsHeader*)addr;
+    uint64_t ids_size = (uint64_t)header->count * sizeof(int32_t);
+    uint64_t vectors_size = (uint64_t)header->count * header->dim * sizeof(float);
+    
+    // int8 符号はベクトル行の後の境界から、復元係数はその直後に並ぶ
+    bool has_codes = (header->flags & WORD_VECTORS_FLAG_INT8) != 0;
+    uint64_t codes_offset = (header->vectors_offset + vectors_size + WORD_VECTORS_ALIGN - 1) / WORD_VECTORS_ALIGN * WORD_VECTORS_ALIGN;
+    uint64_t codes_size = (uint64_t)header->count * header->dim;
+    uint64_t scales_offset = codes_offset + codes_size;
+    if (memcmp(header->magic, WORD_VECTORS_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != WORD_VECTORS_VERSION ||
+        header->dim != VECTOR_DIM ||
+        header->file_size != size ||
+        header->ids_offset % sizeof(int32_t) != 0 ||
+        header->vectors_offset % sizeof(float) != 0 ||
+        header->ids_offset > size || ids_size > size - header->ids_offset ||
+        header->words_offset > size || header->words_size > size - header->words_offset ||
+        header->vectors_offset > size || vectors_size > size - header->vectors_offset ||
+        (has_codes && (scales_offset % sizeof(float) != 0 || scales_offset > size ||
+                       (uint64_t)header->count * sizeof(float) > size - scales_offset))) {
+        printf("ファイル %s は対応する単語ベクトル形式ではありません\n", filename);
+        munmap(addr, size);
+        return -1;
+    }
+    
+    // 単語表（オフセット表の後に文字列が続く）
+    const uint32_t* word_offsets = (const uint32_t*)((const char*)addr + header->words_offset);
+    const char* strings = (const char*)(word_offsets + header->count + 1);
+    uint64_t strings_size = header->words_size >= ((uint64_t)header->count + 1) * sizeof(uint32_t)
+                          ? header->words_size - ((uint64_t)header->count + 1) * sizeof(uint32_t) : 0;
+    bool has_words = strings_size > 0 && header->words_offset % sizeof(uint32_t) == 0;
+    
+    // ID とベクトル行をそのままデータベースにコピーし、単語を辞書に登録
+    const int32_t* ids = (const int32_t*)((const char*)addr + header->ids_offset);
+    const float* vectors = (const float*)((const char*)addr + header->vectors_offset);
+    int count = (int)header->count;
+    if (max_words > 0 && count > max_words) {
+        count = max_words;
+    }
+    
+    // int8 で読み込む場合は float の行をコピーせず、マップしたまま再計算に使う
+    if (db->storage == VECTOR_STORAGE_INT8 && db->size == 0 && count > 0) {
+        const int8_t* codes = has_codes ? (const int8_t*)((const char*)addr + codes_offset) : NULL;
+        const float* code_scales = has_codes ? (const float*)((const char*)addr + scales_offset) : NULL;
+        if (map_vector_db(db, addr, size, vectors, ids, codes, code_scales, count,
+                          (header->flags & WORD_VECTORS_FLAG_NORMALIZED) != 0)) {
+            for (int i = 0; i < count; i++) {
+                if (has_words && word_offsets[i] < strings_size &&
+                    memchr(strings + word_offsets[i], '\0', strings_size - word_offsets[i])) {
+                    set_vector_word(db, i, strings + word_offsets[i]);
+                }
+            }
+            return count;  // 領域はデータベースが解放する
+        }
+    }
+    
+    if (!reserve_vector_db(db, db->size + count)) {
+        munmap(addr, size);
+        return -1;
+    }
+    
+    int word_count = 0;
+    for (int i = 0; i < count; i++) {
+        const char* word = NULL;
+        if (has_words && word_offsets[i] < strings_size &&
+            memchr(strings + word_offsets[i], '\0', strings_size - word_offsets[i])) {
+            word = strings + word_offsets[i];
+        }
+        if (!add_word_vector(db, (float*)(vectors + (size_t)i * VECTOR_DIM), ids[i], word)) {
+            printf("ベクトルをデータベースに追加できませんでした\n");
+            break;
+        }
+        word_count++;
+    }
+    
+    munmap(addr, size);
+    return word_count;
+}
+
+// ファイルに 0 を書き込んで offset まで埋める
+static bool pad_file(FILE* file, uint64_t offset) {
+    static const char zeros[WORD_VECTORS_ALIGN] = {0};
+    long position = ftell(file);
+    if (position < 0 || (uint64_t)position > offset) {
+        return false;
+    }
+    return fwrite(zeros, 1, (size_t)(offset - (uint64_t)position), file) == (size_t)(offset - (uint64_t)position);
+}
+
+// 単語ベクトルをバイナリ形式で保存する
+int save_word_vectors_binary(const char* filename, VectorDB* db) {
+    // 単語表のオフセットを計算
+    uint32_t* offsets = (uint32_t*)malloc(sizeof(uint32_t) * (db->size + 1));
+    if (!offsets) {
+        printf("メモリ不足エラー\n");
+        return 0;
+    }
+    char word[256];
+    uint32_t strings_size = 0;
+    for (int i = 0; i < db->size; i++) {
+        offsets[i] = strings_size;
+        const char* text = get_vector_word(db, i);
+        if (text) {
+            strings_size += (uint32_t)strlen(text) + 1;
+        } else {
+            strings_size += (uint32_t)snprintf(word, sizeof(word), "word%d", db->ids[i]) + 1;
+        }
+    }
+    offsets[db->size] = strings_size;
+    
+    // 各区画の位置を決める
+    WordVectorsHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WORD_VECTORS_MAGIC, sizeof(header.magic));
+    header.version = WORD_VECTORS_VERSION;
+    header.dim = VECTOR_DIM;
+    header.count = (uint32_t)db->size;
+    header.flags = db->normalized ? WORD_VECTORS_FLAG_NORMALIZED : 0;
+    header.ids_offset = sizeof(WordVectorsHeader);
+    header.words_offset = header.ids_offset + (uint64_t)db->size * sizeof(int32_t);
+    header.words_size = (uint64_t)(db->size + 1) * sizeof(uint32_t) + strings_size;
+    header.vectors_offset = (header.words_offset + header.words_size + WORD_VECTORS_ALIGN - 1) / WORD_VECTORS_ALIGN * WORD_VECTORS_ALIGN;
+    header.file_size = header.vectors_offset + (uint64_t)db->size * VECTOR_DIM * sizeof(float);
+    
+    // int8 符号と復元係数はベクトル行の後に置く
+    uint64_t codes_offset = (header.file_size + WORD_VECTORS_ALIGN - 1) / WORD_VECTORS_ALIGN * WORD_VECTORS_ALIGN;
+    bool with_codes = db->storage == VECTOR_STORAGE_INT8;
+    if (with_codes) {
+        header.flags |= WORD_VECTORS_FLAG_INT8;
+        header.file_size = codes_offset + (uint64_t)db->size * VECTOR_DIM + (uint64_t)db->size * sizeof(float);
+    }
+    
+    // 一時ファイルに書いてから置き換える
+    char temp_filename[1024];
+    snprintf(temp_filename, sizeof(temp_filename), "%s.tmp", filename);
+    FILE* file = fopen(temp_filename, "wb");
+    if (!file) {
+        printf("ファイル %s を作成できませんでした\n", temp_filename);
+        free(offsets);
+        return 0;
+    }
+    
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int i = 0; ok && i < db->size; i++) {
+        int32_t id = db->ids[i];
+        ok = fwrite(&id, sizeof(id), 1, file) == 1;
+    }
+    ok = ok && fwrite(offsets, sizeof(uint32_t), db->size + 1, file) == (size_t)(db->size + 1);
+    for (int i = 0; ok && i < db->size; i++) {
+        const char* text = get_vector_word(db, i);
+        if (!text) {
+            snprintf(word, sizeof(word), "word%d", db->ids[i]);
+            text = word;
+        }
+        ok = fwrite(text, 1, strlen(text) + 1, file) == strlen(text) + 1;
+    }
+    ok = ok && pad_file(file, header.vectors_offset);
+    
+    // ベクトル行列は連続しているのでまとめて書く
+    ok = ok && fwrite(db->vectors, sizeof(float) * VECTOR_DIM, db->size, file) == (size_t)db->size;
+    if (with_codes) {
+        ok = ok && pad_file(file, codes_offset);
+        ok = ok && fwrite(db->codes, VECTOR_DIM, db->size, file) == (size_t)db->size;
+        ok = ok && fwrite(db->code_scales, sizeof(float), db->size, file) == (size_t)db->size;
+    }
+    free(offsets);
+    
+    if (fclose(file) != 0 || !ok || rename(temp_filename, filename) != 0) {
+        printf("ファイル %s に書き込めませんでした\n", filename);
+        remove(temp_filename);
+        return 0;
+    }
+    
+    return db->size;
+}
+
+// テキスト形式の単語ベクトルファイルをバイナリ形式に変換する
+int convert_word_vectors_to_binary(const char* text_filename, const char* binary_filename, VectorStorage storage) {
+    VectorDB* db = (VectorDB*)malloc(sizeof(VectorDB));
+    if (!db) {
+        printf("メモリ不足エラー\n");
+        return 0;
+    }
+    init_vector_db(db);
+    set_vector_db_storage(db, storage);
+    
+    // load_word_vectors と同じ規則で単語付きで読み込む
+    int converted = 0;
+    if (load_word_vectors(text_filename, db, 0) > 0) {
+        converted = save_word_vectors_binary(binary_filename, db);
+    }
+    
+    free_vector_db(db);
+    free(db);
+    return converted;
+}
+
 // 単語ベクトルをファイルに保存する
 int save_word_vectors(const char* filename, VectorDB* db) {
     FILE* file = fopen(filename, "w");
@@ -90,40 +328,21 @@ int save_word_vectors(const char* filename, VectorDB* db) {
     }
     
     // データベース内の各ベクトルを保存
+    char word[256];
     for (int i = 0; i < db->size; i++) {
-        // 単語リストから単語を取得（なければIDを使用）
-        char word[256];
-        FILE* word_file = fopen("knowledge/text/japanese_words.txt", "r");
-        if (word_file && db->entries[i].id < 5000) {  // 単語リストの範囲内のIDのみ
-            // 対応する行を読み込む
-            for (int j = 0; j <= db->entries[i].id; j++) {
-                if (fgets(word, sizeof(word), word_file) == NULL) {
-                    break;
-                }
-            }
-            
-            // 改行を削除
-            size_t len = strlen(word);
-            if (len > 0 && word[len-1] == '\n') {
-                word[len-1] = '\0';
-            }
-            
-            fclose(word_file);
-            
-            // 空の場合はIDを使用
-            if (strlen(word) == 0) {
-                sprintf(word, "word%d", db->entries[i].id);
-            }
-        } else {
-            sprintf(word, "word%d", db->entries[i].id);
+        // 辞書から単語を取得（なければIDを使用）
+        const char* text = get_vector_word(db, i);
+        if (!text || text[0] == '\0') {
+            snprintf(word, sizeof(word), "word%d", db->ids[i]);
+            text = word;
         }
         
         // 単語とベクトルを保存
-        fprintf(file, "%s", word);
+        fprintf(file, "%s", text);
         
         // ベクトルを保存
         for (int j = 0; j < VECTOR_DIM; j++) {
-            fprintf(file, " %.6f", db->entries[i].vector[j]);
+            fprintf(file, " %.6f", get_vector(db, i)[j]);
         }
         fprintf(file, "\n");
     }
@@ -161,19 +380,18 @@ int fetch_word_vectors_from_web(const char* url, VectorDB* db, int max_words) {
             char* line = strtok(chunk.data, "\n");
             while (line && (max_words <= 0 || word_count < max_words)) {
                 // 単語を取得（この例では行全体を単語として扱う）
-                // 変数は使用されていないのでコメントアウト
-                // char* word = line;
+                char* word = line;
                 
                 // 単語からベクトルを生成（この例ではランダムベクトルを生成）
                 float vector[VECTOR_DIM];
                 generate_random_vector(vector);
                 normalize_vector(vector);
                 
-                // ベクトルをデータベースに追加
-                if (add_vector(db, vector, word_count)) {
+                // ベクトルを単語付きでデータベースに追加
+                if (add_word_vector(db, vector, word_count, word)) {
                     word_count++;
                 } else {
-                    printf("ベクトルデータベースが満杯です\n");
+                    printf("ベクトルをデータベースに追加できませんでした\n");
                     break;
                 }
                 
@@ -233,23 +451,12 @@ int generate_large_word_vector_dataset(VectorDB* db, int target_size) {
                 continue;
             }
             
-            // 単語からベクトルを生成（ここでは単語の文字コードを使用して決定論的に生成）
+            // 単語からベクトルを生成（文字 n-gram の特徴ハッシュで決定論的に生成、正規化済み）
             float vector[VECTOR_DIM];
-            for (int i = 0; i < VECTOR_DIM; i++) {
-                // 単語の各文字のコードを使用して決定論的にベクトル値を生成
-                float val = 0.0f;
-                for (size_t j = 0; j < strlen(word); j++) {
-                    val += (float)(word[j] * (j+1) * (i+1)) / 10000.0f;
-                }
-                // -1.0から1.0の範囲に正規化
-                vector[i] = fmodf(val, 2.0f) - 1.0f;
-            }
-            
-            // ベクトルを正規化
-            normalize_vector(vector);
+            text_to_feature_vector(word, vector);
             
             // ベクトルをデータベースに追加
-            if (add_vector(db, vector, word_id++)) {
+            if (add_word_vector(db, vector, word_id++, word)) {
                 added++;
                 
                 // 進捗表示
@@ -257,7 +464,7 @@ int generate_large_word_vector_dataset(VectorDB* db, int target_size) {
                     printf("  %d / %d ベクトルを追加しました\n", added, remaining);
                 }
             } else {
-                printf("ベクトルデータベースが満杯です\n");
+                printf("ベクトルをデータベースに追加できませんでした\n");
                 break;
             }
         }
@@ -284,17 +491,9 @@ int generate_large_word_vector_dataset(VectorDB* db, int target_size) {
                     
                     // 単語からベクトルを生成
                     float vector[VECTOR_DIM];
-                    for (int i = 0; i < VECTOR_DIM; i++) {
-                        float val = 0.0f;
-                        for (size_t j = 0; j < strlen(word); j++) {
-                            val += (float)(word[j] * (j+1) * (i+1)) / 10000.0f;
-                        }
-                        vector[i] = fmodf(val, 2.0f) - 1.0f;
-                    }
+                    text_to_feature_vector(word, vector);
                     
-                    normalize_vector(vector);
-                    
-                    if (add_vector(db, vector, word_id++)) {
+                    if (add_word_vector(db, vector, word_id++, word)) {
                         added++;
                     } else {
                         break;
@@ -307,4 +506,19 @@ int generate_large_word_vector_dataset(VectorDB* db, int target_size) {
     
     printf("合計 %d ベクトルを追加しました（総数: %d）\n", db->size - current_size, db->size);
     return db->size;
-}
\ No newline at end of file
+}
+
+// テキスト形式からバイナリ形式への変換ツール
+#ifdef WORD_VECTORS_CONVERT
+int main(int argc, char* argv[]) {
+    bool int8 = argc == 4 && strcmp(argv[3], "--int8") == 0;
+    if (argc != 3 && !int8) {
+        printf("使用法: %s <テキスト形式のファイル> <バイナリ形式のファイル> [--int8]\n", argv[0]);
+        return 1;
+    }
+    
+    int converted = convert_word_vectors_to_binary(argv[1], argv[2], int8 ? VECTOR_STORAGE_INT8 : VECTOR_STORAGE_FLOAT);
+    printf("%d 個の単語ベクトルを変換しました\n", converted);
+    return converted > 0 ? 0 : 1;
+}
+#endif
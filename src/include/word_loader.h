@@ -1,8 +1,32 @@
 #ifndef WORD_LOADER_H
 #define WORD_LOADER_H
 
+#include <stdint.h>
 #include "../vector_search/vector_search.h"
 
+#define WORD_VECTORS_MAGIC "GLLMWVEC"        // バイナリ形式の識別子（8バイト）
+#define WORD_VECTORS_VERSION 1
+#define WORD_VECTORS_ALIGN 64                // ベクトル行の先頭の境界（SIMD 用）
+#define WORD_VECTORS_FLAG_NORMALIZED 0x1     // ベクトルは正規化済み
+#define WORD_VECTORS_FLAG_INT8 0x2           // ベクトル行の後に int8 符号と復元係数がある
+
+// バイナリ形式のヘッダー（64バイト、ファイルの先頭に置く）
+// ヘッダーの後に ID 表、単語表、ベクトル行の順に並ぶ
+// WORD_VECTORS_FLAG_INT8 のときは、ベクトル行の後の WORD_VECTORS_ALIGN 境界から
+// int8_t codes[count][dim] と float scales[count] が続く
+typedef struct {
+    char magic[8];              // WORD_VECTORS_MAGIC
+    uint32_t version;           // WORD_VECTORS_VERSION
+    uint32_t dim;               // ベクトルの次元数
+    uint32_t count;             // 単語数
+    uint32_t flags;             // WORD_VECTORS_FLAG_*
+    uint64_t ids_offset;        // int32_t ids[count]
+    uint64_t words_offset;      // uint32_t offsets[count + 1] の後に '\0' 終端の単語が続く
+    uint64_t words_size;        // 単語表全体のバイト数
+    uint64_t vectors_offset;    // float vectors[count][dim]（WORD_VECTORS_ALIGN の倍数）
+    uint64_t file_size;         // ファイル全体のバイト数
+} WordVectorsHeader;
+
 // 単語ベクトルをファイルから読み込む
 // filename: 単語ベクトルファイルのパス
 // db: ベクトルを格納するデータベース
@@ -16,6 +40,28 @@ int load_word_vectors(const char* filename, VectorDB* db, int max_words);
 // 戻り値: 保存した単語数
 int save_word_vectors(const char* filename, VectorDB* db);
 
+// 単語ベクトルをバイナリ形式のファイルから読み込む（mmap して解析せずにコピーする）
+// 空のデータベースを VECTOR_STORAGE_INT8 にしておくと、float の行はコピーせずに mmap 領域を使い、
+// 符号はファイルから読む（なければ読み込み時に量子化する）
+// filename: バイナリ形式のファイルのパス
+// db: ベクトルを格納するデータベース
+// max_words: 読み込む最大単語数（0の場合は制限なし）
+// 戻り値: 読み込んだ単語数（形式が不正な場合は -1）
+int load_word_vectors_binary(const char* filename, VectorDB* db, int max_words);
+
+// 単語ベクトルをバイナリ形式で保存する
+// filename: 保存先ファイルのパス
+// db: 保存するベクトルデータベース（単語は辞書から取り、なければ "word<ID>"、int8 なら符号も保存する）
+// 戻り値: 保存した単語数（失敗時は 0）
+int save_word_vectors_binary(const char* filename, VectorDB* db);
+
+// テキスト形式の単語ベクトルファイルをバイナリ形式に変換する
+// text_filename: テキスト形式のファイルのパス
+// binary_filename: 保存先ファイルのパス
+// storage: VECTOR_STORAGE_INT8 なら int8 符号も保存する
+// 戻り値: 変換した単語数
+int convert_word_vectors_to_binary(const char* text_filename, const char* binary_filename, VectorStorage storage);
+
 // Webから単語リストを取得して単語ベクトルを生成
 // url: 単語リストを取得するURL
 // db: ベクトルを格納するデータベース
@@ -7,6 +7,7 @@ extern int get_global_vector_db_size_impl();
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <mecab.h>
 #include <locale.h>
 #include <time.h>
@@ -22,6 +23,20 @@ extern int get_global_vector_db_size_impl();
 #include "include/knowledge_manager.c"
 // DuckDuckGo検索モジュールのインクルード
 #include "include/duckduckgo_search.h"
+// 形態素解析モジュールのインクルード
+#include "include/mecab_tagger.c"
+// トピック知識ストアのインクルード
+#include "include/knowledge_store.c"
+// 知識ドキュメントの転置インデックスのインクルード
+#include "include/knowledge_index.c"
+// 質問応答ログの書き込みスレッドのインクルード
+#include "include/qa_log_writer.c"
+// パターンマッチャーのインクルード
+#include "include/pattern_matcher.c"
+// 推論ルールの照合器
+#include "include/rule_matcher.c"
+// 常駐サーバーモジュールのインクルード
+#include "include/query_server.c"
 // ベクトルデータベースモジュールのインクルード
 #include "include/vector_db.c"
 
@@ -39,15 +54,14 @@ bool debug_mode = false;
 #define MAX_TOPICS 20
 #define MAX_TOPIC_NAME 32
 #define USE_EXTERNAL_LLM 0  // 外部LLMを使用するかどうかのフラグ（無効化）
-#define MAX_KNOWLEDGE_ENTRIES 100
-#define MAX_KNOWLEDGE_TEXT 16384 // 16KBに拡大
+#define KNOWLEDGE_INITIAL_CAPACITY 4
 
 // 論理推論用の定義
 #define MAX_TOPICS_LOGIC 20
 #define MAX_TOPIC_NAME_LOGIC 32
 #define MAX_RELATED_TOPICS 5
-#define MAX_INFERENCE_RULES 100
 #define MAX_RULE_TEXT 1024
+#define INFERENCE_RULES_FILE "data/inference_rules.tsv"  // 追加の推論ルール（あれば起動時に読み込む）
 
 // 概念タイプ
 typedef enum {
@@ -70,6 +84,22 @@ typedef struct {
     ConceptType type;           // 概念タイプ
 } Token;
 
+// リクエストコンテキスト（1つの質問の処理中だけ使う状態、スレッドごとに一つ）
+typedef struct {
+    Token tokens[MAX_TOKENS];   // トークン化の結果
+    PatternTokenIds token_ids[MAX_TOKENS]; // トークンのシンボルID
+    int token_count;            // トークン数
+    float agent_scores[MAX_AGENTS]; // エージェントのスコア
+    float topic_scores[MAX_TOPICS]; // トピックのスコア
+    unsigned int* pattern_seen; // パターンの一致済み印（パターン数分）
+    int pattern_seen_size;
+    unsigned int pattern_stamp; // 今回の印
+    RuleMatchScratch rule_scratch; // 推論ルール照合の作業領域
+    unsigned int rand_seed;     // rand_r 用の乱数状態
+    MecabSession* mecab;        // 形態素解析セッション
+    bool owns_mecab;            // セッションを解放する責任があるか
+} RequestContext;
+
 // パターン構造体
 typedef struct {
     char keyword[MAX_WORD_LEN]; // キーワード
@@ -78,9 +108,10 @@ typedef struct {
     float weight;               // 重み
 } Pattern;
 
-// 知識エントリ構造体
+// 知識エントリ構造体（テキストは知識ストアのアリーナまたは mmap を指す）
 typedef struct {
-    char text[MAX_KNOWLEDGE_TEXT];  // 知識テキスト
+    const char* text;               // 知識テキスト（'\0' 終端とは限らない）
+    size_t length;                  // テキストの長さ
     float relevance;                // 関連度
 } KnowledgeEntry;
 
@@ -89,8 +120,9 @@ typedef struct {
     char name[MAX_TOPIC_NAME];      // トピック名
     Pattern patterns[MAX_PATTERNS]; // パターン
     int pattern_count;              // パターン数
-    KnowledgeEntry knowledge[MAX_KNOWLEDGE_ENTRIES]; // 知識ベース
+    KnowledgeEntry* knowledge;      // 知識ベース（可変長）
     int knowledge_count;            // 知識エントリ数
+    int knowledge_capacity;         // 知識エントリの確保数
     float confidence;               // 信頼度
 } Topic;
 
@@ -100,7 +132,7 @@ typedef struct {
     Pattern patterns[MAX_PATTERNS]; // パターン
     int pattern_count;          // パターン数
     float threshold;            // しきい値
-    char (*handler)(const char*, char*, Topic*, int); // ハンドラ関数
+    char (*handler)(RequestContext*, const char*, char*, Topic*, int); // ハンドラ関数
 } Agent;
 
 // トピック関連性構造体
@@ -118,10 +150,7 @@ typedef struct {
     float confidence;
 } InferenceRule;
 
-// グローバル変数
-char text_buffer[MAX_TEXT_LEN];
-Token tokens[MAX_TOKENS];
-int token_count = 0;
+// グローバル変数（初期化後は読み取り専用）
 Agent agents[MAX_AGENTS];
 int agent_count = 0;
 Topic topics[MAX_TOPICS];
@@ -130,8 +159,18 @@ int topic_count = 0;
 // 論理推論用グローバル変数
 TopicRelation topic_relations[MAX_TOPICS_LOGIC];
 int relation_count = 0;
-InferenceRule inference_rules[MAX_INFERENCE_RULES];
+InferenceRule* inference_rules = NULL;
 int rule_count = 0;
+int rule_capacity = 0;
+RuleMatcher rule_matcher;   // 全ルールの条件をまとめたオートマトン
+
+// トピック知識のテキスト置き場
+KnowledgeStore topic_knowledge_store;
+
+// コンパイル済みパターン（起動時に作成し、以降は読み取り専用）
+PatternSymbols pattern_symbols;
+PatternMatcher agent_matcher;
+PatternMatcher topic_matcher;
 
 // 学習データベース
 LearningDB* learning_db = NULL;
@@ -139,56 +178,101 @@ LearningDB* learning_db = NULL;
 KnowledgeBase* knowledge_base = NULL;
 
 // 関数プロトタイプ
-void tokenize_text(const char* text);
+RequestContext* request_context_create(MecabSession* mecab);
+void request_context_free(RequestContext* ctx);
+void tokenize_text(RequestContext* ctx, const char* text);
 void init_agents();
 void init_topics();
 void init_topic_relations();
 void init_inference_rules();
-void add_agent(const char* name, float threshold, char (*handler)(const char*, char*, Topic*, int));
+void add_agent(const char* name, float threshold, char (*handler)(RequestContext*, const char*, char*, Topic*, int));
 void add_pattern(int agent_id, const char* keyword, const char* pos, ConceptType type, float weight);
 void add_topic(const char* name);
 void add_topic_pattern(int topic_id, const char* keyword, const char* pos, ConceptType type, float weight);
 void add_knowledge(int topic_id, const char* text, float relevance);
+void add_knowledge_entry(int topic_id, const char* text, size_t length, float relevance);
+void free_topics();
+bool compile_patterns();
+void free_patterns();
+void calculate_all_scores(RequestContext* ctx);
+void copy_knowledge_response(char* response, const KnowledgeEntry* entry);
 void add_topic_relation(const char* topic, const char* related_topic, float strength);
 void add_inference_rule(const char* condition, const char* conclusion, float confidence);
+int load_inference_rules(const char* filename);
+void free_inference_rules();
 int route_text(const char* text, char* response);
-float calculate_score(int agent_id, const Token* tokens, int token_count);
-float calculate_topic_score(int topic_id, const Token* tokens, int token_count);
-int find_best_topic(const Token* tokens, int token_count);
+int route_text_ctx(RequestContext* ctx, const char* text, char* response);
+float calculate_score(const RequestContext* ctx, int agent_id);
+float calculate_topic_score(const RequestContext* ctx, int topic_id);
+int find_best_topic(const RequestContext* ctx);
 const char* concept_type_to_string(ConceptType type);
 ConceptType string_to_concept_type(const char* str);
 void load_knowledge_from_file(const char* filename, int topic_id);
 bool find_related_topics(const char* topic, char related_topics[MAX_RELATED_TOPICS][MAX_TOPIC_NAME_LOGIC], float strengths[MAX_RELATED_TOPICS], int* count);
-bool apply_inference_rules(const char* input, char* response);
+bool apply_inference_rules(RequestContext* ctx, const char* input, char* response);
 float calculate_topic_similarity(const char* topic1, const char* topic2);
+void* route_worker_init();
+void route_worker_free(void* worker);
+int route_worker_handle(void* worker, const char* text, char* response);
 
 // エージェントハンドラ関数
-char handle_greeting(const char* text, char* response, Topic* topics, int topic_count);
-char handle_question(const char* text, char* response, Topic* topics, int topic_count);
-char handle_command(const char* text, char* response, Topic* topics, int topic_count);
-char handle_statement(const char* text, char* response, Topic* topics, int topic_count);
-char handle_emotion(const char* text, char* response, Topic* topics, int topic_count);
-char handle_fallback(const char* text, char* response, Topic* topics, int topic_count);
+char handle_greeting(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_count);
+char handle_question(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_count);
+char handle_command(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_count);
+char handle_statement(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_count);
+char handle_emotion(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_count);
+char handle_fallback(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_count);
 
-// MeCabを使用してテキストをトークン化する
-void tokenize_text(const char* text) {
-    // MeCabの初期化
-    mecab_t* mecab = mecab_new2("");
-    if (!mecab) {
-        fprintf(stderr, "MeCabの初期化に失敗しました: %s\n", mecab_strerror(NULL));
+// リクエストコンテキストを生成（mecab が NULL の場合は専用のセッションを生成する）
+RequestContext* request_context_create(MecabSession* mecab) {
+    RequestContext* ctx = (RequestContext*)malloc(sizeof(RequestContext));
+    if (!ctx) {
+        fprintf(stderr, "メモリ割り当てエラー: リクエストコンテキストの生成に失敗しました\n");
+        return NULL;
+    }
+    
+    ctx->token_count = 0;
+    ctx->pattern_seen = NULL;
+    ctx->pattern_seen_size = 0;
+    ctx->pattern_stamp = 0;
+    rule_match_scratch_init(&ctx->rule_scratch);
+    ctx->rand_seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)ctx;
+    ctx->owns_mecab = (mecab == NULL);
+    ctx->mecab = mecab ? mecab : mecab_session_create();
+    if (!ctx->mecab) {
+        free(ctx);
+        return NULL;
+    }
+    
+    return ctx;
+}
+
+// リクエストコンテキストを解放
+void request_context_free(RequestContext* ctx) {
+    if (!ctx) {
         return;
     }
     
-    // 形態素解析を実行
-    const mecab_node_t* node = mecab_sparse_tonode(mecab, text);
+    if (ctx->owns_mecab) {
+        mecab_session_destroy(ctx->mecab);
+    }
+    free(ctx->pattern_seen);
+    rule_match_scratch_free(&ctx->rule_scratch);
+    free(ctx);
+}
+
+// MeCabを使用してテキストをトークン化する
+void tokenize_text(RequestContext* ctx, const char* text) {
+    ctx->token_count = 0;
+    
+    // コンテキストのタガーとラティスを再利用する
+    const mecab_node_t* node = mecab_session_parse(ctx->mecab, text);
     if (!node) {
-        fprintf(stderr, "形態素解析に失敗しました: %s\n", mecab_strerror(mecab));
-        mecab_destroy(mecab);
         return;
     }
     
     // 結果を処理
-    token_count = 0;
+    Token* tokens = ctx->tokens;
     for (; node; node = node->next) {
         // EOSノードをスキップ
         if (node->stat == MECAB_EOS_NODE) {
@@ -214,15 +298,17 @@ void tokenize_text(const char* text) {
         char feature_copy[MAX_LINE_LEN];
         strcpy(feature_copy, feature);
         
-        char* pos = strtok(feature_copy, ",");
-        char* pos_detail1 = pos ? strtok(NULL, ",") : NULL;
-        char* pos_detail2 = pos_detail1 ? strtok(NULL, ",") : NULL;
-        char* pos_detail3 = pos_detail2 ? strtok(NULL, ",") : NULL;
-        char* conjugation1 = pos_detail3 ? strtok(NULL, ",") : NULL;
-        char* conjugation2 = conjugation1 ? strtok(NULL, ",") : NULL;
-        char* base_form = conjugation2 ? strtok(NULL, ",") : NULL;
+        char* saveptr = NULL;
+        char* pos = strtok_r(feature_copy, ",", &saveptr);
+        char* pos_detail1 = pos ? strtok_r(NULL, ",", &saveptr) : NULL;
+        char* pos_detail2 = pos_detail1 ? strtok_r(NULL, ",", &saveptr) : NULL;
+        char* pos_detail3 = pos_detail2 ? strtok_r(NULL, ",", &saveptr) : NULL;
+        char* conjugation1 = pos_detail3 ? strtok_r(NULL, ",", &saveptr) : NULL;
+        char* conjugation2 = conjugation1 ? strtok_r(NULL, ",", &saveptr) : NULL;
+        char* base_form = conjugation2 ? strtok_r(NULL, ",", &saveptr) : NULL;
         
         // トークンに追加
+        int token_count = ctx->token_count;
         if (token_count < MAX_TOKENS) {
             strncpy(tokens[token_count].surface, surface, MAX_WORD_LEN - 1);
             tokens[token_count].surface[MAX_WORD_LEN - 1] = '\0';
@@ -277,12 +363,17 @@ void tokenize_text(const char* text) {
                 tokens[token_count].type = ATTRIBUTE;
             }
             
-            token_count++;
+            // パターン照合用のシンボルIDを付ける
+            PatternTokenIds* ids = &ctx->token_ids[token_count];
+            ids->surface = pattern_symbols_lookup(&pattern_symbols, tokens[token_count].surface);
+            ids->base = pattern_symbols_lookup(&pattern_symbols, tokens[token_count].base);
+            ids->pos = pattern_symbols_lookup(&pattern_symbols, tokens[token_count].pos);
+            ids->pos_detail = pattern_symbols_lookup(&pattern_symbols, tokens[token_count].pos_detail);
+            ids->type = (int)tokens[token_count].type;
+            
+            ctx->token_count++;
         }
     }
-    
-    // MeCabを解放
-    mecab_destroy(mecab);
 }
 
 // エージェントを初期化
@@ -628,7 +719,8 @@ void init_topics() {
 // ファイルから知識を読み込む
 void load_knowledge_from_file(const char* filename, int topic_id) {
     char filepath[256];
-    FILE* file = NULL;
+    const char* text = NULL;
+    size_t length = 0;
     static time_t last_check_time = 0;
     static bool knowledge_base_checked = false;
     
@@ -656,46 +748,29 @@ void load_knowledge_from_file(const char* filename, int topic_id) {
     };
     
     for (size_t i = 0; i < sizeof(search_paths) / sizeof(search_paths[0]); i++) {
-        sprintf(filepath, search_paths[i], filename);
-        file = fopen(filepath, "r");
-        if (file) {
+        snprintf(filepath, sizeof(filepath), search_paths[i], filename);
+        // ファイル全体を mmap する（サイズの上限なし）
+        text = knowledge_store_map_file(&topic_knowledge_store, filepath, &length);
+        if (text) {
             // ファイルが見つかった
             printf("ファイルを読み込みました: %s\n", filepath);
             break;
         }
     }
 
-    if (!file) {
+    if (!text) {
         fprintf(stderr, "知識ファイルを開けませんでした: %s\n", filename);
         return;
     }
     
-    // ファイル全体を読み込む
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    char* buffer = (char*)malloc(file_size + 1);
-    if (!buffer) {
-        fprintf(stderr, "メモリ確保に失敗しました\n");
-        fclose(file);
-        return;
-    }
-    
-    size_t read_size = fread(buffer, 1, file_size, file);
-    buffer[read_size] = '\0';
-    
     // 全体を一つの知識として追加
-    add_knowledge(topic_id, buffer, 1.0f);
+    add_knowledge_entry(topic_id, text, length, 1.0f);
     
-    free(buffer);
-    
-    fclose(file);
     // デバッグ情報を非表示
 }
 
 // エージェントを追加
-void add_agent(const char* name, float threshold, char (*handler)(const char*, char*, Topic*, int)) {
+void add_agent(const char* name, float threshold, char (*handler)(RequestContext*, const char*, char*, Topic*, int)) {
     if (agent_count >= MAX_AGENTS) {
         fprintf(stderr, "警告: エージェント数が上限に達しました\n");
         return;
@@ -720,7 +795,9 @@ void add_topic(const char* name) {
     strncpy(topics[topic_count].name, name, MAX_TOPIC_NAME - 1);
     topics[topic_count].name[MAX_TOPIC_NAME - 1] = '\0';
     topics[topic_count].pattern_count = 0;
+    topics[topic_count].knowledge = NULL;
     topics[topic_count].knowledge_count = 0;
+    topics[topic_count].knowledge_capacity = 0;
     
     topic_count++;
 }
@@ -777,29 +854,88 @@ void add_topic_pattern(int topic_id, const char* keyword, const char* pos, Conce
     topics[topic_id].pattern_count++;
 }
 
-// 知識を追加
+// 知識を追加（テキストは知識ストアにコピーする）
 void add_knowledge(int topic_id, const char* text, float relevance) {
+    size_t length = strlen(text);
+    const char* stored = knowledge_store_copy(&topic_knowledge_store, text, length);
+    if (!stored) {
+        return;
+    }
+    
+    add_knowledge_entry(topic_id, stored, length, relevance);
+}
+
+// 知識を追加（text は知識ストア内のテキストで、コピーしない。'\0' で終わるとは限らないので length の範囲だけを読む）
+void add_knowledge_entry(int topic_id, const char* text, size_t length, float relevance) {
     if (topic_id < 0 || topic_id >= topic_count) {
         fprintf(stderr, "警告: 無効なトピックID: %d\n", topic_id);
         return;
     }
     
-    if (topics[topic_id].knowledge_count >= MAX_KNOWLEDGE_ENTRIES) {
-        fprintf(stderr, "警告: 知識エントリ数が上限に達しました（トピック: %s）\n", topics[topic_id].name);
-        return;
+    Topic* topic = &topics[topic_id];
+    
+    // 容量が足りない場合は拡張
+    if (topic->knowledge_count >= topic->knowledge_capacity) {
+        int new_capacity = topic->knowledge_capacity > 0 ? topic->knowledge_capacity * 2 : KNOWLEDGE_INITIAL_CAPACITY;
+        KnowledgeEntry* new_knowledge = (KnowledgeEntry*)realloc(topic->knowledge, sizeof(KnowledgeEntry) * new_capacity);
+        if (!new_knowledge) {
+            fprintf(stderr, "メモリ割り当てエラー: 知識エントリを追加できませんでした（トピック: %s）\n", topic->name);
+            return;
+        }
+        topic->knowledge = new_knowledge;
+        topic->knowledge_capacity = new_capacity;
     }
     
-    int knowledge_id = topics[topic_id].knowledge_count;
+    KnowledgeEntry* entry = &topic->knowledge[topic->knowledge_count];
+    entry->text = text;
+    entry->length = length;
+    entry->relevance = relevance;
     
-    strncpy(topics[topic_id].knowledge[knowledge_id].text, text, MAX_KNOWLEDGE_TEXT - 1);
-    topics[topic_id].knowledge[knowledge_id].text[MAX_KNOWLEDGE_TEXT - 1] = '\0';
-    topics[topic_id].knowledge[knowledge_id].relevance = relevance;
+    topic->knowledge_count++;
+}
+
+// トピックの知識エントリと知識ストアを解放
+void free_topics() {
+    for (int i = 0; i < topic_count; i++) {
+        free(topics[i].knowledge);
+        topics[i].knowledge = NULL;
+        topics[i].knowledge_count = 0;
+        topics[i].knowledge_capacity = 0;
+    }
     
-    topics[topic_id].knowledge_count++;
+    knowledge_store_free(&topic_knowledge_store);
 }
 
-// テキストをルーティング
+// 知識テキストを応答にコピー（MAX_RESPONSE_LEN を超える分はUTF-8の文字境界で切る）
+void copy_knowledge_response(char* response, const KnowledgeEntry* entry) {
+    size_t length = entry->length;
+    if (length >= MAX_RESPONSE_LEN) {
+        length = MAX_RESPONSE_LEN - 1;
+        while (length > 0 && ((unsigned char)entry->text[length] & 0xC0) == 0x80) {
+            length--;
+        }
+    }
+    
+    memcpy(response, entry->text, length);
+    response[length] = '\0';
+}
+
+// テキストをルーティング（メインスレッド用のコンテキストを使う）
 int route_text(const char* text, char* response) {
+    static RequestContext* default_ctx = NULL;
+    if (!default_ctx) {
+        default_ctx = request_context_create(mecab_tagger_default_session());
+        if (!default_ctx) {
+            strcpy(response, "内部エラー: リクエストコンテキストを生成できませんでした");
+            return 0;
+        }
+    }
+    
+    return route_text_ctx(default_ctx, text, response);
+}
+
+// テキストをルーティング（ctx はスレッドごとのリクエストコンテキスト）
+int route_text_ctx(RequestContext* ctx, const char* text, char* response) {
     // ステータスコマンドの特別処理
     if (strstr(text, "ステータス") != NULL || strstr(text, "status") != NULL) {
         // 各トピックの知識数をカウント
@@ -816,14 +952,27 @@ int route_text(const char* text, char* response) {
         }
         
         sprintf(status_info + strlen(status_info), "\n総知識数: %d 件\n", total_knowledge);
+        sprintf(status_info + strlen(status_info), "知識テキスト: %.1f KB (mmap %.1f KB, アリーナ %.1f KB)\n",
+                (topic_knowledge_store.mapped_bytes + topic_knowledge_store.arena_bytes) / 1024.0,
+                topic_knowledge_store.mapped_bytes / 1024.0, topic_knowledge_store.arena_bytes / 1024.0);
         sprintf(status_info + strlen(status_info), "推論ルール数: %d 件\n", rule_count);
+        QALogStats log_stats;
+        qa_log_writer_get_stats(&log_stats);
+        sprintf(status_info + strlen(status_info), "質問応答ログ: %ld 件 (fsync %ld 回, キュー待ち %ld 回)\n",
+                log_stats.records, log_stats.batches, log_stats.waits);
         
         // 辞書の単語数（ベクトルデータベース）
         // 実際のベクトルデータベースのサイズを取得して表示
-        sprintf(status_info + strlen(status_info), "辞書登録単語数: %d 語 (最大 %d 語)\n", 
-                get_global_vector_db_size_impl(), 25000);
+        sprintf(status_info + strlen(status_info), "辞書登録単語数: %d 語 (ベクトル %.1f KB)\n", 
+                get_global_vector_db_size_impl(), get_global_vector_db_bytes_impl() / 1024.0);
         sprintf(status_info + strlen(status_info), "ベクトル次元数: %d 次元\n", 64);
         
+        // 形態素解析器の再利用状況
+        MecabTaggerStats mecab_stats;
+        mecab_tagger_get_stats(&mecab_stats);
+        sprintf(status_info + strlen(status_info), "形態素解析回数: %ld 回 (辞書読み込み %.1f ms, 再利用による節約 %.1f ms)\n",
+                mecab_stats.parse_count, mecab_stats.init_ms, mecab_stats.saved_ms);
+        
         strcpy(response, status_info);
         return 1;
     }
@@ -840,14 +989,24 @@ int route_text(const char* text, char* response) {
     }
     
     // テキストをトークン化
-    tokenize_text(text);
+    tokenize_text(ctx, text);
+    
+    // 全エージェントと全トピックのスコアを計算
+    calculate_all_scores(ctx);
+    
+    if (debug_mode) {
+        MecabTaggerStats mecab_stats;
+        mecab_tagger_get_stats(&mecab_stats);
+        printf("形態素解析: %d トークン (累計 %ld 回, 節約 %.1f ms)\n", 
+               ctx->token_count, mecab_stats.parse_count, mecab_stats.saved_ms);
+    }
     
     // 各エージェントのスコアを計算
     float max_score = -1.0f;
     int best_agent = -1;
     
     for (int i = 0; i < agent_count; i++) {
-        float score = calculate_score(i, tokens, token_count);
+        float score = calculate_score(ctx, i);
         
         if (debug_mode) {
             printf("エージェント '%s' のスコア: %.4f (しきい値: %.4f)\n", 
@@ -871,215 +1030,124 @@ int route_text(const char* text, char* response) {
     }
     
     // 最適なトピックを見つける
-    int best_topic = find_best_topic(tokens, token_count);
+    int best_topic = find_best_topic(ctx);
     
     // 処理開始時間を記録
     time_t start_time = time(NULL);
     
     // エージェントのハンドラを呼び出す
-    char result = agents[best_agent].handler(text, response, topics, best_topic);
+    char result = agents[best_agent].handler(ctx, text, response, topics, best_topic);
     
     // 学習データベースに追加
     if (result && learning_db && strlen(response) > 0) {
         learning_db_add(learning_db, text, response, 0.9f);
         
-        // ログフォルダに質問と回答のペアを保存
-        char title[256];
-        time_t now = time(NULL);
-        struct tm *tm_info = localtime(&now);
-        char timestamp[30];
-        strftime(timestamp, 30, "%Y-%m-%d_%H-%M-%S", tm_info);
-        
-        snprintf(title, sizeof(title), "Q_%lu", (unsigned long)now);
-        
-        // ログディレクトリを作成
-        struct stat st = {0};
-        if (stat("data/logs", &st) == -1) {
-            mkdir("data/logs", 0700);
-        }
-        
-        // ログファイルのパスを作成
-        char log_path[512];
-        snprintf(log_path, sizeof(log_path), "data/logs/%s_%s.log", timestamp, title);
-        
-        // 単語数をカウント
-        int word_count = 0;
-        char *text_copy = strdup(text);
-        char *token = strtok(text_copy, " \t\n,.!?;:()[]{}\"'");
-        while (token != NULL) {
-            word_count++;
-            token = strtok(NULL, " \t\n,.!?;:()[]{}\"'");
-        }
-        free(text_copy);
-        
-        // デバッグ情報を含むコンテンツを作成
-        char content[8192];
-        snprintf(content, sizeof(content), 
-                "# 質問応答ログ: %s\n\n"
-                "## タイムスタンプ\n%s\n\n"
-                "## 質問\n%s\n\n"
-                "## 回答\n%s\n\n"
-                "## デバッグ情報\n"
-                "- 処理時間: %.3f秒\n"
-                "- 最適エージェント: %s\n"
-                "- 関連トピック: %s (信頼度: %.2f)\n"
-                "- 単語数: %d\n"
-                "- 文字数: %d\n"
-                "- 回答文字数: %d\n",
-                title, timestamp, text, response,
-                difftime(now, start_time),
-                agents[best_agent].name,
-                topics[best_topic].name, topics[best_topic].confidence,
-                word_count, (int)strlen(text), (int)strlen(response));
-        
-        // ログファイルに書き込み
-        FILE *log_file = fopen(log_path, "w");
-        if (log_file) {
-            fputs(content, log_file);
-            fclose(log_file);
-            printf("ログを保存しました: %s\n", log_path);
-        } else {
-            fprintf(stderr, "ログファイルを開けませんでした: %s\n", log_path);
-        }
-        
-        // 知識ベースにも追加（質問と回答のペアを保存）
-        if (knowledge_base) {
-            const char* tags[] = {"自動生成", "Q&A", "ログ"};
-            // ログファイルを生成
-            char log_filename[256];
-            time_t now = time(NULL);
-            struct tm *tm_now = localtime(&now);
-            char timestamp[32];
-            strftime(timestamp, sizeof(timestamp), "%Y-%m-%d_%H-%M-%S", tm_now);
-            
-            // ログファイル名を生成
-            snprintf(log_filename, sizeof(log_filename), "Q_%ld", (long)now);
-            
-            // 知識ベースにドキュメントを追加
-            knowledge_base_add_document(knowledge_base, log_filename, content, "質問回答", tags, 3);
+        // 質問と回答のペアはログと知識ベースに書き込みスレッドで保存する
+        QALogEntry entry;
+        entry.question = text;
+        entry.answer = response;
+        entry.agent = agents[best_agent].name;
+        entry.topic = topics[best_topic].name;
+        entry.topic_confidence = topics[best_topic].confidence;
+        entry.answered_at = time(NULL);
+        entry.elapsed = difftime(entry.answered_at, start_time);
+        if (qa_log_writer_submit(&entry) && debug_mode) {
+            printf("質問応答ログを書き込みキューに追加しました\n");
         }
     }
     
     return result;
 }
 
-// エージェントのスコアを計算
-float calculate_score(int agent_id, const Token* tokens, int token_count) {
-    if (agent_id < 0 || agent_id >= agent_count) {
-        return 0.0f;
+// パターンをコンパイル（init_agents と init_topics の後に一度だけ呼ぶ）
+bool compile_patterns() {
+    if (!pattern_symbols_init(&pattern_symbols)) {
+        return false;
     }
     
-    float score = 0.0f;
-    int matches = 0;
-    
-    // 各パターンについて
-    for (int i = 0; i < agents[agent_id].pattern_count; i++) {
-        Pattern* pattern = &agents[agent_id].patterns[i];
-        
-        // 各トークンについて
-        for (int j = 0; j < token_count; j++) {
-            bool keyword_match = false;
-            bool pos_match = false;
-            bool type_match = false;
-            
-            // キーワードのマッチ
-            if (strcmp(pattern->keyword, "*") == 0 || 
-                strcmp(pattern->keyword, tokens[j].surface) == 0 || 
-                strcmp(pattern->keyword, tokens[j].base) == 0) {
-                keyword_match = true;
-            }
-            
-            // 品詞のマッチ
-            if (strcmp(pattern->pos, "*") == 0 || 
-                strcmp(pattern->pos, tokens[j].pos) == 0 || 
-                strcmp(pattern->pos, tokens[j].pos_detail) == 0) {
-                pos_match = true;
-            }
-            
-            // タイプのマッチ
-            if (pattern->type == UNKNOWN || pattern->type == tokens[j].type) {
-                type_match = true;
-            }
-            
-            // すべての条件がマッチした場合
-            if (keyword_match && pos_match && type_match) {
-                score += pattern->weight;
-                matches++;
-                break;  // 同じパターンは一度だけカウント
-            }
+    pattern_matcher_init(&agent_matcher, &pattern_symbols, MAX_AGENTS);
+    for (int i = 0; i < agent_count; i++) {
+        for (int j = 0; j < agents[i].pattern_count; j++) {
+            Pattern* pattern = &agents[i].patterns[j];
+            pattern_matcher_add(&agent_matcher, i, pattern->keyword, pattern->pos,
+                                pattern->type == UNKNOWN ? PATTERN_ANY_TYPE : (int)pattern->type, pattern->weight);
         }
     }
     
-    // パターン数で正規化
-    if (agents[agent_id].pattern_count > 0) {
-        score /= agents[agent_id].pattern_count;
+    pattern_matcher_init(&topic_matcher, &pattern_symbols, MAX_TOPICS);
+    for (int i = 0; i < topic_count; i++) {
+        for (int j = 0; j < topics[i].pattern_count; j++) {
+            Pattern* pattern = &topics[i].patterns[j];
+            pattern_matcher_add(&topic_matcher, i, pattern->keyword, pattern->pos,
+                                pattern->type == UNKNOWN ? PATTERN_ANY_TYPE : (int)pattern->type, pattern->weight);
+        }
     }
     
-    return score;
+    return pattern_matcher_compile(&agent_matcher) && pattern_matcher_compile(&topic_matcher);
 }
 
-// トピックのスコアを計算
-float calculate_topic_score(int topic_id, const Token* tokens, int token_count) {
-    if (topic_id < 0 || topic_id >= topic_count) {
-        return 0.0f;
+// コンパイル済みパターンを解放
+void free_patterns() {
+    pattern_matcher_free(&agent_matcher);
+    pattern_matcher_free(&topic_matcher);
+    pattern_symbols_free(&pattern_symbols);
+}
+
+// 全エージェントと全トピックのスコアを計算（トークン数に比例する）
+void calculate_all_scores(RequestContext* ctx) {
+    int needed = agent_matcher.pattern_count + topic_matcher.pattern_count;
+    if (ctx->pattern_seen_size < needed) {
+        unsigned int* seen = (unsigned int*)calloc(needed, sizeof(unsigned int));
+        if (!seen) {
+            fprintf(stderr, "メモリ割り当てエラー: スコア計算の作業領域を確保できませんでした\n");
+            memset(ctx->agent_scores, 0, sizeof(ctx->agent_scores));
+            memset(ctx->topic_scores, 0, sizeof(ctx->topic_scores));
+            return;
+        }
+        free(ctx->pattern_seen);
+        ctx->pattern_seen = seen;
+        ctx->pattern_seen_size = needed;
+        ctx->pattern_stamp = 0;
     }
     
-    float score = 0.0f;
-    int matches = 0;
+    // 印は毎回変えるので作業領域を消去しなくてよい（一周したときだけ消去）
+    ctx->pattern_stamp++;
+    if (ctx->pattern_stamp == 0) {
+        memset(ctx->pattern_seen, 0, sizeof(unsigned int) * ctx->pattern_seen_size);
+        ctx->pattern_stamp = 1;
+    }
     
-    // 各パターンについて
-    for (int i = 0; i < topics[topic_id].pattern_count; i++) {
-        Pattern* pattern = &topics[topic_id].patterns[i];
-        
-        // 各トークンについて
-        for (int j = 0; j < token_count; j++) {
-            bool keyword_match = false;
-            bool pos_match = false;
-            bool type_match = false;
-            
-            // キーワードのマッチ
-            if (strcmp(pattern->keyword, "*") == 0 || 
-                strcmp(pattern->keyword, tokens[j].surface) == 0 || 
-                strcmp(pattern->keyword, tokens[j].base) == 0) {
-                keyword_match = true;
-            }
-            
-            // 品詞のマッチ
-            if (strcmp(pattern->pos, "*") == 0 || 
-                strcmp(pattern->pos, tokens[j].pos) == 0 || 
-                strcmp(pattern->pos, tokens[j].pos_detail) == 0) {
-                pos_match = true;
-            }
-            
-            // タイプのマッチ
-            if (pattern->type == UNKNOWN || pattern->type == tokens[j].type) {
-                type_match = true;
-            }
-            
-            // すべての条件がマッチした場合
-            if (keyword_match && pos_match && type_match) {
-                score += pattern->weight;
-                matches++;
-                break;  // 同じパターンは一度だけカウント
-            }
-        }
+    pattern_matcher_score(&agent_matcher, ctx->token_ids, ctx->token_count,
+                          ctx->pattern_seen, ctx->pattern_stamp, ctx->agent_scores);
+    pattern_matcher_score(&topic_matcher, ctx->token_ids, ctx->token_count,
+                          ctx->pattern_seen + agent_matcher.pattern_count, ctx->pattern_stamp, ctx->topic_scores);
+}
+
+// エージェントのスコアを取得（calculate_all_scores の結果）
+float calculate_score(const RequestContext* ctx, int agent_id) {
+    if (agent_id < 0 || agent_id >= agent_count) {
+        return 0.0f;
     }
     
-    // パターン数で正規化
-    if (topics[topic_id].pattern_count > 0) {
-        score /= topics[topic_id].pattern_count;
+    return ctx->agent_scores[agent_id];
+}
+
+// トピックのスコアを取得（calculate_all_scores の結果）
+float calculate_topic_score(const RequestContext* ctx, int topic_id) {
+    if (topic_id < 0 || topic_id >= topic_count) {
+        return 0.0f;
     }
     
-    return score;
+    return ctx->topic_scores[topic_id];
 }
 
 // 最適なトピックを見つける
-int find_best_topic(const Token* tokens, int token_count) {
+int find_best_topic(const RequestContext* ctx) {
     float max_score = -1.0f;
     int best_topic = -1;
     
     for (int i = 0; i < topic_count; i++) {
-        float score = calculate_topic_score(i, tokens, token_count);
+        float score = calculate_topic_score(ctx, i);
         
         if (debug_mode) {
             printf("トピック '%s' のスコア: %.4f\n", topics[i].name, score);
@@ -1104,14 +1172,16 @@ int find_best_topic(const Token* tokens, int token_count) {
 }
 
 // 挨拶エージェントのハンドラ
-char handle_greeting(const char* text, char* response, Topic* unused_topics, int unused_topic_id) {
+char handle_greeting(RequestContext* ctx, const char* text, char* response, Topic* unused_topics, int unused_topic_id) {
     // 未使用パラメータの警告を抑制
+    (void)ctx;
     (void)unused_topics;
     (void)unused_topic_id;
     // 時間に応じた挨拶
     time_t now = time(NULL);
-    struct tm* local = localtime(&now);
-    int hour = local->tm_hour;
+    struct tm local;
+    localtime_r(&now, &local);
+    int hour = local.tm_hour;
     
     if (strstr(text, "おはよう") != NULL) {
         strcpy(response, "おはようございます！今日も良い一日をお過ごしください。");
@@ -1138,10 +1208,10 @@ char handle_greeting(const char* text, char* response, Topic* unused_topics, int
 }
 
 // 質問エージェントのハンドラ
-char handle_question(const char* text, char* response, Topic* topics, int topic_id) {
+char handle_question(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_id) {
     // 推論ルールを適用して応答を生成
     
-    if (apply_inference_rules(text, response)) {
+    if (apply_inference_rules(ctx, text, response)) {
         
         return 1;  // 推論ルールが適用された
     }
@@ -1151,8 +1221,8 @@ char handle_question(const char* text, char* response, Topic* topics, int topic_
     if (topic_id >= 0 && topic_id < topic_count) {
         // ランダムに知識エントリを選択
         if (topics[topic_id].knowledge_count > 0) {
-            int knowledge_id = rand() % topics[topic_id].knowledge_count;
-            strcpy(response, topics[topic_id].knowledge[knowledge_id].text);
+            int knowledge_id = rand_r(&ctx->rand_seed) % topics[topic_id].knowledge_count;
+            copy_knowledge_response(response, &topics[topic_id].knowledge[knowledge_id]);
             return 1;
         }
     }
@@ -1220,7 +1290,7 @@ char handle_question(const char* text, char* response, Topic* topics, int topic_
 }
 
 // 命令エージェントのハンドラ
-char handle_command(const char* text, char* response, Topic* topics, int topic_id) {
+char handle_command(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_id) {
     // ステータスコマンドの処理
     if (strstr(text, "ステータス") != NULL || strstr(text, "status") != NULL) {
         // 各トピックの知識数をカウント
@@ -1237,14 +1307,23 @@ char handle_command(const char* text, char* response, Topic* topics, int topic_i
         }
         
         sprintf(status_info + strlen(status_info), "\n総知識数: %d 件\n", total_knowledge);
+        sprintf(status_info + strlen(status_info), "知識テキスト: %.1f KB (mmap %.1f KB, アリーナ %.1f KB)\n",
+                (topic_knowledge_store.mapped_bytes + topic_knowledge_store.arena_bytes) / 1024.0,
+                topic_knowledge_store.mapped_bytes / 1024.0, topic_knowledge_store.arena_bytes / 1024.0);
         sprintf(status_info + strlen(status_info), "推論ルール数: %d 件\n", rule_count);
         
         // 辞書の単語数（ベクトルデータベース）
         // 実際のベクトルデータベースのサイズを取得して表示
-        sprintf(status_info + strlen(status_info), "辞書登録単語数: %d 語 (最大 %d 語)\n", 
-                get_global_vector_db_size_impl(), 25000);
+        sprintf(status_info + strlen(status_info), "辞書登録単語数: %d 語 (ベクトル %.1f KB)\n", 
+                get_global_vector_db_size_impl(), get_global_vector_db_bytes_impl() / 1024.0);
         sprintf(status_info + strlen(status_info), "ベクトル次元数: %d 次元\n", 64);
         
+        // 形態素解析器の再利用状況
+        MecabTaggerStats mecab_stats;
+        mecab_tagger_get_stats(&mecab_stats);
+        sprintf(status_info + strlen(status_info), "形態素解析回数: %ld 回 (辞書読み込み %.1f ms, 再利用による節約 %.1f ms)\n",
+                mecab_stats.parse_count, mecab_stats.init_ms, mecab_stats.saved_ms);
+        
         strcpy(response, status_info);
         return 1;
     }
@@ -1253,8 +1332,8 @@ char handle_command(const char* text, char* response, Topic* topics, int topic_i
     if (topic_id >= 0 && topic_id < topic_count) {
         // ランダムに知識エントリを選択
         if (topics[topic_id].knowledge_count > 0) {
-            int knowledge_id = rand() % topics[topic_id].knowledge_count;
-            strcpy(response, topics[topic_id].knowledge[knowledge_id].text);
+            int knowledge_id = rand_r(&ctx->rand_seed) % topics[topic_id].knowledge_count;
+            copy_knowledge_response(response, &topics[topic_id].knowledge[knowledge_id]);
             return 1;
         }
     }
@@ -1280,21 +1359,21 @@ char handle_command(const char* text, char* response, Topic* topics, int topic_i
 }
 
 // 陳述エージェントのハンドラ
-char handle_statement(const char* unused_text, char* response, Topic* topics, int topic_id) {
+char handle_statement(RequestContext* ctx, const char* unused_text, char* response, Topic* topics, int topic_id) {
     // 未使用パラメータの警告を抑制
     (void)unused_text;
     // トピックが見つかった場合は、そのトピックの知識から回答を生成
     if (topic_id >= 0 && topic_id < topic_count) {
         // ランダムに知識エントリを選択
         if (topics[topic_id].knowledge_count > 0) {
-            int knowledge_id = rand() % topics[topic_id].knowledge_count;
-            strcpy(response, topics[topic_id].knowledge[knowledge_id].text);
+            int knowledge_id = rand_r(&ctx->rand_seed) % topics[topic_id].knowledge_count;
+            copy_knowledge_response(response, &topics[topic_id].knowledge[knowledge_id]);
             return 1;
         }
     }
     
     // ランダムな応答を選択
-    int random = rand() % 5;
+    int random = rand_r(&ctx->rand_seed) % 5;
     
     switch (random) {
         case 0:
@@ -1321,13 +1400,13 @@ char handle_statement(const char* unused_text, char* response, Topic* topics, in
 }
 
 // 感情エージェントのハンドラ
-char handle_emotion(const char* text, char* response, Topic* topics, int topic_id) {
+char handle_emotion(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_id) {
     // トピックが見つかった場合は、そのトピックの知識から回答を生成
     if (topic_id >= 0 && topic_id < topic_count) {
         // ランダムに知識エントリを選択
         if (topics[topic_id].knowledge_count > 0) {
-            int knowledge_id = rand() % topics[topic_id].knowledge_count;
-            strcpy(response, topics[topic_id].knowledge[knowledge_id].text);
+            int knowledge_id = rand_r(&ctx->rand_seed) % topics[topic_id].knowledge_count;
+            copy_knowledge_response(response, &topics[topic_id].knowledge[knowledge_id]);
             return 1;
         }
     }
@@ -1353,10 +1432,10 @@ char handle_emotion(const char* text, char* response, Topic* topics, int topic_i
 }
 
 // フォールバックエージェントのハンドラ
-char handle_fallback(const char* text, char* response, Topic* topics, int topic_id) {
+char handle_fallback(RequestContext* ctx, const char* text, char* response, Topic* topics, int topic_id) {
     // 推論ルールを適用して応答を生成
     
-    if (apply_inference_rules(text, response)) {
+    if (apply_inference_rules(ctx, text, response)) {
         
         return 1;  // 推論ルールが適用された
     }
@@ -1366,8 +1445,8 @@ char handle_fallback(const char* text, char* response, Topic* topics, int topic_
     if (topic_id >= 0 && topic_id < topic_count) {
         // ランダムに知識エントリを選択
         if (topics[topic_id].knowledge_count > 0) {
-            int knowledge_id = rand() % topics[topic_id].knowledge_count;
-            strcpy(response, topics[topic_id].knowledge[knowledge_id].text);
+            int knowledge_id = rand_r(&ctx->rand_seed) % topics[topic_id].knowledge_count;
+            copy_knowledge_response(response, &topics[topic_id].knowledge[knowledge_id]);
             return 1;
         }
     }
@@ -1415,7 +1494,7 @@ char handle_fallback(const char* text, char* response, Topic* topics, int topic_
     }
     
     // 検索に失敗した場合はランダムなフォールバック応答を選択
-    int random = rand() % 5;
+    int random = rand_r(&ctx->rand_seed) % 5;
     
     switch (random) {
         case 0:
@@ -1536,7 +1615,8 @@ void init_topic_relations() {
 
 // 推論ルールを初期化
 void init_inference_rules() {
-    rule_count = 0;
+    free_inference_rules();
+    rule_matcher_init(&rule_matcher);
     
     // 幸せに関する推論ルール
     add_inference_rule("幸せ AND 方法", "幸せになるためには、小さな喜びを見つけることが大切です。", 0.8f);
@@ -1657,7 +1737,14 @@ void init_inference_rules() {
     add_inference_rule("Rust AND 特徴", "Rustプログラミング言語の主な特徴は、メモリ安全性、並行性、パフォーマンスです。所有権システムによりガベージコレクションなしでメモリ安全性を保証し、コンパイル時に多くのエラーを検出します。C++並みの速度と安全性を両立させた現代的な言語です。", 0.95f);
     add_inference_rule("Rust AND 言語", "Rustは、Mozillaが開発した高性能でメモリ安全なプログラミング言語です。所有権とボローイングの概念により、コンパイル時にメモリ関連のバグを防ぎ、ガベージコレクションなしで安全なコードを実現します。システムプログラミングに適しており、WebAssemblyのサポートも充実しています。", 0.95f);
     
-    // デバッグ情報を非表示
+    // ファイルで定義された追加ルール
+    struct stat st;
+    if (stat(INFERENCE_RULES_FILE, &st) == 0) {
+        load_inference_rules(INFERENCE_RULES_FILE);
+    }
+    
+    // 全ルールの条件をオートマトンにまとめる
+    rule_matcher_compile(&rule_matcher);
 }
 
 // トピック関連性を追加
@@ -1696,10 +1783,21 @@ void add_topic_relation(const char* topic, const char* related_topic, float stre
     }
 }
 
-// 推論ルールを追加
+// 推論ルールを追加（init_inference_rules の外で追加した場合は rule_matcher_compile を呼び直す）
 void add_inference_rule(const char* condition, const char* conclusion, float confidence) {
-    if (rule_count >= MAX_INFERENCE_RULES) {
-        fprintf(stderr, "警告: 推論ルールの上限に達しました\n");
+    if (rule_count >= rule_capacity) {
+        int new_capacity = rule_capacity > 0 ? rule_capacity * 2 : 128;
+        InferenceRule* new_rules = (InferenceRule*)realloc(inference_rules, sizeof(InferenceRule) * new_capacity);
+        if (!new_rules) {
+            fprintf(stderr, "メモリ割り当てエラー: 推論ルールを追加できませんでした\n");
+            return;
+        }
+        inference_rules = new_rules;
+        rule_capacity = new_capacity;
+    }
+    
+    // 照合器のルール番号と配列の添字をそろえる
+    if (rule_matcher_add(&rule_matcher, condition, confidence) != rule_count) {
         return;
     }
     
@@ -1714,6 +1812,54 @@ void add_inference_rule(const char* condition, const char* conclusion, float con
     rule_count++;
 }
 
+// 推論ルールをファイルから読み込む（1行に「条件<TAB>結論<TAB>確信度」、# で始まる行はコメント）
+int load_inference_rules(const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "推論ルールファイルを開けませんでした: %s\n", filename);
+        return 0;
+    }
+    
+    char line[MAX_RULE_TEXT * 2 + 64];
+    int line_number = 0;
+    int loaded = 0;
+    
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        
+        char* saveptr = NULL;
+        char* condition = strtok_r(line, "\t", &saveptr);
+        char* conclusion = strtok_r(NULL, "\t", &saveptr);
+        char* confidence = strtok_r(NULL, "\t", &saveptr);
+        if (!condition || !conclusion || !confidence) {
+            fprintf(stderr, "警告: 推論ルールの形式が不正です (%s:%d)\n", filename, line_number);
+            continue;
+        }
+        
+        int before = rule_count;
+        add_inference_rule(condition, conclusion, (float)atof(confidence));
+        if (rule_count > before) {
+            loaded++;
+        }
+    }
+    
+    fclose(file);
+    return loaded;
+}
+
+// 推論ルールと照合器を解放
+void free_inference_rules() {
+    free(inference_rules);
+    inference_rules = NULL;
+    rule_count = 0;
+    rule_capacity = 0;
+    rule_matcher_free(&rule_matcher);
+}
+
 // 関連トピックを検索
 bool find_related_topics(const char* topic, char related_topics[MAX_RELATED_TOPICS][MAX_TOPIC_NAME_LOGIC], float strengths[MAX_RELATED_TOPICS], int* count) {
     *count = 0;
@@ -1735,89 +1881,32 @@ bool find_related_topics(const char* topic, char related_topics[MAX_RELATED_TOPI
     return false;
 }
 
-// 推論ルールを適用
-bool apply_inference_rules(const char* input, char* response) {
-    bool rule_applied = false;
-    float max_confidence = 0.0f;
-    
+// 推論ルールを適用（全ルールの条件を入力の1回の走査で照合する）
+bool apply_inference_rules(RequestContext* ctx, const char* input, char* response) {
     if (debug_mode) {
         printf("入力テキスト: '%s'\n", input);
         printf("推論ルール数: %d\n", rule_count);
     }
     
-    // 各ルールをチェック
-    for (int i = 0; i < rule_count; i++) {
-        char condition[MAX_RULE_TEXT];
-        strncpy(condition, inference_rules[i].condition, MAX_RULE_TEXT - 1);
-        condition[MAX_RULE_TEXT - 1] = '\0';
-        
+    // すべての条件が入力に含まれるルールのうち、確信度が最も高いもの（同じなら先に追加したもの）
+    int best = rule_matcher_find(&rule_matcher, input, &ctx->rule_scratch);
+    if (best < 0) {
         if (debug_mode) {
-            printf("ルール %d: 条件='%s', 結論='%s', 確信度=%.2f\n", 
-                   i, inference_rules[i].condition, 
-                   inference_rules[i].conclusion, inference_rules[i].confidence);
-        }
-        
-        char condition_copy[MAX_RULE_TEXT];
-        strncpy(condition_copy, condition, MAX_RULE_TEXT - 1);
-        condition_copy[MAX_RULE_TEXT - 1] = '\0';
-        
-        char* token = strtok(condition_copy, " AND ");
-        bool match = true;
-        
-        // ANDで区切られた条件をすべてチェック
-        while (token != NULL && match) {
-            // ワイルドカードの場合は常にマッチ
-            if (strcmp(token, "*") == 0) {
-                if (debug_mode) {
-                    printf("  ワイルドカードマッチ: '*'\n");
-                }
-                token = strtok(NULL, " AND ");
-                continue;
-            }
-            
-            // 入力テキストに条件が含まれているかチェック
-            if (strstr(input, token) == NULL) {
-                if (debug_mode) {
-                    printf("  不一致: '%s' が入力テキストに含まれていません\n", token);
-                }
-                match = false;
-                break;
-            } else {
-                if (debug_mode) {
-                    printf("  一致: '%s' が入力テキストに含まれています\n", token);
-                }
-            }
-            
-            token = strtok(NULL, " AND ");
-        }
-        
-        // すべての条件がマッチし、より高い確信度を持つ場合
-        if (match && inference_rules[i].confidence > max_confidence) {
-            strncpy(response, inference_rules[i].conclusion, MAX_RESPONSE_LEN - 1);
-            response[MAX_RESPONSE_LEN - 1] = '\0';
-            max_confidence = inference_rules[i].confidence;
-            rule_applied = true;
-            if (debug_mode) {
-                printf("  ルール適用: 確信度=%.2f, 結論='%s'\n", 
-                       inference_rules[i].confidence, inference_rules[i].conclusion);
-            }
-        } else if (match) {
-            if (debug_mode) {
-                printf("  ルールはマッチしましたが、より高い確信度のルールが既に適用されています\n");
-            }
+            printf("適用可能な推論ルールが見つかりませんでした\n");
         }
+        return false;
     }
     
+    strncpy(response, inference_rules[best].conclusion, MAX_RESPONSE_LEN - 1);
+    response[MAX_RESPONSE_LEN - 1] = '\0';
+    
     if (debug_mode) {
-        if (rule_applied) {
-            printf("最終的に適用されたルールの確信度: %.2f\n", max_confidence);
-            printf("推論ルールが適用されました: %s\n", response);
-        } else {
-            printf("適用可能な推論ルールが見つかりませんでした\n");
-        }
+        printf("ルール %d: 条件='%s'\n", best, inference_rules[best].condition);
+        printf("最終的に適用されたルールの確信度: %.2f\n", inference_rules[best].confidence);
+        printf("推論ルールが適用されました: %s\n", response);
     }
     
-    return rule_applied;
+    return true;
 }
 
 // トピック間の類似度を計算
@@ -1876,20 +1965,63 @@ float calculate_topic_similarity(const char* topic1, const char* topic2) {
     return max_similarity;
 }
 
+// 常駐サーバーのワーカーごとにリクエストコンテキストを生成
+void* route_worker_init() {
+    return request_context_create(NULL);
+}
+
+// ワーカーのリクエストコンテキストを解放
+void route_worker_free(void* worker) {
+    request_context_free((RequestContext*)worker);
+}
+
+// ワーカーのコンテキストで質問を処理
+int route_worker_handle(void* worker, const char* text, char* response) {
+    if (!worker) {
+        strcpy(response, "内部エラー: リクエストコンテキストがありません");
+        return 0;
+    }
+    return route_text_ctx((RequestContext*)worker, text, response);
+}
+
 // メイン関数
 int main(int argc, char* argv[]) {
     // ロケールを設定（日本語対応）
     setlocale(LC_ALL, "");
     
+    // トピック知識ストアを初期化
+    knowledge_store_init(&topic_knowledge_store);
+    
     // 乱数の初期化
     srand((unsigned int)time(NULL));
     
+    // 標準入出力の常駐サーバーモードでは、初期化中のログを応答に混ぜない
+    bool stdio_server = false;
+    for (int j = 1; j < argc; j++) {
+        if (strcmp(argv[j], "-s") == 0 || strcmp(argv[j], "--server") == 0) {
+            stdio_server = true;
+        } else if (strcmp(argv[j], "--port") == 0 || strncmp(argv[j], "--port=", 7) == 0 ||
+                   strcmp(argv[j], "--socket") == 0 || strncmp(argv[j], "--socket=", 9) == 0) {
+            stdio_server = false;
+            break;
+        }
+    }
+    if (stdio_server) {
+        query_server_reserve_stdout();
+    }
+    
+    // 形態素解析器を初期化（辞書の読み込みは起動時の一度だけ）
+    mecab_tagger_init("");
+    
     // エージェントとトピックを初期化
     init_agents();
     init_topics();
     init_topic_relations();
     init_inference_rules();
     
+    // エージェントとトピックのパターンをコンパイル
+    compile_patterns();
+    
     // ベクトルデータベースを初期化
     init_global_vector_db_impl();
     
@@ -1900,6 +2032,9 @@ int main(int argc, char* argv[]) {
     // system("rm -rf data/knowledge_base/*"); // 既存のナレッジベースを削除しないように変更
     knowledge_base = knowledge_base_init("logs");
     
+    // 質問応答ログの書き込みスレッドを開始（応答を返してから書き込む）
+    qa_log_writer_start("data/logs", knowledge_base);
+    
     // コマンドライン引数の解析
     int i = 1;  // 最初の引数から開始
     
@@ -1917,6 +2052,7 @@ int main(int argc, char* argv[]) {
         printf("  %s [-d] <入力テキスト>\n", argv[0]);
         printf("  %s [-d] -f <入力ファイル>\n", argv[0]);
         printf("  %s [-d] -i (対話モード)\n", argv[0]);
+        printf("  %s [-d] -s [--port <ポート番号>] [--socket <パス>] [--threads <数>] (常駐サーバーモード)\n", argv[0]);
         printf("  オプション:\n");
         printf("    -d: デバッグモードを有効化\n");
         
@@ -1952,6 +2088,11 @@ int main(int argc, char* argv[]) {
             printf("%s\n", response);
         }
         
+        qa_log_writer_stop();
+        free_topics();
+        free_patterns();
+        free_inference_rules();
+        mecab_tagger_free();
         return 0;
     }
     
@@ -1983,10 +2124,45 @@ int main(int argc, char* argv[]) {
         
         // 応答を表示
         printf("%s\n", response);
+    } else if (strcmp(argv[i], "-s") == 0 || strcmp(argv[i], "--server") == 0) {
+        // 常駐サーバーモード（初期化は起動時の一度だけで、以降は質問ごとにルーティングのみ行う）
+        QueryServerConfig server_config;
+        query_server_config_init(&server_config);
+        server_config.debug = debug_mode;
+        server_config.handler = route_worker_handle;
+        server_config.worker_init = route_worker_init;
+        server_config.worker_free = route_worker_free;
+        
+        for (int j = i + 1; j < argc; j++) {
+            if (strcmp(argv[j], "--port") == 0 && j + 1 < argc) {
+                server_config.port = atoi(argv[++j]);
+            } else if (strncmp(argv[j], "--port=", 7) == 0) {
+                server_config.port = atoi(argv[j] + 7);
+            } else if (strcmp(argv[j], "--socket") == 0 && j + 1 < argc) {
+                strncpy(server_config.socket_path, argv[++j], sizeof(server_config.socket_path) - 1);
+            } else if (strncmp(argv[j], "--socket=", 9) == 0) {
+                strncpy(server_config.socket_path, argv[j] + 9, sizeof(server_config.socket_path) - 1);
+            } else if (strcmp(argv[j], "--threads") == 0 && j + 1 < argc) {
+                server_config.threads = atoi(argv[++j]);
+            } else if (strncmp(argv[j], "--threads=", 10) == 0) {
+                server_config.threads = atoi(argv[j] + 10);
+            } else if (strcmp(argv[j], "--debug") == 0) {
+                debug_mode = true;
+                server_config.debug = true;
+            }
+        }
+        
+        if (server_config.port > 0 || server_config.socket_path[0] != '\0') {
+            query_server_run(&server_config);
+        } else {
+            // ポートもソケットも指定されていない場合は標準入出力の行プロトコル
+            query_server_run_stdio(&server_config);
+        }
     } else if (strcmp(argv[i], "-i") == 0) {
         // 対話モード
         printf("対話モードを開始します。終了するには 'exit' と入力してください。\n");
         // APIキー関連のコマンドは削除
+        char text_buffer[MAX_TEXT_LEN];
         
         while (1) {
             // 入力を受け取る
@@ -2035,7 +2211,9 @@ int main(int argc, char* argv[]) {
         printf("%s\n", response);
     }
     
-    // 終了処理
+    // 終了処理（キューに残った質問応答ログを書き出してから知識ベースを解放する）
+    qa_log_writer_stop();
+    
     if (learning_db) {
         learning_db_free(learning_db);
     }
@@ -2044,5 +2222,10 @@ int main(int argc, char* argv[]) {
         knowledge_base_free(knowledge_base);
     }
     
+    free_topics();
+    free_patterns();
+    free_inference_rules();
+    mecab_tagger_free();
+    
     return 0;
 }
\ No newline at end of file
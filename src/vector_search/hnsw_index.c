@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hnsw_index.h"
+
+#define HNSW_INITIAL_CAPACITY 1024
+#define HNSW_VISITED_INITIAL_BUCKETS 1024
+
+// ノードのベクトル
+#define HNSW_VECTOR(vectors, stride, node) ((const float*)((const char*)(vectors) + (size_t)(node) * (stride)))
+
+// 距離とノードの組
+typedef struct {
+    float dist;
+    int node;
+} HnswCandidate;
+
+// 最小ヒープ（最大ヒープとして使うときは距離の符号を反転して入れる）
+typedef struct {
+    HnswCandidate* items;
+    int count;
+    int capacity;
+} HnswHeap;
+
+// 訪問済みノードの集合（オープンアドレス法、空きは -1）
+typedef struct {
+    int* buckets;
+    int bucket_count;
+    int count;
+} HnswVisited;
+
+// 1回の探索の作業領域
+typedef struct {
+    HnswHeap candidates;        // 未展開の候補（近い順）
+    HnswHeap results;           // 見つかった上位 ef 件（遠い順、距離は負値）
+    HnswVisited visited;
+} HnswSearchContext;
+
+// ---- ヒープ ----
+
+static bool hnsw_heap_push(HnswHeap* heap, float dist, int node) {
+    if (heap->count >= heap->capacity) {
+        int new_capacity = heap->capacity > 0 ? heap->capacity * 2 : 64;
+        HnswCandidate* new_items = (HnswCandidate*)realloc(heap->items, sizeof(HnswCandidate) * new_capacity);
+        if (!new_items) {
+            fprintf(stderr, "メモリ割り当てエラー: 近傍探索の候補を追加できませんでした\n");
+            return false;
+        }
+        heap->items = new_items;
+        heap->capacity = new_capacity;
+    }
+
+    int index = heap->count++;
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (heap->items[parent].dist <= dist) {
+            break;
+        }
+        heap->items[index] = heap->items[parent];
+        index = parent;
+    }
+    heap->items[index].dist = dist;
+    heap->items[index].node = node;
+    return true;
+}
+
+static HnswCandidate hnsw_heap_pop(HnswHeap* heap) {
+    HnswCandidate top = heap->items[0];
+    HnswCandidate last = heap->items[--heap->count];
+    int index = 0;
+    for (;;) {
+        int child = index * 2 + 1;
+        if (child >= heap->count) {
+            break;
+        }
+        if (child + 1 < heap->count && heap->items[child + 1].dist < heap->items[child].dist) {
+            child++;
+        }
+        if (last.dist <= heap->items[child].dist) {
+            break;
+        }
+        heap->items[index] = heap->items[child];
+        index = child;
+    }
+    if (heap->count > 0) {
+        heap->items[index] = last;
+    }
+    return top;
+}
+
+// ---- 訪問済み集合 ----
+
+static void hnsw_visited_clear(HnswVisited* visited) {
+    if (visited->buckets) {
+        memset(visited->buckets, 0xff, sizeof(int) * visited->bucket_count);
+    }
+    visited->count = 0;
+}
+
+// 未訪問なら登録して true を返す
+static bool hnsw_visited_insert(HnswVisited* visited, int node) {
+    // 負荷率を 1/2 以下に保つ
+    if ((visited->count + 1) * 2 > visited->bucket_count) {
+        int new_bucket_count = visited->bucket_count > 0 ? visited->bucket_count * 2 : HNSW_VISITED_INITIAL_BUCKETS;
+        int* new_buckets = (int*)malloc(sizeof(int) * new_bucket_count);
+        if (!new_buckets) {
+            fprintf(stderr, "メモリ割り当てエラー: 近傍探索の訪問済み集合を拡張できませんでした\n");
+            return false;
+        }
+        memset(new_buckets, 0xff, sizeof(int) * new_bucket_count);
+        for (int i = 0; i < visited->bucket_count; i++) {
+            int old = visited->buckets[i];
+            if (old < 0) {
+                continue;
+            }
+            unsigned int slot = ((unsigned int)old * 2654435761u) & (new_bucket_count - 1);
+            while (new_buckets[slot] != -1) {
+                slot = (slot + 1) & (new_bucket_count - 1);
+            }
+            new_buckets[slot] = old;
+        }
+        free(visited->buckets);
+        visited->buckets = new_buckets;
+        visited->bucket_count = new_bucket_count;
+    }
+
+    unsigned int slot = ((unsigned int)node * 2654435761u) & (visited->bucket_count - 1);
+    while (visited->buckets[slot] != -1) {
+        if (visited->buckets[slot] == node) {
+            return false;
+        }
+        slot = (slot + 1) & (visited->bucket_count - 1);
+    }
+    visited->buckets[slot] = node;
+    visited->count++;
+    return true;
+}
+
+static void hnsw_context_free(HnswSearchContext* ctx) {
+    free(ctx->candidates.items);
+    free(ctx->results.items);
+    free(ctx->visited.buckets);
+}
+
+// ---- グラフ ----
+
+// ノードの層の近傍リスト（[個数, ID...]）
+static int* hnsw_links(const HnswIndex* index, int node, int level) {
+    int* links = index->links[node];
+    return level == 0 ? links : links + (index->m0 + 1) + (level - 1) * (index->m + 1);
+}
+
+static int hnsw_max_links(const HnswIndex* index, int level) {
+    return level == 0 ? index->m0 : index->m;
+}
+
+static float hnsw_distance(const HnswIndex* index, const float* vectors, size_t stride, const float* query, int node) {
+    return vector_squared_distance(query, HNSW_VECTOR(vectors, stride, node), index->dim);
+}
+
+// 新しいノードの層を決める（指数分布）
+static int hnsw_random_level(HnswIndex* index) {
+    // xorshift64*
+    uint64_t x = index->random_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    index->random_state = x;
+    double uniform = ((double)((x * 2685821657736338717ULL) >> 11) + 1.0) / 9007199254740993.0;
+    int level = (int)(-log(uniform) * index->level_mult);
+    return level < HNSW_MAX_LEVEL ? level : HNSW_MAX_LEVEL;
+}
+
+// 1つの層で入口から ef 件の近傍を探す（結果は ctx->results に遠い順のヒープで入る）
+static bool hnsw_search_layer(const HnswIndex* index, const float* vectors, size_t stride, const float* query,
+                              int entry, float entry_dist, int ef, int level, HnswSearchContext* ctx) {
+    ctx->candidates.count = 0;
+    ctx->results.count = 0;
+    hnsw_visited_clear(&ctx->visited);
+
+    if (!hnsw_visited_insert(&ctx->visited, entry) ||
+        !hnsw_heap_push(&ctx->candidates, entry_dist, entry) ||
+        !hnsw_heap_push(&ctx->results, -entry_dist, entry)) {
+        return false;
+    }
+
+    while (ctx->candidates.count > 0) {
+        HnswCandidate current = hnsw_heap_pop(&ctx->candidates);
+        float farthest = -ctx->results.items[0].dist;
+        if (current.dist > farthest && ctx->results.count >= ef) {
+            break;  // 残りの候補はどれも結果より遠い
+        }
+
+        const int* links = hnsw_links(index, current.node, level);
+        for (int i = 1; i <= links[0]; i++) {
+            int neighbor = links[i];
+            if (!hnsw_visited_insert(&ctx->visited, neighbor)) {
+                continue;
+            }
+
+            float dist = hnsw_distance(index, vectors, stride, query, neighbor);
+            if (ctx->results.count < ef || dist < -ctx->results.items[0].dist) {
+                if (!hnsw_heap_push(&ctx->candidates, dist, neighbor) ||
+                    !hnsw_heap_push(&ctx->results, -dist, neighbor)) {
+                    return false;
+                }
+                if (ctx->results.count > ef) {
+                    hnsw_heap_pop(&ctx->results);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// 上位の層を貪欲にたどって入口を下ろす
+static int hnsw_greedy_descend(const HnswIndex* index, const float* vectors, size_t stride, const float* query,
+                               int entry, float* entry_dist, int from_level, int to_level) {
+    int current = entry;
+    float current_dist = *entry_dist;
+    for (int level = from_level; level > to_level; level--) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            const int* links = hnsw_links(index, current, level);
+            for (int i = 1; i <= links[0]; i++) {
+                float dist = hnsw_distance(index, vectors, stride, query, links[i]);
+                if (dist < current_dist) {
+                    current_dist = dist;
+                    current = links[i];
+                    changed = true;
+                }
+            }
+        }
+    }
+    *entry_dist = current_dist;
+    return current;
+}
+
+static int hnsw_compare_candidates(const void* a, const void* b) {
+    const HnswCandidate* x = (const HnswCandidate*)a;
+    const HnswCandidate* y = (const HnswCandidate*)b;
+    if (x->dist != y->dist) {
+        return x->dist < y->dist ? -1 : 1;
+    }
+    return x->node - y->node;
+}
+
+// 候補から近傍を選ぶ（既に選んだ近傍の方が近い候補は除き、方向の偏りを抑える）
+// candidates は近い順に並べておく、選んだノードを selected に入れて個数を返す
+static int hnsw_select_neighbors(const HnswIndex* index, const float* vectors, size_t stride,
+                                 const HnswCandidate* candidates, int candidate_count, int max_count, int* selected) {
+    int count = 0;
+    for (int i = 0; i < candidate_count && count < max_count; i++) {
+        const float* vector = HNSW_VECTOR(vectors, stride, candidates[i].node);
+        bool keep = true;
+        for (int j = 0; j < count; j++) {
+            if (hnsw_distance(index, vectors, stride, vector, selected[j]) < candidates[i].dist) {
+                keep = false;
+                break;
+            }
+        }
+        if (keep) {
+            selected[count++] = candidates[i].node;
+        }
+    }
+    return count;
+}
+
+// 近傍リストに node を加える（あふれたら選び直す）
+static bool hnsw_connect(HnswIndex* index, const float* vectors, size_t stride, int owner, int node, int level) {
+    int* links = hnsw_links(index, owner, level);
+    int max_count = hnsw_max_links(index, level);
+    if (links[0] < max_count) {
+        links[++links[0]] = node;
+        return true;
+    }
+
+    HnswCandidate* candidates = (HnswCandidate*)malloc(sizeof(HnswCandidate) * (max_count + 1));
+    int* selected = (int*)malloc(sizeof(int) * max_count);
+    if (!candidates || !selected) {
+        fprintf(stderr, "メモリ割り当てエラー: 近傍リストを更新できませんでした\n");
+        free(candidates);
+        free(selected);
+        return false;
+    }
+
+    const float* owner_vector = HNSW_VECTOR(vectors, stride, owner);
+    for (int i = 0; i < max_count; i++) {
+        candidates[i].node = links[i + 1];
+        candidates[i].dist = hnsw_distance(index, vectors, stride, owner_vector, links[i + 1]);
+    }
+    candidates[max_count].node = node;
+    candidates[max_count].dist = hnsw_distance(index, vectors, stride, owner_vector, node);
+    qsort(candidates, max_count + 1, sizeof(HnswCandidate), hnsw_compare_candidates);
+
+    links[0] = hnsw_select_neighbors(index, vectors, stride, candidates, max_count + 1, max_count, selected);
+    memcpy(links + 1, selected, sizeof(int) * links[0]);
+
+    free(candidates);
+    free(selected);
+    return true;
+}
+
+// グラフを初期化
+bool hnsw_init(HnswIndex* index, int dim, int m, int ef_construction, int ef_search) {
+    memset(index, 0, sizeof(HnswIndex));
+    index->dim = dim;
+    index->m = m > 1 ? m : HNSW_DEFAULT_M;
+    index->m0 = index->m * 2;
+    index->ef_construction = ef_construction > 0 ? ef_construction : HNSW_DEFAULT_EF_CONSTRUCTION;
+    index->ef_search = ef_search > 0 ? ef_search : HNSW_DEFAULT_EF_SEARCH;
+    index->level_mult = 1.0 / log((double)index->m);
+    index->entry_point = -1;
+    index->max_level = -1;
+    index->random_state = 0x9E3779B97F4A7C15ULL;
+    return true;
+}
+
+// グラフを解放
+void hnsw_free(HnswIndex* index) {
+    if (index->links) {
+        for (int i = 0; i < index->count; i++) {
+            free(index->links[i]);
+        }
+    }
+    free(index->links);
+    free(index->levels);
+    index->links = NULL;
+    index->levels = NULL;
+    index->count = 0;
+    index->capacity = 0;
+    index->entry_point = -1;
+    index->max_level = -1;
+}
+
+// ノードを追加
+bool hnsw_insert(HnswIndex* index, const float* vectors, size_t stride, int node) {
+    if (node != index->count) {
+        fprintf(stderr, "近傍探索のグラフには格納順にノードを追加してください: %d\n", node);
+        return false;
+    }
+
+    if (index->count >= index->capacity) {
+        int new_capacity = index->capacity > 0 ? index->capacity * 2 : HNSW_INITIAL_CAPACITY;
+        int* new_levels = (int*)realloc(index->levels, sizeof(int) * new_capacity);
+        if (!new_levels) {
+            fprintf(stderr, "メモリ割り当てエラー: 近傍探索のグラフを拡張できませんでした\n");
+            return false;
+        }
+        index->levels = new_levels;
+        int** new_links = (int**)realloc(index->links, sizeof(int*) * new_capacity);
+        if (!new_links) {
+            fprintf(stderr, "メモリ割り当てエラー: 近傍探索のグラフを拡張できませんでした\n");
+            return false;
+        }
+        index->links = new_links;
+        index->capacity = new_capacity;
+    }
+
+    int level = hnsw_random_level(index);
+    int* links = (int*)calloc((size_t)(index->m0 + 1) + (size_t)level * (index->m + 1), sizeof(int));
+    if (!links) {
+        fprintf(stderr, "メモリ割り当てエラー: 近傍探索のノードを追加できませんでした\n");
+        return false;
+    }
+    index->levels[node] = level;
+    index->links[node] = links;
+    index->count++;
+
+    if (index->entry_point < 0) {
+        index->entry_point = node;
+        index->max_level = level;
+        return true;
+    }
+
+    const float* query = HNSW_VECTOR(vectors, stride, node);
+    float entry_dist = hnsw_distance(index, vectors, stride, query, index->entry_point);
+    int entry = hnsw_greedy_descend(index, vectors, stride, query, index->entry_point, &entry_dist,
+                                    index->max_level, level);
+
+    HnswSearchContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int* selected = (int*)malloc(sizeof(int) * index->m0);
+    bool ok = selected != NULL;
+
+    for (int l = level < index->max_level ? level : index->max_level; ok && l >= 0; l--) {
+        if (!hnsw_search_layer(index, vectors, stride, query, entry, entry_dist, index->ef_construction, l, &ctx)) {
+            ok = false;
+            break;
+        }
+
+        // 結果を近い順に並べて近傍を選ぶ
+        HnswCandidate* found = ctx.results.items;
+        int found_count = ctx.results.count;
+        for (int i = 0; i < found_count; i++) {
+            found[i].dist = -found[i].dist;
+        }
+        qsort(found, found_count, sizeof(HnswCandidate), hnsw_compare_candidates);
+
+        int* own = hnsw_links(index, node, l);
+        own[0] = hnsw_select_neighbors(index, vectors, stride, found, found_count, index->m, selected);
+        memcpy(own + 1, selected, sizeof(int) * own[0]);
+
+        for (int i = 1; i <= own[0]; i++) {
+            if (!hnsw_connect(index, vectors, stride, own[i], node, l)) {
+                ok = false;
+                break;
+            }
+        }
+
+        // 次の層は最も近いノードから始める
+        entry = found[0].node;
+        entry_dist = found[0].dist;
+    }
+
+    free(selected);
+    hnsw_context_free(&ctx);
+
+    if (!ok) {
+        fprintf(stderr, "近傍探索のグラフにノードを追加できませんでした: %d\n", node);
+        return false;
+    }
+
+    if (level > index->max_level) {
+        index->entry_point = node;
+        index->max_level = level;
+    }
+    return true;
+}
+
+// クエリに近い上位k件を返す
+int hnsw_search(const HnswIndex* index, const float* vectors, size_t stride,
+                const float* query, int k, int ef, TopKItem* results) {
+    if (index->entry_point < 0 || k <= 0 || !results) {
+        return 0;
+    }
+
+    if (ef <= 0) {
+        ef = index->ef_search;
+    }
+    if (ef < k) {
+        ef = k;
+    }
+
+    float entry_dist = hnsw_distance(index, vectors, stride, query, index->entry_point);
+    int entry = hnsw_greedy_descend(index, vectors, stride, query, index->entry_point, &entry_dist,
+                                    index->max_level, 0);
+
+    HnswSearchContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    if (!hnsw_search_layer(index, vectors, stride, query, entry, entry_dist, ef, 0, &ctx)) {
+        hnsw_context_free(&ctx);
+        return 0;
+    }
+
+    TopKSelector selector;
+    top_k_init(&selector, results, k);
+    for (int i = 0; i < ctx.results.count; i++) {
+        int node = ctx.results.items[i].node;
+        top_k_push(&selector, ctx.results.items[i].dist, node, node);
+    }
+
+    hnsw_context_free(&ctx);
+    return top_k_finalize(&selector);
+}
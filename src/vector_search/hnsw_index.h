@@ -0,0 +1,51 @@
+#ifndef HNSW_INDEX_H
+#define HNSW_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "vector_distance.h"
+
+#define HNSW_DEFAULT_M 16                 // 上位層の近傍数（第0層はこの2倍）
+#define HNSW_DEFAULT_EF_CONSTRUCTION 100  // 追加時に調べる候補数
+// 検索時に調べる候補数（大きいほど再現率が上がり遅くなる）
+// クラスタ状の64次元ベクトルでは 25,000件で再現率 1.0（上位10件）だが、一様乱数のような構造のないベクトルでは
+// 30,000件で約0.89、100,000件で約0.77まで下がる。そうしたデータで高い再現率が要るときは 256〜400 に上げる
+#define HNSW_DEFAULT_EF_SEARCH 128
+#define HNSW_MAX_LEVEL 16                 // 層の上限
+
+// 近似最近傍探索のグラフ（HNSW: Hierarchical Navigable Small World）
+// ノード番号はベクトルの格納位置と同じで、ベクトル自体は呼び出し側の配列を参照する
+typedef struct {
+    int dim;                    // 次元数
+    int m;                      // 上位層の最大近傍数
+    int m0;                     // 第0層の最大近傍数
+    int ef_construction;
+    int ef_search;
+    double level_mult;          // 層を決める係数（1 / ln(m)）
+
+    int* levels;                // ノード → 最上位の層
+    int** links;                // ノード → 近傍リスト（各層が [個数, ID...] の並び、第0層が先頭）
+    int count;
+    int capacity;
+
+    int entry_point;            // 最上位の層にいる入口のノード（空なら -1）
+    int max_level;
+    uint64_t random_state;      // 層を決める乱数（rand() の系列を乱さないよう専用に持つ）
+} HnswIndex;
+
+// グラフを初期化（0 以下の値は既定値）
+bool hnsw_init(HnswIndex* index, int dim, int m, int ef_construction, int ef_search);
+
+// グラフを解放
+void hnsw_free(HnswIndex* index);
+
+// ノードを追加（node は index->count と同じ番号、vectors + node * stride バイトにベクトルがある）
+bool hnsw_insert(HnswIndex* index, const float* vectors, size_t stride, int node);
+
+// クエリに近い上位k件を返す（results は k 件分、スコアは距離の二乗の負値で降順に並ぶ）
+// ef は調べる候補数（0 以下なら index->ef_search）、複数スレッドから同時に呼べる
+int hnsw_search(const HnswIndex* index, const float* vectors, size_t stride,
+                const float* query, int k, int ef, TopKItem* results);
+
+#endif // HNSW_INDEX_H
@@ -0,0 +1,586 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "vector_distance.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define VECTOR_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+// 実装の関数表
+typedef struct {
+    VectorKernelLevel level;
+    const char* name;
+    float (*dot)(const float* a, const float* b, int dim);
+    float (*squared_distance)(const float* a, const float* b, int dim);
+    float (*dot_norm)(const float* a, const float* b, int dim, float* b_norm_squared);
+    float (*dot_int8)(const float* a, const int8_t* b, int dim);
+    float (*dot_norm_int8)(const float* a, const int8_t* b, int dim, float* b_norm_squared);
+} VectorKernels;
+
+// ---- 汎用のループ ----
+
+static float dot_scalar(const float* a, const float* b, int dim) {
+    float sum = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static float squared_distance_scalar(const float* a, const float* b, int dim) {
+    float sum = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+static float dot_norm_scalar(const float* a, const float* b, int dim, float* b_norm_squared) {
+    float dot = 0.0f;
+    float norm = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        dot += a[i] * b[i];
+        norm += b[i] * b[i];
+    }
+    *b_norm_squared = norm;
+    return dot;
+}
+
+static float dot_int8_scalar(const float* a, const int8_t* b, int dim) {
+    float sum = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        sum += a[i] * (float)b[i];
+    }
+    return sum;
+}
+
+static float dot_norm_int8_scalar(const float* a, const int8_t* b, int dim, float* b_norm_squared) {
+    float dot = 0.0f;
+    int norm = 0;
+    for (int i = 0; i < dim; i++) {
+        dot += a[i] * (float)b[i];
+        norm += b[i] * b[i];
+    }
+    *b_norm_squared = (float)norm;
+    return dot;
+}
+
+static const VectorKernels scalar_kernels = {
+    VECTOR_KERNEL_SCALAR, "scalar", dot_scalar, squared_distance_scalar, dot_norm_scalar,
+    dot_int8_scalar, dot_norm_int8_scalar
+};
+
+#ifdef VECTOR_KERNEL_X86
+
+// ---- SSE ----
+
+__attribute__((target("sse")))
+static inline float hsum_sse(__m128 v) {
+    __m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+
+__attribute__((target("sse")))
+static float dot_sse(const float* a, const float* b, int dim) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    float sum = hsum_sse(_mm_add_ps(acc0, acc1));
+    for (; i < dim; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("sse")))
+static float squared_distance_sse(const float* a, const float* b, int dim) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        __m128 d0 = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        __m128 d1 = _mm_sub_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4));
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(d0, d0));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(d1, d1));
+    }
+    float sum = hsum_sse(_mm_add_ps(acc0, acc1));
+    for (; i < dim; i++) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("sse")))
+static float dot_norm_sse(const float* a, const float* b, int dim, float* b_norm_squared) {
+    __m128 dot_acc = _mm_setzero_ps();
+    __m128 norm_acc = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= dim; i += 4) {
+        __m128 vb = _mm_loadu_ps(b + i);
+        dot_acc = _mm_add_ps(dot_acc, _mm_mul_ps(_mm_loadu_ps(a + i), vb));
+        norm_acc = _mm_add_ps(norm_acc, _mm_mul_ps(vb, vb));
+    }
+    float dot = hsum_sse(dot_acc);
+    float norm = hsum_sse(norm_acc);
+    for (; i < dim; i++) {
+        dot += a[i] * b[i];
+        norm += b[i] * b[i];
+    }
+    *b_norm_squared = norm;
+    return dot;
+}
+
+// int8 の符号拡張は SSE4.1 以降なので、SSE では汎用のループを使う
+static const VectorKernels sse_kernels = {
+    VECTOR_KERNEL_SSE, "sse", dot_sse, squared_distance_sse, dot_norm_sse,
+    dot_int8_scalar, dot_norm_int8_scalar
+};
+
+// ---- AVX2 + FMA ----
+
+__attribute__((target("avx2,fma")))
+static inline float hsum_avx(__m256 v) {
+    __m128 sums = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    __m128 shuf = _mm_movehdup_ps(sums);
+    sums = _mm_add_ps(sums, shuf);
+    shuf = _mm_movehl_ps(shuf, sums);
+    sums = _mm_add_ss(sums, shuf);
+    return _mm_cvtss_f32(sums);
+}
+
+__attribute__((target("avx2,fma")))
+static float dot_avx2(const float* a, const float* b, int dim) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    float sum = hsum_avx(_mm256_add_ps(acc0, acc1));
+    for (; i < dim; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static float squared_distance_avx2(const float* a, const float* b, int dim) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    }
+    float sum = hsum_avx(_mm256_add_ps(acc0, acc1));
+    for (; i < dim; i++) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static float dot_norm_avx2(const float* a, const float* b, int dim, float* b_norm_squared) {
+    __m256 dot_acc = _mm256_setzero_ps();
+    __m256 norm_acc = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        __m256 vb = _mm256_loadu_ps(b + i);
+        dot_acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), vb, dot_acc);
+        norm_acc = _mm256_fmadd_ps(vb, vb, norm_acc);
+    }
+    float dot = hsum_avx(dot_acc);
+    float norm = hsum_avx(norm_acc);
+    for (; i < dim; i++) {
+        dot += a[i] * b[i];
+        norm += b[i] * b[i];
+    }
+    *b_norm_squared = norm;
+    return dot;
+}
+
+// 8個の int8 を float に広げる
+__attribute__((target("avx2,fma")))
+static inline __m256 load_int8_avx2(const int8_t* b) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)b)));
+}
+
+__attribute__((target("avx2,fma")))
+static float dot_int8_avx2(const float* a, const int8_t* b, int dim) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), load_int8_avx2(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), load_int8_avx2(b + i + 8), acc1);
+    }
+    for (; i + 8 <= dim; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), load_int8_avx2(b + i), acc0);
+    }
+    float sum = hsum_avx(_mm256_add_ps(acc0, acc1));
+    for (; i < dim; i++) {
+        sum += a[i] * (float)b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static float dot_norm_int8_avx2(const float* a, const int8_t* b, int dim, float* b_norm_squared) {
+    __m256 dot_acc = _mm256_setzero_ps();
+    __m256 norm_acc = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        __m256 vb = load_int8_avx2(b + i);
+        dot_acc = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), vb, dot_acc);
+        norm_acc = _mm256_fmadd_ps(vb, vb, norm_acc);
+    }
+    float dot = hsum_avx(dot_acc);
+    float norm = hsum_avx(norm_acc);
+    for (; i < dim; i++) {
+        dot += a[i] * (float)b[i];
+        norm += (float)(b[i] * b[i]);
+    }
+    *b_norm_squared = norm;
+    return dot;
+}
+
+static const VectorKernels avx2_kernels = {
+    VECTOR_KERNEL_AVX2, "avx2", dot_avx2, squared_distance_avx2, dot_norm_avx2,
+    dot_int8_avx2, dot_norm_int8_avx2
+};
+
+// ---- AVX-512 ----
+
+__attribute__((target("avx512f")))
+static float dot_avx512(const float* a, const float* b, int dim) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= dim; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16), acc1);
+    }
+    for (; i + 16 <= dim; i += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), acc0);
+    }
+    if (i < dim) {
+        // 端数はマスク付きで読む
+        __mmask16 mask = (__mmask16)((1u << (dim - i)) - 1);
+        acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i), acc1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f")))
+static float squared_distance_avx512(const float* a, const float* b, int dim) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= dim; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 16 <= dim; i += 16) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+    }
+    if (i < dim) {
+        __mmask16 mask = (__mmask16)((1u << (dim - i)) - 1);
+        __m512 d1 = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + i), _mm512_maskz_loadu_ps(mask, b + i));
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+}
+
+__attribute__((target("avx512f")))
+static float dot_norm_avx512(const float* a, const float* b, int dim, float* b_norm_squared) {
+    __m512 dot_acc = _mm512_setzero_ps();
+    __m512 norm_acc = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m512 vb = _mm512_loadu_ps(b + i);
+        dot_acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), vb, dot_acc);
+        norm_acc = _mm512_fmadd_ps(vb, vb, norm_acc);
+    }
+    if (i < dim) {
+        __mmask16 mask = (__mmask16)((1u << (dim - i)) - 1);
+        __m512 vb = _mm512_maskz_loadu_ps(mask, b + i);
+        dot_acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), vb, dot_acc);
+        norm_acc = _mm512_fmadd_ps(vb, vb, norm_acc);
+    }
+    *b_norm_squared = _mm512_reduce_add_ps(norm_acc);
+    return _mm512_reduce_add_ps(dot_acc);
+}
+
+// 16個の int8 を float に広げる
+__attribute__((target("avx512f")))
+static inline __m512 load_int8_avx512(const int8_t* b) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepi8_epi32(_mm_loadu_si128((const __m128i*)b)));
+}
+
+__attribute__((target("avx512f")))
+static float dot_int8_avx512(const float* a, const int8_t* b, int dim) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 32 <= dim; i += 32) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), load_int8_avx512(b + i), acc0);
+        acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), load_int8_avx512(b + i + 16), acc1);
+    }
+    for (; i + 16 <= dim; i += 16) {
+        acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), load_int8_avx512(b + i), acc0);
+    }
+    float sum = _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+    for (; i < dim; i++) {
+        sum += a[i] * (float)b[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+static float dot_norm_int8_avx512(const float* a, const int8_t* b, int dim, float* b_norm_squared) {
+    __m512 dot_acc = _mm512_setzero_ps();
+    __m512 norm_acc = _mm512_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m512 vb = load_int8_avx512(b + i);
+        dot_acc = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), vb, dot_acc);
+        norm_acc = _mm512_fmadd_ps(vb, vb, norm_acc);
+    }
+    float dot = _mm512_reduce_add_ps(dot_acc);
+    float norm = _mm512_reduce_add_ps(norm_acc);
+    for (; i < dim; i++) {
+        dot += a[i] * (float)b[i];
+        norm += (float)(b[i] * b[i]);
+    }
+    *b_norm_squared = norm;
+    return dot;
+}
+
+static const VectorKernels avx512_kernels = {
+    VECTOR_KERNEL_AVX512, "avx512", dot_avx512, squared_distance_avx512, dot_norm_avx512,
+    dot_int8_avx512, dot_norm_int8_avx512
+};
+
+// CPUが対応している実装を返す（なければ NULL）
+static const VectorKernels* supported_kernels(VectorKernelLevel level) {
+    __builtin_cpu_init();
+    switch (level) {
+        case VECTOR_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f") ? &avx512_kernels : NULL;
+        case VECTOR_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? &avx2_kernels : NULL;
+        case VECTOR_KERNEL_SSE:
+            return __builtin_cpu_supports("sse") ? &sse_kernels : NULL;
+        case VECTOR_KERNEL_SCALAR:
+            return &scalar_kernels;
+    }
+    return NULL;
+}
+
+static const VectorKernels* kernels = &scalar_kernels;
+
+// 起動時に最も速い実装を選ぶ（スレッドが動き出す前に済ませる）
+__attribute__((constructor))
+static void vector_kernel_init(void) {
+    static const VectorKernelLevel order[] = { VECTOR_KERNEL_AVX512, VECTOR_KERNEL_AVX2, VECTOR_KERNEL_SSE };
+    for (int i = 0; i < (int)(sizeof(order) / sizeof(order[0])); i++) {
+        const VectorKernels* candidate = supported_kernels(order[i]);
+        if (candidate) {
+            kernels = candidate;
+            return;
+        }
+    }
+}
+
+#else
+
+static const VectorKernels* supported_kernels(VectorKernelLevel level) {
+    return level == VECTOR_KERNEL_SCALAR ? &scalar_kernels : NULL;
+}
+
+static const VectorKernels* kernels = &scalar_kernels;
+
+#endif // VECTOR_KERNEL_X86
+
+// 内積
+float vector_dot(const float* a, const float* b, int dim) {
+    return kernels->dot(a, b, dim);
+}
+
+// ユークリッド距離の二乗
+float vector_squared_distance(const float* a, const float* b, int dim) {
+    return kernels->squared_distance(a, b, dim);
+}
+
+// 内積と b のノルムの二乗を一度に計算
+float vector_dot_norm(const float* a, const float* b, int dim, float* b_norm_squared) {
+    return kernels->dot_norm(a, b, dim, b_norm_squared);
+}
+
+// float と int8 符号の内積
+float vector_dot_int8(const float* a, const int8_t* b, int dim) {
+    return kernels->dot_int8(a, b, dim);
+}
+
+// float と int8 符号の内積と、符号のノルムの二乗を一度に計算
+float vector_dot_norm_int8(const float* a, const int8_t* b, int dim, float* b_norm_squared) {
+    return kernels->dot_norm_int8(a, b, dim, b_norm_squared);
+}
+
+// int8 に量子化（行の最大絶対値を 127 に合わせ、復元係数を返す）
+float vector_quantize_int8(const float* vector, int dim, int8_t* code) {
+    float max_abs = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        float value = fabsf(vector[i]);
+        if (value > max_abs) {
+            max_abs = value;
+        }
+    }
+    if (max_abs == 0.0f) {
+        memset(code, 0, (size_t)dim);
+        return 0.0f;
+    }
+    
+    float scale = max_abs / 127.0f;
+    float inverse = 127.0f / max_abs;
+    for (int i = 0; i < dim; i++) {
+        long value = lrintf(vector[i] * inverse);
+        code[i] = (int8_t)(value > 127 ? 127 : (value < -127 ? -127 : value));
+    }
+    return scale;
+}
+
+// ノルムの二乗
+float vector_norm_squared(const float* a, int dim) {
+    return kernels->dot(a, a, dim);
+}
+
+// 単位ベクトル（またはゼロベクトル）か
+bool vector_is_unit(const float* a, int dim) {
+    float norm = vector_norm_squared(a, dim);
+    return norm == 0.0f || fabsf(norm - 1.0f) <= VECTOR_UNIT_EPSILON;
+}
+
+// 使用中の実装
+VectorKernelLevel vector_kernel_level(void) {
+    return kernels->level;
+}
+
+// 実装名
+const char* vector_kernel_name(void) {
+    return kernels->name;
+}
+
+// 実装を切り替える
+bool vector_kernel_select(VectorKernelLevel level) {
+    const VectorKernels* candidate = supported_kernels(level);
+    if (!candidate) {
+        return false;
+    }
+    kernels = candidate;
+    return true;
+}
+
+// a が b より悪い候補か（スコアが低い、同じなら後に見たもの）
+static inline bool top_k_worse(const TopKItem* a, const TopKItem* b) {
+    return a->score < b->score || (a->score == b->score && a->order > b->order);
+}
+
+// 根から下へたどってヒープの性質を戻す
+static void top_k_sift_down(TopKItem* items, int count, int index) {
+    TopKItem item = items[index];
+    for (;;) {
+        int child = index * 2 + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && top_k_worse(&items[child + 1], &items[child])) {
+            child++;
+        }
+        if (!top_k_worse(&items[child], &item)) {
+            break;
+        }
+        items[index] = items[child];
+        index = child;
+    }
+    items[index] = item;
+}
+
+// 選択器を初期化
+void top_k_init(TopKSelector* selector, TopKItem* items, int k) {
+    selector->items = items;
+    selector->count = 0;
+    selector->capacity = k > 0 ? k : 0;
+}
+
+// 候補を追加
+void top_k_push(TopKSelector* selector, float score, int id, int order) {
+    TopKItem item = { score, id, order };
+    TopKItem* items = selector->items;
+
+    if (selector->count < selector->capacity) {
+        // 葉に置いて上へたどる
+        int index = selector->count++;
+        while (index > 0) {
+            int parent = (index - 1) / 2;
+            if (!top_k_worse(&item, &items[parent])) {
+                break;
+            }
+            items[index] = items[parent];
+            index = parent;
+        }
+        items[index] = item;
+        return;
+    }
+
+    // 最下位（根）より良ければ入れ替える
+    if (selector->capacity > 0 && top_k_worse(&items[0], &item)) {
+        items[0] = item;
+        top_k_sift_down(items, selector->count, 0);
+    }
+}
+
+// 最下位のスコア
+float top_k_threshold(const TopKSelector* selector) {
+    if (selector->count < selector->capacity || selector->capacity == 0) {
+        return -FLT_MAX;
+    }
+    return selector->items[0].score;
+}
+
+// スコアの降順に並べる（最下位を末尾へ順に移すヒープソート）
+int top_k_finalize(TopKSelector* selector) {
+    TopKItem* items = selector->items;
+    for (int end = selector->count - 1; end > 0; end--) {
+        TopKItem worst = items[0];
+        items[0] = items[end];
+        items[end] = worst;
+        top_k_sift_down(items, end, 0);
+    }
+    return selector->count;
+}
@@ -0,0 +1,81 @@
+#ifndef VECTOR_DISTANCE_H
+#define VECTOR_DISTANCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 距離計算の実装（実行時にCPUが対応する最も速いものを選ぶ）
+typedef enum {
+    VECTOR_KERNEL_SCALAR = 0,   // 汎用のループ
+    VECTOR_KERNEL_SSE,          // SSE（4要素ずつ）
+    VECTOR_KERNEL_AVX2,         // AVX2 + FMA（8要素ずつ）
+    VECTOR_KERNEL_AVX512        // AVX-512（16要素ずつ）
+} VectorKernelLevel;
+
+// 正規化済みとみなすノルムの二乗の許容誤差
+#define VECTOR_UNIT_EPSILON 1e-4f
+
+// 内積
+float vector_dot(const float* a, const float* b, int dim);
+
+// ユークリッド距離の二乗
+float vector_squared_distance(const float* a, const float* b, int dim);
+
+// 内積と b のノルムの二乗を一度に計算（クエリのノルムを先に求めておくコサイン類似度用）
+float vector_dot_norm(const float* a, const float* b, int dim, float* b_norm_squared);
+
+// ノルムの二乗
+float vector_norm_squared(const float* a, int dim);
+
+// int8 に量子化（各要素を 復元係数 × 符号 で近似する、戻り値は復元係数）
+// 係数は行の最大絶対値 / 127 で、ゼロベクトルなら 0
+float vector_quantize_int8(const float* vector, int dim, int8_t* code);
+
+// float と int8 符号の内積（復元係数は掛けていない）
+// クエリは float のまま量子化した行と比べる（非対称な距離計算）
+float vector_dot_int8(const float* a, const int8_t* b, int dim);
+
+// float と int8 符号の内積と、符号のノルムの二乗を一度に計算
+float vector_dot_norm_int8(const float* a, const int8_t* b, int dim, float* b_norm_squared);
+
+// 単位ベクトル（またはゼロベクトル）か
+// どちらも内積がそのままコサイン類似度になる
+bool vector_is_unit(const float* a, int dim);
+
+// 使用中の実装
+VectorKernelLevel vector_kernel_level(void);
+
+// 実装名（"avx512" など）
+const char* vector_kernel_name(void);
+
+// 実装を切り替える（CPUが対応していなければ false、比較や計測用）
+bool vector_kernel_select(VectorKernelLevel level);
+
+// 上位k件の候補
+typedef struct {
+    float score;    // スコア（大きいほど良い）
+    int id;         // エントリのID
+    int order;      // 走査順（同じスコアなら先に見たものを優先）
+} TopKItem;
+
+// 上位k件の選択器（呼び出し側が用意した k 件分の領域を最小ヒープとして使う）
+typedef struct {
+    TopKItem* items;
+    int count;
+    int capacity;
+} TopKSelector;
+
+// 選択器を初期化（items は k 件分）
+void top_k_init(TopKSelector* selector, TopKItem* items, int k);
+
+// 候補を追加（k 件そろった後は最下位より良いときだけ入れ替える）
+void top_k_push(TopKSelector* selector, float score, int id, int order);
+
+// 最下位のスコア（k 件そろうまでは -FLT_MAX）
+// 走査側はこれ以下の候補を追加しなくてよい
+float top_k_threshold(const TopKSelector* selector);
+
+// スコアの降順（同じなら走査順）に並べ、件数を返す
+int top_k_finalize(TopKSelector* selector);
+
+#endif // VECTOR_DISTANCE_H
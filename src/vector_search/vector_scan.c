@@ -0,0 +1,460 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include "vector_scan.h"
+
+// 分割した行の範囲を1つ処理する関数
+typedef void (*ScanTask)(void* job, int shard);
+
+// 走査用のスレッドプール（呼び出し元も分割の1つを受け持つ）
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    pthread_mutex_t dispatch;               // 同時に流すジョブは1つだけ（使用中なら呼び出し元で走査する）
+    pthread_t workers[VECTOR_SCAN_MAX_THREADS];
+    int worker_count;
+    int thread_count;                       // 設定されたスレッド数（0 ならCPU数）
+    unsigned long generation;               // ジョブを流すたびに増える
+    ScanTask task;
+    void* job;
+    int shard_count;
+    int next_shard;
+    int pending;                            // 終わっていない分割の数
+    bool stopping;
+} scan_pool = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .work_ready = PTHREAD_COND_INITIALIZER,
+    .work_done = PTHREAD_COND_INITIALIZER,
+    .dispatch = PTHREAD_MUTEX_INITIALIZER
+};
+
+// 1回の走査（分割ごとの結果を shard_results に置き、最後にまとめる）
+typedef struct {
+    const VectorScanSource* source;
+    VectorMetric metric;
+    const float* queries;
+    int query_count;
+    int k;
+    bool quantized;                         // int8 符号で走査する
+    int shard_count;
+    TopKItem* shard_results;                // 分割 × クエリ × k 件
+    int* shard_counts;                      // 分割 × クエリ
+} ScanJob;
+
+// 残っている分割を取って処理する（mutex を保持した状態で呼ぶ）
+static void scan_pool_run_shards(void) {
+    while (scan_pool.next_shard < scan_pool.shard_count) {
+        int shard = scan_pool.next_shard++;
+        ScanTask task = scan_pool.task;
+        void* job = scan_pool.job;
+
+        pthread_mutex_unlock(&scan_pool.mutex);
+        task(job, shard);
+        pthread_mutex_lock(&scan_pool.mutex);
+
+        if (--scan_pool.pending == 0) {
+            pthread_cond_broadcast(&scan_pool.work_done);
+        }
+    }
+}
+
+// ワーカースレッド
+static void* scan_worker_main(void* arg) {
+    (void)arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&scan_pool.mutex);
+    for (;;) {
+        while (!scan_pool.stopping && scan_pool.generation == seen) {
+            pthread_cond_wait(&scan_pool.work_ready, &scan_pool.mutex);
+        }
+        if (scan_pool.stopping) {
+            break;
+        }
+        // 途中から加わった場合も残りの分割だけを取るので安全
+        seen = scan_pool.generation;
+        scan_pool_run_shards();
+    }
+    pthread_mutex_unlock(&scan_pool.mutex);
+    return NULL;
+}
+
+// 設定されたスレッド数（mutex を保持した状態で呼ぶ）
+static int scan_pool_thread_count(void) {
+    int threads = scan_pool.thread_count;
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    return threads < VECTOR_SCAN_MAX_THREADS ? threads : VECTOR_SCAN_MAX_THREADS;
+}
+
+// ワーカーがいなければ作る（mutex を保持した状態で呼ぶ）
+static void scan_pool_start(void) {
+    int wanted = scan_pool_thread_count() - 1;
+    if (scan_pool.worker_count > 0 || wanted <= 0) {
+        return;
+    }
+
+    // シグナルは呼び出し元のスレッドで受け取るよう、ワーカーではブロックする
+    sigset_t block_set;
+    sigset_t old_set;
+    sigfillset(&block_set);
+    pthread_sigmask(SIG_BLOCK, &block_set, &old_set);
+
+    while (scan_pool.worker_count < wanted) {
+        if (pthread_create(&scan_pool.workers[scan_pool.worker_count], NULL, scan_worker_main, NULL) != 0) {
+            fprintf(stderr, "ベクトル走査用のスレッドを作成できませんでした\n");
+            break;
+        }
+        scan_pool.worker_count++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+}
+
+// 分割をスレッドプールで処理する（プールが使えなければ呼び出し元で順に処理する）
+static void scan_pool_run(ScanTask task, void* job, int shard_count) {
+    if (shard_count > 1 && pthread_mutex_trylock(&scan_pool.dispatch) == 0) {
+        pthread_mutex_lock(&scan_pool.mutex);
+        scan_pool_start();
+        if (scan_pool.worker_count > 0) {
+            scan_pool.task = task;
+            scan_pool.job = job;
+            scan_pool.shard_count = shard_count;
+            scan_pool.next_shard = 0;
+            scan_pool.pending = shard_count;
+            scan_pool.generation++;
+            pthread_cond_broadcast(&scan_pool.work_ready);
+
+            scan_pool_run_shards();
+            while (scan_pool.pending > 0) {
+                pthread_cond_wait(&scan_pool.work_done, &scan_pool.mutex);
+            }
+
+            pthread_mutex_unlock(&scan_pool.mutex);
+            pthread_mutex_unlock(&scan_pool.dispatch);
+            return;
+        }
+        pthread_mutex_unlock(&scan_pool.mutex);
+        pthread_mutex_unlock(&scan_pool.dispatch);
+    }
+
+    for (int shard = 0; shard < shard_count; shard++) {
+        task(job, shard);
+    }
+}
+
+// 行のスコア（大きいほど良い、ユークリッド距離は平方根を取る前の二乗の負値）
+static inline float scan_score(const VectorScanSource* source, VectorMetric metric,
+                               const float* query, float query_scale, const float* row) {
+    if (metric == VECTOR_METRIC_EUCLIDEAN) {
+        return -vector_squared_distance(query, row, source->dim);
+    }
+    if (source->normalized) {
+        // 全行が単位ベクトルなら内積だけでよい
+        return vector_dot(query, row, source->dim) * query_scale;
+    }
+
+    float row_norm = 0.0f;
+    float dot_product = vector_dot_norm(query, row, source->dim, &row_norm);
+    if (query_scale == 0.0f || row_norm == 0.0f) {
+        return 0.0f;
+    }
+    return dot_product * query_scale / sqrtf(row_norm);
+}
+
+// int8 符号の行のスコア（再計算の候補を選ぶための近似値）
+static inline float scan_score_int8(const VectorScanSource* source, VectorMetric metric,
+                                    const float* query, float query_scale, int row) {
+    const int8_t* code = source->codes + (size_t)row * source->dim;
+    float scale = source->code_scales[row];
+    if (metric == VECTOR_METRIC_EUCLIDEAN) {
+        // |q - s c|^2 = |q|^2 - 2 s (q・c) + s^2 |c|^2 のうち、行によらない |q|^2 を除いた負値
+        float code_norm = 0.0f;
+        float dot_product = vector_dot_norm_int8(query, code, source->dim, &code_norm);
+        return scale * (2.0f * dot_product - scale * code_norm);
+    }
+    if (source->normalized) {
+        return vector_dot_int8(query, code, source->dim) * scale * query_scale;
+    }
+
+    // 復元係数は分子と分母で打ち消し合う
+    float code_norm = 0.0f;
+    float dot_product = vector_dot_norm_int8(query, code, source->dim, &code_norm);
+    if (query_scale == 0.0f || code_norm == 0.0f) {
+        return 0.0f;
+    }
+    return dot_product * query_scale / sqrtf(code_norm);
+}
+
+// [begin, end) の行を全クエリで走査する（results はクエリ × k 件、counts はクエリごとの件数）
+static void scan_rows(const ScanJob* job, int begin, int end, TopKItem* results, int* counts) {
+    const VectorScanSource* source = job->source;
+    int dim = source->dim;
+    int k = job->k;
+
+    for (int query_begin = 0; query_begin < job->query_count; query_begin += VECTOR_SCAN_BLOCK_QUERIES) {
+        int query_block = job->query_count - query_begin;
+        if (query_block > VECTOR_SCAN_BLOCK_QUERIES) {
+            query_block = VECTOR_SCAN_BLOCK_QUERIES;
+        }
+
+        TopKSelector selectors[VECTOR_SCAN_BLOCK_QUERIES];
+        float query_scales[VECTOR_SCAN_BLOCK_QUERIES];
+        for (int q = 0; q < query_block; q++) {
+            top_k_init(&selectors[q], results + (size_t)(query_begin + q) * k, k);
+
+            // クエリのノルムは一度だけ求める
+            float query_norm = 0.0f;
+            if (job->metric == VECTOR_METRIC_COSINE) {
+                query_norm = sqrtf(vector_norm_squared(job->queries + (size_t)(query_begin + q) * dim, dim));
+            }
+            query_scales[q] = query_norm > 0.0f ? 1.0f / query_norm : 0.0f;
+        }
+
+        // 行ブロックがキャッシュにある間にクエリのブロックをすべて当てる
+        for (int row_begin = begin; row_begin < end; row_begin += VECTOR_SCAN_BLOCK_ROWS) {
+            int row_end = row_begin + VECTOR_SCAN_BLOCK_ROWS < end ? row_begin + VECTOR_SCAN_BLOCK_ROWS : end;
+
+            for (int q = 0; q < query_block; q++) {
+                const float* query = job->queries + (size_t)(query_begin + q) * dim;
+                TopKSelector* selector = &selectors[q];
+
+                // 走査順に見るので、最下位と同じスコアは後から来た方が負ける
+                if (job->quantized) {
+                    for (int i = row_begin; i < row_end; i++) {
+                        float score = scan_score_int8(source, job->metric, query, query_scales[q], i);
+                        if (selector->count < selector->capacity || score > top_k_threshold(selector)) {
+                            top_k_push(selector, score, source->ids[i], i);
+                        }
+                    }
+                } else {
+                    const float* row = source->vectors + (size_t)row_begin * dim;
+                    for (int i = row_begin; i < row_end; i++, row += dim) {
+                        float score = scan_score(source, job->metric, query, query_scales[q], row);
+                        if (selector->count < selector->capacity || score > top_k_threshold(selector)) {
+                            top_k_push(selector, score, source->ids[i], i);
+                        }
+                    }
+                }
+            }
+        }
+
+        for (int q = 0; q < query_block; q++) {
+            counts[query_begin + q] = top_k_finalize(&selectors[q]);
+        }
+    }
+}
+
+// 分割 shard の行を走査する
+static void scan_shard(void* arg, int shard) {
+    const ScanJob* job = (const ScanJob*)arg;
+    int count = job->source->count;
+    int begin = (int)((long long)count * shard / job->shard_count);
+    int end = (int)((long long)count * (shard + 1) / job->shard_count);
+
+    scan_rows(job, begin, end,
+              job->shard_results + (size_t)shard * job->query_count * job->k,
+              job->shard_counts + (size_t)shard * job->query_count);
+}
+
+// 行数とクエリ数から分割数を決める
+static int scan_shard_count(int rows, int query_count) {
+    // クエリが多いほど1行あたりの仕事が増えるので、少ない行でも分ける
+    int min_rows = VECTOR_SCAN_MIN_SHARD_ROWS / query_count;
+    if (min_rows < VECTOR_SCAN_BLOCK_ROWS) {
+        min_rows = VECTOR_SCAN_BLOCK_ROWS;
+    }
+
+    int shards = rows / min_rows;
+    int threads = vector_scan_threads();
+    if (shards > threads) {
+        shards = threads;
+    }
+    return shards > 1 ? shards : 1;
+}
+
+// 全行を走査して上位k件を求める（ユークリッド距離のスコアは距離の二乗の負値のまま）
+static bool scan_top_k(const VectorScanSource* source, VectorMetric metric, const float* queries, int query_count,
+                       int k, bool quantized, TopKItem* results, int* result_counts) {
+    ScanJob job;
+    job.source = source;
+    job.metric = metric;
+    job.queries = queries;
+    job.query_count = query_count;
+    job.k = k;
+    job.quantized = quantized;
+    job.shard_count = scan_shard_count(source->count, query_count);
+    job.shard_results = NULL;
+    job.shard_counts = NULL;
+
+    if (job.shard_count > 1) {
+        job.shard_results = (TopKItem*)malloc(sizeof(TopKItem) * (size_t)job.shard_count * query_count * k);
+        job.shard_counts = (int*)malloc(sizeof(int) * (size_t)job.shard_count * query_count);
+        if (!job.shard_results || !job.shard_counts) {
+            // 分割用の領域が取れなければ呼び出し元だけで走査する
+            free(job.shard_results);
+            free(job.shard_counts);
+            job.shard_count = 1;
+        }
+    }
+
+    if (job.shard_count == 1) {
+        scan_rows(&job, 0, source->count, results, result_counts);
+        return true;
+    }
+
+    scan_pool_run(scan_shard, &job, job.shard_count);
+
+    // 分割ごとの上位k件をまとめる（行番号が同じスコアの順位を決めるので、1スレッドで走査した結果と一致する）
+    for (int q = 0; q < query_count; q++) {
+        TopKSelector selector;
+        top_k_init(&selector, results + (size_t)q * k, k);
+        for (int shard = 0; shard < job.shard_count; shard++) {
+            const TopKItem* items = job.shard_results + ((size_t)shard * query_count + q) * k;
+            int count = job.shard_counts[(size_t)shard * query_count + q];
+            for (int i = 0; i < count; i++) {
+                top_k_push(&selector, items[i].score, items[i].id, items[i].order);
+            }
+        }
+        result_counts[q] = top_k_finalize(&selector);
+    }
+
+    free(job.shard_results);
+    free(job.shard_counts);
+    return true;
+}
+
+// int8 符号で候補を多めに選び、float の行で計算し直して上位k件を求める
+static bool scan_top_k_reranked(const VectorScanSource* source, VectorMetric metric, const float* queries,
+                                int query_count, int k, TopKItem* results, int* result_counts) {
+    int candidate_count = k * VECTOR_SCAN_RERANK_FACTOR;
+    if (candidate_count < VECTOR_SCAN_RERANK_MIN) {
+        candidate_count = VECTOR_SCAN_RERANK_MIN;
+    }
+    if (candidate_count > source->count) {
+        candidate_count = source->count;
+    }
+
+    TopKItem* candidates = (TopKItem*)malloc(sizeof(TopKItem) * (size_t)query_count * candidate_count);
+    int* candidate_counts = (int*)malloc(sizeof(int) * (size_t)query_count);
+    if (!candidates || !candidate_counts) {
+        // 候補の領域が取れなければ float の行をそのまま走査する
+        free(candidates);
+        free(candidate_counts);
+        return scan_top_k(source, metric, queries, query_count, k, false, results, result_counts);
+    }
+
+    scan_top_k(source, metric, queries, query_count, candidate_count, true, candidates, candidate_counts);
+
+    int dim = source->dim;
+    for (int q = 0; q < query_count; q++) {
+        const float* query = queries + (size_t)q * dim;
+        float query_norm = metric == VECTOR_METRIC_COSINE ? sqrtf(vector_norm_squared(query, dim)) : 0.0f;
+        float query_scale = query_norm > 0.0f ? 1.0f / query_norm : 0.0f;
+
+        TopKSelector selector;
+        top_k_init(&selector, results + (size_t)q * k, k);
+        const TopKItem* items = candidates + (size_t)q * candidate_count;
+        for (int i = 0; i < candidate_counts[q]; i++) {
+            const float* row = source->vectors + (size_t)items[i].order * dim;
+            top_k_push(&selector, scan_score(source, metric, query, query_scale, row), items[i].id, items[i].order);
+        }
+        result_counts[q] = top_k_finalize(&selector);
+    }
+
+    free(candidates);
+    free(candidate_counts);
+    return true;
+}
+
+// 複数クエリの上位k件を一度の走査で求める
+bool vector_scan_batch_top_k(const VectorScanSource* source, VectorMetric metric,
+                             const float* queries, int query_count, int k,
+                             TopKItem* results, int* result_counts) {
+    if (!source || !queries || !results || !result_counts || query_count < 0) {
+        return false;
+    }
+    if (source->count <= 0 || k <= 0 || query_count == 0) {
+        for (int q = 0; q < query_count; q++) {
+            result_counts[q] = 0;
+        }
+        return true;
+    }
+
+    bool ok = source->codes
+        ? scan_top_k_reranked(source, metric, queries, query_count, k, results, result_counts)
+        : scan_top_k(source, metric, queries, query_count, k, false, results, result_counts);
+
+    // 残った k 件だけ平方根を取る
+    if (ok && metric == VECTOR_METRIC_EUCLIDEAN) {
+        for (int q = 0; q < query_count; q++) {
+            TopKItem* items = results + (size_t)q * k;
+            for (int i = 0; i < result_counts[q]; i++) {
+                items[i].score = -sqrtf(-items[i].score);
+            }
+        }
+    }
+
+    return ok;
+}
+
+// クエリに近い上位k件を全件走査で求める
+int vector_scan_top_k(const VectorScanSource* source, VectorMetric metric,
+                      const float* query, int k, TopKItem* results) {
+    int count = 0;
+    if (!vector_scan_batch_top_k(source, metric, query, 1, k, results, &count)) {
+        return 0;
+    }
+    return count;
+}
+
+// 走査に使うスレッド数
+int vector_scan_threads(void) {
+    pthread_mutex_lock(&scan_pool.mutex);
+    int threads = scan_pool_thread_count();
+    pthread_mutex_unlock(&scan_pool.mutex);
+    return threads;
+}
+
+// ワーカーを止めて待つ（dispatch を保持した状態で呼ぶ）
+static void scan_pool_stop(void) {
+    pthread_mutex_lock(&scan_pool.mutex);
+    int worker_count = scan_pool.worker_count;
+    scan_pool.stopping = true;
+    pthread_cond_broadcast(&scan_pool.work_ready);
+    pthread_mutex_unlock(&scan_pool.mutex);
+
+    for (int i = 0; i < worker_count; i++) {
+        pthread_join(scan_pool.workers[i], NULL);
+    }
+
+    pthread_mutex_lock(&scan_pool.mutex);
+    scan_pool.worker_count = 0;
+    scan_pool.stopping = false;
+    pthread_mutex_unlock(&scan_pool.mutex);
+}
+
+// 走査に使うスレッド数を設定
+void vector_scan_set_threads(int threads) {
+    pthread_mutex_lock(&scan_pool.dispatch);
+    scan_pool_stop();
+    pthread_mutex_lock(&scan_pool.mutex);
+    scan_pool.thread_count = threads > 0 ? threads : 0;
+    pthread_mutex_unlock(&scan_pool.mutex);
+    pthread_mutex_unlock(&scan_pool.dispatch);
+}
+
+// 走査用のスレッドを止める
+void vector_scan_shutdown(void) {
+    pthread_mutex_lock(&scan_pool.dispatch);
+    scan_pool_stop();
+    pthread_mutex_unlock(&scan_pool.dispatch);
+}
@@ -0,0 +1,53 @@
+#ifndef VECTOR_SCAN_H
+#define VECTOR_SCAN_H
+
+#include <stdbool.h>
+#include "vector_distance.h"
+
+#define VECTOR_SCAN_MAX_THREADS 64          // スレッド数の上限
+#define VECTOR_SCAN_MIN_SHARD_ROWS 8192     // 1スレッドに任せる最小の行数（クエリ1件あたり）
+#define VECTOR_SCAN_BLOCK_ROWS 128          // まとめて読む行数（64次元で32KB、L1/L2に収まる大きさ）
+#define VECTOR_SCAN_BLOCK_QUERIES 16        // 同じ行ブロックに当てるクエリ数
+#define VECTOR_SCAN_RERANK_FACTOR 4         // int8 で走査するとき、k の何倍の候補を float で再計算するか
+#define VECTOR_SCAN_RERANK_MIN 32           // 再計算する候補の最小数
+
+// 距離の種類
+typedef enum {
+    VECTOR_METRIC_EUCLIDEAN = 0,    // スコアは距離の負値
+    VECTOR_METRIC_COSINE            // スコアはコサイン類似度
+} VectorMetric;
+
+// 走査するベクトルの集まり（行列は count × dim で行は連続）
+// codes があれば int8 符号で候補を絞り、上位の候補だけ vectors で計算し直す（スコアは float で計算した値になる）
+typedef struct {
+    const float* vectors;
+    const int* ids;                 // 行番号 → ID
+    int count;
+    int dim;
+    bool normalized;                // 全行が単位ベクトルか（コサイン類似度を内積で計算できる）
+    const int8_t* codes;            // count × dim の int8 符号（なければ NULL）
+    const float* code_scales;       // 行ごとの復元係数
+} VectorScanSource;
+
+// クエリに近い上位k件を全件走査で求める（results は k 件分、件数を返す）
+// 行が多ければ複数スレッドに分けて走査し、各スレッドの上位k件をまとめる
+int vector_scan_top_k(const VectorScanSource* source, VectorMetric metric,
+                      const float* query, int k, TopKItem* results);
+
+// 複数クエリの上位k件を一度の走査で求める（queries は query_count × dim）
+// results は query_count × k 件分で、クエリ q の結果は results + q * k、件数は result_counts[q] に入る
+// 行をブロックごとに読み、同じブロックを複数クエリで使い回す
+bool vector_scan_batch_top_k(const VectorScanSource* source, VectorMetric metric,
+                             const float* queries, int query_count, int k,
+                             TopKItem* results, int* result_counts);
+
+// 走査に使うスレッド数（呼び出し元を含む）
+int vector_scan_threads(void);
+
+// 走査に使うスレッド数を設定（0 以下ならCPU数、1 なら常に呼び出し元だけで走査）
+void vector_scan_set_threads(int threads);
+
+// 走査用のスレッドを止める（次の走査で必要なら作り直す）
+void vector_scan_shutdown(void);
+
+#endif // VECTOR_SCAN_H
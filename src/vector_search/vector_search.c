@@ -1,14 +1,47 @@
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <time.h>
 #include <float.h>
+#include <sys/mman.h>
 #include "vector_search.h"
+#include "vector_distance.h"
+#include "vector_scan.h"
+
+#define WORD_ARENA_INITIAL_SIZE 65536
+#define WORD_BUCKETS_INITIAL_COUNT 1024
 
 // ベクトルデータベースの初期化
 void init_vector_db(VectorDB* db) {
+    db->vectors = NULL;
+    db->ids = NULL;
     db->size = 0;
+    db->capacity = 0;
+    db->normalized = true;
+    db->storage = VECTOR_STORAGE_FLOAT;
+    db->codes = NULL;
+    db->code_scales = NULL;
+    db->mapping = NULL;
+    db->mapping_size = 0;
+    memset(&db->words, 0, sizeof(WordDictionary));
+}
+
+// ベクトルデータベースの解放（空の状態に戻るので、そのまま再利用できる）
+void free_vector_db(VectorDB* db) {
+    if (db->mapping) {
+        munmap(db->mapping, db->mapping_size);
+    } else {
+        free(db->vectors);
+    }
+    free(db->ids);
+    free(db->codes);
+    free(db->code_scales);
+    free(db->words.arena);
+    free(db->words.word_offsets);
+    free(db->words.buckets);
+    init_vector_db(db);
 }
 
 // ベクトルデータベースのサイズを取得
@@ -16,43 +49,378 @@ int get_vector_db_size(VectorDB* db) {
     return db->size;
 }
 
+// 確保済みのベクトル数を取得
+int get_vector_db_capacity(VectorDB* db) {
+    return db->capacity;
+}
+
+// ベクトル行列とID配列（int8 なら符号も）を capacity 個分に付け替える（capacity >= size）
+static int resize_vector_db(VectorDB* db, int capacity) {
+    float* vectors = NULL;
+    if (capacity > 0 &&
+        posix_memalign((void**)&vectors, VECTOR_DB_ALIGNMENT, sizeof(float) * VECTOR_DIM * (size_t)capacity) != 0) {
+        fprintf(stderr, "メモリ割り当てエラー: ベクトルデータベースを拡張できませんでした\n");
+        return 0;
+    }
+    size_t rows = capacity > 0 ? (size_t)capacity : 1;
+    int* ids = (int*)realloc(db->ids, sizeof(int) * rows);
+    if (ids) {
+        db->ids = ids;
+    }
+    bool ok = ids != NULL;
+    if (ok && db->storage == VECTOR_STORAGE_INT8) {
+        int8_t* codes = (int8_t*)realloc(db->codes, VECTOR_DIM * rows);
+        if (codes) {
+            db->codes = codes;
+        }
+        float* code_scales = codes ? (float*)realloc(db->code_scales, sizeof(float) * rows) : NULL;
+        if (code_scales) {
+            db->code_scales = code_scales;
+        }
+        ok = code_scales != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "メモリ割り当てエラー: ベクトルデータベースを拡張できませんでした\n");
+        free(vectors);
+        // 付け替えた配列は capacity 個以上あるので、縮める途中なら容量だけ合わせる
+        if (ids && capacity < db->capacity) {
+            db->capacity = capacity;
+        }
+        return 0;
+    }
+    
+    // 行列は境界を保つため確保し直して移す（mmap 領域にあった行もここで手元に移る）
+    if (db->size > 0) {
+        memcpy(vectors, db->vectors, sizeof(float) * VECTOR_DIM * (size_t)db->size);
+    }
+    if (db->mapping) {
+        munmap(db->mapping, db->mapping_size);
+        db->mapping = NULL;
+        db->mapping_size = 0;
+    } else {
+        free(db->vectors);
+    }
+    db->vectors = vectors;
+    db->capacity = capacity;
+    return 1;
+}
+
+// 少なくとも capacity 個のベクトルを入れられるように確保
+int reserve_vector_db(VectorDB* db, int capacity) {
+    if (capacity <= db->capacity) {
+        return 1;
+    }
+    return resize_vector_db(db, capacity);
+}
+
+// 確保済みの領域を現在のベクトル数まで縮める
+int shrink_vector_db(VectorDB* db) {
+    if (db->capacity == db->size) {
+        return 1;
+    }
+    return resize_vector_db(db, db->size);
+}
+
+// エントリのベクトル
+const float* get_vector(const VectorDB* db, int index) {
+    return db->vectors + (size_t)index * VECTOR_DIM;
+}
+
+// ベクトルの持ち方を切り替える
+int set_vector_db_storage(VectorDB* db, VectorStorage storage) {
+    if (storage == db->storage) {
+        return 1;
+    }
+    
+    if (storage == VECTOR_STORAGE_FLOAT) {
+        // mmap 領域の行は手元に移してから符号を捨てる
+        if (db->mapping && !resize_vector_db(db, db->capacity)) {
+            return 0;
+        }
+        free(db->codes);
+        free(db->code_scales);
+        db->codes = NULL;
+        db->code_scales = NULL;
+        db->storage = VECTOR_STORAGE_FLOAT;
+        return 1;
+    }
+    
+    size_t rows = db->capacity > 0 ? (size_t)db->capacity : 1;
+    int8_t* codes = (int8_t*)malloc(VECTOR_DIM * rows);
+    float* code_scales = (float*)malloc(sizeof(float) * rows);
+    if (!codes || !code_scales) {
+        fprintf(stderr, "メモリ割り当てエラー: int8 符号の領域を確保できませんでした\n");
+        free(codes);
+        free(code_scales);
+        return 0;
+    }
+    for (int i = 0; i < db->size; i++) {
+        code_scales[i] = vector_quantize_int8(get_vector(db, i), VECTOR_DIM, codes + (size_t)i * VECTOR_DIM);
+    }
+    db->codes = codes;
+    db->code_scales = code_scales;
+    db->storage = VECTOR_STORAGE_INT8;
+    return 1;
+}
+
+// ファイルの mmap 領域にある float の行列をコピーせずに使う
+int map_vector_db(VectorDB* db, void* mapping, size_t mapping_size, const float* vectors, const int32_t* ids,
+                  const int8_t* codes, const float* code_scales, int count, bool normalized) {
+    if (db->size != 0 || db->storage != VECTOR_STORAGE_INT8 || db->mapping || count <= 0 ||
+        (uintptr_t)vectors % VECTOR_DB_ALIGNMENT != 0) {
+        return 0;
+    }
+    
+    // ID と符号だけを確保する
+    int* new_ids = (int*)malloc(sizeof(int) * (size_t)count);
+    int8_t* new_codes = (int8_t*)malloc(VECTOR_DIM * (size_t)count);
+    float* new_scales = (float*)malloc(sizeof(float) * (size_t)count);
+    if (!new_ids || !new_codes || !new_scales) {
+        fprintf(stderr, "メモリ割り当てエラー: ベクトルデータベースを確保できませんでした\n");
+        free(new_ids);
+        free(new_codes);
+        free(new_scales);
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        new_ids[i] = ids[i];
+    }
+    if (codes && code_scales) {
+        memcpy(new_codes, codes, VECTOR_DIM * (size_t)count);
+        memcpy(new_scales, code_scales, sizeof(float) * (size_t)count);
+    } else {
+        for (int i = 0; i < count; i++) {
+            new_scales[i] = vector_quantize_int8(vectors + (size_t)i * VECTOR_DIM, VECTOR_DIM, new_codes + (size_t)i * VECTOR_DIM);
+        }
+    }
+    
+    free(db->vectors);
+    free(db->ids);
+    free(db->codes);
+    free(db->code_scales);
+    db->vectors = (float*)vectors;
+    db->ids = new_ids;
+    db->codes = new_codes;
+    db->code_scales = new_scales;
+    db->size = count;
+    db->capacity = count;
+    db->mapping = mapping;
+    db->mapping_size = mapping_size;
+    
+    // 行を読まずに済むよう、正規化済みかはファイルの情報に従う
+    db->normalized = normalized;
+    return 1;
+}
+
+// ベクトルのために確保しているメモリ
+size_t get_vector_db_bytes(const VectorDB* db) {
+    size_t row_bytes = sizeof(int);
+    if (!db->mapping) {
+        row_bytes += sizeof(float) * VECTOR_DIM;
+    }
+    if (db->storage == VECTOR_STORAGE_INT8) {
+        row_bytes += VECTOR_DIM + sizeof(float);
+    }
+    return (size_t)db->capacity * row_bytes;
+}
+
 // ベクトルをデータベースに追加
 int add_vector(VectorDB* db, float* vector, int id) {
-    if (db->size >= MAX_VECTORS) {
-        return 0;  // データベースが満杯
+    // 満杯なら2倍に拡張
+    if (db->size >= db->capacity) {
+        int new_capacity = db->capacity > 0 ? db->capacity * 2 : VECTOR_DB_INITIAL_CAPACITY;
+        if (!reserve_vector_db(db, new_capacity)) {
+            return 0;
+        }
     }
     
     // ベクトルをコピー
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        db->entries[db->size].vector[i] = vector[i];
+    memcpy(db->vectors + (size_t)db->size * VECTOR_DIM, vector, sizeof(float) * VECTOR_DIM);
+    db->ids[db->size] = id;
+    if (db->storage == VECTOR_STORAGE_INT8) {
+        db->code_scales[db->size] = vector_quantize_int8(vector, VECTOR_DIM, db->codes + (size_t)db->size * VECTOR_DIM);
     }
-    db->entries[db->size].id = id;
     db->size++;
     
+    // 正規化されていないベクトルが入ればコサイン類似度はノルムで割って求める
+    if (db->normalized && !vector_is_unit(vector, VECTOR_DIM)) {
+        db->normalized = false;
+    }
+    
     return 1;  // 成功
 }
 
+// 単語のハッシュ値（FNV-1a）
+static unsigned int word_hash(const char* word) {
+    unsigned int hash = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)word; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 単語 → エントリ番号のハッシュ表に登録（既にあれば何もしない）
+static void word_dictionary_insert(WordDictionary* dict, int index) {
+    const char* word = dict->arena + dict->word_offsets[index];
+    unsigned int mask = (unsigned int)dict->bucket_count - 1;
+    unsigned int slot = word_hash(word) & mask;
+    while (dict->buckets[slot] != -1) {
+        if (strcmp(dict->arena + dict->word_offsets[dict->buckets[slot]], word) == 0) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    dict->buckets[slot] = index;
+}
+
+// ハッシュ表を拡張して再配置
+static int word_dictionary_rehash(WordDictionary* dict, int new_bucket_count) {
+    int* new_buckets = (int*)malloc(sizeof(int) * new_bucket_count);
+    if (!new_buckets) {
+        return 0;
+    }
+    for (int i = 0; i < new_bucket_count; i++) {
+        new_buckets[i] = -1;
+    }
+    
+    int* old_buckets = dict->buckets;
+    dict->buckets = new_buckets;
+    dict->bucket_count = new_bucket_count;
+    
+    // 先に登録されたエントリを優先するため、番号順に入れ直す
+    for (int i = 0; i < dict->word_capacity; i++) {
+        if (dict->word_offsets[i] >= 0) {
+            word_dictionary_insert(dict, i);
+        }
+    }
+    
+    free(old_buckets);
+    return 1;
+}
+
+// エントリの単語を設定（同じ単語が既にあれば単語からの検索は先のエントリを返す）
+int set_vector_word(VectorDB* db, int index, const char* word) {
+    WordDictionary* dict = &db->words;
+    if (index < 0 || index >= db->size || !word) {
+        return 0;
+    }
+    
+    // エントリ番号 → 位置の表を確保
+    if (index >= dict->word_capacity) {
+        int new_capacity = dict->word_capacity > 0 ? dict->word_capacity : 1024;
+        while (new_capacity <= index) {
+            new_capacity *= 2;
+        }
+        int* new_offsets = (int*)realloc(dict->word_offsets, sizeof(int) * new_capacity);
+        if (!new_offsets) {
+            return 0;
+        }
+        for (int i = dict->word_capacity; i < new_capacity; i++) {
+            new_offsets[i] = -1;
+        }
+        dict->word_offsets = new_offsets;
+        dict->word_capacity = new_capacity;
+    }
+    if (dict->word_offsets[index] >= 0) {
+        return 0;  // 単語は一度だけ設定できる
+    }
+    
+    // 単語をアリーナに追加
+    size_t length = strlen(word) + 1;
+    if (dict->arena_used + length > dict->arena_capacity) {
+        size_t new_capacity = dict->arena_capacity > 0 ? dict->arena_capacity : WORD_ARENA_INITIAL_SIZE;
+        while (dict->arena_used + length > new_capacity) {
+            new_capacity *= 2;
+        }
+        char* new_arena = (char*)realloc(dict->arena, new_capacity);
+        if (!new_arena) {
+            return 0;
+        }
+        dict->arena = new_arena;
+        dict->arena_capacity = new_capacity;
+    }
+    memcpy(dict->arena + dict->arena_used, word, length);
+    dict->word_offsets[index] = (int)dict->arena_used;
+    dict->arena_used += length;
+    dict->word_count++;
+    
+    // 負荷率を 1/2 以下に保つ
+    if (dict->word_count * 2 > dict->bucket_count) {
+        int new_bucket_count = dict->bucket_count > 0 ? dict->bucket_count * 2 : WORD_BUCKETS_INITIAL_COUNT;
+        if (!word_dictionary_rehash(dict, new_bucket_count)) {
+            return 0;
+        }
+    } else {
+        word_dictionary_insert(dict, index);
+    }
+    
+    return 1;
+}
+
+// 単語付きでベクトルをデータベースに追加
+int add_word_vector(VectorDB* db, float* vector, int id, const char* word) {
+    if (!add_vector(db, vector, id)) {
+        return 0;
+    }
+    if (word) {
+        set_vector_word(db, db->size - 1, word);
+    }
+    return 1;
+}
+
+// エントリの単語を取得（なければ NULL）
+const char* get_vector_word(const VectorDB* db, int index) {
+    const WordDictionary* dict = &db->words;
+    if (index < 0 || index >= dict->word_capacity || dict->word_offsets[index] < 0) {
+        return NULL;
+    }
+    return dict->arena + dict->word_offsets[index];
+}
+
+// IDのエントリの単語を取得（なければ NULL）
+const char* get_vector_word_by_id(const VectorDB* db, int id) {
+    // 通常は ID とエントリ番号が一致する
+    if (id >= 0 && id < db->size && db->ids[id] == id) {
+        return get_vector_word(db, id);
+    }
+    for (int i = 0; i < db->size; i++) {
+        if (db->ids[i] == id) {
+            return get_vector_word(db, i);
+        }
+    }
+    return NULL;
+}
+
+// 単語のエントリ番号を取得（なければ -1）
+int find_vector_by_word(const VectorDB* db, const char* word) {
+    const WordDictionary* dict = &db->words;
+    if (!dict->buckets || !word) {
+        return -1;
+    }
+    
+    unsigned int mask = (unsigned int)dict->bucket_count - 1;
+    unsigned int slot = word_hash(word) & mask;
+    while (dict->buckets[slot] != -1) {
+        int index = dict->buckets[slot];
+        if (strcmp(dict->arena + dict->word_offsets[index], word) == 0) {
+            return index;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
 // ユークリッド距離の計算
 float euclidean_distance(float* v1, float* v2) {
-    float sum = 0.0f;
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        float diff = v1[i] - v2[i];
-        sum += diff * diff;
-    }
-    return sqrtf(sum);
+    return sqrtf(vector_squared_distance(v1, v2, VECTOR_DIM));
 }
 
 // コサイン類似度の計算
 float cosine_similarity(float* v1, float* v2) {
-    float dot_product = 0.0f;
-    float norm1 = 0.0f;
     float norm2 = 0.0f;
-    
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        dot_product += v1[i] * v2[i];
-        norm1 += v1[i] * v1[i];
-        norm2 += v2[i] * v2[i];
-    }
+    float dot_product = vector_dot_norm(v1, v2, VECTOR_DIM, &norm2);
+    float norm1 = vector_norm_squared(v1, VECTOR_DIM);
     
     if (norm1 == 0.0f || norm2 == 0.0f) {
         return 0.0f;
@@ -61,44 +429,77 @@ float cosine_similarity(float* v1, float* v2) {
     return dot_product / (sqrtf(norm1) * sqrtf(norm2));
 }
 
-// 最も近いベクトルを検索（ユークリッド距離）
-int search_nearest_euclidean(VectorDB* db, float* query_vector) {
+// 走査の対象としてデータベースの行列を渡す
+static VectorScanSource vector_db_scan_source(const VectorDB* db) {
+    VectorScanSource source;
+    source.vectors = db->vectors;
+    source.ids = db->ids;
+    source.count = db->size;
+    source.dim = VECTOR_DIM;
+    source.normalized = db->normalized;
+    source.codes = db->storage == VECTOR_STORAGE_INT8 ? db->codes : NULL;
+    source.code_scales = db->code_scales;
+    return source;
+}
+
+// 最も近いベクトルを1件検索（行が多ければ複数スレッドで走査する）
+static int search_nearest(VectorDB* db, VectorMetric metric, float* query_vector) {
     if (db->size == 0) {
         return -1;  // データベースが空
     }
     
-    float min_distance = FLT_MAX;
-    int nearest_id = -1;
-    
-    for (int i = 0; i < db->size; i++) {
-        float distance = euclidean_distance(query_vector, db->entries[i].vector);
-        if (distance < min_distance) {
-            min_distance = distance;
-            nearest_id = db->entries[i].id;
-        }
+    VectorScanSource source = vector_db_scan_source(db);
+    TopKItem nearest;
+    if (vector_scan_top_k(&source, metric, query_vector, 1, &nearest) == 0) {
+        return -1;
     }
-    
-    return nearest_id;
+    return nearest.id;
 }
 
-// 最も近いベクトルを検索（コサイン類似度）
-int search_nearest_cosine(VectorDB* db, float* query_vector) {
-    if (db->size == 0) {
-        return -1;  // データベースが空
+// 複数のクエリそれぞれで最も近いベクトルを検索
+static int search_nearest_batch(VectorDB* db, VectorMetric metric, const float* queries, int query_count, int* nearest_ids) {
+    if (query_count <= 0) {
+        return 1;
     }
     
-    float max_similarity = -1.0f;
-    int nearest_id = -1;
+    TopKItem* nearest = (TopKItem*)malloc(sizeof(TopKItem) * query_count);
+    int* counts = (int*)malloc(sizeof(int) * query_count);
+    if (!nearest || !counts) {
+        fprintf(stderr, "メモリ割り当てエラー: 検索結果の領域を確保できませんでした\n");
+        free(nearest);
+        free(counts);
+        return 0;
+    }
     
-    for (int i = 0; i < db->size; i++) {
-        float similarity = cosine_similarity(query_vector, db->entries[i].vector);
-        if (similarity > max_similarity) {
-            max_similarity = similarity;
-            nearest_id = db->entries[i].id;
-        }
+    VectorScanSource source = vector_db_scan_source(db);
+    int ok = vector_scan_batch_top_k(&source, metric, queries, query_count, 1, nearest, counts);
+    for (int q = 0; q < query_count; q++) {
+        nearest_ids[q] = ok && counts[q] > 0 ? nearest[q].id : -1;
     }
     
-    return nearest_id;
+    free(nearest);
+    free(counts);
+    return ok;
+}
+
+// 最も近いベクトルを検索（ユークリッド距離）
+int search_nearest_euclidean(VectorDB* db, float* query_vector) {
+    return search_nearest(db, VECTOR_METRIC_EUCLIDEAN, query_vector);
+}
+
+// 最も近いベクトルを検索（コサイン類似度）
+int search_nearest_cosine(VectorDB* db, float* query_vector) {
+    return search_nearest(db, VECTOR_METRIC_COSINE, query_vector);
+}
+
+// 複数のクエリそれぞれで最も近いベクトルを検索（ユークリッド距離）
+int search_nearest_euclidean_batch(VectorDB* db, const float* queries, int query_count, int* nearest_ids) {
+    return search_nearest_batch(db, VECTOR_METRIC_EUCLIDEAN, queries, query_count, nearest_ids);
+}
+
+// 複数のクエリそれぞれで最も近いベクトルを検索（コサイン類似度）
+int search_nearest_cosine_batch(VectorDB* db, const float* queries, int query_count, int* nearest_ids) {
+    return search_nearest_batch(db, VECTOR_METRIC_COSINE, queries, query_count, nearest_ids);
 }
 
 // ランダムなベクトルを生成
@@ -123,6 +524,56 @@ void normalize_vector(float* vector) {
     }
 }
 
+// 特徴のハッシュを次元に足し込む（符号もハッシュで決め、衝突による偏りを打ち消す）
+static void add_hashed_feature(float* vector, uint32_t hash) {
+    uint32_t mixed = hash * 2654435761u;
+    int index = (int)(mixed >> 26) % VECTOR_DIM;
+    vector[index] += (mixed & 0x02000000u) ? -1.0f : 1.0f;
+}
+
+// 2つのハッシュを組み合わせる
+static uint32_t combine_feature_hash(uint32_t a, uint32_t b) {
+    return a ^ (b + 0x9e3779b9u + (a << 6) + (a >> 2));
+}
+
+// テキストを文字 n-gram（1〜3文字）の特徴ハッシュでベクトル化
+void text_to_feature_vector(const char* text, float* vector) {
+    for (int i = 0; i < VECTOR_DIM; i++) {
+        vector[i] = 0.0f;
+    }
+    if (!text) {
+        return;
+    }
+    
+    // 1回の走査で全次元を求める（直前の2文字のハッシュだけを覚えておく）
+    const unsigned char* p = (const unsigned char*)text;
+    uint32_t previous = 0;
+    uint32_t before_previous = 0;
+    int chars = 0;
+    while (*p) {
+        // UTF-8 の1文字分のバイトをハッシュする
+        uint32_t hash = 2166136261u;
+        do {
+            hash ^= *p++;
+            hash *= 16777619u;
+        } while ((*p & 0xC0) == 0x80);
+        
+        add_hashed_feature(vector, hash);
+        if (chars >= 1) {
+            add_hashed_feature(vector, combine_feature_hash(previous, hash));
+        }
+        if (chars >= 2) {
+            add_hashed_feature(vector, combine_feature_hash(combine_feature_hash(before_previous, previous), hash));
+        }
+        
+        before_previous = previous;
+        previous = hash;
+        chars++;
+    }
+    
+    normalize_vector(vector);
+}
+
 // ベクトルの一部を表示
 void print_vector_preview(float* vector, int preview_size) {
     printf("[");
@@ -162,6 +613,7 @@ int main() {
         }
     }
     printf("%d ベクトルをデータベースに追加しました\n", db.size);
+    free_vector_db(&db);
 #else
 // ダミー関数（テスト用のベクトルをデータベースに追加）
 void add_test_vectors_to_db(VectorDB* db, int num_vectors) {
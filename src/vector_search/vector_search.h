@@ -1,42 +1,126 @@
 #ifndef VECTOR_SEARCH_H
 #define VECTOR_SEARCH_H
 
-#define MAX_VECTORS 25000   // 最大ベクトル数を25000に増加
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 #define VECTOR_DIM 64      // ベクトルの次元数
+#define VECTOR_DB_ALIGNMENT 64          // ベクトル行列の先頭の境界（バイト）
+#define VECTOR_DB_INITIAL_CAPACITY 256  // 最初に確保するベクトル数
 
-// ベクトルとそのIDを格納する構造体
+// 単語辞書（単語は文字列アリーナに詰め、ハッシュ表で単語から引く）
 typedef struct {
-    float vector[VECTOR_DIM];  // ベクトルデータ
-    int id;                    // ベクトルのID
-} VectorEntry;
+    char* arena;                       // '\0' 終端の単語を詰めた領域
+    size_t arena_used;
+    size_t arena_capacity;
+    int* word_offsets;                 // エントリ番号 → アリーナ内の位置（単語がなければ -1）
+    int word_capacity;
+    int* buckets;                      // 単語 → エントリ番号（オープンアドレス法、空きは -1）
+    int bucket_count;
+    int word_count;                    // 登録した単語数
+} WordDictionary;
+
+// ベクトルの持ち方
+typedef enum {
+    VECTOR_STORAGE_FLOAT = 0,          // float の行列だけを走査する
+    VECTOR_STORAGE_INT8                // int8 符号を走査し、上位の候補だけ float の行で計算し直す
+} VectorStorage;
 
-// ベクトルデータベース
+// ベクトルデータベース（ベクトルとIDを別々の配列に持ち、必要に応じて拡張する）
 typedef struct {
-    VectorEntry entries[MAX_VECTORS];  // ベクトルエントリの配列
+    float* vectors;                    // size × VECTOR_DIM の行列（行は連続、先頭は VECTOR_DB_ALIGNMENT 境界）
+    int* ids;                          // エントリ番号 → ID
     int size;                          // 現在のベクトル数
+    int capacity;                      // 確保済みのベクトル数
+    bool normalized;                   // 全エントリが単位ベクトルか（コサイン類似度を内積で計算できる）
+    VectorStorage storage;
+    int8_t* codes;                     // size × VECTOR_DIM の int8 符号（VECTOR_STORAGE_INT8 のとき）
+    float* code_scales;                // 行ごとの復元係数
+    void* mapping;                     // vectors がファイルの mmap 領域を指すときの領域（なければ NULL）
+    size_t mapping_size;
+    WordDictionary words;              // エントリの単語
 } VectorDB;
 
 // ベクトルデータベースの初期化
 void init_vector_db(VectorDB* db);
 
+// ベクトルデータベースの解放（空の状態に戻るので、そのまま再利用できる）
+void free_vector_db(VectorDB* db);
+
 // ベクトルデータベースのサイズを取得
 int get_vector_db_size(VectorDB* db);
 
+// 確保済みのベクトル数を取得
+int get_vector_db_capacity(VectorDB* db);
+
+// 少なくとも capacity 個のベクトルを入れられるように確保（失敗時は 0）
+int reserve_vector_db(VectorDB* db, int capacity);
+
+// 確保済みの領域を現在のベクトル数まで縮める（失敗時は 0、データはそのまま）
+int shrink_vector_db(VectorDB* db);
+
+// エントリのベクトル（VECTOR_DIM 個の float、mmap 領域を指すことがあるので書き換えない）
+const float* get_vector(const VectorDB* db, int index);
+
+// ベクトルの持ち方を切り替える（INT8 にすると既存の行も量子化する、失敗時は 0）
+int set_vector_db_storage(VectorDB* db, VectorStorage storage);
+
+// ファイルの mmap 領域にある float の行列をコピーせずに使う（空で VECTOR_STORAGE_INT8 のデータベースのみ）
+// ids と符号はコピーし、codes が NULL なら行から作る。領域は db が引き取り、解放や拡張のときに munmap する
+int map_vector_db(VectorDB* db, void* mapping, size_t mapping_size, const float* vectors, const int32_t* ids,
+                  const int8_t* codes, const float* code_scales, int count, bool normalized);
+
+// ベクトルのために確保しているメモリ（バイト、mmap 領域は含まない）
+size_t get_vector_db_bytes(const VectorDB* db);
+
 // ベクトルをデータベースに追加
 int add_vector(VectorDB* db, float* vector, int id);
 
+// 単語付きでベクトルをデータベースに追加
+int add_word_vector(VectorDB* db, float* vector, int id, const char* word);
+
+// エントリの単語を設定（同じ単語が既にあれば単語からの検索は先のエントリを返す）
+int set_vector_word(VectorDB* db, int index, const char* word);
+
+// エントリの単語を取得（なければ NULL）
+const char* get_vector_word(const VectorDB* db, int index);
+
+// IDのエントリの単語を取得（なければ NULL）
+const char* get_vector_word_by_id(const VectorDB* db, int id);
+
+// 単語のエントリ番号を取得（なければ -1）
+int find_vector_by_word(const VectorDB* db, const char* word);
+
+// ベクトル間のユークリッド距離を計算
+float euclidean_distance(float* v1, float* v2);
+
+// ベクトル間のコサイン類似度を計算
+float cosine_similarity(float* v1, float* v2);
+
 // ユークリッド距離で最も近いベクトルを検索
 int search_nearest_euclidean(VectorDB* db, float* query_vector);
 
 // コサイン類似度で最も近いベクトルを検索
 int search_nearest_cosine(VectorDB* db, float* query_vector);
 
+// 複数のクエリそれぞれでユークリッド距離が最も近いベクトルを検索
+// queries は query_count × VECTOR_DIM、nearest_ids[q] にIDが入る（失敗時は 0）
+int search_nearest_euclidean_batch(VectorDB* db, const float* queries, int query_count, int* nearest_ids);
+
+// 複数のクエリそれぞれでコサイン類似度が最も近いベクトルを検索
+int search_nearest_cosine_batch(VectorDB* db, const float* queries, int query_count, int* nearest_ids);
+
 // ランダムなベクトルを生成
 void generate_random_vector(float* vector);
 
 // ベクトルを正規化
 void normalize_vector(float* vector);
 
+// テキストを文字 n-gram の特徴ハッシュでベクトル化（テキストの長さに比例する時間、単位ベクトルにする）
+// 共通の文字列が多いテキストほど近いベクトルになる。空のテキストはゼロベクトル
+void text_to_feature_vector(const char* text, float* vector);
+
 // ベクトルの一部を表示
 void print_vector_preview(float* vector, int preview_size);
 
@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,21 +6,37 @@
 #include <time.h>
 #include <float.h>
 #include "vector_search_improved.h"
+#include "vector_distance.h"
+#include "vector_scan.h"
 
 // ベクトルデータベースの初期化
 void init_vector_db_improved(VectorDB* db) {
+    db->vectors = NULL;
+    db->ids = NULL;
     db->size = 0;
+    db->capacity = 0;
+    db->normalized = true;
     db->use_index = false;
-    db->index_map = NULL;
+    db->index = NULL;
+    db->index_m = 0;
+    db->index_ef_construction = 0;
+    db->index_ef_search = 0;
 }
 
 // ベクトルデータベースの解放
 void free_vector_db_improved(VectorDB* db) {
-    if (db->index_map) {
-        free(db->index_map);
-        db->index_map = NULL;
+    if (db->index) {
+        hnsw_free(db->index);
+        free(db->index);
+        db->index = NULL;
     }
+    free(db->vectors);
+    free(db->ids);
+    db->vectors = NULL;
+    db->ids = NULL;
     db->size = 0;
+    db->capacity = 0;
+    db->normalized = true;
     db->use_index = false;
 }
 
@@ -28,27 +45,77 @@ int get_vector_db_size_improved(VectorDB* db) {
     return db->size;
 }
 
+// 確保済みのベクトル数を取得
+int get_vector_db_capacity_improved(VectorDB* db) {
+    return db->capacity;
+}
+
+// ベクトル行列とID配列を capacity 個分に付け替える（capacity >= size）
+static int resize_vector_db_improved(VectorDB* db, int capacity) {
+    float* vectors = NULL;
+    if (capacity > 0 &&
+        posix_memalign((void**)&vectors, VECTOR_DB_ALIGNMENT, sizeof(float) * VECTOR_DIM * (size_t)capacity) != 0) {
+        fprintf(stderr, "メモリ割り当てエラー: ベクトルデータベースを拡張できませんでした\n");
+        return 0;
+    }
+    int* ids = (int*)realloc(db->ids, sizeof(int) * (capacity > 0 ? capacity : 1));
+    if (!ids) {
+        fprintf(stderr, "メモリ割り当てエラー: ベクトルデータベースを拡張できませんでした\n");
+        free(vectors);
+        return 0;
+    }
+    
+    // 行列は境界を保つため確保し直して移す（インデックスは行番号で参照するのでそのまま使える）
+    if (db->size > 0) {
+        memcpy(vectors, db->vectors, sizeof(float) * VECTOR_DIM * (size_t)db->size);
+    }
+    free(db->vectors);
+    db->vectors = vectors;
+    db->ids = ids;
+    db->capacity = capacity;
+    return 1;
+}
+
+// 少なくとも capacity 個のベクトルを入れられるように確保
+int reserve_vector_db_improved(VectorDB* db, int capacity) {
+    if (capacity <= db->capacity) {
+        return 1;
+    }
+    return resize_vector_db_improved(db, capacity);
+}
+
+// 確保済みの領域を現在のベクトル数まで縮める
+int shrink_vector_db_improved(VectorDB* db) {
+    if (db->capacity == db->size) {
+        return 1;
+    }
+    return resize_vector_db_improved(db, db->size);
+}
+
 // ベクトルをデータベースに追加
 int add_vector_improved(VectorDB* db, float* vector, int id) {
-    if (db->size >= MAX_VECTORS) {
-        return 0;  // データベースが満杯
+    // 満杯なら2倍に拡張
+    if (db->size >= db->capacity) {
+        int new_capacity = db->capacity > 0 ? db->capacity * 2 : VECTOR_DB_INITIAL_CAPACITY;
+        if (!reserve_vector_db_improved(db, new_capacity)) {
+            return 0;
+        }
     }
     
     // ベクトルをコピー
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        db->entries[db->size].vector[i] = vector[i];
-    }
-    db->entries[db->size].id = id;
-    db->entries[db->size].relevance = 0.0f;
+    memcpy(db->vectors + (size_t)db->size * VECTOR_DIM, vector, sizeof(float) * VECTOR_DIM);
+    db->ids[db->size] = id;
     db->size++;
     
-    // インデックスが構築されている場合は無効化
-    if (db->use_index) {
+    // 正規化されていないベクトルが入ればコサイン類似度はノルムで割って求める
+    if (db->normalized && !vector_is_unit(vector, VECTOR_DIM)) {
+        db->normalized = false;
+    }
+    
+    // インデックスが構築されている場合は追加分だけ挿入する
+    if (db->use_index && !hnsw_insert(db->index, db->vectors, sizeof(float) * VECTOR_DIM, db->size - 1)) {
+        // 挿入できなければインデックスを使わない（検索は全件走査に戻る）
         db->use_index = false;
-        if (db->index_map) {
-            free(db->index_map);
-            db->index_map = NULL;
-        }
     }
     
     return 1;  // 成功
@@ -56,25 +123,14 @@ int add_vector_improved(VectorDB* db, float* vector, int id) {
 
 // ユークリッド距離の計算
 float euclidean_distance_improved(float* v1, float* v2) {
-    float sum = 0.0f;
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        float diff = v1[i] - v2[i];
-        sum += diff * diff;
-    }
-    return sqrtf(sum);
+    return sqrtf(vector_squared_distance(v1, v2, VECTOR_DIM));
 }
 
 // コサイン類似度の計算
 float cosine_similarity_improved(float* v1, float* v2) {
-    float dot_product = 0.0f;
-    float norm1 = 0.0f;
     float norm2 = 0.0f;
-    
-    for (int i = 0; i < VECTOR_DIM; i++) {
-        dot_product += v1[i] * v2[i];
-        norm1 += v1[i] * v1[i];
-        norm2 += v2[i] * v2[i];
-    }
+    float dot_product = vector_dot_norm(v1, v2, VECTOR_DIM, &norm2);
+    float norm1 = vector_norm_squared(v1, VECTOR_DIM);
     
     if (norm1 == 0.0f || norm2 == 0.0f) {
         return 0.0f;
@@ -83,170 +139,238 @@ float cosine_similarity_improved(float* v1, float* v2) {
     return dot_product / (sqrtf(norm1) * sqrtf(norm2));
 }
 
-// 検索結果をスコアでソート（降順）
+// クエリとエントリのコサイン類似度（query_scale はクエリのノルムの逆数、ゼロベクトルなら 0）
+static float entry_cosine_improved(VectorDB* db, float* query_vector, float query_scale, int index) {
+    if (db->normalized) {
+        // 全エントリが単位ベクトルなら内積だけでよい
+        return vector_dot(query_vector, db->vectors + (size_t)index * VECTOR_DIM, VECTOR_DIM) * query_scale;
+    }
+    
+    float entry_norm = 0.0f;
+    float dot_product = vector_dot_norm(query_vector, db->vectors + (size_t)index * VECTOR_DIM, VECTOR_DIM, &entry_norm);
+    if (query_scale == 0.0f || entry_norm == 0.0f) {
+        return 0.0f;
+    }
+    return dot_product * query_scale / sqrtf(entry_norm);
+}
+
+// 検索結果をスコアでソート（降順、同じスコアは元の順を保つ）
 void sort_search_results(SearchResult* results) {
-    // バブルソート（結果数は少ないので十分）
-    for (int i = 0; i < results->count - 1; i++) {
-        for (int j = 0; j < results->count - i - 1; j++) {
-            if (results->scores[j] < results->scores[j + 1]) {
-                // スコアの交換
-                float temp_score = results->scores[j];
-                results->scores[j] = results->scores[j + 1];
-                results->scores[j + 1] = temp_score;
-                
-                // IDの交換
-                int temp_id = results->ids[j];
-                results->ids[j] = results->ids[j + 1];
-                results->ids[j + 1] = temp_id;
-            }
+    // 挿入ソート（結果数は少ないので十分）
+    for (int i = 1; i < results->count; i++) {
+        float score = results->scores[i];
+        int id = results->ids[i];
+        int j = i - 1;
+        while (j >= 0 && results->scores[j] < score) {
+            results->scores[j + 1] = results->scores[j];
+            results->ids[j + 1] = results->ids[j];
+            j--;
         }
+        results->scores[j + 1] = score;
+        results->ids[j + 1] = id;
     }
 }
 
-// 最も近いベクトルを検索（ユークリッド距離、複数結果）
-SearchResult search_nearest_euclidean_improved(VectorDB* db, float* query_vector, int max_results) {
+// 上位k件を SearchResult に詰める（MAX_SEARCH_RESULTS 件まで）
+static SearchResult search_result_from_top_k(const TopKItem* items, int count) {
     SearchResult result;
-    result.count = 0;
-    
-    if (db->size == 0 || max_results <= 0) {
-        return result;  // データベースが空または無効なmax_results
+    result.count = count < MAX_SEARCH_RESULTS ? count : MAX_SEARCH_RESULTS;
+    for (int i = 0; i < result.count; i++) {
+        result.ids[i] = items[i].id;
+        result.scores[i] = items[i].score;
     }
-    
-    // max_resultsの上限を設定
-    if (max_results > MAX_SEARCH_RESULTS) {
-        max_results = MAX_SEARCH_RESULTS;
+    return result;
+}
+
+// 走査の対象としてデータベースの行列を渡す
+static VectorScanSource vector_db_scan_source_improved(const VectorDB* db) {
+    VectorScanSource source;
+    source.vectors = db->vectors;
+    source.ids = db->ids;
+    source.count = db->size;
+    source.dim = VECTOR_DIM;
+    source.normalized = db->normalized;
+    source.codes = NULL;
+    source.code_scales = NULL;
+    return source;
+}
+
+// グラフをたどるかどうか（件数が少ないうちは全件走査でも速いので、厳密な結果を返す）
+static bool vector_db_index_usable(const VectorDB* db) {
+    return db->use_index && db->size >= VECTOR_DB_INDEX_MIN_SIZE;
+}
+
+// ユークリッド距離で上位k件を検索（スコアは距離の負値）
+int search_nearest_euclidean_top_k(VectorDB* db, float* query_vector, int k, TopKItem* results) {
+    if (db->size == 0 || k <= 0 || !results) {
+        return 0;  // データベースが空または無効なk
     }
     
-    // 結果数の上限はデータベースのサイズ
-    if (max_results > db->size) {
-        max_results = db->size;
+    // インデックスがあればグラフをたどる
+    if (vector_db_index_usable(db)) {
+        int count = hnsw_search(db->index, db->vectors, sizeof(float) * VECTOR_DIM, query_vector, k, 0, results);
+        for (int i = 0; i < count; i++) {
+            results[i].score = -sqrtf(-results[i].score);
+            results[i].id = db->ids[results[i].order];
+        }
+        return count;
     }
     
-    // 初期化：最初のmax_results個のエントリで結果を初期化
-    for (int i = 0; i < max_results; i++) {
-        float distance = euclidean_distance_improved(query_vector, db->entries[i].vector);
-        result.ids[i] = db->entries[i].id;
-        result.scores[i] = -distance;  // 距離の負値をスコアとして使用（大きいほど良い）
-        result.count++;
+    VectorScanSource source = vector_db_scan_source_improved(db);
+    return vector_scan_top_k(&source, VECTOR_METRIC_EUCLIDEAN, query_vector, k, results);
+}
+
+// コサイン類似度で上位k件を検索
+int search_nearest_cosine_top_k(VectorDB* db, float* query_vector, int k, TopKItem* results) {
+    if (db->size == 0 || k <= 0 || !results) {
+        return 0;  // データベースが空または無効なk
     }
     
-    // 結果をソート（スコア降順）
-    sort_search_results(&result);
-    
-    // 残りのエントリをチェック
-    for (int i = max_results; i < db->size; i++) {
-        float distance = euclidean_distance_improved(query_vector, db->entries[i].vector);
-        float score = -distance;
+    // 全エントリが単位ベクトルならユークリッド距離の順とコサイン類似度の順は同じなので、インデックスで候補を絞る
+    if (vector_db_index_usable(db) && db->normalized) {
+        // クエリのノルムは一度だけ求める
+        float query_norm = sqrtf(vector_norm_squared(query_vector, VECTOR_DIM));
+        float query_scale = query_norm > 0.0f ? 1.0f / query_norm : 0.0f;
+        
+        TopKSelector selector;
+        top_k_init(&selector, results, k);
+        
+        int count = hnsw_search(db->index, db->vectors, sizeof(float) * VECTOR_DIM, query_vector, k, 0, results);
         
-        // 最も低いスコアよりも高いスコアがあれば置き換え
-        if (score > result.scores[result.count - 1]) {
-            result.ids[result.count - 1] = db->entries[i].id;
-            result.scores[result.count - 1] = score;
-            
-            // 再ソート
-            sort_search_results(&result);
+        // 類似度を計算し直して並べ直す（先頭から順に読んだ要素を同じ領域のヒープへ入れる）
+        for (int i = 0; i < count; i++) {
+            int index = results[i].order;
+            top_k_push(&selector, entry_cosine_improved(db, query_vector, query_scale, index), db->ids[index], index);
         }
+        return top_k_finalize(&selector);
     }
     
-    return result;
+    VectorScanSource source = vector_db_scan_source_improved(db);
+    return vector_scan_top_k(&source, VECTOR_METRIC_COSINE, query_vector, k, results);
 }
 
-// 最も近いベクトルを検索（コサイン類似度、複数結果）
-SearchResult search_nearest_cosine_improved(VectorDB* db, float* query_vector, int max_results) {
-    SearchResult result;
-    result.count = 0;
+// 複数クエリの上位k件を検索
+static int search_top_k_batch_improved(VectorDB* db, VectorMetric metric, const float* queries, int query_count,
+                                       int k, TopKItem* results, int* result_counts) {
+    if (query_count <= 0) {
+        return 1;
+    }
+    if (!queries || !results || !result_counts) {
+        return 0;
+    }
     
-    if (db->size == 0 || max_results <= 0) {
-        return result;  // データベースが空または無効なmax_results
+    // インデックスがあればクエリごとにグラフをたどる
+    if (vector_db_index_usable(db) && (metric == VECTOR_METRIC_EUCLIDEAN || db->normalized)) {
+        for (int q = 0; q < query_count; q++) {
+            float* query = (float*)queries + (size_t)q * VECTOR_DIM;
+            result_counts[q] = metric == VECTOR_METRIC_EUCLIDEAN
+                ? search_nearest_euclidean_top_k(db, query, k, results + (size_t)q * k)
+                : search_nearest_cosine_top_k(db, query, k, results + (size_t)q * k);
+        }
+        return 1;
     }
     
+    VectorScanSource source = vector_db_scan_source_improved(db);
+    return vector_scan_batch_top_k(&source, metric, queries, query_count, k, results, result_counts);
+}
+
+// 複数クエリのユークリッド距離の上位k件を検索
+int search_nearest_euclidean_top_k_batch(VectorDB* db, const float* queries, int query_count, int k,
+                                         TopKItem* results, int* result_counts) {
+    return search_top_k_batch_improved(db, VECTOR_METRIC_EUCLIDEAN, queries, query_count, k, results, result_counts);
+}
+
+// 複数クエリのコサイン類似度の上位k件を検索
+int search_nearest_cosine_top_k_batch(VectorDB* db, const float* queries, int query_count, int k,
+                                      TopKItem* results, int* result_counts) {
+    return search_top_k_batch_improved(db, VECTOR_METRIC_COSINE, queries, query_count, k, results, result_counts);
+}
+
+// 最も近いベクトルを検索（ユークリッド距離、複数結果）
+SearchResult search_nearest_euclidean_improved(VectorDB* db, float* query_vector, int max_results) {
     // max_resultsの上限を設定
     if (max_results > MAX_SEARCH_RESULTS) {
         max_results = MAX_SEARCH_RESULTS;
     }
     
-    // 結果数の上限はデータベースのサイズ
-    if (max_results > db->size) {
-        max_results = db->size;
-    }
-    
-    // 初期化：最初のmax_results個のエントリで結果を初期化
-    for (int i = 0; i < max_results; i++) {
-        float similarity = cosine_similarity_improved(query_vector, db->entries[i].vector);
-        result.ids[i] = db->entries[i].id;
-        result.scores[i] = similarity;
-        result.count++;
-    }
-    
-    // 結果をソート（スコア降順）
-    sort_search_results(&result);
-    
-    // 残りのエントリをチェック
-    for (int i = max_results; i < db->size; i++) {
-        float similarity = cosine_similarity_improved(query_vector, db->entries[i].vector);
-        
-        // 最も低いスコアよりも高いスコアがあれば置き換え
-        if (similarity > result.scores[result.count - 1]) {
-            result.ids[result.count - 1] = db->entries[i].id;
-            result.scores[result.count - 1] = similarity;
-            
-            // 再ソート
-            sort_search_results(&result);
-        }
+    TopKItem items[MAX_SEARCH_RESULTS];
+    int count = search_nearest_euclidean_top_k(db, query_vector, max_results, items);
+    return search_result_from_top_k(items, count);
+}
+
+// 最も近いベクトルを検索（コサイン類似度、複数結果）
+SearchResult search_nearest_cosine_improved(VectorDB* db, float* query_vector, int max_results) {
+    // max_resultsの上限を設定
+    if (max_results > MAX_SEARCH_RESULTS) {
+        max_results = MAX_SEARCH_RESULTS;
     }
     
-    return result;
+    TopKItem items[MAX_SEARCH_RESULTS];
+    int count = search_nearest_cosine_top_k(db, query_vector, max_results, items);
+    return search_result_from_top_k(items, count);
 }
 
 // ハイブリッド検索（コサイン類似度とキーワードマッチングの組み合わせ）
 SearchResult search_hybrid_improved(VectorDB* db, float* query_vector, const char* query_text, int max_results) {
-    // まずコサイン類似度で検索
-    SearchResult result = search_nearest_cosine_improved(db, query_vector, max_results);
+    // max_resultsの上限を設定
+    if (max_results > MAX_SEARCH_RESULTS) {
+        max_results = MAX_SEARCH_RESULTS;
+    }
+    if (max_results <= 0) {
+        return search_result_from_top_k(NULL, 0);
+    }
+    
+    // まずコサイン類似度で候補を多めに集める
+    TopKItem candidates[HYBRID_SEARCH_CANDIDATES];
+    int candidate_count = search_nearest_cosine_top_k(db, query_vector, HYBRID_SEARCH_CANDIDATES, candidates);
     
     // キーワードマッチングのための重みを設定
     const float keyword_weight = 0.3f;  // キーワードマッチングの重み
     const float vector_weight = 0.7f;   // ベクトル類似度の重み
     
-    // クエリテキストが提供されている場合、キーワードマッチングを適用
-    if (query_text && strlen(query_text) > 0) {
-        // 簡易的なキーワード抽出（スペースで分割）
-        char query_copy[1024];
-        strncpy(query_copy, query_text, sizeof(query_copy) - 1);
-        query_copy[sizeof(query_copy) - 1] = '\0';
-        
-        char* keywords[20];  // 最大20キーワード
-        int keyword_count = 0;
-        
-        char* token = strtok(query_copy, " ,.");
-        while (token && keyword_count < 20) {
-            keywords[keyword_count++] = token;
-            token = strtok(NULL, " ,.");
-        }
+    // クエリテキストがなければ類似度の上位をそのまま返す
+    if (!query_text || strlen(query_text) == 0) {
+        return search_result_from_top_k(candidates, candidate_count < max_results ? candidate_count : max_results);
+    }
+    
+    // 簡易的なキーワード抽出（スペースで分割）
+    char query_copy[1024];
+    strncpy(query_copy, query_text, sizeof(query_copy) - 1);
+    query_copy[sizeof(query_copy) - 1] = '\0';
+    
+    char* keywords[20];  // 最大20キーワード
+    int keyword_count = 0;
+    
+    char* token = strtok(query_copy, " ,.");
+    while (token && keyword_count < 20) {
+        keywords[keyword_count++] = token;
+        token = strtok(NULL, " ,.");
+    }
+    
+    // 各候補のスコアを調整し、上位max_results件を選び直す
+    TopKItem items[MAX_SEARCH_RESULTS];
+    TopKSelector selector;
+    top_k_init(&selector, items, max_results);
+    
+    for (int i = 0; i < candidate_count; i++) {
+        int id = candidates[i].id;
+        float vector_score = candidates[i].score;
+        float keyword_score = 0.0f;
         
-        // 各結果のスコアを調整
-        for (int i = 0; i < result.count; i++) {
-            int id = result.ids[i];
-            float vector_score = result.scores[i];
-            float keyword_score = 0.0f;
-            
-            // ここでは仮のキーワードスコアを設定
-            // 実際の実装では、ドキュメントの内容とキーワードのマッチングを行う
-            // この例では、IDが偶数の場合に高いスコアを与える単純な例
-            if (id % 2 == 0) {
-                keyword_score = 0.8f;
-            } else {
-                keyword_score = 0.2f;
-            }
-            
-            // 最終スコアを計算
-            result.scores[i] = vector_weight * vector_score + keyword_weight * keyword_score;
+        // ここでは仮のキーワードスコアを設定
+        // 実際の実装では、ドキュメントの内容とキーワードのマッチングを行う
+        // この例では、IDが偶数の場合に高いスコアを与える単純な例
+        if (id % 2 == 0) {
+            keyword_score = 0.8f;
+        } else {
+            keyword_score = 0.2f;
         }
         
-        // 調整後のスコアで再ソート
-        sort_search_results(&result);
+        // 最終スコアを計算（同じスコアなら類似度の順位を優先）
+        top_k_push(&selector, vector_weight * vector_score + keyword_weight * keyword_score, id, i);
     }
     
-    return result;
+    return search_result_from_top_k(items, top_k_finalize(&selector));
 }
 
 // ベクトルデータベースのインデックスを構築
@@ -256,25 +380,40 @@ void build_vector_db_index(VectorDB* db) {
     }
     
     // 既存のインデックスを解放
-    if (db->index_map) {
-        free(db->index_map);
-    }
-    
-    // 新しいインデックスを割り当て
-    db->index_map = (int*)malloc(sizeof(int) * db->size);
-    if (!db->index_map) {
-        db->use_index = false;
-        return;  // メモリ割り当て失敗
+    if (db->index) {
+        hnsw_free(db->index);
+    } else {
+        db->index = (HnswIndex*)malloc(sizeof(HnswIndex));
+        if (!db->index) {
+            fprintf(stderr, "メモリ割り当てエラー: インデックスを作成できませんでした\n");
+            db->use_index = false;
+            return;
+        }
     }
+    db->use_index = false;
     
-    // 単純なインデックスマッピング（将来的に改良可能）
+    // 格納順にグラフへ挿入
+    hnsw_init(db->index, VECTOR_DIM, db->index_m, db->index_ef_construction, db->index_ef_search);
     for (int i = 0; i < db->size; i++) {
-        db->index_map[i] = i;
+        if (!hnsw_insert(db->index, db->vectors, sizeof(float) * VECTOR_DIM, i)) {
+            hnsw_free(db->index);
+            return;  // メモリ割り当て失敗（全件走査のまま）
+        }
     }
     
     db->use_index = true;
 }
 
+// インデックスのパラメータを設定
+void configure_vector_db_index(VectorDB* db, int m, int ef_construction, int ef_search) {
+    db->index_m = m > 0 ? m : 0;
+    db->index_ef_construction = ef_construction > 0 ? ef_construction : 0;
+    db->index_ef_search = ef_search > 0 ? ef_search : 0;
+    if (db->index) {
+        db->index->ef_search = ef_search > 0 ? ef_search : HNSW_DEFAULT_EF_SEARCH;
+    }
+}
+
 // ランダムなベクトルを生成
 void generate_random_vector_improved(float* vector) {
     for (int i = 0; i < VECTOR_DIM; i++) {
@@ -2,17 +2,15 @@
 #define VECTOR_SEARCH_IMPROVED_H
 
 #include <stdbool.h>
+#include "vector_distance.h"
+#include "hnsw_index.h"
 
-#define MAX_VECTORS 25000   // 最大ベクトル数
 #define VECTOR_DIM 64      // ベクトルの次元数
-#define MAX_SEARCH_RESULTS 10  // 検索結果の最大数
-
-// ベクトルとそのIDを格納する構造体
-typedef struct {
-    float vector[VECTOR_DIM];  // ベクトルデータ
-    int id;                    // ベクトルのID
-    float relevance;           // 関連性スコア（検索結果用）
-} VectorEntry;
+#define VECTOR_DB_ALIGNMENT 64          // ベクトル行列の先頭の境界（バイト）
+#define VECTOR_DB_INITIAL_CAPACITY 256  // 最初に確保するベクトル数
+#define MAX_SEARCH_RESULTS 10  // 検索結果の最大数（SearchResult に入る件数）
+#define HYBRID_SEARCH_CANDIDATES 100  // ハイブリッド検索で再順位付けする候補数
+#define VECTOR_DB_INDEX_MIN_SIZE 16384  // これより少ないうちはインデックスがあっても全件走査する（厳密な結果を返す）
 
 // 検索結果構造体
 typedef struct {
@@ -21,13 +19,18 @@ typedef struct {
     int count;                         // 実際の結果数
 } SearchResult;
 
-// ベクトルデータベース
+// ベクトルデータベース（ベクトルとIDを別々の配列に持ち、必要に応じて拡張する）
 typedef struct {
-    VectorEntry entries[MAX_VECTORS];  // ベクトルエントリの配列
+    float* vectors;                    // size × VECTOR_DIM の行列（行は連続、先頭は VECTOR_DB_ALIGNMENT 境界）
+    int* ids;                          // エントリ番号 → ID
     int size;                          // 現在のベクトル数
+    int capacity;                      // 確保済みのベクトル数
+    bool normalized;                   // 全エントリが単位ベクトルか（コサイン類似度を内積で計算できる）
     bool use_index;                    // インデックスを使用するかどうか
-    // 簡易インデックス構造（将来的に拡張可能）
-    int* index_map;                    // インデックスマッピング
+    HnswIndex* index;                  // 近似最近傍探索のグラフ（use_index のときだけ使う）
+    int index_m;                       // グラフの近傍数（0 なら既定値）
+    int index_ef_construction;         // 追加時に調べる候補数（0 なら既定値）
+    int index_ef_search;               // 検索時に調べる候補数（0 なら既定値）
 } VectorDB;
 
 // ベクトルデータベースの初期化
@@ -39,6 +42,15 @@ void free_vector_db_improved(VectorDB* db);
 // ベクトルデータベースのサイズを取得
 int get_vector_db_size_improved(VectorDB* db);
 
+// 確保済みのベクトル数を取得
+int get_vector_db_capacity_improved(VectorDB* db);
+
+// 少なくとも capacity 個のベクトルを入れられるように確保（失敗時は 0）
+int reserve_vector_db_improved(VectorDB* db, int capacity);
+
+// 確保済みの領域を現在のベクトル数まで縮める（失敗時は 0、データはそのまま）
+int shrink_vector_db_improved(VectorDB* db);
+
 // ベクトルをデータベースに追加
 int add_vector_improved(VectorDB* db, float* vector, int id);
 
@@ -48,6 +60,21 @@ SearchResult search_nearest_euclidean_improved(VectorDB* db, float* query_vector
 // コサイン類似度で最も近いベクトルを検索（複数結果）
 SearchResult search_nearest_cosine_improved(VectorDB* db, float* query_vector, int max_results);
 
+// ユークリッド距離で上位k件を検索（results は k 件分、スコアの降順に並べて件数を返す）
+int search_nearest_euclidean_top_k(VectorDB* db, float* query_vector, int k, TopKItem* results);
+
+// コサイン類似度で上位k件を検索（results は k 件分、スコアの降順に並べて件数を返す）
+int search_nearest_cosine_top_k(VectorDB* db, float* query_vector, int k, TopKItem* results);
+
+// 複数クエリのユークリッド距離の上位k件を一度の走査で検索（queries は query_count × VECTOR_DIM）
+// results は query_count × k 件分で、クエリ q の結果は results + q * k、件数は result_counts[q] に入る
+int search_nearest_euclidean_top_k_batch(VectorDB* db, const float* queries, int query_count, int k,
+                                         TopKItem* results, int* result_counts);
+
+// 複数クエリのコサイン類似度の上位k件を一度の走査で検索
+int search_nearest_cosine_top_k_batch(VectorDB* db, const float* queries, int query_count, int k,
+                                      TopKItem* results, int* result_counts);
+
 // ハイブリッド検索（コサイン類似度とキーワードマッチングの組み合わせ）
 SearchResult search_hybrid_improved(VectorDB* db, float* query_vector, const char* query_text, int max_results);
 
@@ -60,16 +87,20 @@ void normalize_vector_improved(float* vector);
 // ベクトルの一部を表示
 void print_vector_preview_improved(float* vector, int preview_size);
 
-// ベクトルデータベースのインデックスを構築
+// ベクトルデータベースのインデックスを構築（以降の追加はインデックスにも入り、検索はインデックスを通る）
 void build_vector_db_index(VectorDB* db);
 
+// インデックスのパラメータを設定（0 以下は既定値）
+// m と ef_construction は次の構築から、ef_search はすぐに反映される
+void configure_vector_db_index(VectorDB* db, int m, int ef_construction, int ef_search);
+
 // ベクトル間のユークリッド距離を計算
 float euclidean_distance_improved(float* v1, float* v2);
 
 // ベクトル間のコサイン類似度を計算
 float cosine_similarity_improved(float* v1, float* v2);
 
-// 検索結果をスコアでソート
+// 検索結果をスコアでソート（同じスコアは元の順を保つ）
 void sort_search_results(SearchResult* results);
 
 #endif // VECTOR_SEARCH_IMPROVED_H
\ No newline at end of file